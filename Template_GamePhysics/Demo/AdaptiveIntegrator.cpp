@@ -0,0 +1,223 @@
+#include "AdaptiveIntegrator.h"
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+
+//Dormand-Prince 5(4) tableau
+static const float dp_a[7][6] = {
+	{ 0, 0, 0, 0, 0, 0 },
+	{ 1.f/5, 0, 0, 0, 0, 0 },
+	{ 3.f/40, 9.f/40, 0, 0, 0, 0 },
+	{ 44.f/45, -56.f/15, 32.f/9, 0, 0, 0 },
+	{ 19372.f/6561, -25360.f/2187, 64448.f/6561, -212.f/729, 0, 0 },
+	{ 9017.f/3168, -355.f/33, 46732.f/5247, 49.f/176, -5103.f/18656, 0 },
+	{ 35.f/384, 0, 500.f/1113, 125.f/192, -2187.f/6784, 11.f/84 }
+};
+//5th order weights are the last row of the tableau (FSAL), these are the differences to the 4th order weights
+static const float dp_e[7] = { 71.f/57600, 0, -71.f/16695, 71.f/1920, -17253.f/339200, 22.f/525, -1.f/40 };
+
+AdaptiveIntegrator::AdaptiveIntegrator()
+{
+	tolerance = 1e-4f;
+	minStep = 1e-5f;
+	maxStep = 0.05f;
+	safety = 0.9f;
+	maxGrowth = 5.0f;
+	maxShrink = 0.2f;
+	reset();
+}
+
+void AdaptiveIntegrator::reset()
+{
+	currentStep = 0.001f;
+	acceptedSteps = rejectedSteps = 0;
+	frameAcceptedSteps = frameRejectedSteps = 0;
+	lastStep = 0;
+	lastError = 0;
+}
+
+void AdaptiveIntegrator::gatherTopology(std::list<SpringPoint*>& points, std::list<Spring>& springs)
+{
+	//the pointer to index map only has to be rebuilt when the point list changed
+	if(pointVec.size() != points.size() || !std::equal(points.begin(), points.end(), pointVec.begin())) {
+		pointVec.assign(points.begin(), points.end());
+		indexOf.clear();
+		for(size_t i = 0; i < pointVec.size(); i++)
+			indexOf[pointVec[i]] = (int)i;
+	}
+	size_t n = pointVec.size();
+	invMass.resize(n);
+	damping.resize(n);
+	for(size_t i = 0; i < n; i++) {
+		invMass[i] = pointVec[i]->gp_isStatic ? 0.0f : 1.0f/pointVec[i]->gp_mass;
+		damping[i] = pointVec[i]->gp_damping;
+	}
+
+	//springs store pointers, map them to indices once per advance
+	springFirst.clear(); springSecond.clear(); springStiffness.clear(); springRestLength.clear();
+	for(auto spring = springs.begin(); spring != springs.end(); spring++) {
+		auto i1 = indexOf.find(spring->gs_point1);
+		auto i2 = indexOf.find(spring->gs_point2);
+		if(i1 == indexOf.end() || i2 == indexOf.end())
+			continue;
+		springFirst.push_back(i1->second);
+		springSecond.push_back(i2->second);
+		springStiffness.push_back(spring->gs_stiffness);
+		springRestLength.push_back(spring->gs_initialLength);
+	}
+
+	y0.resize(2*n); y1.resize(2*n); yTmp.resize(2*n); yErr.resize(2*n);
+	for(int s = 0; s < 7; s++)
+		k[s].resize(2*n);
+}
+
+void AdaptiveIntegrator::evaluate(const std::vector<XMFLOAT3>& y, std::vector<XMFLOAT3>& dydt)
+{
+	size_t n = pointVec.size();
+	//dx/dt = v, dv/dt = a
+	for(size_t i = 0; i < n; i++) {
+		if(invMass[i] == 0.0f) {
+			dydt[i] = XMFLOAT3(0,0,0);
+			dydt[n+i] = XMFLOAT3(0,0,0);
+			continue;
+		}
+		dydt[i] = y[n+i];
+		dydt[n+i] = XMFLOAT3(0, gravityAcc, 0);
+		if(dampingOn)
+			dydt[n+i] = subVector(dydt[n+i], multiplyVector(y[n+i], damping[i]));
+	}
+	//-k(l-L)(xi-xj)/l
+	for(size_t s = 0; s < springFirst.size(); s++) {
+		int i1 = springFirst[s], i2 = springSecond[s];
+		XMFLOAT3 d = subVector(y[i1], y[i2]);
+		float l = vectorLength(d);
+		if(l <= 0.0f)
+			continue;
+		XMFLOAT3 f = multiplyVector(d, -springStiffness[s]*(l-springRestLength[s])/l);
+		dydt[n+i1] = addVector(dydt[n+i1], multiplyVector(f, invMass[i1]));
+		dydt[n+i2] = subVector(dydt[n+i2], multiplyVector(f, invMass[i2]));
+	}
+}
+
+//yTmp = y0 + h * sum(a_sj * k_j)
+void AdaptiveIntegrator::stage(int s, float h)
+{
+	size_t m = y0.size();
+	for(size_t i = 0; i < m; i++) {
+		XMFLOAT3 sum = y0[i];
+		for(int j = 0; j < s; j++) {
+			if(dp_a[s][j] != 0.0f)
+				sum = addVector(sum, multiplyVector(k[j][i], h*dp_a[s][j]));
+		}
+		yTmp[i] = sum;
+	}
+}
+
+//scaled RMS norm of the embedded error estimate, <= 1 means the step is accepted
+float AdaptiveIntegrator::errorNorm()
+{
+	size_t m = y0.size();
+	if(m == 0)
+		return 0.0f;
+	double sum = 0;
+	for(size_t i = 0; i < m; i++) {
+		const float* e = &yErr[i].x;
+		const float* a = &y0[i].x;
+		const float* b = &y1[i].x;
+		for(int c = 0; c < 3; c++) {
+			float scale = tolerance + tolerance*std::max(fabsf(a[c]), fabsf(b[c]));
+			float r = e[c]/scale;
+			sum += r*r;
+		}
+	}
+	return (float)sqrt(sum/(3*m));
+}
+
+void AdaptiveIntegrator::writeBack()
+{
+	size_t n = pointVec.size();
+	for(size_t i = 0; i < n; i++) {
+		if(pointVec[i]->gp_isStatic)
+			continue;
+		pointVec[i]->gp_position = y0[i];
+		pointVec[i]->gp_velocity = y0[n+i];
+	}
+}
+
+void AdaptiveIntegrator::advance(std::list<SpringPoint*>& points, std::list<Spring>& springs, float interval, float gravity, bool useGravity, bool useDamping,
+	std::function<void(SpringPoint*, float)> collide)
+{
+	frameAcceptedSteps = frameRejectedSteps = 0;
+	if(interval <= 0.0f || points.empty())
+		return;
+
+	gatherTopology(points, springs);
+	gravityAcc = useGravity ? gravity : 0.0f;
+	dampingOn = useDamping;
+
+	size_t n = pointVec.size();
+	for(size_t i = 0; i < n; i++) {
+		y0[i] = pointVec[i]->gp_position;
+		y0[n+i] = pointVec[i]->gp_velocity;
+	}
+
+	float t = 0.0f;
+	float h = std::min(std::max(currentStep, minStep), maxStep);
+	while(t < interval) {
+		//do not step past the end of the frame, but remember the controller's step for the next frame
+		float hStep = std::min(h, interval - t);
+		bool clipped = hStep < h;
+
+		evaluate(y0, k[0]);
+		for(int s = 1; s < 7; s++) {
+			stage(s, hStep);
+			evaluate(yTmp, k[s]);
+		}
+		//the last stage point is the 5th order solution
+		y1 = yTmp;
+		size_t m = y0.size();
+		for(size_t i = 0; i < m; i++) {
+			XMFLOAT3 e(0,0,0);
+			for(int s = 0; s < 7; s++) {
+				if(dp_e[s] != 0.0f)
+					e = addVector(e, multiplyVector(k[s][i], hStep*dp_e[s]));
+			}
+			yErr[i] = e;
+		}
+
+		float err = errorNorm();
+		float factor = (err > 0.0f) ? safety*powf(err, -0.2f) : maxGrowth;
+		factor = std::min(maxGrowth, std::max(maxShrink, factor));
+
+		if(err <= 1.0f || hStep <= minStep) {
+			//accepted
+			y0.swap(y1);
+			t += hStep;
+			frameAcceptedSteps++;
+			lastStep = hStep;
+			lastError = err;
+			if(collide) {
+				writeBack();
+				for(size_t i = 0; i < n; i++) {
+					collide(pointVec[i], hStep);
+					y0[i] = pointVec[i]->gp_position;
+					y0[n+i] = pointVec[i]->gp_velocity;
+				}
+			}
+			//a step shortened by the frame end says nothing about the step the error would allow
+			if(!clipped)
+				h = std::min(maxStep, hStep*factor);
+		}
+		else {
+			frameRejectedSteps++;
+			h = std::max(minStep, hStep*factor);
+		}
+	}
+	writeBack();
+	currentStep = h;
+	acceptedSteps += frameAcceptedSteps;
+	rejectedSteps += frameRejectedSteps;
+}
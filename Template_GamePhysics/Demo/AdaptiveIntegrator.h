@@ -0,0 +1,74 @@
+#pragma once
+#ifndef AdaptiveIntegrator_HEADER
+#define AdaptiveIntegrator_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include <list>
+#include <functional>
+#include <unordered_map>
+#include "point.h"
+#include "spring.h"
+
+// Embedded Runge-Kutta (Dormand-Prince 5(4)) integrator for the mass spring system.
+// Advances a whole frame interval with as many internal steps as the error tolerance requires,
+// rejecting steps whose error estimate is too large and growing the step when the error allows it.
+class AdaptiveIntegrator
+{
+public:
+	//error tolerance, used as absolute and relative tolerance per state component
+	float tolerance;
+	float minStep;
+	float maxStep;
+	//step size controller: new step = step * clamp(safety * err^(-1/5), maxShrink, maxGrowth)
+	float safety;
+	float maxGrowth;
+	float maxShrink;
+
+	//statistics, accumulated since the last reset (the frame values are overwritten every advance())
+	int acceptedSteps;
+	int rejectedSteps;
+	int frameAcceptedSteps;
+	int frameRejectedSteps;
+	float lastStep;
+	float lastError;
+
+	AdaptiveIntegrator();
+
+	void reset();
+	//integrates springs and points over the given interval. the collision callback is called for every point after each accepted step
+	void advance(std::list<SpringPoint*>& points, std::list<Spring>& springs, float interval, float gravity, bool useGravity, bool useDamping,
+		std::function<void(SpringPoint*, float)> collide);
+
+private:
+	float currentStep;
+
+	//flattened topology, gathered at the start of every advance(): pointVec and indexOf are only rebuilt
+	//when the point list changed (other points or another order), the per point values and the spring
+	//arrays are refilled every time as springs can tear between frames
+	std::vector<SpringPoint*> pointVec;
+	std::unordered_map<SpringPoint*, int> indexOf;
+	std::vector<int> springFirst;
+	std::vector<int> springSecond;
+	std::vector<float> springStiffness;
+	std::vector<float> springRestLength;
+	std::vector<float> invMass;
+	std::vector<float> damping;
+
+	//state (positions followed by velocities) and stage derivatives
+	std::vector<XMFLOAT3> y0, y1, yTmp, yErr;
+	std::vector<XMFLOAT3> k[7];
+
+	float gravityAcc;
+	bool dampingOn;
+
+	void gatherTopology(std::list<SpringPoint*>& points, std::list<Spring>& springs);
+	void evaluate(const std::vector<XMFLOAT3>& y, std::vector<XMFLOAT3>& dydt);
+	void stage(int s, float h);
+	float errorNorm();
+	void writeBack();
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include "BoxCollision.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+//centre, unit axes and half extents of a transformed unit cube
+struct OrientedBox
+{
+	float centre[3];
+	float axes[3][3];
+	float half[3];
+};
+
+static float dot(const float* a, const float* b)
+{
+	return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static OrientedBox makeBox(const XMFLOAT4X4& m)
+{
+	OrientedBox box;
+	for(int i = 0; i < 3; i++) {
+		float length = std::sqrt(m.m[i][0]*m.m[i][0] + m.m[i][1]*m.m[i][1] + m.m[i][2]*m.m[i][2]);
+		for(int k = 0; k < 3; k++)
+			box.axes[i][k] = m.m[i][k]/length;
+		box.half[i] = 0.5f*length;
+		box.centre[i] = m.m[3][i];
+	}
+	return box;
+}
+
+//projected radius of a box onto a direction
+static float radius(const OrientedBox& box, const float* direction)
+{
+	return box.half[0]*std::abs(dot(box.axes[0], direction)) + box.half[1]*std::abs(dot(box.axes[1], direction)) + box.half[2]*std::abs(dot(box.axes[2], direction));
+}
+
+//separation along axis 0-14, the direction is normalised and points from A to B.
+//returns false for cross products of (nearly) parallel edges, those axes are covered by the face axes
+static bool testAxis(const OrientedBox& a, const OrientedBox& b, int axis, float& separation, float* direction)
+{
+	if(axis < 3)
+		for(int k = 0; k < 3; k++)
+			direction[k] = a.axes[axis][k];
+	else if(axis < 6)
+		for(int k = 0; k < 3; k++)
+			direction[k] = b.axes[axis-3][k];
+	else {
+		const float* u = a.axes[(axis-6)/3];
+		const float* v = b.axes[(axis-6)%3];
+		direction[0] = u[1]*v[2] - u[2]*v[1];
+		direction[1] = u[2]*v[0] - u[0]*v[2];
+		direction[2] = u[0]*v[1] - u[1]*v[0];
+		float length = std::sqrt(dot(direction, direction));
+		if(length < 1e-4f)
+			return false;
+		for(int k = 0; k < 3; k++)
+			direction[k] /= length;
+	}
+	float offset[3] = { b.centre[0] - a.centre[0], b.centre[1] - a.centre[1], b.centre[2] - a.centre[2] };
+	float distance = dot(offset, direction);
+	if(distance < 0.f) {
+		distance = -distance;
+		for(int k = 0; k < 3; k++)
+			direction[k] = -direction[k];
+	}
+	separation = distance - radius(a, direction) - radius(b, direction);
+	return true;
+}
+
+//polygon vertex with the feature it came from
+struct ClipVertex
+{
+	float p[3];
+	int feature;
+};
+
+//keeps the part of the polygon with dot(p, normal) <= offset
+static int clipPolygon(const ClipVertex* in, int count, const float* normal, float offset, int plane, ClipVertex* out)
+{
+	int result = 0;
+	for(int i = 0; i < count; i++) {
+		const ClipVertex& a = in[i];
+		const ClipVertex& b = in[(i+1)%count];
+		float da = dot(a.p, normal) - offset, db = dot(b.p, normal) - offset;
+		//the same inside test for both, else a vertex on the plane is emitted twice and a
+		//quad clipped four times no longer fits into eight vertices
+		bool insideA = da <= 0.f, insideB = db <= 0.f;
+		if(insideA)
+			out[result++] = a;
+		if(insideA != insideB) {
+			float t = da/(da - db);
+			ClipVertex& v = out[result++];
+			for(int k = 0; k < 3; k++)
+				v.p[k] = a.p[k] + t*(b.p[k] - a.p[k]);
+			//the edge that was cut and the plane that cut it
+			v.feature = (16 + 4*plane + (a.feature & 3)) & 63;
+		}
+	}
+	return result;
+}
+
+static void faceContact(const OrientedBox& a, const OrientedBox& b, int axis, const float* direction, ContactManifold& manifold)
+{
+	//the reference face belongs to the box the axis came from, n points from it to the incident box
+	bool referenceIsA = axis < 3;
+	const OrientedBox& reference = referenceIsA ? a : b;
+	const OrientedBox& incident = referenceIsA ? b : a;
+	int face = referenceIsA ? axis : axis - 3;
+	float n[3];
+	for(int k = 0; k < 3; k++)
+		n[k] = referenceIsA ? direction[k] : -direction[k];
+
+	//the incident face is the one most opposed to n
+	int incidentAxis = 0;
+	float best = -1.f;
+	for(int i = 0; i < 3; i++) {
+		float d = std::abs(dot(incident.axes[i], n));
+		if(d > best) {
+			best = d;
+			incidentAxis = i;
+		}
+	}
+	float sign = dot(incident.axes[incidentAxis], n) > 0.f ? -1.f : 1.f;
+	int p = (incidentAxis + 1) % 3, q = (incidentAxis + 2) % 3;
+	ClipVertex polygon[8], clipped[8];
+	const float corners[4][2] = { { 1.f, 1.f }, { -1.f, 1.f }, { -1.f, -1.f }, { 1.f, -1.f } };
+	for(int v = 0; v < 4; v++) {
+		for(int k = 0; k < 3; k++)
+			polygon[v].p[k] = incident.centre[k] + sign*incident.half[incidentAxis]*incident.axes[incidentAxis][k]
+				+ corners[v][0]*incident.half[p]*incident.axes[p][k] + corners[v][1]*incident.half[q]*incident.axes[q][k];
+		polygon[v].feature = v;
+	}
+
+	//clip against the four side planes of the reference face
+	int count = 4;
+	int sides[2] = { (face + 1) % 3, (face + 2) % 3 };
+	for(int s = 0; s < 4 && count > 0; s++) {
+		const float* axisDirection = reference.axes[sides[s/2]];
+		float sideNormal[3];
+		for(int k = 0; k < 3; k++)
+			sideNormal[k] = (s & 1) ? -axisDirection[k] : axisDirection[k];
+		float offset = dot(reference.centre, sideNormal) + reference.half[sides[s/2]];
+		ClipVertex* from = (s & 1) ? clipped : polygon;
+		ClipVertex* to = (s & 1) ? polygon : clipped;
+		count = clipPolygon(from, count, sideNormal, offset, s, to);
+	}
+
+	//keep the points below the reference face, depth along n
+	float faceOffset = dot(reference.centre, n) + reference.half[face];
+	float depths[8];
+	int kept = 0, deepest = -1;
+	for(int i = 0; i < count; i++) {
+		float depth = faceOffset - dot(polygon[i].p, n);
+		if(deepest < 0 || depth > depths[deepest])
+			deepest = i;
+		depths[i] = depth;
+		if(depth >= 0.f)
+			kept++;
+	}
+	int chosen[8];
+	int chosenCount = 0;
+	for(int i = 0; i < count; i++)
+		if(depths[i] >= 0.f || (kept == 0 && i == deepest))
+			chosen[chosenCount++] = i;
+
+	//more than four: the deepest, the one farthest from it, then the ones spanning the largest area
+	if(chosenCount > 4) {
+		int pick[4];
+		pick[0] = deepest >= 0 && depths[deepest] >= 0.f ? deepest : chosen[0];
+		for(int slot = 1; slot < 4; slot++) {
+			float bestScore = -1.f;
+			pick[slot] = pick[0];
+			for(int c = 0; c < chosenCount; c++) {
+				int i = chosen[c];
+				float score = 0.f;
+				for(int other = 0; other < slot; other++) {
+					float d[3] = { polygon[i].p[0] - polygon[pick[other]].p[0], polygon[i].p[1] - polygon[pick[other]].p[1], polygon[i].p[2] - polygon[pick[other]].p[2] };
+					score += std::sqrt(dot(d, d));
+				}
+				if(score > bestScore) {
+					bestScore = score;
+					pick[slot] = i;
+				}
+			}
+		}
+		chosenCount = 4;
+		for(int slot = 0; slot < 4; slot++)
+			chosen[slot] = pick[slot];
+	}
+
+	manifold.pointCount = chosenCount;
+	for(int c = 0; c < chosenCount; c++) {
+		int i = chosen[c];
+		float depth = std::max(depths[i], 0.f);
+		manifold.points[c] = XMFLOAT3(polygon[i].p[0] + 0.5f*depth*n[0], polygon[i].p[1] + 0.5f*depth*n[1], polygon[i].p[2] + 0.5f*depth*n[2]);
+		manifold.depths[c] = depth;
+		manifold.features[c] = axis*64 + polygon[i].feature;
+	}
+}
+
+static void edgeContact(const OrientedBox& a, const OrientedBox& b, int axis, const float* direction, float separation, ContactManifold& manifold)
+{
+	int edgeA = (axis-6)/3, edgeB = (axis-6)%3;
+	//middle of the edge of A furthest along the axis and of the edge of B furthest against it
+	float pointA[3], pointB[3];
+	for(int k = 0; k < 3; k++) {
+		pointA[k] = a.centre[k];
+		pointB[k] = b.centre[k];
+	}
+	for(int i = 0; i < 3; i++) {
+		if(i != edgeA) {
+			float s = dot(a.axes[i], direction) > 0.f ? a.half[i] : -a.half[i];
+			for(int k = 0; k < 3; k++)
+				pointA[k] += s*a.axes[i][k];
+		}
+		if(i != edgeB) {
+			float s = dot(b.axes[i], direction) > 0.f ? -b.half[i] : b.half[i];
+			for(int k = 0; k < 3; k++)
+				pointB[k] += s*b.axes[i][k];
+		}
+	}
+	//closest points of the two edges
+	const float* d1 = a.axes[edgeA];
+	const float* d2 = b.axes[edgeB];
+	float r[3] = { pointA[0] - pointB[0], pointA[1] - pointB[1], pointA[2] - pointB[2] };
+	float d12 = dot(d1, d2), c = dot(d1, r), f = dot(d2, r);
+	float denominator = 1.f - d12*d12;
+	float s = denominator > 1e-6f ? (d12*f - c)/denominator : 0.f;
+	s = std::max(-a.half[edgeA], std::min(a.half[edgeA], s));
+	float t = d12*s + f;
+	t = std::max(-b.half[edgeB], std::min(b.half[edgeB], t));
+	manifold.pointCount = 1;
+	manifold.points[0] = XMFLOAT3(0.5f*(pointA[0] + s*d1[0] + pointB[0] + t*d2[0]), 0.5f*(pointA[1] + s*d1[1] + pointB[1] + t*d2[1]),
+		0.5f*(pointA[2] + s*d1[2] + pointB[2] + t*d2[2]));
+	manifold.depths[0] = -separation;
+	manifold.features[0] = axis*64;
+}
+
+static bool buildManifold(const OrientedBox& a, const OrientedBox& b, int axis, const float* direction, float separation, ContactManifold& manifold)
+{
+	if(axis < 6)
+		faceContact(a, b, axis, direction, manifold);
+	else
+		edgeContact(a, b, axis, direction, separation, manifold);
+	manifold.axis = axis;
+	//the direction points from A to B
+	manifold.normal = XMFLOAT3(-direction[0], -direction[1], -direction[2]);
+	return manifold.pointCount > 0;
+}
+
+bool BoxCollision::collide(const XMFLOAT4X4& obj2WorldA, const XMFLOAT4X4& obj2WorldB, ContactManifold& manifold, int& axisHint)
+{
+	OrientedBox a = makeBox(obj2WorldA), b = makeBox(obj2WorldB);
+	manifold.pointCount = 0;
+	float separation, direction[3];
+
+	//whatever separated the pair last time most likely still does
+	if(axisHint >= 0 && axisHint < 15 && testAxis(a, b, axisHint, separation, direction) && separation > 0.f)
+		return false;
+
+	//least penetration, a face of A before a face of B before an edge pair unless clearly better,
+	//otherwise the choice flips between nearly equal axes from frame to frame
+	const float relativeTolerance = 0.95f, absoluteTolerance = 0.001f;
+	int bestAxis = -1;
+	float bestSeparation = -FLT_MAX, bestDirection[3];
+	for(int axis = 0; axis < 15; axis++) {
+		if(!testAxis(a, b, axis, separation, direction))
+			continue;
+		if(separation > 0.f) {
+			axisHint = axis;
+			return false;
+		}
+		bool better = bestAxis < 0 || (axis < 3 ? separation > bestSeparation : separation > relativeTolerance*bestSeparation + absoluteTolerance);
+		if(better) {
+			bestAxis = axis;
+			bestSeparation = separation;
+			for(int k = 0; k < 3; k++)
+				bestDirection[k] = direction[k];
+		}
+	}
+	if(bestAxis < 0)
+		return false;
+	axisHint = bestAxis;
+	return buildManifold(a, b, bestAxis, bestDirection, bestSeparation, manifold);
+}
+
+float BoxCollision::separation(const XMFLOAT4X4& obj2WorldA, const XMFLOAT4X4& obj2WorldB, XMFLOAT3& axis)
+{
+	OrientedBox a = makeBox(obj2WorldA), b = makeBox(obj2WorldB);
+	float best = -FLT_MAX, separation, direction[3];
+	for(int k = 0; k < 15; k++)
+		if(testAxis(a, b, k, separation, direction) && separation > best) {
+			best = separation;
+			axis = XMFLOAT3(direction[0], direction[1], direction[2]);
+		}
+	return best;
+}
+
+bool BoxCollision::contact(const XMFLOAT4X4& obj2WorldA, const XMFLOAT4X4& obj2WorldB, int axis, ContactManifold& manifold)
+{
+	OrientedBox a = makeBox(obj2WorldA), b = makeBox(obj2WorldB);
+	manifold.pointCount = 0;
+	float separation, direction[3];
+	if(axis < 0 || axis >= 15 || !testAxis(a, b, axis, separation, direction) || separation > 0.f)
+		return false;
+	return buildManifold(a, b, axis, direction, separation, manifold);
+}
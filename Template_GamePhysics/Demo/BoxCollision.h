@@ -0,0 +1,43 @@
+#pragma once
+#ifndef BoxCollision_HEADER
+#define BoxCollision_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+// Up to four contact points between two boxes, all sharing one normal.
+struct ContactManifold
+{
+	int pointCount;
+	//points from B to A, the direction of the impulse on A (like CollisionInfo::normalWorld)
+	XMFLOAT3 normal;
+	//half way between the two surfaces
+	XMFLOAT3 points[4];
+	float depths[4];
+	//which features touch (separating axis, clipped vertex or edge), stable while the contact persists
+	int features[4];
+	//separating axis test the contact came from, 0-5 face of A / B, 6-14 edge pairs
+	int axis;
+};
+
+// Box vs box with the separating axis test over all 15 axes (3 faces of each box and the 9 edge
+// cross products). The boxes are unit cubes transformed by obj2World (scale * rotation * translation,
+// see getObj2WorldMat), no matrix is inverted.
+// The first separating axis found ends the test, and the axis of the last call (separating or
+// the one the contact was built from) is tested first, so boxes that stay apart usually cost one
+// axis. Face contacts clip the incident face against the side planes of the reference face and
+// keep up to four points, edge contacts give the closest points of the two edges.
+class BoxCollision
+{
+public:
+	//returns true and fills the manifold if the boxes overlap. axisHint is the cached axis of this
+	//pair, -1 if there is none, it is updated
+	static bool collide(const XMFLOAT4X4& obj2WorldA, const XMFLOAT4X4& obj2WorldB, ContactManifold& manifold, int& axisHint);
+	//only the contact of an axis already known to be the least penetrating one (see BoxCollisionBatch)
+	static bool contact(const XMFLOAT4X4& obj2WorldA, const XMFLOAT4X4& obj2WorldB, int axis, ContactManifold& manifold);
+	//largest gap along the 15 axes, negative if the boxes overlap. never more than the distance of the
+	//boxes, axis is its direction from A to B
+	static float separation(const XMFLOAT4X4& obj2WorldA, const XMFLOAT4X4& obj2WorldB, XMFLOAT3& axis);
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "BoxCollisionBatch.h"
+
+#include <cfloat>
+
+//a transformed unit cube per lane
+struct BoxLanes
+{
+	XMVECTOR centre[3];
+	XMVECTOR axes[3][3];
+	XMVECTOR half[3];
+};
+
+static XMVECTOR dot(const XMVECTOR* a, const XMVECTOR* b)
+{
+	return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static void loadBoxes(const XMFLOAT4X4* const* matrices, BoxLanes& box)
+{
+	for(int i = 0; i < 4; i++) {
+		//row i of the four matrices, transposed: component k of all four lanes in one vector
+		XMMATRIX rows = XMMatrixTranspose(XMMATRIX(
+			XMLoadFloat4((const XMFLOAT4*)matrices[0]->m[i]),
+			XMLoadFloat4((const XMFLOAT4*)matrices[1]->m[i]),
+			XMLoadFloat4((const XMFLOAT4*)matrices[2]->m[i]),
+			XMLoadFloat4((const XMFLOAT4*)matrices[3]->m[i])));
+		if(i == 3) {
+			for(int k = 0; k < 3; k++)
+				box.centre[k] = rows.r[k];
+			continue;
+		}
+		XMVECTOR length = XMVectorSqrt(dot(rows.r, rows.r));
+		XMVECTOR inverse = XMVectorReciprocal(length);
+		for(int k = 0; k < 3; k++)
+			box.axes[i][k] = rows.r[k]*inverse;
+		box.half[i] = length*0.5f;
+	}
+}
+
+//per lane bookkeeping of the axes tested so far
+struct AxisLanes
+{
+	XMVECTOR separated;
+	XMVECTOR firstAxis;
+	XMVECTOR best;
+	XMVECTOR bestAxis;
+};
+
+static void addAxis(AxisLanes& lanes, int axis, XMVECTOR separation, XMVECTOR valid)
+{
+	XMVECTOR axisId = XMVectorReplicate((float)axis);
+	XMVECTOR separating = XMVectorAndCInt(XMVectorAndInt(valid, XMVectorGreater(separation, XMVectorZero())), lanes.separated);
+	lanes.firstAxis = XMVectorSelect(lanes.firstAxis, axisId, separating);
+	lanes.separated = XMVectorOrInt(lanes.separated, separating);
+	//faces of A by plain comparison, everything after only when clearly better, as in BoxCollision::collide
+	XMVECTOR limit = axis < 3 ? lanes.best : lanes.best*0.95f + XMVectorReplicate(0.001f);
+	XMVECTOR better = XMVectorAndInt(valid, XMVectorGreater(separation, limit));
+	lanes.best = XMVectorSelect(lanes.best, separation, better);
+	lanes.bestAxis = XMVectorSelect(lanes.bestAxis, axisId, better);
+}
+
+//bit i set if lane i overlaps, 16 if the group was done after the face axes
+static int testGroup(const XMFLOAT4X4* const* matricesA, const XMFLOAT4X4* const* matricesB, int* axes)
+{
+	BoxLanes a, b;
+	loadBoxes(matricesA, a);
+	loadBoxes(matricesB, b);
+
+	//B and the offset in the frame of A
+	XMVECTOR R[3][3], absR[3][3], t[3], offset[3];
+	XMVECTOR epsilon = XMVectorReplicate(1e-6f);
+	for(int k = 0; k < 3; k++)
+		offset[k] = b.centre[k] - a.centre[k];
+	for(int i = 0; i < 3; i++) {
+		t[i] = dot(offset, a.axes[i]);
+		for(int j = 0; j < 3; j++) {
+			R[i][j] = dot(a.axes[i], b.axes[j]);
+			absR[i][j] = XMVectorAbs(R[i][j]) + epsilon;
+		}
+	}
+
+	AxisLanes lanes;
+	lanes.separated = XMVectorFalseInt();
+	lanes.firstAxis = XMVectorReplicate(-1.f);
+	lanes.best = XMVectorReplicate(-FLT_MAX);
+	lanes.bestAxis = XMVectorReplicate(-1.f);
+	XMVECTOR all = XMVectorTrueInt();
+
+	for(int i = 0; i < 3; i++) {
+		XMVECTOR radiusB = b.half[0]*absR[i][0] + b.half[1]*absR[i][1] + b.half[2]*absR[i][2];
+		addAxis(lanes, i, XMVectorAbs(t[i]) - a.half[i] - radiusB, all);
+	}
+	for(int j = 0; j < 3; j++) {
+		XMVECTOR radiusA = a.half[0]*absR[0][j] + a.half[1]*absR[1][j] + a.half[2]*absR[2][j];
+		XMVECTOR distance = XMVectorAbs(t[0]*R[0][j] + t[1]*R[1][j] + t[2]*R[2][j]);
+		addAxis(lanes, 3 + j, distance - radiusA - b.half[j], all);
+	}
+	bool early = XMVector4EqualInt(lanes.separated, all);
+
+	//a_i x b_j in the frame of A, normalised by its length. parallel edges are left to the faces
+	XMVECTOR parallel = XMVectorReplicate(1e-4f);
+	for(int i = 0; i < 3 && !early; i++) {
+		int i1 = (i + 1)%3, i2 = (i + 2)%3;
+		for(int j = 0; j < 3; j++) {
+			int j1 = (j + 1)%3, j2 = (j + 2)%3;
+			XMVECTOR length = XMVectorSqrt(R[i1][j]*R[i1][j] + R[i2][j]*R[i2][j]);
+			XMVECTOR distance = XMVectorAbs(t[i2]*R[i1][j] - t[i1]*R[i2][j]);
+			XMVECTOR radiusA = a.half[i1]*absR[i2][j] + a.half[i2]*absR[i1][j];
+			XMVECTOR radiusB = b.half[j1]*absR[i][j2] + b.half[j2]*absR[i][j1];
+			XMVECTOR valid = XMVectorGreater(length, parallel);
+			XMVECTOR safeLength = XMVectorSelect(XMVectorReplicate(1.f), length, valid);
+			addAxis(lanes, 6 + 3*i + j, (distance - radiusA - radiusB)/safeLength, valid);
+		}
+		if(XMVector4EqualInt(lanes.separated, all))
+			break;
+	}
+
+	XMFLOAT4 first, best;
+	XMStoreFloat4(&first, lanes.firstAxis);
+	XMStoreFloat4(&best, lanes.bestAxis);
+	float firstAxes[4] = { first.x, first.y, first.z, first.w };
+	float bestAxes[4] = { best.x, best.y, best.z, best.w };
+	int mask = early ? 16 : 0;
+	for(int lane = 0; lane < 4; lane++) {
+		bool separated = firstAxes[lane] >= 0.f;
+		axes[lane] = (int)(separated ? firstAxes[lane] : bestAxes[lane]);
+		if(!separated)
+			mask |= 1 << lane;
+	}
+	return mask;
+}
+
+BoxCollisionBatch::BoxCollisionBatch()
+{
+	groupCount = 0;
+	earlyOuts = 0;
+}
+
+void BoxCollisionBatch::run(const std::vector<XMFLOAT4X4>& world, const std::vector<std::pair<int, int>>& pairs, ThreadPool& pool, const std::vector<int>* bodyShapes)
+{
+	int pairCount = (int)pairs.size();
+	groupCount = (pairCount + 3)/4;
+	axes.resize(groupCount*4);
+	groupMasks.resize(groupCount);
+	pool.parallelFor(groupCount, 16, [&](int begin, int end) {
+		const XMFLOAT4X4* matricesA[4];
+		const XMFLOAT4X4* matricesB[4];
+		for(int group = begin; group < end; group++) {
+			//the last group is filled up with its first pair
+			for(int lane = 0; lane < 4; lane++) {
+				int pair = 4*group + lane < pairCount ? 4*group + lane : 4*group;
+				matricesA[lane] = &world[pairs[pair].first];
+				matricesB[lane] = &world[pairs[pair].second];
+			}
+			groupMasks[group] = testGroup(matricesA, matricesB, &axes[4*group]);
+		}
+	});
+	axes.resize(pairCount);
+
+	//the overlapping pairs in order
+	overlapping.clear();
+	manifoldIndex.assign(pairCount, -1);
+	earlyOuts = 0;
+	for(int group = 0; group < groupCount; group++) {
+		if(groupMasks[group] & 16)
+			earlyOuts++;
+		for(int lane = 0; lane < 4 && 4*group + lane < pairCount; lane++) {
+			int pair = 4*group + lane;
+			if(!(groupMasks[group] & (1 << lane)))
+				continue;
+			if(bodyShapes && ((*bodyShapes)[pairs[pair].first] >= 0 || (*bodyShapes)[pairs[pair].second] >= 0))
+				continue;
+			manifoldIndex[pair] = (int)overlapping.size();
+			overlapping.push_back(pair);
+		}
+	}
+
+	manifolds.resize(overlapping.size());
+	pool.parallelFor((int)overlapping.size(), 16, [&](int begin, int end) {
+		for(int k = begin; k < end; k++) {
+			const std::pair<int, int>& pair = pairs[overlapping[k]];
+			BoxCollision::contact(world[pair.first], world[pair.second], axes[overlapping[k]], manifolds[k]);
+		}
+	});
+}
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef BoxCollisionBatch_HEADER
+#define BoxCollisionBatch_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include <utility>
+#include "BoxCollision.h"
+#include "ThreadPool.h"
+
+// The separating axis test of BoxCollision for a whole pair list, four pairs at a time.
+// The matrices of four pairs are transposed so that every vector holds one value (a centre
+// coordinate, an axis component, a half extent) of all four pairs, and the 15 axes are tested for
+// the four lanes together without a branch per pair. As in the OBB test of Gottschalk et al. the
+// axes of B and the offset are taken into the frame of A first (the 3x3 dot products R and t),
+// after which every axis, edge pairs included, is a few multiply-adds. |R| gets a small epsilon
+// so nearly parallel edges never separate by round off.
+// Per lane the first separating axis and the least penetrating one (same face before edge bias
+// as BoxCollision::collide) are kept, a group stops as soon as all four lanes are separated.
+// The overlapping pairs are compacted into one list and only those get a manifold, built from
+// the axis the batch found (BoxCollision::contact), in parallel.
+class BoxCollisionBatch
+{
+public:
+	//per pair of the last run: the separating axis, or the one the contact is built from
+	std::vector<int> axes;
+	//per pair, the manifold of an overlapping pair or -1
+	std::vector<int> manifoldIndex;
+	//the overlapping pairs in order, and their manifolds
+	std::vector<int> overlapping;
+	std::vector<ContactManifold> manifolds;
+
+	//statistics of the last run
+	int groupCount;
+	//groups that stopped before the edge axes
+	int earlyOuts;
+
+	BoxCollisionBatch();
+
+	//boxes are scaled unit cubes given by world (see RigidBodyWorld::world). pairs with a body that has
+	//a convex shape in bodyShapes (see RigidBodyWorld::bodyShapes) are left to GJK and get no manifold
+	void run(const std::vector<XMFLOAT4X4>& world, const std::vector<std::pair<int, int>>& pairs, ThreadPool& pool, const std::vector<int>* bodyShapes = nullptr);
+
+private:
+	//bit i set if lane i of the group overlaps
+	std::vector<int> groupMasks;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef BroadPhase_HEADER
+#define BroadPhase_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include <utility>
+#include <cfloat>
+
+// Common interface of the broad phases (SweepAndPrune, DynamicAABBTree).
+// Every update gets one world space box per object, the index of an object has to stay the same
+// between updates, and fills pairs with the objects whose boxes overlap. The boxes can come
+// from anything: rigid bodies, a whole cloth or a particle group (see pointBounds).
+class BroadPhase
+{
+public:
+	//overlapping pairs of the last update, first < second, sorted. pairs of two static objects are left out
+	std::vector<std::pair<int, int>> pairs;
+
+	virtual ~BroadPhase() {}
+
+	virtual void clear() = 0;
+	//box i is [lower[i], upper[i]], a different box count starts over
+	virtual void update(const std::vector<XMFLOAT3>& lower, const std::vector<XMFLOAT3>& upper, const std::vector<char>& isStatic) = 0;
+
+	//bounds of a group of points (SpringPoint, Particle), grown by the point radius
+	template<class T> static void pointBounds(const std::vector<T>& points, float radius, XMFLOAT3& lower, XMFLOAT3& upper)
+	{
+		XMVECTOR low = XMVectorReplicate(FLT_MAX), high = XMVectorReplicate(-FLT_MAX);
+		for(auto point = points.begin(); point != points.end(); point++) {
+			XMVECTOR position = XMLoadFloat3(&point->gp_position);
+			low = XMVectorMin(low, position);
+			high = XMVectorMax(high, position);
+		}
+		XMStoreFloat3(&lower, XMVectorSubtract(low, XMVectorReplicate(radius)));
+		XMStoreFloat3(&upper, XMVectorAdd(high, XMVectorReplicate(radius)));
+	}
+};
+
+#endif
@@ -0,0 +1,265 @@
+#include "ClothSelfCollision.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+static XMFLOAT3 crossVector(XMFLOAT3 a, XMFLOAT3 b)
+{
+	return XMFLOAT3(a.y*b.z-a.z*b.y, a.z*b.x-a.x*b.z, a.x*b.y-a.y*b.x);
+}
+
+//a triangle's bounding box is clamped to this many cells per axis, so one torn or exploded
+//triangle can't fill the whole table
+static const int maxCellsPerAxis = 8;
+
+static bool isFinite(XMFLOAT3 v)
+{
+	//NaN fails every comparison
+	return fabsf(v.x) < 1e30f && fabsf(v.y) < 1e30f && fabsf(v.z) < 1e30f;
+}
+
+//closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5), also returns the barycentric weights of b and c
+static XMFLOAT3 closestPointOnTriangle(XMFLOAT3 p, XMFLOAT3 a, XMFLOAT3 b, XMFLOAT3 c, float& v, float& w)
+{
+	XMFLOAT3 ab = subVector(b, a), ac = subVector(c, a), ap = subVector(p, a);
+	float d1 = dotProduct(ab, ap), d2 = dotProduct(ac, ap);
+	if(d1 <= 0.0f && d2 <= 0.0f) { v = 0; w = 0; return a; }
+
+	XMFLOAT3 bp = subVector(p, b);
+	float d3 = dotProduct(ab, bp), d4 = dotProduct(ac, bp);
+	if(d3 >= 0.0f && d4 <= d3) { v = 1; w = 0; return b; }
+
+	float vc = d1*d4 - d3*d2;
+	if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		v = d1 / (d1 - d3); w = 0;
+		return addVector(a, multiplyVector(ab, v));
+	}
+
+	XMFLOAT3 cp = subVector(p, c);
+	float d5 = dotProduct(ab, cp), d6 = dotProduct(ac, cp);
+	if(d6 >= 0.0f && d5 <= d6) { v = 0; w = 1; return c; }
+
+	float vb = d5*d2 - d1*d6;
+	if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		v = 0; w = d2 / (d2 - d6);
+		return addVector(a, multiplyVector(ac, w));
+	}
+
+	float va = d3*d6 - d5*d4;
+	if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		w = (d4 - d3) / ((d4 - d3) + (d5 - d6)); v = 1 - w;
+		return addVector(b, multiplyVector(subVector(c, b), w));
+	}
+
+	float denom = 1.0f / (va + vb + vc);
+	v = vb * denom;
+	w = vc * denom;
+	return addVector(a, addVector(multiplyVector(ab, v), multiplyVector(ac, w)));
+}
+
+ClothSelfCollision::ClothSelfCollision()
+{
+	thicknessScale = 0.3f;
+	stiffness = 0.5f;
+	lastContacts = 0;
+	lastThickness = 0;
+	lastTruncatedTriangles = 0;
+	cachedRevision = -1;
+	restEdgeLength = 0;
+	tableMask = 0;
+	cellStart = cellEntries = nullptr;
+	triangleCellMin = triangleCellMax = nullptr;
+}
+
+void ClothSelfCollision::updateRestEdgeLength(SpringNetwork& network)
+{
+	if(cachedRevision == network.topologyRevision)
+		return;
+	restEdgeLength = 0;
+	for(auto spring = network.springs.begin(); spring != network.springs.end(); spring++) {
+		if(spring->gs_initialLength > 0.0f && (restEdgeLength == 0.0f || spring->gs_initialLength < restEdgeLength))
+			restEdgeLength = spring->gs_initialLength;
+	}
+	cachedRevision = network.topologyRevision;
+}
+
+unsigned int ClothSelfCollision::hashCell(int x, int y, int z)
+{
+	return ((unsigned int)x*73856093u ^ (unsigned int)y*19349663u ^ (unsigned int)z*83492791u) & tableMask;
+}
+
+void ClothSelfCollision::buildHash(SpringNetwork& network, float cellSize, float thickness, StepArena& arena)
+{
+	int triangleCount = network.getTriangleCount();
+	unsigned int tableSize = 64;
+	while(tableSize < 2*(unsigned int)triangleCount)
+		tableSize *= 2;
+	tableMask = tableSize - 1;
+
+	float invCell = 1.0f / cellSize;
+	triangleCellMin = arena.allocateArray<int>(3*triangleCount);
+	triangleCellMax = arena.allocateArray<int>(3*triangleCount);
+	cellStart = arena.allocateArray<int>(tableSize + 1);
+	memset(cellStart, 0, (tableSize + 1)*sizeof(int));
+
+	//counting sort: count the cells every (thickened) triangle bounding box touches, then fill
+	for(int t = 0; t < triangleCount; t++) {
+		const XMFLOAT3& a = network.points[network.triangles[3*t]].gp_position;
+		const XMFLOAT3& b = network.points[network.triangles[3*t+1]].gp_position;
+		const XMFLOAT3& c = network.points[network.triangles[3*t+2]].gp_position;
+		int* cmin = &triangleCellMin[3*t];
+		int* cmax = &triangleCellMax[3*t];
+		if(!isFinite(a) || !isFinite(b) || !isFinite(c)) {
+			//exploded triangle, keep it out of the table
+			cmin[0] = 1; cmax[0] = 0;
+			continue;
+		}
+		const float* pa = &a.x;
+		const float* pb = &b.x;
+		const float* pc = &c.x;
+		bool truncated = false;
+		for(int k = 0; k < 3; k++) {
+			float lo = std::min(pa[k], std::min(pb[k], pc[k])) - thickness;
+			float hi = std::max(pa[k], std::max(pb[k], pc[k])) + thickness;
+			cmin[k] = (int)floorf(lo*invCell);
+			cmax[k] = (int)floorf(hi*invCell);
+			if(cmax[k] - cmin[k] >= maxCellsPerAxis) {
+				cmax[k] = cmin[k] + maxCellsPerAxis - 1;
+				truncated = true;
+			}
+		}
+		if(truncated)
+			lastTruncatedTriangles++;
+		for(int x = cmin[0]; x <= cmax[0]; x++)
+			for(int y = cmin[1]; y <= cmax[1]; y++)
+				for(int z = cmin[2]; z <= cmax[2]; z++)
+					cellStart[hashCell(x, y, z)+1]++;
+	}
+	for(unsigned int h = 0; h < tableSize; h++)
+		cellStart[h+1] += cellStart[h];
+
+	cellEntries = arena.allocateArray<int>(cellStart[tableSize]);
+	int* fill = arena.allocateArray<int>(tableSize);
+	memcpy(fill, cellStart, tableSize*sizeof(int));
+	//triangle by triangle, so the copies of a triangle whose cells share a bucket end up next to each other
+	for(int t = 0; t < triangleCount; t++) {
+		const int* cmin = &triangleCellMin[3*t];
+		const int* cmax = &triangleCellMax[3*t];
+		for(int x = cmin[0]; x <= cmax[0]; x++)
+			for(int y = cmin[1]; y <= cmax[1]; y++)
+				for(int z = cmin[2]; z <= cmax[2]; z++)
+					cellEntries[fill[hashCell(x, y, z)]++] = t;
+	}
+}
+
+void ClothSelfCollision::resolve(SpringNetwork& network, ThreadPool& pool, StepArena& arena)
+{
+	lastContacts = 0;
+	lastTruncatedTriangles = 0;
+	int pointCount = (int)network.points.size();
+	if(pointCount == 0 || network.triangles.empty())
+		return;
+
+	updateRestEdgeLength(network);
+	if(restEdgeLength <= 0.0f)
+		return;
+	float thickness = thicknessScale * restEdgeLength;
+	lastThickness = thickness;
+	//a thickened triangle with edges of the smallest rest length then touches at most two cells per axis,
+	//bigger or stretched ones more, up to maxCellsPerAxis
+	float cellSize = restEdgeLength + 2*thickness;
+	float invCell = 1.0f / cellSize;
+
+	buildHash(network, cellSize, thickness, arena);
+
+	XMFLOAT3* positionCorrection = arena.allocateArray<XMFLOAT3>(pointCount);
+	XMFLOAT3* velocityCorrection = arena.allocateArray<XMFLOAT3>(pointCount);
+	int* contactCount = arena.allocateArray<int>(pointCount);
+	std::fill_n(positionCorrection, pointCount, XMFLOAT3(0,0,0));
+	std::fill_n(velocityCorrection, pointCount, XMFLOAT3(0,0,0));
+	std::fill_n(contactCount, pointCount, 0);
+
+	std::vector<SpringPoint>& points = network.points;
+	const std::vector<int>& triangles = network.triangles;
+
+	//query, every point only writes its own correction
+	pool.parallelFor(pointCount, 256, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			const SpringPoint& point = points[i];
+			if(point.gp_isStatic || !isFinite(point.gp_position))
+				continue;
+			XMFLOAT3 p = point.gp_position;
+			int cx = (int)floorf(p.x*invCell), cy = (int)floorf(p.y*invCell), cz = (int)floorf(p.z*invCell);
+			unsigned int h = hashCell(cx, cy, cz);
+			for(int e = cellStart[h]; e < cellStart[h+1]; e++) {
+				int t = cellEntries[e];
+				//a triangle with several cells in this bucket is listed once per cell, count it once
+				if(e > cellStart[h] && cellEntries[e-1] == t)
+					continue;
+				//other cells hashed into the same bucket
+				const int* cmin = &triangleCellMin[3*t];
+				const int* cmax = &triangleCellMax[3*t];
+				if(cx < cmin[0] || cx > cmax[0] || cy < cmin[1] || cy > cmax[1] || cz < cmin[2] || cz > cmax[2])
+					continue;
+				int ia = triangles[3*t], ib = triangles[3*t+1], ic = triangles[3*t+2];
+				if(i == ia || i == ib || i == ic)
+					continue;
+
+				const SpringPoint& a = points[ia];
+				const SpringPoint& b = points[ib];
+				const SpringPoint& c = points[ic];
+				float v, w;
+				XMFLOAT3 q = closestPointOnTriangle(p, a.gp_position, b.gp_position, c.gp_position, v, w);
+				XMFLOAT3 diff = subVector(p, q);
+				float dist = vectorLength(diff);
+				if(dist >= thickness)
+					continue;
+				//topological neighbours are kept apart by the springs
+				if(network.areConnected(i, ia) || network.areConnected(i, ib) || network.areConnected(i, ic))
+					continue;
+
+				XMFLOAT3 n = crossVector(subVector(b.gp_position, a.gp_position), subVector(c.gp_position, a.gp_position));
+				float nLength = vectorLength(n);
+				if(nLength <= 1e-12f)
+					continue;
+				n = multiplyVector(n, 1.0f/nLength);
+
+				//the side the point was on before the step, so points that tunneled through are pushed back
+				XMFLOAT3 prevN = crossVector(subVector(b.gp_prevPosition, a.gp_prevPosition), subVector(c.gp_prevPosition, a.gp_prevPosition));
+				float prevSide = dotProduct(subVector(point.gp_prevPosition, a.gp_prevPosition), prevN);
+				float side = (prevSide != 0.0f) ? prevSide : dotProduct(diff, n);
+				XMFLOAT3 push = multiplyVector(n, side < 0.0f ? -1.0f : 1.0f);
+				//next to an edge or corner push away from it, unless that would be through the triangle
+				bool interior = v > 0.0f && w > 0.0f && v + w < 1.0f;
+				if(!interior && dist > 1e-6f && dotProduct(diff, push) > 0.0f)
+					push = multiplyVector(diff, 1.0f/dist);
+
+				XMFLOAT3 target = addVector(q, multiplyVector(push, thickness));
+				positionCorrection[i] = addVector(positionCorrection[i], multiplyVector(subVector(target, p), stiffness));
+
+				//remove the approaching part of the relative velocity
+				XMFLOAT3 vTri = addVector(multiplyVector(a.gp_velocity, 1-v-w), addVector(multiplyVector(b.gp_velocity, v), multiplyVector(c.gp_velocity, w)));
+				float vn = dotProduct(subVector(point.gp_velocity, vTri), push);
+				if(vn < 0.0f)
+					velocityCorrection[i] = subVector(velocityCorrection[i], multiplyVector(push, vn));
+				contactCount[i]++;
+			}
+		}
+	});
+
+	//apply the averaged corrections
+	pool.parallelFor(pointCount, 1024, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			if(contactCount[i] == 0)
+				continue;
+			float inv = 1.0f / contactCount[i];
+			points[i].gp_position = addVector(points[i].gp_position, multiplyVector(positionCorrection[i], inv));
+			points[i].gp_velocity = addVector(points[i].gp_velocity, multiplyVector(velocityCorrection[i], inv));
+		}
+	});
+
+	for(int i = 0; i < pointCount; i++)
+		if(contactCount[i] > 0)
+			lastContacts++;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef ClothSelfCollision_HEADER
+#define ClothSelfCollision_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "SpringNetwork.h"
+#include "ThreadPool.h"
+#include "StepArena.h"
+
+// Point/triangle self-collision for spring networks.
+// Every step the triangles are binned into a spatial hash with cells sized from the smallest rest edge length,
+// then each point looks up the triangles in its cell. Points that belong to or are connected by a
+// spring to a triangle's corner are skipped, they are kept apart by the springs anyway.
+// Contacts push the point back to the side of the triangle it was on in the previous step.
+// Each point only writes its own correction (Jacobi style), so the queries run in parallel.
+class ClothSelfCollision
+{
+public:
+	//collision distance as a fraction of the smallest rest edge length
+	float thicknessScale;
+	//fraction of the penetration removed per step, the triangle corners take the rest when they are queried
+	float stiffness;
+
+	//statistics of the last resolve()
+	int lastContacts;
+	float lastThickness;
+	//triangles stretched over more than maxCellsPerAxis cells on an axis, they are only hashed into
+	//their first cells and miss contacts beyond them
+	int lastTruncatedTriangles;
+
+	ClothSelfCollision();
+
+	//the hash and the corrections are allocated from the arena, they are dropped at the end of the step
+	void resolve(SpringNetwork& network, ThreadPool& pool, StepArena& arena);
+
+private:
+	//cell size is taken from the rest lengths, recomputed when the topology changes
+	int cachedRevision;
+	float restEdgeLength;
+
+	//arena storage, only valid during resolve()
+	int* cellStart;
+	int* cellEntries;
+	int* triangleCellMin;
+	int* triangleCellMax;
+	unsigned int tableMask;
+
+	void updateRestEdgeLength(SpringNetwork& network);
+	void buildHash(SpringNetwork& network, float cellSize, float thickness, StepArena& arena);
+	unsigned int hashCell(int x, int y, int z);
+};
+
+#endif
@@ -4,6 +4,7 @@ using namespace DirectX;
 
 #include "vectorOperations.h"
 #include "rigidBody.h"
+#include <algorithm>
 
 XMFLOAT3 c_position;
 XMVECTOR c_normal;
@@ -13,17 +14,16 @@ float impulse;
 
 
 void Contact::calcRelativeVelocity() {
-			XMFLOAT3 cross;
-			XMStoreFloat3(&cross, XMVector3Cross(XMLoadFloat3(&body1->getAngularVelocity()), XMLoadFloat3(&subVector(c_position,body1->getPosition()))));
-			XMFLOAT3 v1 = addVector(body1->getVelocity(), cross);
-			XMStoreFloat3(&cross, XMVector3Cross(XMLoadFloat3(&body2->getAngularVelocity()), XMLoadFloat3(&subVector(c_position,body2->getPosition()))));
-			XMFLOAT3 v2 = addVector(body2->getVelocity(), cross);
+			XMFLOAT3 v1 = body1->getPointVelocity(c_position);
+			XMFLOAT3 v2 = body2->getPointVelocity(c_position);
 			//v_relative_dot;
 			v_relative = subVector(v1,v2);
 			XMStoreFloat(&v_relative_dot, XMVector3Dot(c_normal,XMLoadFloat3(&v_relative)));
 
 			if(v_relative_dot > 0 ) { //separating
-			
+				//a warm started push may have been too much, take some of it back
+				if(normalImpulse > 0.f)
+					calculateImpulse();
 			}
 			else if ( v_relative_dot < 0) { //colliding
 				calculateImpulse();
@@ -34,51 +34,53 @@ void Contact::calcRelativeVelocity() {
 
 
 void Contact::calculateImpulse() {
-	float c = 0.5f; //this should determine if the body is elastic or plastic.. for now i'll leave it as plastic!
-
-	float ma = body1->getMassInverse(), mb = body2->getMassInverse();
+	float c = v_relative_dot < 0 ? 0.5f : 0.f; //this should determine if the body is elastic or plastic.. for now i'll leave it as plastic!
 
 	float numerator = -(1+c)*v_relative_dot;
+	impulse = numerator / inverseMass(c_normal);
+
+	//the sum over the step must stay a push
+	float previous = normalImpulse;
+	normalImpulse = std::max(previous + impulse, 0.f);
+	impulse = normalImpulse - previous;
+	XMFLOAT3 change;
+	XMStoreFloat3(&change, c_normal*impulse);
+	body1->applyImpulse(c_position, change);
+	body2->applyImpulse(c_position, multiplyVector(change, -1.f));
+
+	if(friction <= 0.f)
+		return;
+	//stop the sliding, as far as the cone around the normal impulse allows
+	XMVECTOR v = XMLoadFloat3(&subVector(body1->getPointVelocity(c_position), body2->getPointVelocity(c_position)));
+	XMVECTOR tangentVelocity = v - c_normal*XMVector3Dot(v, c_normal);
+	float speed = XMVectorGetX(XMVector3Length(tangentVelocity));
+	if(speed < 1e-6f)
+		return;
+	XMVECTOR tangent = tangentVelocity/speed;
+	XMVECTOR accumulated = XMLoadFloat3(&frictionImpulse) - tangent*(speed/inverseMass(tangent));
+	float limit = friction*normalImpulse;
+	float length = XMVectorGetX(XMVector3Length(accumulated));
+	if(length > limit)
+		accumulated *= limit/length;
+	XMStoreFloat3(&change, accumulated - XMLoadFloat3(&frictionImpulse));
+	XMStoreFloat3(&frictionImpulse, accumulated);
+	body1->applyImpulse(c_position, change);
+	body2->applyImpulse(c_position, multiplyVector(change, -1.f));
+}
 
-	XMVECTOR tempVec_a, tempVec_b, center_1, center_2;
-	center_1 = XMLoadFloat3(&(subVector(c_position,body1->getPosition())));
-	center_2 = XMLoadFloat3(&(subVector(c_position,body2->getPosition())));
-	tempVec_a = XMVector3Transform(XMVector3Cross(XMVector3Cross(center_1,c_normal),center_1),body1->getInertiaTensorInverse());
-	tempVec_b = XMVector3Transform(XMVector3Cross(XMVector3Cross(center_2,c_normal),center_2),body1->getInertiaTensorInverse()); //TODO ?!?! is it really supposed to be 'body1' in this row??
-	tempVec_a = XMVector3Dot(tempVec_a+tempVec_b,c_normal);
-
-	float temp;
-	XMStoreFloat(&temp, tempVec_a);
-	float denominator = ma + mb + temp;
-
-	impulse = numerator / denominator;
-
-	XMFLOAT3 newVelocity_1, newVelocity_2, newAngMom_1, newAngMom_2,tempf3;
-	c_normal *= impulse; //scale the normal with the impulse
-	
-	XMStoreFloat3(&tempf3, c_normal*ma);
-	newVelocity_1 = addVector(body1->getAngularVelocity(),tempf3);
-
-	XMStoreFloat3(&tempf3, c_normal*mb);
-	newVelocity_2 = subVector(body2->getAngularVelocity(),tempf3);
-
-	XMStoreFloat3(&tempf3, XMVector3Cross(center_1,c_normal));
-	newAngMom_1 = addVector(body1->getAngularMomentum(),tempf3);
-
-	XMStoreFloat3(&tempf3, XMVector3Cross(center_2,c_normal));
-	newAngMom_2 = subVector(body2->getAngularMomentum(),tempf3);
-
-	if(!body1->isStatic)
-	{
-		body1->setLinearVelocity(newVelocity_1);
-		body1->setAngularMomentum(newAngMom_1);
-	}
-	if(!body2->isStatic)
-	{
-		body2->setLinearVelocity(newVelocity_2);
-		body2->setAngularMomentum(newAngMom_2);
+float Contact::inverseMass(XMVECTOR direction)
+{
+	//static bodies take nothing, neither linear nor angular
+	float result = 0.f;
+	rigidBody* bodies[2] = { body1, body2 };
+	for(int i = 0; i < 2; i++) {
+		if(bodies[i]->isStatic)
+			continue;
+		XMVECTOR r = XMLoadFloat3(&subVector(c_position, bodies[i]->getPosition()));
+		XMVECTOR angular = XMVector3Transform(XMVector3Cross(r, direction), bodies[i]->getWorldInertiaInverse());
+		result += bodies[i]->getMassInverse() + XMVectorGetX(XMVector3Dot(XMVector3Cross(angular, r), direction));
 	}
-
+	return result > 0.f ? result : 1.f;
 }
 	
 	Contact::Contact(XMFLOAT3 pos, XMVECTOR norm, rigidBody* rb1,rigidBody* rb2)
@@ -88,10 +90,20 @@ void Contact::calculateImpulse() {
 	//depth = d;
 	body1 = rb1;
 	body2 = rb2;
+	impulse = 0.f;
+	depth = 0.f;
+	normalImpulse = 0.f;
+	frictionImpulse = XMFLOAT3(0.f, 0.f, 0.f);
+	friction = 0.f;
 }
 
 Contact::Contact(void)
 {
+	impulse = 0.f;
+	depth = 0.f;
+	normalImpulse = 0.f;
+	frictionImpulse = XMFLOAT3(0.f, 0.f, 0.f);
+	friction = 0.f;
 }
 
 
@@ -18,10 +18,16 @@ public:
 	float depth;
 	float impulse;
 	rigidBody* body1,* body2;
-	
+	//impulses summed over the step, carried over from the last step by the contact cache.
+	//the normal one never pulls the bodies together, the friction one stays inside the Coulomb cone
+	float normalImpulse;
+	XMFLOAT3 frictionImpulse;
+	float friction;
 
 	void calcRelativeVelocity();
 	void calculateImpulse();
+	//inverse mass the two bodies show along a direction at the contact point
+	float inverseMass(XMVECTOR direction);
 
 	Contact(XMFLOAT3 pos, XMVECTOR norm, rigidBody* rb1, rigidBody* rb2);
 	Contact(void);
@@ -0,0 +1,197 @@
+#include "ContactCache.h"
+
+#include <algorithm>
+
+static float distanceSquared(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	float x = a.x - b.x, y = a.y - b.y, z = a.z - b.z;
+	return x*x + y*y + z*z;
+}
+
+ContactCache::ContactCache()
+{
+	matchDistance = 0.05f;
+	normalTolerance = 0.95f;
+	breakingDistance = 0.01f;
+	matchedPoints = 0;
+	newPoints = 0;
+	pairCount = 0;
+	step = 0;
+	matching = creating = 0;
+}
+
+void ContactCache::clear()
+{
+	pairs.clear();
+	matchedPoints = 0;
+	newPoints = 0;
+	pairCount = 0;
+	step = 0;
+	matching = creating = 0;
+}
+
+CachedManifold& ContactCache::find(int bodyA, int bodyB)
+{
+	std::pair<int,int> key(bodyA, bodyB);
+	auto found = pairs.find(key);
+	if(found == pairs.end()) {
+		CachedManifold empty;
+		empty.axis = -1;
+		empty.pointCount = 0;
+		empty.normal = XMFLOAT3(0.f, 0.f, 0.f);
+		empty.simplex.count = 0;
+		found = pairs.insert(std::make_pair(key, empty)).first;
+	}
+	found->second.lastStep = step;
+	return found->second;
+}
+
+void ContactCache::refresh(CachedManifold& cached, const ContactManifold& manifold)
+{
+	CachedContact previous[4];
+	int previousCount = cached.pointCount;
+	for(int i = 0; i < previousCount; i++)
+		previous[i] = cached.points[i];
+	//a turned normal means a different contact, the old impulses point the wrong way
+	float turn = cached.normal.x*manifold.normal.x + cached.normal.y*manifold.normal.y + cached.normal.z*manifold.normal.z;
+	if(turn < normalTolerance)
+		previousCount = 0;
+	bool used[4] = { false, false, false, false };
+	float limit = matchDistance*matchDistance;
+
+	for(int k = 0; k < manifold.pointCount; k++) {
+		CachedContact& point = cached.points[k];
+		point.position = manifold.points[k];
+		point.depth = manifold.depths[k];
+		point.feature = manifold.features[k];
+		//same features first, then the closest unused point
+		int match = -1;
+		for(int i = 0; i < previousCount && match < 0; i++)
+			if(!used[i] && previous[i].feature == point.feature && distanceSquared(previous[i].position, point.position) < limit)
+				match = i;
+		float best = limit;
+		for(int i = 0; i < previousCount && match < 0; i++) {
+			float d = distanceSquared(previous[i].position, point.position);
+			if(!used[i] && d < best) {
+				best = d;
+				match = i;
+			}
+		}
+		if(match >= 0) {
+			used[match] = true;
+			point.normalImpulse = previous[match].normalImpulse;
+			point.frictionImpulse = previous[match].frictionImpulse;
+			matching++;
+		}
+		else {
+			point.normalImpulse = 0.f;
+			point.frictionImpulse = XMFLOAT3(0.f, 0.f, 0.f);
+			creating++;
+		}
+	}
+	cached.pointCount = manifold.pointCount;
+	cached.normal = manifold.normal;
+	cached.axis = manifold.axis;
+}
+
+//the area four points span, whatever order they are in
+static float area(const XMVECTOR* p)
+{
+	float a = XMVectorGetX(XMVector3LengthSq(XMVector3Cross(p[0] - p[1], p[2] - p[3])));
+	float b = XMVectorGetX(XMVector3LengthSq(XMVector3Cross(p[0] - p[2], p[1] - p[3])));
+	float c = XMVectorGetX(XMVector3LengthSq(XMVector3Cross(p[0] - p[3], p[1] - p[2])));
+	return std::max(a, std::max(b, c));
+}
+
+void ContactCache::accumulate(CachedManifold& cached, const ConvexResult& result, const XMFLOAT4X4& worldA, const XMFLOAT4X4& worldInverseA, const XMFLOAT4X4& worldB, const XMFLOAT4X4& worldInverseB)
+{
+	XMVECTOR normal = XMLoadFloat3(&result.normal);
+	float turn = cached.normal.x*result.normal.x + cached.normal.y*result.normal.y + cached.normal.z*result.normal.z;
+	int previousCount = turn < normalTolerance ? 0 : cached.pointCount;
+	float limit = matchDistance*matchDistance;
+
+	//the old points where the bodies took them
+	CachedContact points[5];
+	int count = 0;
+	for(int i = 0; i < previousCount; i++) {
+		CachedContact point = cached.points[i];
+		XMVECTOR a = XMVector3Transform(XMLoadFloat3(&point.localA), XMLoadFloat4x4(&worldA));
+		XMVECTOR b = XMVector3Transform(XMLoadFloat3(&point.localB), XMLoadFloat4x4(&worldB));
+		float depth = XMVectorGetX(XMVector3Dot(b - a, normal));
+		XMVECTOR slide = a - b + normal*depth;
+		if(depth < -breakingDistance || XMVectorGetX(XMVector3LengthSq(slide)) > limit)
+			continue;
+		point.depth = depth;
+		XMStoreFloat3(&point.position, (a + b)*0.5f);
+		points[count++] = point;
+		matching++;
+	}
+
+	CachedContact fresh;
+	XMVECTOR a = XMLoadFloat3(&result.pointA), b = XMLoadFloat3(&result.pointB);
+	XMStoreFloat3(&fresh.position, (a + b)*0.5f);
+	XMStoreFloat3(&fresh.localA, XMVector3Transform(a, XMLoadFloat4x4(&worldInverseA)));
+	XMStoreFloat3(&fresh.localB, XMVector3Transform(b, XMLoadFloat4x4(&worldInverseB)));
+	fresh.depth = -result.distance;
+	fresh.feature = 0;
+	fresh.normalImpulse = 0.f;
+	fresh.frictionImpulse = XMFLOAT3(0.f, 0.f, 0.f);
+	int match = -1;
+	float best = limit;
+	for(int i = 0; i < count; i++) {
+		float d = distanceSquared(points[i].position, fresh.position);
+		if(d < best) {
+			best = d;
+			match = i;
+		}
+	}
+	if(match >= 0) {
+		fresh.normalImpulse = points[match].normalImpulse;
+		fresh.frictionImpulse = points[match].frictionImpulse;
+		points[match] = fresh;
+	}
+	else {
+		points[count++] = fresh;
+		creating++;
+	}
+
+	if(count == 5) {
+		//the new point stays, of the others the one without which the rest spans the most
+		int drop = 0;
+		float largest = -1.f;
+		for(int i = 0; i < 4; i++) {
+			XMVECTOR rest[4];
+			for(int j = 0, k = 0; j < 5; j++)
+				if(j != i)
+					rest[k++] = XMLoadFloat3(&points[j].position);
+			float spanned = area(rest);
+			if(spanned > largest) {
+				largest = spanned;
+				drop = i;
+			}
+		}
+		points[drop] = points[4];
+		count = 4;
+	}
+
+	for(int i = 0; i < count; i++)
+		cached.points[i] = points[i];
+	cached.pointCount = count;
+	cached.normal = result.normal;
+	cached.axis = -1;
+}
+
+void ContactCache::endStep()
+{
+	for(auto pair = pairs.begin(); pair != pairs.end();) {
+		if(pair->second.lastStep != step)
+			pair = pairs.erase(pair);
+		else
+			pair++;
+	}
+	pairCount = (int)pairs.size();
+	step++;
+	matchedPoints = matching;
+	newPoints = creating;
+	matching = creating = 0;
+}
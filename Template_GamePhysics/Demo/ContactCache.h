@@ -0,0 +1,87 @@
+#pragma once
+#ifndef ContactCache_HEADER
+#define ContactCache_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <map>
+#include <utility>
+#include "BoxCollision.h"
+#include "ConvexCollision.h"
+
+// One contact point that lives across steps, with the impulses it needed last time.
+struct CachedContact
+{
+	XMFLOAT3 position;
+	float depth;
+	int feature;
+	float normalImpulse;
+	XMFLOAT3 frictionImpulse;
+	//where the point is on A and on B in their own frames, only for accumulated points
+	XMFLOAT3 localA;
+	XMFLOAT3 localB;
+};
+
+// Everything kept about one pair of bodies, also while they are only close (then pointCount is 0
+// and the cached separating axis or simplex is what is left).
+struct CachedManifold
+{
+	int axis;
+	int pointCount;
+	XMFLOAT3 normal;
+	CachedContact points[4];
+	//last GJK simplex of pairs with a convex shape, count 0 for box pairs
+	ConvexSimplex simplex;
+	//step the pair was last reported by the broad phase
+	int lastStep;
+};
+
+// Persistent contact manifolds keyed by body pair.
+// A fresh manifold from the narrow phase is matched against the cached points: first the point
+// with the same feature id, otherwise the closest one, both within matchDistance and only while
+// the normal did not turn. Matched points keep their accumulated normal and friction impulses,
+// which the contacts apply as a warm start before solving, so a resting stack starts every step
+// with nearly the right answer instead of from zero.
+// GJK gives one point per step, so for pairs with a convex shape the manifold is built up over the
+// steps instead: the cached points are carried along by the bodies (anchors in both body frames),
+// kept while they still touch and have not slid apart, and the new point replaces the one it matches
+// or is added, dropping the point that leaves the largest area if there are five. A box resting on
+// a hull so gets its corners one after the other and stops rocking.
+// Pairs the broad phase stopped reporting are dropped at the end of the step.
+class ContactCache
+{
+public:
+	//how far a point may move between steps and still be the same contact
+	float matchDistance;
+	//cosine of the largest normal change that keeps the impulses
+	float normalTolerance;
+	//accumulated points further apart than this along the normal are dropped
+	float breakingDistance;
+
+	//statistics of the last step
+	int matchedPoints;
+	int newPoints;
+	int pairCount;
+
+	ContactCache();
+
+	void clear();
+
+	//the cached manifold of a pair, an empty one with no axis if the pair is new
+	CachedManifold& find(int bodyA, int bodyB);
+	//replaces the cached points by the new manifold, matched points keep their impulses
+	void refresh(CachedManifold& cached, const ContactManifold& manifold);
+	//adds the GJK point of a touching pair to the accumulated points. the matrices are the object to
+	//world ones of the bodies and their inverses (see RigidBodyWorld::world)
+	void accumulate(CachedManifold& cached, const ConvexResult& result, const XMFLOAT4X4& worldA, const XMFLOAT4X4& worldInverseA, const XMFLOAT4X4& worldB, const XMFLOAT4X4& worldInverseB);
+	//forgets the pairs not found since the last call
+	void endStep();
+
+private:
+	std::map<std::pair<int,int>, CachedManifold> pairs;
+	int step;
+	int matching, creating;
+};
+
+#endif
@@ -0,0 +1,334 @@
+#include "ContactSolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+ContactSolver::ContactSolver()
+{
+	iterations = 10;
+	positionCorrection = SPLIT_IMPULSE;
+	correctionFactor = 0.2f;
+	allowedPenetration = 0.01f;
+	restitution = 0.5f;
+	restitutionThreshold = 1.f;
+	colouringThreshold = 256;
+	rowCount = 0;
+	bodyCount = 0;
+	islandCount = 0;
+	largestIsland = 0;
+	colourCount = 0;
+}
+
+int ContactSolver::addBody(RigidBodyWorld& world, int body)
+{
+	if(bodyIndex[body] >= 0)
+		return bodyIndex[body];
+	BodyState state;
+	state.body = body;
+	//static bodies don't take any impulse, linear or angular
+	state.isStatic = world.isStatic[body] != 0;
+	state.massInverse = state.isStatic ? 0.f : world.massInverses[body];
+	state.inertiaInverse = state.isStatic ? XMMatrixScaling(0.f, 0.f, 0.f) : XMLoadFloat4x4(&world.worldInertiaInverses[body]);
+	state.linear = XMLoadFloat3(&world.velocities[body]);
+	state.angular = XMLoadFloat3(&world.angularVelocities[body]);
+	state.momentum = XMVectorZero();
+	state.pseudoLinear = XMVectorZero();
+	state.pseudoAngular = XMVectorZero();
+	int index = (int)bodies.size();
+	bodies.push_back(state);
+	bodyIndex[body] = index;
+	return index;
+}
+
+int ContactSolver::findRoot(int body)
+{
+	while(parent[body] != body) {
+		parent[body] = parent[parent[body]];
+		body = parent[body];
+	}
+	return body;
+}
+
+void ContactSolver::buildIslands(StepArena& arena)
+{
+	int count = (int)bodies.size();
+	parent.resize(count);
+	for(int i = 0; i < count; i++)
+		parent[i] = i;
+	for(auto row = rows.begin(); row != rows.end(); row++) {
+		if(bodies[row->bodyA].isStatic || bodies[row->bodyB].isStatic)
+			continue;
+		int a = findRoot(row->bodyA), b = findRoot(row->bodyB);
+		//the lower index stays the root, so the result doesn't depend on the row order
+		if(a != b)
+			parent[std::max(a, b)] = std::min(a, b);
+	}
+
+	//islands numbered by their first row, rows keep their order inside an island
+	int* rowIsland = arena.allocateArray<int>(rows.size());
+	islandOfRoot.assign(count, -1);
+	islandCount = 0;
+	for(size_t k = 0; k < rows.size(); k++) {
+		int body = bodies[rows[k].bodyA].isStatic ? rows[k].bodyB : rows[k].bodyA;
+		int root = findRoot(body);
+		if(islandOfRoot[root] < 0)
+			islandOfRoot[root] = islandCount++;
+		rowIsland[k] = islandOfRoot[root];
+	}
+	islandStart.assign(islandCount + 1, 0);
+	for(size_t k = 0; k < rows.size(); k++)
+		islandStart[rowIsland[k] + 1]++;
+	for(int i = 0; i < islandCount; i++)
+		islandStart[i + 1] += islandStart[i];
+	islandRows.resize(rows.size());
+	int* fill = arena.allocateArray<int>(islandCount);
+	std::copy(islandStart.begin(), islandStart.end() - 1, fill);
+	for(size_t k = 0; k < rows.size(); k++)
+		islandRows[fill[rowIsland[k]]++] = (int)k;
+
+	smallIslands.clear();
+	colourRows.clear();
+	colourStart.assign(1, 0);
+	largeIslandColours.assign(1, 0);
+	largestIsland = 0;
+	colourCount = 0;
+	for(int i = 0; i < islandCount; i++) {
+		int size = islandStart[i + 1] - islandStart[i];
+		largestIsland = std::max(largestIsland, size);
+		if(size < colouringThreshold)
+			smallIslands.push_back(i);
+		else {
+			colourIsland(i, arena);
+			largeIslandColours.push_back((int)colourStart.size() - 1);
+		}
+	}
+}
+
+void ContactSolver::colourIsland(int island, StepArena& arena)
+{
+	//one greedy pass per colour: a row joins unless one of its dynamic bodies already has a row in it
+	colourMark.assign(bodies.size(), -1);
+	int remainingCount = islandStart[island + 1] - islandStart[island];
+	int* remaining = arena.allocateArray<int>(remainingCount);
+	int* next = arena.allocateArray<int>(remainingCount);
+	std::copy(islandRows.begin() + islandStart[island], islandRows.begin() + islandStart[island + 1], remaining);
+	int colour = 0;
+	while(remainingCount > 0) {
+		int nextCount = 0;
+		for(int k = 0; k < remainingCount; k++) {
+			const Row& row = rows[remaining[k]];
+			bool freeA = bodies[row.bodyA].isStatic || colourMark[row.bodyA] != colour;
+			bool freeB = bodies[row.bodyB].isStatic || colourMark[row.bodyB] != colour;
+			if(freeA && freeB) {
+				colourMark[row.bodyA] = colourMark[row.bodyB] = colour;
+				colourRows.push_back(remaining[k]);
+			}
+			else
+				next[nextCount++] = remaining[k];
+		}
+		colourStart.push_back((int)colourRows.size());
+		std::swap(remaining, next);
+		remainingCount = nextCount;
+		colour++;
+	}
+	colourCount = std::max(colourCount, colour);
+}
+
+float ContactSolver::inverseMass(const Row& row, XMVECTOR direction)
+{
+	const BodyState& a = bodies[row.bodyA];
+	const BodyState& b = bodies[row.bodyB];
+	XMVECTOR angularA = XMVector3Transform(XMVector3Cross(row.armA, direction), a.inertiaInverse);
+	XMVECTOR angularB = XMVector3Transform(XMVector3Cross(row.armB, direction), b.inertiaInverse);
+	float result = a.massInverse + b.massInverse + XMVectorGetX(XMVector3Dot(XMVector3Cross(angularA, row.armA) + XMVector3Cross(angularB, row.armB), direction));
+	return result;
+}
+
+void ContactSolver::applyImpulse(const Row& row, XMVECTOR impulse)
+{
+	BodyState& a = bodies[row.bodyA];
+	BodyState& b = bodies[row.bodyB];
+	if(!a.isStatic) {
+		XMVECTOR torque = XMVector3Cross(row.armA, impulse);
+		a.linear += impulse*a.massInverse;
+		a.angular += XMVector3Transform(torque, a.inertiaInverse);
+		a.momentum += torque;
+	}
+	if(!b.isStatic) {
+		XMVECTOR torque = XMVector3Cross(row.armB, impulse);
+		b.linear -= impulse*b.massInverse;
+		b.angular -= XMVector3Transform(torque, b.inertiaInverse);
+		b.momentum -= torque;
+	}
+}
+
+void ContactSolver::applyPseudoImpulse(const Row& row, XMVECTOR impulse)
+{
+	BodyState& a = bodies[row.bodyA];
+	BodyState& b = bodies[row.bodyB];
+	if(!a.isStatic) {
+		a.pseudoLinear += impulse*a.massInverse;
+		a.pseudoAngular += XMVector3Transform(XMVector3Cross(row.armA, impulse), a.inertiaInverse);
+	}
+	if(!b.isStatic) {
+		b.pseudoLinear -= impulse*b.massInverse;
+		b.pseudoAngular -= XMVector3Transform(XMVector3Cross(row.armB, impulse), b.inertiaInverse);
+	}
+}
+
+XMVECTOR ContactSolver::relativeVelocity(const Row& row)
+{
+	const BodyState& a = bodies[row.bodyA];
+	const BodyState& b = bodies[row.bodyB];
+	return a.linear + XMVector3Cross(a.angular, row.armA) - b.linear - XMVector3Cross(b.angular, row.armB);
+}
+
+void ContactSolver::prepareRow(Row& row, const SolverContact& contact, RigidBodyWorld& world, float timeStep)
+{
+	XMVECTOR position = XMLoadFloat3(&contact.position);
+	row.normal = XMVector3Normalize(XMLoadFloat3(&contact.normal));
+	row.armA = position - XMLoadFloat3(&world.positions[contact.bodyA]);
+	row.armB = position - XMLoadFloat3(&world.positions[contact.bodyB]);
+	//any two directions perpendicular to the normal
+	XMVECTOR helper = std::abs(XMVectorGetX(row.normal)) < 0.57f ? XMVectorSet(1.f, 0.f, 0.f, 0.f) : XMVectorSet(0.f, 1.f, 0.f, 0.f);
+	row.tangent[0] = XMVector3Normalize(XMVector3Cross(row.normal, helper));
+	row.tangent[1] = XMVector3Cross(row.normal, row.tangent[0]);
+
+	float normalInverse = inverseMass(row, row.normal);
+	row.normalMass = normalInverse > 0.f ? 1.f/normalInverse : 0.f;
+	for(int t = 0; t < 2; t++) {
+		float tangentInverse = inverseMass(row, row.tangent[t]);
+		row.tangentMass[t] = tangentInverse > 0.f ? 1.f/tangentInverse : 0.f;
+	}
+
+	float approach = XMVectorGetX(XMVector3Dot(relativeVelocity(row), row.normal));
+	row.velocityTarget = approach < -restitutionThreshold ? -restitution*approach : 0.f;
+	float penetration = std::max(contact.depth - allowedPenetration, 0.f);
+	row.positionTarget = correctionFactor*penetration/timeStep;
+	if(positionCorrection == BAUMGARTE)
+		row.velocityTarget = std::max(row.velocityTarget, row.positionTarget);
+
+	row.friction = contact.friction;
+	row.normalImpulse = contact.normalImpulse;
+	XMVECTOR friction = XMLoadFloat3(&contact.frictionImpulse);
+	row.tangentImpulse[0] = XMVectorGetX(XMVector3Dot(friction, row.tangent[0]));
+	row.tangentImpulse[1] = XMVectorGetX(XMVector3Dot(friction, row.tangent[1]));
+	row.pseudoImpulse = 0.f;
+}
+
+void ContactSolver::warmStartRow(Row& row)
+{
+	//the friction part was projected onto the new tangents
+	applyImpulse(row, row.normal*row.normalImpulse + row.tangent[0]*row.tangentImpulse[0] + row.tangent[1]*row.tangentImpulse[1]);
+}
+
+void ContactSolver::solveRow(Row& row)
+{
+	//friction first, with the normal impulse of the last iteration as the limit
+	XMVECTOR v = relativeVelocity(row);
+	float old[2] = { row.tangentImpulse[0], row.tangentImpulse[1] };
+	for(int t = 0; t < 2; t++)
+		row.tangentImpulse[t] -= row.tangentMass[t]*XMVectorGetX(XMVector3Dot(v, row.tangent[t]));
+	float limit = row.friction*row.normalImpulse;
+	float length = std::sqrt(row.tangentImpulse[0]*row.tangentImpulse[0] + row.tangentImpulse[1]*row.tangentImpulse[1]);
+	if(length > limit) {
+		row.tangentImpulse[0] *= limit/length;
+		row.tangentImpulse[1] *= limit/length;
+	}
+	applyImpulse(row, row.tangent[0]*(row.tangentImpulse[0] - old[0]) + row.tangent[1]*(row.tangentImpulse[1] - old[1]));
+
+	//the accumulated normal impulse only ever pushes
+	float normalVelocity = XMVectorGetX(XMVector3Dot(relativeVelocity(row), row.normal));
+	float previous = row.normalImpulse;
+	row.normalImpulse = std::max(previous + row.normalMass*(row.velocityTarget - normalVelocity), 0.f);
+	applyImpulse(row, row.normal*(row.normalImpulse - previous));
+}
+
+void ContactSolver::solvePseudoRow(Row& row)
+{
+	const BodyState& a = bodies[row.bodyA];
+	const BodyState& b = bodies[row.bodyB];
+	XMVECTOR v = a.pseudoLinear + XMVector3Cross(a.pseudoAngular, row.armA) - b.pseudoLinear - XMVector3Cross(b.pseudoAngular, row.armB);
+	float normalVelocity = XMVectorGetX(XMVector3Dot(v, row.normal));
+	float previous = row.pseudoImpulse;
+	row.pseudoImpulse = std::max(previous + row.normalMass*(row.positionTarget - normalVelocity), 0.f);
+	applyPseudoImpulse(row, row.normal*(row.pseudoImpulse - previous));
+}
+
+void ContactSolver::solve(std::vector<SolverContact>& contacts, RigidBodyWorld& world, float timeStep, ThreadPool& pool, StepArena& arena)
+{
+	rows.resize(contacts.size());
+	bodies.clear();
+	bodyIndex.assign(world.size(), -1);
+	for(size_t k = 0; k < contacts.size(); k++) {
+		rows[k].bodyA = addBody(world, contacts[k].bodyA);
+		rows[k].bodyB = addBody(world, contacts[k].bodyB);
+	}
+	rowCount = (int)rows.size();
+	bodyCount = (int)bodies.size();
+
+	//rows, with everything that stays the same over the iterations
+	pool.parallelFor(rowCount, 64, [&](int begin, int end) {
+		for(int k = begin; k < end; k++)
+			prepareRow(rows[k], contacts[k], world, timeStep);
+	});
+	buildIslands(arena);
+
+	//whole islands, one thread each
+	bool split = positionCorrection == SPLIT_IMPULSE;
+	pool.parallelFor((int)smallIslands.size(), 1, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			int first = islandStart[smallIslands[i]], last = islandStart[smallIslands[i] + 1];
+			for(int k = first; k < last; k++)
+				warmStartRow(rows[islandRows[k]]);
+			for(int iteration = 0; iteration < iterations; iteration++)
+				for(int k = first; k < last; k++)
+					solveRow(rows[islandRows[k]]);
+			if(split)
+				for(int iteration = 0; iteration < iterations; iteration++)
+					for(int k = first; k < last; k++)
+						solvePseudoRow(rows[islandRows[k]]);
+		}
+	});
+
+	//coloured islands, the rows of one colour in parallel
+	for(size_t i = 0; i + 1 < largeIslandColours.size(); i++) {
+		int firstColour = largeIslandColours[i], lastColour = largeIslandColours[i + 1];
+		for(int pass = -1; pass < (split ? 2*iterations : iterations); pass++) {
+			for(int colour = firstColour; colour < lastColour; colour++) {
+				int first = colourStart[colour];
+				pool.parallelFor(colourStart[colour + 1] - first, 16, [&](int begin, int end) {
+					for(int k = first + begin; k < first + end; k++) {
+						if(pass < 0)
+							warmStartRow(rows[colourRows[k]]);
+						else if(pass < iterations)
+							solveRow(rows[colourRows[k]]);
+						else
+							solvePseudoRow(rows[colourRows[k]]);
+					}
+				});
+			}
+		}
+	}
+
+	pool.parallelFor(bodyCount, 64, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			BodyState& body = bodies[i];
+			if(body.isStatic)
+				continue;
+			int b = body.body;
+			XMStoreFloat3(&world.velocities[b], body.linear);
+			XMStoreFloat3(&world.angularMomenta[b], XMLoadFloat3(&world.angularMomenta[b]) + body.momentum);
+			if(split)
+				world.correctPosition(b, body.pseudoLinear*timeStep, body.pseudoAngular*timeStep);
+			else
+				world.updateInertia(b);
+		}
+	});
+
+	for(size_t k = 0; k < contacts.size(); k++) {
+		const Row& row = rows[k];
+		contacts[k].normalImpulse = row.normalImpulse;
+		XMStoreFloat3(&contacts[k].frictionImpulse, row.tangent[0]*row.tangentImpulse[0] + row.tangent[1]*row.tangentImpulse[1]);
+	}
+}
@@ -0,0 +1,149 @@
+#pragma once
+#ifndef ContactSolver_HEADER
+#define ContactSolver_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "RigidBodyWorld.h"
+#include "ThreadPool.h"
+#include "StepArena.h"
+
+// One contact point between two bodies of a RigidBodyWorld. The normal points from B to A, the
+// direction of the impulse on A, depth is the penetration.
+struct SolverContact
+{
+	int bodyA;
+	int bodyB;
+	XMFLOAT3 position;
+	XMFLOAT3 normal;
+	float depth;
+	float friction;
+	//impulses summed over the step, carried over from the last step by the contact cache
+	float normalImpulse;
+	XMFLOAT3 frictionImpulse;
+};
+
+// Sequential impulse solver for all contacts of a step.
+// Every contact becomes a row with its lever arms, normal and tangent directions and their
+// effective masses computed once, the restitution target comes from the velocity before the solve.
+// The carried over impulses (SolverContact::normalImpulse/frictionImpulse, see ContactCache) are applied
+// first, then every iteration goes over the rows in order (Gauss-Seidel) and only changes the
+// accumulated impulses: the normal one never pulls, the friction one stays inside the Coulomb cone
+// of the current normal impulse. The velocities are kept in the solver while iterating and only
+// written back to the world at the end.
+// Penetration beyond allowedPenetration is pushed out either by a Baumgarte bias on the velocity
+// (adds energy, stacks jitter) or by split impulses, which solve the same rows a second time on
+// separate pseudo velocities that only move the bodies and are thrown away afterwards.
+//
+// Rows only affect each other through shared dynamic bodies, so the bodies are split into islands
+// (union-find over the rows, static bodies don't connect anything) and the islands are solved in
+// parallel, each one in row order. An island with at least colouringThreshold rows would keep one
+// thread busy on its own, its rows are coloured instead so that no two rows of one colour share a
+// dynamic body, and the rows of a colour are solved in parallel, one colour after the other.
+// Neither the islands nor the colours depend on the thread count, so neither does the result.
+class ContactSolver
+{
+public:
+	enum PositionCorrection
+	{
+		NO_CORRECTION,
+		BAUMGARTE,
+		SPLIT_IMPULSE
+	};
+
+	int iterations;
+	int positionCorrection;
+	//fraction of the penetration removed per step
+	float correctionFactor;
+	float allowedPenetration;
+	float restitution;
+	//slower impacts don't bounce, resting contacts would jitter
+	float restitutionThreshold;
+	int colouringThreshold;
+
+	//statistics of the last solve
+	int rowCount;
+	int bodyCount;
+	int islandCount;
+	int largestIsland;
+	int colourCount;
+
+	ContactSolver();
+
+	//changes the velocities in the world (and the positions with split impulses), the accumulated
+	//impulses end up in the contacts. the island and colouring scratch comes from the arena
+	void solve(std::vector<SolverContact>& contacts, RigidBodyWorld& world, float timeStep, ThreadPool& pool, StepArena& arena);
+
+private:
+	struct Row
+	{
+		int bodyA;
+		int bodyB;
+		XMVECTOR normal;
+		XMVECTOR tangent[2];
+		XMVECTOR armA;
+		XMVECTOR armB;
+		//inverse effective masses turned into masses
+		float normalMass;
+		float tangentMass[2];
+		float velocityTarget;
+		float positionTarget;
+		float friction;
+		float normalImpulse;
+		float tangentImpulse[2];
+		float pseudoImpulse;
+	};
+
+	struct BodyState
+	{
+		//index in the world
+		int body;
+		//static bodies are shared by all islands and never written
+		bool isStatic;
+		float massInverse;
+		XMMATRIX inertiaInverse;
+		XMVECTOR linear;
+		XMVECTOR angular;
+		//angular momentum added by the solver, written back with the velocities
+		XMVECTOR momentum;
+		XMVECTOR pseudoLinear;
+		XMVECTOR pseudoAngular;
+	};
+
+	std::vector<Row> rows;
+	std::vector<BodyState> bodies;
+	//solver body of every world body, -1 if it has no contact
+	std::vector<int> bodyIndex;
+
+	//union-find parents of the bodies, then the rows grouped by island, islandStart has one entry more
+	std::vector<int> parent;
+	std::vector<int> islandOfRoot;
+	std::vector<int> islandRows;
+	std::vector<int> islandStart;
+	//islands solved whole, and the rows of the coloured ones grouped by colour. colours
+	//largeIslandColours[i] to largeIslandColours[i+1] belong to the i-th coloured island
+	std::vector<int> smallIslands;
+	std::vector<int> colourRows;
+	std::vector<int> colourStart;
+	std::vector<int> largeIslandColours;
+	std::vector<int> colourMark;
+
+	int addBody(RigidBodyWorld& world, int body);
+	int findRoot(int body);
+	void buildIslands(StepArena& arena);
+	//appends the colours of an island to colourRows/colourStart
+	void colourIsland(int island, StepArena& arena);
+
+	float inverseMass(const Row& row, XMVECTOR direction);
+	void applyImpulse(const Row& row, XMVECTOR impulse);
+	void applyPseudoImpulse(const Row& row, XMVECTOR impulse);
+	XMVECTOR relativeVelocity(const Row& row);
+	void prepareRow(Row& row, const SolverContact& contact, RigidBodyWorld& world, float timeStep);
+	void warmStartRow(Row& row);
+	void solveRow(Row& row);
+	void solvePseudoRow(Row& row);
+};
+
+#endif
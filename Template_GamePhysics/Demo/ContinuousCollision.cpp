@@ -0,0 +1,178 @@
+#include "ContinuousCollision.h"
+#include "BoxCollision.h"
+
+#include <algorithm>
+#include <cmath>
+
+//pose of a body after moving for time with its current velocities, as integratePositions would
+static void predictPose(RigidBodyWorld& world, int body, const XMFLOAT3& position, const XMFLOAT4& orientation, float time, XMFLOAT3& p, XMFLOAT4& q)
+{
+	XMStoreFloat3(&p, XMLoadFloat3(&position) + XMLoadFloat3(&world.velocities[body])*time);
+	XMVECTOR rotation = XMLoadFloat4(&orientation);
+	XMVECTOR turn = XMQuaternionMultiply(rotation, XMVectorSetW(XMLoadFloat3(&world.angularVelocities[body])*time, 0.f));
+	XMStoreFloat4(&q, XMQuaternionNormalize(rotation + turn*0.5f));
+}
+
+static XMFLOAT4X4 predictTransform(RigidBodyWorld& world, int body, const XMFLOAT3& position, const XMFLOAT4& orientation, float time)
+{
+	const XMFLOAT3& s = world.scales[body];
+	XMFLOAT3 p;
+	XMFLOAT4 q;
+	predictPose(world, body, position, orientation, time, p, q);
+	XMFLOAT4X4 transform;
+	XMStoreFloat4x4(&transform, XMMatrixScaling(s.x, s.y, s.z)*XMMatrixRotationQuaternion(XMLoadFloat4(&q))*XMMatrixTranslation(p.x, p.y, p.z));
+	return transform;
+}
+
+//no point of the body is further from the centre
+static float boundingRadius(RigidBodyWorld& world, int body)
+{
+	ConvexShape box;
+	return world.shape(body, box).boundingRadius();
+}
+
+ContinuousCollision::ContinuousCollision()
+{
+	fastFraction = 0.5f;
+	tolerance = 0.01f;
+	maxIterations = 20;
+	maxSubSteps = 4;
+	fastBodies = 0;
+	impacts = 0;
+}
+
+void ContinuousCollision::sweepBounds(RigidBodyWorld& world, float timeStep)
+{
+	int count = world.size();
+	fast.assign(count, 0);
+	fastBodies = 0;
+	for(int i = 0; i < count; i++) {
+		if(world.isStatic[i])
+			continue;
+		ConvexShape box;
+		const XMFLOAT3& half = world.shape(i, box).halfExtents;
+		float radius = boundingRadius(world, i);
+		XMVECTOR move = XMLoadFloat3(&world.velocities[i])*timeStep;
+		float turn = std::min(XMVectorGetX(XMVector3Length(XMLoadFloat3(&world.angularVelocities[i])))*timeStep*radius, radius);
+		float motion = XMVectorGetX(XMVector3Length(move)) + turn;
+		if(motion <= fastFraction*std::min(half.x, std::min(half.y, half.z)))
+			continue;
+		fast[i] = 1;
+		fastBodies++;
+		//the box at the start and at the end of the step, grown by what the rotation can add
+		XMVECTOR lower = XMLoadFloat3(&world.lower[i]), upper = XMLoadFloat3(&world.upper[i]);
+		XMVECTOR grow = XMVectorReplicate(turn);
+		XMStoreFloat3(&world.lower[i], XMVectorMin(lower, lower + move) - grow);
+		XMStoreFloat3(&world.upper[i], XMVectorMax(upper, upper + move) + grow);
+	}
+}
+
+float ContinuousCollision::timeOfImpact(RigidBodyWorld& world, int body, int other, float elapsed, float duration, XMVECTOR& normal)
+{
+	XMVECTOR relative = XMLoadFloat3(&world.velocities[body]) - XMLoadFloat3(&world.velocities[other]);
+	float bound = XMVectorGetX(XMVector3Length(relative))
+		+ XMVectorGetX(XMVector3Length(XMLoadFloat3(&world.angularVelocities[body])))*boundingRadius(world, body)
+		+ XMVectorGetX(XMVector3Length(XMLoadFloat3(&world.angularVelocities[other])))*boundingRadius(world, other);
+	if(bound*duration <= 0.f)
+		return 1.f;
+
+	//two boxes by their separating axes, anything else by GJK, starting from the last simplex
+	ConvexShape boxA, boxB;
+	ConvexBody a, b;
+	a.shape = &world.shape(body, boxA);
+	b.shape = &world.shape(other, boxB);
+	bool boxes = world.bodyShapes[body] < 0 && world.bodyShapes[other] < 0;
+	ConvexSimplex simplex;
+	simplex.count = 0;
+	ConvexResult result;
+
+	float t = 0.f;
+	for(int iteration = 0; iteration < maxIterations; iteration++) {
+		XMFLOAT3 axis;
+		float gap;
+		if(boxes)
+			gap = BoxCollision::separation(predictTransform(world, body, world.positions[body], world.orientations[body], t*duration),
+				predictTransform(world, other, startPositions[other], startOrientations[other], elapsed + t*duration), axis);
+		else {
+			predictPose(world, body, world.positions[body], world.orientations[body], t*duration, a.position, a.orientation);
+			predictPose(world, other, startPositions[other], startOrientations[other], elapsed + t*duration, b.position, b.orientation);
+			convex.query(a, b, simplex, result);
+			gap = result.distance;
+			axis = XMFLOAT3(-result.normal.x, -result.normal.y, -result.normal.z);
+		}
+		if(gap < tolerance) {
+			normal = XMLoadFloat3(&axis);
+			//moving apart or sliding past, the discrete contacts are enough
+			if(XMVectorGetX(XMVector3Dot(relative, normal)) <= 0.f)
+				return 1.f;
+			return t;
+		}
+		//nothing can close the gap faster than the bound
+		t += (gap - 0.5f*tolerance)/(bound*duration);
+		if(t >= 1.f)
+			return 1.f;
+	}
+	//not converged, safe up to here. no normal, no impulse, the next sub-step goes on from there
+	normal = XMVectorZero();
+	return t;
+}
+
+bool ContinuousCollision::impact(RigidBodyWorld& world, int body, int other, XMVECTOR normal)
+{
+	XMVECTOR a = XMLoadFloat3(&world.velocities[body]), b = XMLoadFloat3(&world.velocities[other]);
+	float approach = XMVectorGetX(XMVector3Dot(a - b, normal));
+	float massInverse = world.massInverses[body] + world.massInverses[other];
+	if(approach <= 0.f || massInverse <= 0.f)
+		return false;
+	XMVECTOR impulse = normal*(approach/massInverse);
+	XMStoreFloat3(&world.velocities[body], a - impulse*world.massInverses[body]);
+	XMStoreFloat3(&world.velocities[other], b + impulse*world.massInverses[other]);
+	return true;
+}
+
+void ContinuousCollision::integratePositions(RigidBodyWorld& world, const std::vector<std::pair<int, int>>& pairs, float timeStep, ThreadPool& pool)
+{
+	impacts = 0;
+	convex.resetStatistics();
+	moved.assign(world.size(), 0);
+	if(fastBodies > 0) {
+		startPositions = world.positions;
+		startOrientations = world.orientations;
+		partners.clear();
+		for(auto pair = pairs.begin(); pair != pairs.end(); pair++) {
+			if(fast[pair->first])
+				partners.push_back(*pair);
+			if(fast[pair->second])
+				partners.push_back(std::make_pair(pair->second, pair->first));
+		}
+		std::sort(partners.begin(), partners.end());
+
+		for(size_t first = 0, last = 0; first < partners.size(); first = last) {
+			int body = partners[first].first;
+			for(last = first; last < partners.size() && partners[last].first == body; last++);
+			moved[body] = 1;
+			float elapsed = 0.f;
+			for(int subStep = 0; subStep < maxSubSteps && elapsed < timeStep; subStep++) {
+				float duration = timeStep - elapsed, earliest = 1.f;
+				int hit = -1;
+				XMVECTOR hitNormal = XMVectorZero(), normal;
+				for(size_t k = first; k < last; k++) {
+					float t = timeOfImpact(world, body, partners[k].second, elapsed, duration, normal);
+					if(t < earliest) {
+						earliest = t;
+						hit = partners[k].second;
+						hitNormal = normal;
+					}
+				}
+				world.correctPosition(body, XMLoadFloat3(&world.velocities[body])*(earliest*duration), XMLoadFloat3(&world.angularVelocities[body])*(earliest*duration));
+				elapsed += earliest*duration;
+				if(hit < 0)
+					break;
+				if(impact(world, body, hit, hitNormal))
+					impacts++;
+			}
+		}
+	}
+	//the rest, fast bodies without partners too
+	world.integratePositions(timeStep, pool, &moved);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef ContinuousCollision_HEADER
+#define ContinuousCollision_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include <utility>
+#include "RigidBodyWorld.h"
+#include "ConvexCollision.h"
+#include "ThreadPool.h"
+
+// Continuous collision for the bodies that move too far in one step (explode, mouse drag).
+// A body is fast when its motion over the step, linear plus rotation at its corners, is more than
+// fastFraction of its smallest half extent, less than that and the discrete contacts catch it.
+// sweepBounds grows the bounds of fast bodies over their whole motion, so the broad phase reports
+// everything they could hit during the step.
+// integratePositions then moves only the fast bodies by sub-steps: conservative advancement against
+// every pair partner finds the first time of impact (the SAT gap of two boxes is never more than
+// their distance, pairs with a convex shape take the GJK distance, and no point of either body moves
+// faster than |v_rel| + |w_A| r_A + |w_B| r_B),
+// the body is moved up to it, the approaching part of the relative velocity is taken out with a
+// plastic impulse through the centres, and the rest of the step goes on from there. After
+// maxSubSteps the rest of the step is dropped. The solver handles the resting contact next step.
+// All other bodies move with RigidBodyWorld::integratePositions as usual.
+// Partners are taken as moving straight from where they were at the start of the step.
+class ContinuousCollision
+{
+public:
+	//of the smallest half extent (the radius of round shapes) per step
+	float fastFraction;
+	//bodies stop this far from what they hit
+	float tolerance;
+	int maxIterations;
+	int maxSubSteps;
+
+	//per body, set by sweepBounds
+	std::vector<char> fast;
+
+	//statistics of the last step
+	int fastBodies;
+	int impacts;
+
+	ContinuousCollision();
+
+	//marks the fast bodies and grows their bounds (world.lower/upper) over the step
+	void sweepBounds(RigidBodyWorld& world, float timeStep);
+	//moves all bodies, the fast ones up to their impacts with the partners in pairs
+	void integratePositions(RigidBodyWorld& world, const std::vector<std::pair<int, int>>& pairs, float timeStep, ThreadPool& pool);
+
+private:
+	std::vector<XMFLOAT3> startPositions;
+	std::vector<XMFLOAT4> startOrientations;
+	//(fast body, partner), sorted by fast body
+	std::vector<std::pair<int, int>> partners;
+	//bodies already moved by sub-steps
+	std::vector<char> moved;
+	//distances of pairs with a convex shape
+	ConvexCollision convex;
+
+	//fraction of duration until body, from where it is now, comes within tolerance of other while
+	//approaching it, 1 if it doesn't. elapsed is the time since the start of the step
+	float timeOfImpact(RigidBodyWorld& world, int body, int other, float elapsed, float duration, XMVECTOR& normal);
+	//plastic impulse through the centres along normal (from body to other), false if they don't approach
+	bool impact(RigidBodyWorld& world, int body, int other, XMVECTOR normal);
+};
+
+#endif
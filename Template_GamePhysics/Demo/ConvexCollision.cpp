@@ -0,0 +1,449 @@
+#include "ConvexCollision.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+static XMVECTOR load(const XMFLOAT3& v)
+{
+	return XMLoadFloat3(&v);
+}
+
+static float dot(FXMVECTOR a, FXMVECTOR b)
+{
+	return XMVectorGetX(XMVector3Dot(a, b));
+}
+
+//a point of the shape from its own frame into the world
+static XMVECTOR place(const ConvexBody& body, FXMVECTOR local)
+{
+	return XMVector3Rotate(local, XMLoadFloat4(&body.orientation)) + XMLoadFloat3(&body.position);
+}
+
+//the sub simplex holding the point closest to the origin, and the weights of that point
+struct Closest
+{
+	int count;
+	int index[4];
+	float lambda[4];
+};
+
+static void closestSegment(const XMVECTOR* w, int i0, int i1, Closest& closest)
+{
+	XMVECTOR edge = w[i1] - w[i0];
+	float length = dot(edge, edge);
+	float t = length > 0.f ? -dot(w[i0], edge)/length : 0.f;
+	if(t <= 0.f) {
+		closest.count = 1;
+		closest.index[0] = i0;
+		closest.lambda[0] = 1.f;
+	}
+	else if(t >= 1.f) {
+		closest.count = 1;
+		closest.index[0] = i1;
+		closest.lambda[0] = 1.f;
+	}
+	else {
+		closest.count = 2;
+		closest.index[0] = i0;
+		closest.index[1] = i1;
+		closest.lambda[0] = 1.f - t;
+		closest.lambda[1] = t;
+	}
+}
+
+static XMVECTOR pointOf(const XMVECTOR* w, const Closest& closest)
+{
+	XMVECTOR point = XMVectorZero();
+	for(int k = 0; k < closest.count; k++)
+		point += w[closest.index[k]]*closest.lambda[k];
+	return point;
+}
+
+//the Voronoi regions of the triangle in turn, Ericson 5.1.5 with the origin as the point
+static void closestTriangle(const XMVECTOR* w, int i0, int i1, int i2, Closest& closest)
+{
+	XMVECTOR a = w[i0], b = w[i1], c = w[i2];
+	XMVECTOR ab = b - a, ac = c - a;
+	float d1 = -dot(ab, a), d2 = -dot(ac, a);
+	if(d1 <= 0.f && d2 <= 0.f) {
+		closest.count = 1;
+		closest.index[0] = i0;
+		closest.lambda[0] = 1.f;
+		return;
+	}
+	float d3 = -dot(ab, b), d4 = -dot(ac, b);
+	if(d3 >= 0.f && d4 <= d3) {
+		closest.count = 1;
+		closest.index[0] = i1;
+		closest.lambda[0] = 1.f;
+		return;
+	}
+	float vc = d1*d4 - d3*d2;
+	if(vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+		closestSegment(w, i0, i1, closest);
+		return;
+	}
+	float d5 = -dot(ab, c), d6 = -dot(ac, c);
+	if(d6 >= 0.f && d5 <= d6) {
+		closest.count = 1;
+		closest.index[0] = i2;
+		closest.lambda[0] = 1.f;
+		return;
+	}
+	float vb = d5*d2 - d1*d6;
+	if(vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+		closestSegment(w, i0, i2, closest);
+		return;
+	}
+	float va = d3*d6 - d5*d4;
+	if(va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+		closestSegment(w, i1, i2, closest);
+		return;
+	}
+	float sum = va + vb + vc;
+	if(sum <= FLT_MIN) {
+		//flat triangle, the best of its edges
+		Closest edge;
+		float best = FLT_MAX;
+		int edges[3][2] = { { i0, i1 }, { i1, i2 }, { i2, i0 } };
+		for(int e = 0; e < 3; e++) {
+			closestSegment(w, edges[e][0], edges[e][1], edge);
+			XMVECTOR point = pointOf(w, edge);
+			if(dot(point, point) < best) {
+				best = dot(point, point);
+				closest = edge;
+			}
+		}
+		return;
+	}
+	closest.count = 3;
+	closest.index[0] = i0;
+	closest.index[1] = i1;
+	closest.index[2] = i2;
+	closest.lambda[1] = vb/sum;
+	closest.lambda[2] = vc/sum;
+	closest.lambda[0] = 1.f - closest.lambda[1] - closest.lambda[2];
+}
+
+static void closestTetrahedron(const XMVECTOR* w, Closest& closest)
+{
+	//each face with the vertex across from it
+	static const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+	float weights[4];
+	bool outside[4];
+	bool inside = true;
+	for(int f = 0; f < 4; f++) {
+		XMVECTOR a = w[faces[f][0]];
+		XMVECTOR normal = XMVector3Cross(w[faces[f][1]] - a, w[faces[f][2]] - a);
+		XMVECTOR height = w[faces[f][3]] - a;
+		float origin = -dot(normal, a), across = dot(normal, height);
+		//a flat tetrahedron has no inside, every face is a candidate
+		outside[f] = across*across <= 1e-10f*dot(normal, normal)*dot(height, height) || origin*across < 0.f;
+		inside = inside && !outside[f];
+		weights[faces[f][3]] = outside[f] ? 0.f : origin/across;
+	}
+	if(inside) {
+		closest.count = 4;
+		for(int k = 0; k < 4; k++) {
+			closest.index[k] = k;
+			closest.lambda[k] = weights[k];
+		}
+		return;
+	}
+	Closest face;
+	float best = FLT_MAX;
+	for(int f = 0; f < 4; f++) {
+		if(!outside[f])
+			continue;
+		closestTriangle(w, faces[f][0], faces[f][1], faces[f][2], face);
+		XMVECTOR point = pointOf(w, face);
+		if(dot(point, point) < best) {
+			best = dot(point, point);
+			closest = face;
+		}
+	}
+}
+
+ConvexCollision::ConvexCollision()
+{
+	tolerance = 1e-3f;
+	maxIterations = 32;
+	maxFaces = 128;
+	queries = 0;
+	iterations = 0;
+	penetrations = 0;
+}
+
+void ConvexCollision::resetStatistics()
+{
+	queries = 0;
+	iterations = 0;
+	penetrations = 0;
+}
+
+ConvexCollision::Vertex ConvexCollision::support(const ConvexBody& a, const ConvexBody& b, FXMVECTOR direction)
+{
+	iterations++;
+	Vertex vertex;
+	XMVECTOR localA = a.shape->coreSupport(XMVector3InverseRotate(direction, XMLoadFloat4(&a.orientation)));
+	XMVECTOR localB = b.shape->coreSupport(XMVector3InverseRotate(-direction, XMLoadFloat4(&b.orientation)));
+	XMVECTOR pointA = place(a, localA), pointB = place(b, localB);
+	XMStoreFloat3(&vertex.localA, localA);
+	XMStoreFloat3(&vertex.localB, localB);
+	XMStoreFloat3(&vertex.a, pointA);
+	XMStoreFloat3(&vertex.b, pointB);
+	XMStoreFloat3(&vertex.w, pointA - pointB);
+	return vertex;
+}
+
+void ConvexCollision::query(const ConvexBody& a, const ConvexBody& b, ConvexSimplex& simplex, ConvexResult& result)
+{
+	queries++;
+	int start = iterations;
+	//the accuracy is that of the smaller shape, the larger one only costs precision
+	float size = std::min(a.shape->boundingRadius(), b.shape->boundingRadius());
+	float touching = 1e-4f*size;
+
+	//the cached points where the bodies are now, otherwise a first support point between the centres
+	Vertex s[4];
+	int count = 0;
+	for(int i = 0; i < simplex.count; i++, count++) {
+		s[i].localA = simplex.pointsA[i];
+		s[i].localB = simplex.pointsB[i];
+		XMVECTOR pointA = place(a, load(s[i].localA)), pointB = place(b, load(s[i].localB));
+		XMStoreFloat3(&s[i].a, pointA);
+		XMStoreFloat3(&s[i].b, pointB);
+		XMStoreFloat3(&s[i].w, pointA - pointB);
+	}
+	if(count == 0) {
+		XMVECTOR direction = load(b.position) - load(a.position);
+		if(dot(direction, direction) <= touching*touching)
+			direction = XMVectorSet(0.f, 1.f, 0.f, 0.f);
+		s[count++] = support(a, b, direction);
+	}
+
+	XMVECTOR w[4];
+	Closest closest;
+	XMVECTOR v;
+	bool overlap = false;
+	for(int iteration = 0; ; iteration++) {
+		//reduce to the sub simplex of the closest point
+		for(int k = 0; k < count; k++)
+			w[k] = load(s[k].w);
+		if(count == 1) {
+			closest.count = 1;
+			closest.index[0] = 0;
+			closest.lambda[0] = 1.f;
+		}
+		else if(count == 2)
+			closestSegment(w, 0, 1, closest);
+		else if(count == 3)
+			closestTriangle(w, 0, 1, 2, closest);
+		else
+			closestTetrahedron(w, closest);
+		Vertex kept[4];
+		for(int k = 0; k < closest.count; k++)
+			kept[k] = s[closest.index[k]];
+		count = closest.count;
+		for(int k = 0; k < count; k++) {
+			s[k] = kept[k];
+			w[k] = load(s[k].w);
+			closest.index[k] = k;
+		}
+		v = pointOf(w, closest);
+
+		float vv = dot(v, v);
+		if(count == 4 || vv <= touching*touching) {
+			overlap = true;
+			break;
+		}
+		if(iteration >= maxIterations)
+			break;
+		Vertex next = support(a, b, -v);
+		XMVECTOR point = load(next.w);
+		//no support point is closer to the origin than the one found
+		if(vv - dot(v, point) <= tolerance*tolerance*vv)
+			break;
+		bool known = false;
+		for(int k = 0; k < count && !known; k++)
+			known = XMVectorGetX(XMVector3LengthSq(point - w[k])) <= touching*touching;
+		if(known)
+			break;
+		s[count++] = next;
+	}
+
+	simplex.count = count;
+	for(int k = 0; k < count; k++) {
+		simplex.pointsA[k] = s[k].localA;
+		simplex.pointsB[k] = s[k].localB;
+	}
+
+	XMVECTOR pointA = XMVectorZero(), pointB = XMVectorZero(), normal;
+	float distance;
+	for(int k = 0; k < count; k++) {
+		pointA += load(s[k].a)*closest.lambda[k];
+		pointB += load(s[k].b)*closest.lambda[k];
+	}
+	if(!overlap) {
+		distance = sqrtf(dot(v, v));
+		normal = v*(1.f/distance);
+	}
+	else {
+		penetrations++;
+		if(expand(a, b, s, count, result)) {
+			distance = result.distance;
+			normal = load(result.normal);
+			pointA = load(result.pointA);
+			pointB = load(result.pointB);
+		}
+		else {
+			//no polytope, the overlap along the line of the centres
+			normal = load(a.position) - load(b.position);
+			normal = dot(normal, normal) > 0.f ? XMVector3Normalize(normal) : XMVectorSet(0.f, 1.f, 0.f, 0.f);
+			Vertex deepest = support(a, b, -normal);
+			distance = dot(load(deepest.w), normal);
+			pointA = load(deepest.a);
+			pointB = load(deepest.b);
+		}
+	}
+
+	//from the cores to the surfaces
+	float marginA = a.shape->margin(), marginB = b.shape->margin();
+	result.distance = distance - marginA - marginB;
+	XMStoreFloat3(&result.normal, normal);
+	XMStoreFloat3(&result.pointA, pointA - normal*marginA);
+	XMStoreFloat3(&result.pointB, pointB + normal*marginB);
+	result.iterations = iterations - start;
+}
+
+bool ConvexCollision::addFace(int v0, int v1, int v2)
+{
+	XMVECTOR a = load(vertices[v0].w);
+	XMVECTOR normal = XMVector3Cross(load(vertices[v1].w) - a, load(vertices[v2].w) - a);
+	float length = sqrtf(dot(normal, normal));
+	if(length <= FLT_MIN)
+		return false;
+	normal = normal*(1.f/length);
+	Face face;
+	face.v[0] = v0;
+	face.v[1] = v1;
+	face.v[2] = v2;
+	//the centre of the first tetrahedron stays inside while the polytope grows
+	if(dot(normal, a - load(centre)) < 0.f) {
+		face.v[1] = v2;
+		face.v[2] = v1;
+		normal = -normal;
+	}
+	XMStoreFloat3(&face.normal, normal);
+	face.distance = dot(normal, a);
+	faces.push_back(face);
+	return true;
+}
+
+bool ConvexCollision::expand(const ConvexBody& a, const ConvexBody& b, Vertex* simplex, int count, ConvexResult& result)
+{
+	float size = std::min(a.shape->boundingRadius(), b.shape->boundingRadius());
+	float epsilon = 1e-4f*size;
+	vertices.assign(simplex, simplex + count);
+
+	//GJK may stop with fewer than four points when the origin is on the simplex, add some around it
+	if(vertices.size() == 1) {
+		for(int k = 0; k < 6 && vertices.size() == 1; k++) {
+			float sign = k < 3 ? 1.f : -1.f;
+			Vertex next = support(a, b, XMVectorSet(k%3 == 0 ? sign : 0.f, k%3 == 1 ? sign : 0.f, k%3 == 2 ? sign : 0.f, 0.f));
+			if(XMVectorGetX(XMVector3Length(load(next.w) - load(vertices[0].w))) > epsilon)
+				vertices.push_back(next);
+		}
+	}
+	if(vertices.size() == 2) {
+		XMVECTOR edge = XMVector3Normalize(load(vertices[1].w) - load(vertices[0].w));
+		XMFLOAT3 e;
+		XMStoreFloat3(&e, XMVectorAbs(edge));
+		XMVECTOR axis = e.x <= e.y && e.x <= e.z ? XMVectorSet(1.f, 0.f, 0.f, 0.f) : e.y <= e.z ? XMVectorSet(0.f, 1.f, 0.f, 0.f) : XMVectorSet(0.f, 0.f, 1.f, 0.f);
+		XMVECTOR u = XMVector3Normalize(XMVector3Cross(edge, axis));
+		XMVECTOR directions[4] = { u, XMVector3Cross(edge, u), -u, -XMVector3Cross(edge, u) };
+		for(int k = 0; k < 4 && vertices.size() == 2; k++) {
+			Vertex next = support(a, b, directions[k]);
+			if(XMVectorGetX(XMVector3Length(XMVector3Cross(load(next.w) - load(vertices[0].w), edge))) > epsilon)
+				vertices.push_back(next);
+		}
+	}
+	if(vertices.size() == 3) {
+		XMVECTOR origin = load(vertices[0].w);
+		XMVECTOR normal = XMVector3Normalize(XMVector3Cross(load(vertices[1].w) - origin, load(vertices[2].w) - origin));
+		Vertex next = support(a, b, normal);
+		if(fabsf(dot(load(next.w) - origin, normal)) <= epsilon)
+			next = support(a, b, -normal);
+		if(fabsf(dot(load(next.w) - origin, normal)) > epsilon)
+			vertices.push_back(next);
+	}
+	if(vertices.size() < 4)
+		return false;
+
+	XMVECTOR inner = XMVectorZero();
+	for(int k = 0; k < 4; k++)
+		inner += load(vertices[k].w)*0.25f;
+	XMStoreFloat3(&centre, inner);
+	faces.clear();
+	if(!addFace(0, 1, 2) || !addFace(0, 3, 1) || !addFace(0, 2, 3) || !addFace(1, 3, 2))
+		return false;
+
+	int nearest = 0;
+	for(;;) {
+		nearest = 0;
+		for(size_t f = 1; f < faces.size(); f++)
+			if(faces[f].distance < faces[nearest].distance)
+				nearest = (int)f;
+		if((int)faces.size() >= maxFaces)
+			break;
+		XMVECTOR normal = load(faces[nearest].normal);
+		Vertex next = support(a, b, normal);
+		XMVECTOR point = load(next.w);
+		//the face is on the boundary of A - B
+		if(dot(point, normal) - faces[nearest].distance <= tolerance*size)
+			break;
+
+		//every face the new point sees goes, the edges between kept and removed faces stay open
+		int added = (int)vertices.size();
+		vertices.push_back(next);
+		horizon.clear();
+		for(size_t f = 0; f < faces.size(); ) {
+			if(dot(load(faces[f].normal), point - load(vertices[faces[f].v[0]].w)) <= 0.f) {
+				f++;
+				continue;
+			}
+			for(int e = 0; e < 3; e++) {
+				std::pair<int, int> edge(faces[f].v[e], faces[f].v[(e + 1)%3]);
+				auto reverse = std::find(horizon.begin(), horizon.end(), std::make_pair(edge.second, edge.first));
+				if(reverse != horizon.end())
+					horizon.erase(reverse);
+				else
+					horizon.push_back(edge);
+			}
+			faces[f] = faces.back();
+			faces.pop_back();
+		}
+		for(size_t e = 0; e < horizon.size(); e++)
+			addFace(horizon[e].first, horizon[e].second, added);
+		if(faces.empty())
+			return false;
+	}
+
+	//the origin projected on the nearest face, its weights give the deepest points
+	const Face& face = faces[nearest];
+	XMVECTOR normal = load(face.normal);
+	XMVECTOR w0 = load(vertices[face.v[0]].w), w1 = load(vertices[face.v[1]].w), w2 = load(vertices[face.v[2]].w);
+	XMVECTOR e0 = w1 - w0, e1 = w2 - w0, p = normal*face.distance - w0;
+	float d00 = dot(e0, e0), d01 = dot(e0, e1), d11 = dot(e1, e1), d20 = dot(p, e0), d21 = dot(p, e1);
+	float denominator = d00*d11 - d01*d01;
+	float l1 = denominator > FLT_MIN ? (d11*d20 - d01*d21)/denominator : 0.f;
+	float l2 = denominator > FLT_MIN ? (d00*d21 - d01*d20)/denominator : 0.f;
+	float l0 = 1.f - l1 - l2;
+	XMStoreFloat3(&result.pointA, load(vertices[face.v[0]].a)*l0 + load(vertices[face.v[1]].a)*l1 + load(vertices[face.v[2]].a)*l2);
+	XMStoreFloat3(&result.pointB, load(vertices[face.v[0]].b)*l0 + load(vertices[face.v[1]].b)*l1 + load(vertices[face.v[2]].b)*l2);
+	//the face normal points out of A - B, A has to move the other way
+	XMStoreFloat3(&result.normal, -normal);
+	result.distance = -face.distance;
+	return true;
+}
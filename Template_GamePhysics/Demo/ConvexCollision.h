@@ -0,0 +1,104 @@
+#pragma once
+#ifndef ConvexCollision_HEADER
+#define ConvexCollision_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include <utility>
+#include "ConvexShape.h"
+
+// A convex shape placed in the world.
+struct ConvexBody
+{
+	const ConvexShape* shape;
+	XMFLOAT3 position;
+	XMFLOAT4 orientation;
+};
+
+// The simplex GJK ended with, kept per pair (see CachedManifold) to start the next query from.
+// The points are the support points of A and B in their own frames, so they are still points of the
+// shapes after the bodies moved and only have to be placed again.
+struct ConvexSimplex
+{
+	int count;
+	XMFLOAT3 pointsA[4];
+	XMFLOAT3 pointsB[4];
+};
+
+struct ConvexResult
+{
+	//between the surfaces, negative if they overlap
+	float distance;
+	//from B to A, the direction of the impulse on A (like ContactManifold::normal)
+	XMFLOAT3 normal;
+	//closest points, or the deepest points if they overlap, on the surfaces
+	XMFLOAT3 pointA;
+	XMFLOAT3 pointB;
+	//support calls this query needed
+	int iterations;
+};
+
+// Distance and penetration of two convex shapes from their support functions alone.
+// GJK walks a simplex of the Minkowski difference A - B towards the origin: each step asks for the
+// support point in the direction of the origin and keeps the smallest sub simplex that contains
+// the closest point (the case analysis of Ericson, Real-Time Collision Detection 5.1), until the
+// support point gets no closer than tolerance (relative). It runs on the cores of the shapes and the
+// radii of spheres and capsules are taken off at the end, so rounded shapes that touch are still
+// a GJK distance, only cores that overlap need EPA.
+// EPA grows the last GJK simplex into a polytope around the origin and keeps pushing out the face
+// closest to the origin until the support point along its normal is not further out, that face
+// gives the penetration depth and normal.
+// The query starts from the cached simplex of the pair, placed at the current poses. Bodies move
+// little per step, so the cached points already are the answer or next to it and the query ends
+// after one or two support calls instead of building the simplex again.
+class ConvexCollision
+{
+public:
+	//relative, GJK stops when a support point improves the distance by less
+	float tolerance;
+	int maxIterations;
+	int maxFaces;
+
+	//statistics since the last resetStatistics
+	int queries;
+	int iterations;
+	int penetrations;
+
+	ConvexCollision();
+
+	void resetStatistics();
+	//simplex is the cached one of the pair (count 0 if there is none) and is updated
+	void query(const ConvexBody& a, const ConvexBody& b, ConvexSimplex& simplex, ConvexResult& result);
+
+private:
+	struct Vertex
+	{
+		XMFLOAT3 w;
+		XMFLOAT3 a;
+		XMFLOAT3 b;
+		XMFLOAT3 localA;
+		XMFLOAT3 localB;
+	};
+	struct Face
+	{
+		int v[3];
+		XMFLOAT3 normal;
+		float distance;
+	};
+
+	//EPA polytope, kept to save the allocations
+	std::vector<Vertex> vertices;
+	std::vector<Face> faces;
+	std::vector<std::pair<int, int>> horizon;
+	//inside the polytope, the faces are turned away from it
+	XMFLOAT3 centre;
+
+	Vertex support(const ConvexBody& a, const ConvexBody& b, FXMVECTOR direction);
+	//the core penetration, false if the polytope could not be built
+	bool expand(const ConvexBody& a, const ConvexBody& b, Vertex* simplex, int count, ConvexResult& result);
+	bool addFace(int v0, int v1, int v2);
+};
+
+#endif
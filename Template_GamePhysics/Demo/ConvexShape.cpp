@@ -0,0 +1,275 @@
+#include "ConvexShape.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//latitude and longitude steps of the round meshes
+static const int roundStacks = 8;
+static const int roundSlices = 16;
+
+static void addTriangle(std::vector<unsigned short>& indices, int a, int b, int c)
+{
+	indices.push_back((unsigned short)a);
+	indices.push_back((unsigned short)b);
+	indices.push_back((unsigned short)c);
+}
+
+ConvexShape::ConvexShape()
+{
+	type = BOX;
+	radius = 0.f;
+	halfHeight = 0.f;
+	halfExtents = XMFLOAT3(0.5f, 0.5f, 0.5f);
+}
+
+ConvexShape ConvexShape::sphere(float radius)
+{
+	ConvexShape shape;
+	shape.type = SPHERE;
+	shape.radius = radius;
+	shape.halfExtents = XMFLOAT3(radius, radius, radius);
+	shape.buildRoundMesh();
+	return shape;
+}
+
+ConvexShape ConvexShape::capsule(float radius, float halfHeight)
+{
+	ConvexShape shape;
+	shape.type = CAPSULE;
+	shape.radius = radius;
+	shape.halfHeight = halfHeight;
+	shape.halfExtents = XMFLOAT3(radius, halfHeight + radius, radius);
+	shape.buildRoundMesh();
+	return shape;
+}
+
+ConvexShape ConvexShape::box(XMFLOAT3 halfExtents)
+{
+	ConvexShape shape;
+	shape.type = BOX;
+	shape.halfExtents = halfExtents;
+	for(int i = 0; i < 8; i++)
+		shape.vertices.push_back(XMFLOAT3(i & 1 ? halfExtents.x : -halfExtents.x, i & 2 ? halfExtents.y : -halfExtents.y, i & 4 ? halfExtents.z : -halfExtents.z));
+	shape.buildHullMesh();
+	return shape;
+}
+
+ConvexShape ConvexShape::hull(const std::vector<XMFLOAT3>& points)
+{
+	ConvexShape shape;
+	shape.type = HULL;
+	shape.vertices = points;
+	shape.buildHullMesh();
+	//the bounds, for the inertia
+	XMVECTOR lower = XMVectorZero(), upper = XMVectorZero();
+	for(size_t i = 0; i < shape.vertices.size(); i++) {
+		XMVECTOR p = XMLoadFloat3(&shape.vertices[i]);
+		lower = i == 0 ? p : XMVectorMin(lower, p);
+		upper = i == 0 ? p : XMVectorMax(upper, p);
+	}
+	XMStoreFloat3(&shape.halfExtents, (upper - lower)*0.5f);
+	return shape;
+}
+
+XMVECTOR ConvexShape::coreSupport(FXMVECTOR direction) const
+{
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, direction);
+	switch(type) {
+	case SPHERE:
+		return XMVectorZero();
+	case CAPSULE:
+		return XMVectorSet(0.f, d.y < 0.f ? -halfHeight : halfHeight, 0.f, 0.f);
+	case BOX:
+		return XMVectorSet(d.x < 0.f ? -halfExtents.x : halfExtents.x, d.y < 0.f ? -halfExtents.y : halfExtents.y, d.z < 0.f ? -halfExtents.z : halfExtents.z, 0.f);
+	}
+	//hulls are small, a plain search is fine
+	int best = 0;
+	float bestDot = -FLT_MAX;
+	for(size_t i = 0; i < vertices.size(); i++) {
+		float dot = vertices[i].x*d.x + vertices[i].y*d.y + vertices[i].z*d.z;
+		if(dot > bestDot) {
+			bestDot = dot;
+			best = (int)i;
+		}
+	}
+	return XMLoadFloat3(&vertices[best]);
+}
+
+float ConvexShape::margin() const
+{
+	return type == SPHERE || type == CAPSULE ? radius : 0.f;
+}
+
+void ConvexShape::bounds(FXMVECTOR position, FXMVECTOR orientation, XMFLOAT3& lower, XMFLOAT3& upper) const
+{
+	//support along each world axis, asked in the frame of the shape
+	float low[3], high[3];
+	for(int k = 0; k < 3; k++) {
+		XMVECTOR axis = XMVectorSet(k == 0 ? 1.f : 0.f, k == 1 ? 1.f : 0.f, k == 2 ? 1.f : 0.f, 0.f);
+		XMVECTOR local = XMVector3InverseRotate(axis, orientation);
+		high[k] = XMVectorGetX(XMVector3Dot(XMVector3Rotate(coreSupport(local), orientation), axis)) + margin();
+		low[k] = XMVectorGetX(XMVector3Dot(XMVector3Rotate(coreSupport(-local), orientation), axis)) - margin();
+	}
+	XMStoreFloat3(&lower, position + XMVectorSet(low[0], low[1], low[2], 0.f));
+	XMStoreFloat3(&upper, position + XMVectorSet(high[0], high[1], high[2], 0.f));
+}
+
+float ConvexShape::boundingRadius() const
+{
+	switch(type) {
+	case SPHERE:
+		return radius;
+	case CAPSULE:
+		return halfHeight + radius;
+	case BOX:
+		return XMVectorGetX(XMVector3Length(XMLoadFloat3(&halfExtents)));
+	}
+	float largest = 0.f;
+	for(size_t i = 0; i < vertices.size(); i++)
+		largest = std::max(largest, XMVectorGetX(XMVector3Length(XMLoadFloat3(&vertices[i]))));
+	return largest;
+}
+
+XMFLOAT3 ConvexShape::unitInertia() const
+{
+	if(type == SPHERE) {
+		float i = 0.4f*radius*radius;
+		return XMFLOAT3(i, i, i);
+	}
+	if(type == CAPSULE) {
+		//a cylinder of height h = 2 halfHeight and two half spheres, mass split by volume
+		float r2 = radius*radius, h = 2.f*halfHeight;
+		float cylinder = h, spheres = 4.f/3.f*radius;
+		float mc = cylinder/(cylinder + spheres), ms = spheres/(cylinder + spheres);
+		float axial = mc*0.5f*r2 + ms*0.4f*r2;
+		float across = mc*(h*h/12.f + 0.25f*r2) + ms*(0.4f*r2 + 0.25f*h*h + 0.375f*h*radius);
+		return XMFLOAT3(across, axial, across);
+	}
+	//solid box, I = 1/12 (b^2 + c^2) with b, c the full extents
+	float x = halfExtents.x*halfExtents.x, y = halfExtents.y*halfExtents.y, z = halfExtents.z*halfExtents.z;
+	return XMFLOAT3((y + z)/3.f, (x + z)/3.f, (x + y)/3.f);
+}
+
+void ConvexShape::buildRoundMesh()
+{
+	meshPositions.clear();
+	meshNormals.clear();
+	meshIndices.clear();
+	//rings from the top down, the equator twice so the capsule gets its cylinder between the halves
+	int rings = 0;
+	for(int stack = 0; stack <= roundStacks; stack++) {
+		for(int half = 0; half < 2; half++) {
+			if(half == 1 && stack != roundStacks/2)
+				continue;
+			float phi = XM_PI*stack/roundStacks;
+			float offset = stack < roundStacks/2 || (stack == roundStacks/2 && half == 0) ? halfHeight : -halfHeight;
+			for(int slice = 0; slice <= roundSlices; slice++) {
+				float theta = XM_2PI*slice/roundSlices;
+				XMFLOAT3 normal(sinf(phi)*cosf(theta), cosf(phi), sinf(phi)*sinf(theta));
+				meshNormals.push_back(normal);
+				meshPositions.push_back(XMFLOAT3(radius*normal.x, radius*normal.y + offset, radius*normal.z));
+			}
+			rings++;
+		}
+	}
+	for(int ring = 0; ring + 1 < rings; ring++)
+		for(int slice = 0; slice < roundSlices; slice++) {
+			int a = ring*(roundSlices + 1) + slice, b = a + 1, c = a + roundSlices + 1, d = c + 1;
+			addTriangle(meshIndices, a, b, c);
+			addTriangle(meshIndices, b, d, c);
+		}
+}
+
+void ConvexShape::buildHullMesh()
+{
+	meshPositions.clear();
+	meshNormals.clear();
+	meshIndices.clear();
+	int count = (int)vertices.size();
+	float size = 0.f;
+	for(int i = 0; i < count; i++)
+		size = std::max(size, XMVectorGetX(XMVector3Length(XMLoadFloat3(&vertices[i]))));
+	float epsilon = 1e-4f*std::max(size, 1e-3f);
+
+	//every plane through three points with all points behind it is a face, found once
+	std::vector<XMFLOAT4> planes;
+	std::vector<char> onHull(count, 0);
+	for(int i = 0; i < count; i++)
+		for(int j = i + 1; j < count; j++)
+			for(int k = j + 1; k < count; k++) {
+				XMVECTOR a = XMLoadFloat3(&vertices[i]);
+				XMVECTOR normal = XMVector3Cross(XMLoadFloat3(&vertices[j]) - a, XMLoadFloat3(&vertices[k]) - a);
+				float length = XMVectorGetX(XMVector3Length(normal));
+				if(length < epsilon*epsilon)
+					continue;
+				normal = normal*(1.f/length);
+				float offset = XMVectorGetX(XMVector3Dot(normal, a));
+				int above = 0, below = 0;
+				for(int m = 0; m < count; m++) {
+					float side = XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&vertices[m]))) - offset;
+					above += side > epsilon;
+					below += side < -epsilon;
+				}
+				if(above > 0 && below > 0)
+					continue;
+				if(above > 0) {
+					normal = -normal;
+					offset = -offset;
+				}
+				bool known = false;
+				for(size_t p = 0; p < planes.size() && !known; p++)
+					known = planes[p].x*XMVectorGetX(normal) + planes[p].y*XMVectorGetY(normal) + planes[p].z*XMVectorGetZ(normal) > 1.f - 1e-4f && fabsf(planes[p].w - offset) < epsilon;
+				if(!known) {
+					XMFLOAT4 plane;
+					XMStoreFloat4(&plane, XMVectorSetW(normal, offset));
+					planes.push_back(plane);
+				}
+			}
+
+	//the points of each face around its centre, fanned so that (b-a)x(c-a) points out
+	for(size_t p = 0; p < planes.size(); p++) {
+		XMVECTOR normal = XMVectorSetW(XMLoadFloat4(&planes[p]), 0.f);
+		std::vector<int> face;
+		XMVECTOR centre = XMVectorZero();
+		for(int m = 0; m < count; m++) {
+			XMVECTOR point = XMLoadFloat3(&vertices[m]);
+			if(fabsf(XMVectorGetX(XMVector3Dot(normal, point)) - planes[p].w) > epsilon)
+				continue;
+			bool duplicate = false;
+			for(size_t f = 0; f < face.size() && !duplicate; f++)
+				duplicate = XMVectorGetX(XMVector3LengthSq(point - XMLoadFloat3(&vertices[face[f]]))) < epsilon*epsilon;
+			if(duplicate)
+				continue;
+			face.push_back(m);
+			onHull[m] = 1;
+			centre += point;
+		}
+		centre = centre*(1.f/face.size());
+		XMVECTOR u = XMVector3Normalize(XMLoadFloat3(&vertices[face[0]]) - centre);
+		XMVECTOR v = XMVector3Cross(normal, u);
+		std::vector<std::pair<float, int>> order;
+		for(size_t f = 0; f < face.size(); f++) {
+			XMVECTOR offset = XMLoadFloat3(&vertices[face[f]]) - centre;
+			order.push_back(std::make_pair(atan2f(XMVectorGetX(XMVector3Dot(offset, v)), XMVectorGetX(XMVector3Dot(offset, u))), face[f]));
+		}
+		std::sort(order.begin(), order.end());
+		int first = (int)meshPositions.size();
+		XMFLOAT3 faceNormal;
+		XMStoreFloat3(&faceNormal, normal);
+		for(size_t f = 0; f < order.size(); f++) {
+			meshPositions.push_back(vertices[order[f].second]);
+			meshNormals.push_back(faceNormal);
+		}
+		for(int f = 1; f + 1 < (int)order.size(); f++)
+			addTriangle(meshIndices, first, first + f, first + f + 1);
+	}
+
+	//inner points never support anything
+	std::vector<XMFLOAT3> kept;
+	for(int i = 0; i < count; i++)
+		if(onHull[i])
+			kept.push_back(vertices[i]);
+	vertices.swap(kept);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#ifndef ConvexShape_HEADER
+#define ConvexShape_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+
+// A convex shape in its own frame, centred on its centre of mass, given by its support function
+// (the farthest point along a direction), which is all GJK and EPA need (see ConvexCollision).
+// Spheres and capsules are a point and a segment along y grown by radius: the support is taken of
+// that core only and the radius is added to the distance afterwards, so they stay exactly round
+// and touching contacts never need EPA. Boxes and hulls have no radius.
+// For drawing every shape also has a triangle mesh: the faces of the hull (coplanar points
+// merged into one fan), the six box faces or a tessellated sphere/capsule. Triangles are wound
+// so that (b-a)x(c-a) points out, like the floor quads.
+class ConvexShape
+{
+public:
+	enum Type
+	{
+		SPHERE,
+		CAPSULE,
+		BOX,
+		HULL
+	};
+
+	int type;
+	//sphere and capsule
+	float radius;
+	//capsule, half the length of the core segment
+	float halfHeight;
+	//box
+	XMFLOAT3 halfExtents;
+	//hull points, only those on the hull are kept
+	std::vector<XMFLOAT3> vertices;
+
+	//drawing mesh, three indices per triangle, 16 bit as the primitive batch takes them
+	std::vector<XMFLOAT3> meshPositions;
+	std::vector<XMFLOAT3> meshNormals;
+	std::vector<unsigned short> meshIndices;
+
+	ConvexShape();
+
+	static ConvexShape sphere(float radius);
+	static ConvexShape capsule(float radius, float halfHeight);
+	static ConvexShape box(XMFLOAT3 halfExtents);
+	//the hull of the points, which should be centred on the centre of mass already
+	static ConvexShape hull(const std::vector<XMFLOAT3>& points);
+
+	//farthest point of the core along a local direction
+	XMVECTOR coreSupport(FXMVECTOR direction) const;
+	//what the core is grown by
+	float margin() const;
+	//world bounds, radius included
+	void bounds(FXMVECTOR position, FXMVECTOR orientation, XMFLOAT3& lower, XMFLOAT3& upper) const;
+	//no point is further from the centre
+	float boundingRadius() const;
+	//diagonal of the inertia tensor for a mass of 1. hulls use the solid box of their bounds
+	XMFLOAT3 unitInertia() const;
+
+private:
+	void buildRoundMesh();
+	void buildHullMesh();
+};
+
+#endif
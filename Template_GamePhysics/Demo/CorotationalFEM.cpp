@@ -0,0 +1,319 @@
+#include "CorotationalFEM.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+
+static XMFLOAT3 scaled(const XMFLOAT3& v, float s)
+{
+	return XMFLOAT3(v.x*s, v.y*s, v.z*s);
+}
+
+static float dot3(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+//isotropic linear stress for the symmetric part of the displacement gradient g (minus identity if requested)
+static Matrix3 linearStress(const Matrix3& g, float lambda, float mu, bool subtractIdentity)
+{
+	Matrix3 strain;
+	for(int r = 0; r < 3; r++)
+		for(int c = 0; c < 3; c++)
+			strain.m[r][c] = 0.5f*(g.m[r][c] + g.m[c][r]) - (subtractIdentity && r == c ? 1.f : 0.f);
+	float trace = strain.m[0][0] + strain.m[1][1] + strain.m[2][2];
+	Matrix3 stress;
+	for(int r = 0; r < 3; r++)
+		for(int c = 0; c < 3; c++)
+			stress.m[r][c] = 2*mu*strain.m[r][c] + (r == c ? lambda*trace : 0.f);
+	return stress;
+}
+
+CorotationalFEM::CorotationalFEM()
+{
+	youngsModulus = 500.f;
+	poissonRatio = 0.3f;
+	massDamping = 0.1f;
+	stiffnessDamping = 0.01f;
+	solverTolerance = 1e-3f;
+	maxIterations = 50;
+	lastIterations = 0;
+	invertedElements = 0;
+	pointCount = 0;
+	lambda = mu = 0.f;
+}
+
+bool CorotationalFEM::isInitialized()
+{
+	return !tets.empty();
+}
+
+int CorotationalFEM::getElementCount()
+{
+	return (int)tets.size()/4;
+}
+
+void CorotationalFEM::clear()
+{
+	tets.clear();
+	gradients.clear();
+	volumes.clear();
+	restInverse.clear();
+	rotations.clear();
+	rotationMatrices.clear();
+	incidentStart.clear();
+	incident.clear();
+	pointCount = 0;
+}
+
+bool CorotationalFEM::initialize(SpringNetwork& network, const std::vector<int>& elements, float totalMass)
+{
+	clear();
+	pointCount = (int)network.points.size();
+	int skipped = 0;
+	float totalVolume = 0.f;
+	std::vector<float> pointVolume(pointCount, 0.f);
+	for(int t = 0; t+3 < (int)elements.size(); t += 4) {
+		const int* corner = &elements[t];
+		bool valid = true;
+		for(int i = 0; i < 4; i++)
+			valid = valid && corner[i] >= 0 && corner[i] < pointCount;
+		if(!valid) {
+			std::cout << "CorotationalFEM: tet " << t/4 << " points outside the network" << std::endl;
+			clear();
+			return false;
+		}
+		XMFLOAT3 x0 = network.points[corner[0]].gp_position;
+		XMFLOAT3 e[3];
+		for(int i = 0; i < 3; i++) {
+			XMFLOAT3 xi = network.points[corner[i+1]].gp_position;
+			e[i] = XMFLOAT3(xi.x - x0.x, xi.y - x0.y, xi.z - x0.z);
+		}
+		Matrix3 edges = Matrix3::fromColumns(e[0], e[1], e[2]), inverse;
+		float volume = std::abs(edges.determinant())/6.f;
+		//slivers would make the whole system stiff, they are left out
+		float edgeScale = std::max(dot3(e[0], e[0]), std::max(dot3(e[1], e[1]), dot3(e[2], e[2])));
+		if(volume < 1e-6f*edgeScale*std::sqrt(edgeScale) || !edges.inverse(inverse)) {
+			skipped++;
+			continue;
+		}
+		tets.insert(tets.end(), corner, corner+4);
+		volumes.push_back(volume);
+		restInverse.push_back(inverse);
+		//gradient of shape function k is row k-1 of the inverse, corner 0 gets minus their sum
+		XMFLOAT3 g1(inverse.m[0][0], inverse.m[0][1], inverse.m[0][2]);
+		XMFLOAT3 g2(inverse.m[1][0], inverse.m[1][1], inverse.m[1][2]);
+		XMFLOAT3 g3(inverse.m[2][0], inverse.m[2][1], inverse.m[2][2]);
+		gradients.push_back(XMFLOAT3(-g1.x - g2.x - g3.x, -g1.y - g2.y - g3.y, -g1.z - g2.z - g3.z));
+		gradients.push_back(g1);
+		gradients.push_back(g2);
+		gradients.push_back(g3);
+		for(int i = 0; i < 4; i++)
+			pointVolume[corner[i]] += 0.25f*volume;
+		totalVolume += volume;
+	}
+	if(tets.empty()) {
+		std::cout << "CorotationalFEM: no usable tets" << std::endl;
+		return false;
+	}
+	if(skipped > 0)
+		std::cout << "CorotationalFEM: skipped " << skipped << " degenerate tets" << std::endl;
+
+	int tetCount = getElementCount();
+	rotations.assign(tetCount, XMFLOAT4(0.f, 0.f, 0.f, 1.f));
+	rotationMatrices.assign(tetCount, Matrix3::identity());
+	remapPoints(std::vector<int>());
+
+	//lumped masses, points outside every tet keep a small share so nothing divides by zero
+	float fallback = totalMass / pointCount;
+	for(int i = 0; i < pointCount; i++)
+		network.points[i].setMass(pointVolume[i] > 0.f ? totalMass*pointVolume[i]/totalVolume : fallback);
+	return true;
+}
+
+void CorotationalFEM::remapPoints(const std::vector<int>& newIndex)
+{
+	if(!newIndex.empty())
+		for(auto index = tets.begin(); index != tets.end(); index++)
+			*index = newIndex[*index];
+
+	//corners around every point, counting sort by point
+	incidentStart.assign(pointCount+1, 0);
+	for(auto index = tets.begin(); index != tets.end(); index++)
+		incidentStart[*index+1]++;
+	for(int i = 0; i < pointCount; i++)
+		incidentStart[i+1] += incidentStart[i];
+	incident.resize(tets.size());
+	std::vector<int> fill(incidentStart.begin(), incidentStart.end()-1);
+	for(int k = 0; k < (int)tets.size(); k++)
+		incident[fill[tets[k]]++] = k;
+}
+
+void CorotationalFEM::gatherCorners(const std::vector<XMFLOAT3>& corners, std::vector<XMFLOAT3>& result, ThreadPool& pool)
+{
+	pool.parallelFor(pointCount, 256, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			XMFLOAT3 sum(0.f, 0.f, 0.f);
+			for(int k = incidentStart[i]; k < incidentStart[i+1]; k++) {
+				const XMFLOAT3& c = corners[incident[k]];
+				sum.x += c.x;
+				sum.y += c.y;
+				sum.z += c.z;
+			}
+			result[i] = sum;
+		}
+	});
+}
+
+void CorotationalFEM::applySystem(const std::vector<XMFLOAT3>& vector, std::vector<XMFLOAT3>& result, float massScale, float stiffnessScale, ThreadPool& pool)
+{
+	//K v = sum over tets R Ke R^T v, Ke applied as the stress of the displacement gradient sum u_j g_j^T
+	int tetCount = getElementCount();
+	pool.parallelFor(tetCount, 128, [&](int begin, int end) {
+		for(int t = begin; t < end; t++) {
+			const Matrix3& r = rotationMatrices[t];
+			const XMFLOAT3* g = &gradients[4*t];
+			Matrix3 displacementGradient = Matrix3::zero();
+			for(int j = 0; j < 4; j++) {
+				XMFLOAT3 u = r.transposeTimes(vector[tets[4*t+j]]);
+				float uj[3] = { u.x, u.y, u.z }, gj[3] = { g[j].x, g[j].y, g[j].z };
+				for(int a = 0; a < 3; a++)
+					for(int b = 0; b < 3; b++)
+						displacementGradient.m[a][b] += uj[a]*gj[b];
+			}
+			Matrix3 stress = linearStress(displacementGradient, lambda, mu, false);
+			for(int i = 0; i < 4; i++)
+				cornerValues[4*t+i] = r*scaled(stress*g[i], volumes[t]);
+		}
+	});
+	gatherCorners(cornerValues, result, pool);
+	for(int i = 0; i < pointCount; i++) {
+		if(isFixed[i]) {
+			result[i] = XMFLOAT3(0.f, 0.f, 0.f);
+			continue;
+		}
+		float m = massScale*masses[i];
+		result[i] = XMFLOAT3(m*vector[i].x + stiffnessScale*result[i].x, m*vector[i].y + stiffnessScale*result[i].y, m*vector[i].z + stiffnessScale*result[i].z);
+	}
+}
+
+void CorotationalFEM::step(SpringNetwork& network, float deltaTime, float gravity, ThreadPool& pool)
+{
+	if(!isInitialized() || (int)network.points.size() != pointCount)
+		return;
+	int tetCount = getElementCount();
+	lambda = youngsModulus*poissonRatio / ((1 + poissonRatio)*(1 - 2*poissonRatio));
+	mu = youngsModulus / (2*(1 + poissonRatio));
+	cornerValues.resize(4*tetCount);
+	cornerDiagonal.resize(4*tetCount);
+	velocity.resize(pointCount);
+	rhs.resize(pointCount);
+	residual.resize(pointCount);
+	direction.resize(pointCount);
+	product.resize(pointCount);
+	preconditioner.resize(pointCount);
+	masses.resize(pointCount);
+	isFixed.resize(pointCount);
+	for(int i = 0; i < pointCount; i++) {
+		const SpringPoint& point = network.points[i];
+		masses[i] = point.gp_mass;
+		isFixed[i] = point.gp_isStatic ? 1 : 0;
+		velocity[i] = point.gp_isStatic ? XMFLOAT3(0.f, 0.f, 0.f) : point.gp_velocity;
+	}
+
+	//rotations, elastic forces f_i = -V R sigma(R^T F - I) g_i and the diagonal of R Ke R^T
+	std::atomic<int> inverted(0);
+	pool.parallelFor(tetCount, 128, [&](int begin, int end) {
+		int localInverted = 0;
+		for(int t = begin; t < end; t++) {
+			const int* corner = &tets[4*t];
+			XMFLOAT3 x0 = network.points[corner[0]].gp_position;
+			XMFLOAT3 e[3];
+			for(int i = 0; i < 3; i++) {
+				XMFLOAT3 xi = network.points[corner[i+1]].gp_position;
+				e[i] = XMFLOAT3(xi.x - x0.x, xi.y - x0.y, xi.z - x0.z);
+			}
+			Matrix3 f = Matrix3::fromColumns(e[0], e[1], e[2])*restInverse[t];
+			if(f.determinant() <= 0.f)
+				localInverted++;
+			Matrix3::extractRotation(f, rotations[t], 8);
+			Matrix3 r = Matrix3::fromQuaternion(rotations[t]);
+			rotationMatrices[t] = r;
+			Matrix3 stress = linearStress(r.transposed()*f, lambda, mu, true);
+			const XMFLOAT3* g = &gradients[4*t];
+			for(int i = 0; i < 4; i++) {
+				cornerValues[4*t+i] = r*scaled(stress*g[i], -volumes[t]);
+				//R Ke_ii R^T = V ((lambda+mu) h h^T + mu |g|^2 I) with h = R g
+				XMFLOAT3 h = r*g[i];
+				float isotropic = mu*dot3(g[i], g[i]);
+				cornerDiagonal[4*t+i] = scaled(XMFLOAT3((lambda+mu)*h.x*h.x + isotropic, (lambda+mu)*h.y*h.y + isotropic, (lambda+mu)*h.z*h.z + isotropic), volumes[t]);
+			}
+		}
+		inverted += localInverted;
+	});
+	invertedElements = inverted;
+	gatherCorners(cornerValues, rhs, pool);
+	gatherCorners(cornerDiagonal, preconditioner, pool);
+
+	//(M + h*C + h^2*K) v = M v0 + h*f with C = a*M + b*K
+	float massScale = 1 + deltaTime*massDamping;
+	float stiffnessScale = deltaTime*deltaTime + deltaTime*stiffnessDamping;
+	for(int i = 0; i < pointCount; i++) {
+		if(isFixed[i]) {
+			rhs[i] = preconditioner[i] = XMFLOAT3(0.f, 0.f, 0.f);
+			continue;
+		}
+		float m = masses[i];
+		XMFLOAT3 force(rhs[i].x, rhs[i].y + gravity*m, rhs[i].z);
+		rhs[i] = XMFLOAT3(m*velocity[i].x + deltaTime*force.x, m*velocity[i].y + deltaTime*force.y, m*velocity[i].z + deltaTime*force.z);
+		XMFLOAT3 d = preconditioner[i];
+		preconditioner[i] = XMFLOAT3(1.f/(massScale*m + stiffnessScale*d.x), 1.f/(massScale*m + stiffnessScale*d.y), 1.f/(massScale*m + stiffnessScale*d.z));
+	}
+
+	//preconditioned CG, warm started with the current velocity
+	applySystem(velocity, product, massScale, stiffnessScale, pool);
+	float rz = 0.f, rhsNorm = 0.f, residualNorm = 0.f;
+	for(int i = 0; i < pointCount; i++) {
+		residual[i] = XMFLOAT3(rhs[i].x - product[i].x, rhs[i].y - product[i].y, rhs[i].z - product[i].z);
+		direction[i] = XMFLOAT3(preconditioner[i].x*residual[i].x, preconditioner[i].y*residual[i].y, preconditioner[i].z*residual[i].z);
+		rz += dot3(residual[i], direction[i]);
+		rhsNorm += dot3(rhs[i], rhs[i]);
+		residualNorm += dot3(residual[i], residual[i]);
+	}
+	float threshold = solverTolerance*solverTolerance*rhsNorm;
+	lastIterations = 0;
+	while(residualNorm > threshold && lastIterations < maxIterations) {
+		applySystem(direction, product, massScale, stiffnessScale, pool);
+		float curvature = 0.f;
+		for(int i = 0; i < pointCount; i++)
+			curvature += dot3(direction[i], product[i]);
+		if(curvature <= 0.f)
+			break;
+		float alpha = rz / curvature;
+		float rzNew = 0.f;
+		residualNorm = 0.f;
+		for(int i = 0; i < pointCount; i++) {
+			velocity[i] = XMFLOAT3(velocity[i].x + alpha*direction[i].x, velocity[i].y + alpha*direction[i].y, velocity[i].z + alpha*direction[i].z);
+			residual[i] = XMFLOAT3(residual[i].x - alpha*product[i].x, residual[i].y - alpha*product[i].y, residual[i].z - alpha*product[i].z);
+			rzNew += residual[i].x*preconditioner[i].x*residual[i].x + residual[i].y*preconditioner[i].y*residual[i].y + residual[i].z*preconditioner[i].z*residual[i].z;
+			residualNorm += dot3(residual[i], residual[i]);
+		}
+		float beta = rzNew / rz;
+		rz = rzNew;
+		for(int i = 0; i < pointCount; i++)
+			direction[i] = XMFLOAT3(preconditioner[i].x*residual[i].x + beta*direction[i].x,
+				preconditioner[i].y*residual[i].y + beta*direction[i].y,
+				preconditioner[i].z*residual[i].z + beta*direction[i].z);
+		lastIterations++;
+	}
+
+	for(int i = 0; i < pointCount; i++) {
+		SpringPoint& point = network.points[i];
+		point.gp_posTemp = point.gp_position;
+		point.resetForces();
+		if(point.gp_isStatic)
+			continue;
+		point.gp_velocity = velocity[i];
+		point.IntegratePosition(deltaTime);
+	}
+}
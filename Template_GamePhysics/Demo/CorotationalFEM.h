@@ -0,0 +1,85 @@
+#pragma once
+#ifndef CorotationalFEM_HEADER
+#define CorotationalFEM_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "Matrix3.h"
+#include "SpringNetwork.h"
+#include "ThreadPool.h"
+
+// Co-rotational linear FEM for tetrahedral meshes ("Interactive Virtual Materials", Mueller & Gross).
+// The nodes are the points of a SpringNetwork (the one MeshLoader::buildTetNetwork made for the
+// same tets), so drawing, ground and rigid body collisions work like for the spring version, the
+// springs themselves are ignored. Per tet the shape function gradients and the volume are
+// precomputed, every step extracts the element rotation with a warm started polar decomposition,
+// evaluates linear elasticity in the rotated frame and integrates with linearised backward Euler.
+// The system (M + h*C + h^2*K) v = M v0 + h*f is never assembled, CG applies it element by element
+// and starts from the last velocity, so a resting or slowly moving body needs only a few iterations.
+class CorotationalFEM
+{
+public:
+	//material, changes are picked up by the next step
+	float youngsModulus;
+	float poissonRatio;
+	//rayleigh damping C = massDamping*M + stiffnessDamping*K
+	float massDamping;
+	float stiffnessDamping;
+	//relative residual and iteration limit of the velocity solve
+	float solverTolerance;
+	int maxIterations;
+
+	//statistics
+	int lastIterations;
+	int invertedElements;
+
+	CorotationalFEM();
+
+	//the current point positions are the rest state, point masses are set from the tet volumes.
+	//returns false and prints the reason for degenerate meshes
+	bool initialize(SpringNetwork& network, const std::vector<int>& tets, float totalMass);
+	bool isInitialized();
+	void clear();
+	int getElementCount();
+
+	//forces are left at zero, positions and velocities are updated
+	void step(SpringNetwork& network, float deltaTime, float gravity, ThreadPool& pool);
+
+	//after the network's points were renumbered (SpringNetwork::permutePoints)
+	void remapPoints(const std::vector<int>& newIndex);
+
+private:
+	//4 point indices per tet
+	std::vector<int> tets;
+	int pointCount;
+	//shape function gradients in the rest state, 4 per tet
+	std::vector<XMFLOAT3> gradients;
+	std::vector<float> volumes;
+	//rest edge matrix inverse, F = [x1-x0 x2-x0 x3-x0] * restInverse
+	std::vector<Matrix3> restInverse;
+	//per tet, the quaternion is the warm start of the next polar decomposition
+	std::vector<XMFLOAT4> rotations;
+	std::vector<Matrix3> rotationMatrices;
+	//tets around each point: (tet*4 + corner), incidentStart has pointCount+1 entries
+	std::vector<int> incidentStart;
+	std::vector<int> incident;
+
+	//per tet corner results, gathered per point afterwards so no two threads write the same point
+	std::vector<XMFLOAT3> cornerValues;
+	std::vector<XMFLOAT3> cornerDiagonal;
+
+	//solver vectors, one entry per point
+	std::vector<XMFLOAT3> velocity, rhs, residual, direction, product, preconditioner;
+	std::vector<float> masses;
+	std::vector<char> isFixed;
+
+	float lambda, mu;
+
+	//product = (massScale*M + stiffnessScale*K) * vector
+	void applySystem(const std::vector<XMFLOAT3>& vector, std::vector<XMFLOAT3>& result, float massScale, float stiffnessScale, ThreadPool& pool);
+	void gatherCorners(const std::vector<XMFLOAT3>& corners, std::vector<XMFLOAT3>& result, ThreadPool& pool);
+};
+
+#endif
@@ -0,0 +1,321 @@
+#include "DynamicAABBTree.h"
+
+#include <algorithm>
+
+static XMFLOAT3 minimum(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMFLOAT3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+}
+
+static XMFLOAT3 maximum(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMFLOAT3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+}
+
+//surface area, half of it is enough for comparing costs
+static float area(const XMFLOAT3& lower, const XMFLOAT3& upper)
+{
+	float x = upper.x - lower.x, y = upper.y - lower.y, z = upper.z - lower.z;
+	return x*y + y*z + z*x;
+}
+
+static bool overlaps(const XMFLOAT3& lowerA, const XMFLOAT3& upperA, const XMFLOAT3& lowerB, const XMFLOAT3& upperB)
+{
+	return lowerA.x <= upperB.x && lowerB.x <= upperA.x && lowerA.y <= upperB.y && lowerB.y <= upperA.y && lowerA.z <= upperB.z && lowerB.z <= upperA.z;
+}
+
+static bool contains(const XMFLOAT3& lowerA, const XMFLOAT3& upperA, const XMFLOAT3& lowerB, const XMFLOAT3& upperB)
+{
+	return lowerA.x <= lowerB.x && lowerA.y <= lowerB.y && lowerA.z <= lowerB.z && upperB.x <= upperA.x && upperB.y <= upperA.y && upperB.z <= upperA.z;
+}
+
+DynamicAABBTree::DynamicAABBTree()
+{
+	margin = 0.1f;
+	displacementFactor = 2.f;
+	reinsertions = 0;
+	overlapTests = 0;
+	height = 0;
+	nodeCount = 0;
+	root = -1;
+	freeList = -1;
+}
+
+void DynamicAABBTree::clear()
+{
+	pairs.clear();
+	nodes.clear();
+	leaves.clear();
+	centres.clear();
+	root = -1;
+	freeList = -1;
+	reinsertions = 0;
+	overlapTests = 0;
+	height = 0;
+	nodeCount = 0;
+}
+
+int DynamicAABBTree::allocateNode()
+{
+	int node = freeList;
+	if(node >= 0)
+		freeList = nodes[node].parent;
+	else {
+		node = (int)nodes.size();
+		nodes.push_back(Node());
+	}
+	nodes[node].parent = -1;
+	nodes[node].child1 = nodes[node].child2 = -1;
+	nodes[node].height = 0;
+	nodes[node].object = -1;
+	nodeCount++;
+	return node;
+}
+
+void DynamicAABBTree::freeNode(int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+	nodeCount--;
+}
+
+void DynamicAABBTree::setFatBox(int leaf, const XMFLOAT3& lower, const XMFLOAT3& upper, const XMFLOAT3& displacement)
+{
+	Node& node = nodes[leaf];
+	node.lower = XMFLOAT3(lower.x - margin, lower.y - margin, lower.z - margin);
+	node.upper = XMFLOAT3(upper.x + margin, upper.y + margin, upper.z + margin);
+	//only stretch towards where the object is heading
+	float d[3] = { displacementFactor*displacement.x, displacementFactor*displacement.y, displacementFactor*displacement.z };
+	float* low = &node.lower.x;
+	float* high = &node.upper.x;
+	for(int axis = 0; axis < 3; axis++) {
+		if(d[axis] < 0.f)
+			low[axis] += d[axis];
+		else
+			high[axis] += d[axis];
+	}
+}
+
+void DynamicAABBTree::refit(int index)
+{
+	Node& node = nodes[index];
+	const Node& child1 = nodes[node.child1];
+	const Node& child2 = nodes[node.child2];
+	node.lower = minimum(child1.lower, child2.lower);
+	node.upper = maximum(child1.upper, child2.upper);
+	node.height = 1 + std::max(child1.height, child2.height);
+}
+
+void DynamicAABBTree::insertLeaf(int leaf)
+{
+	if(root < 0) {
+		root = leaf;
+		nodes[leaf].parent = -1;
+		return;
+	}
+
+	//cheapest sibling by the surface area heuristic
+	XMFLOAT3 leafLower = nodes[leaf].lower, leafUpper = nodes[leaf].upper;
+	int index = root;
+	while(nodes[index].child1 >= 0) {
+		const Node& node = nodes[index];
+		float nodeArea = area(node.lower, node.upper);
+		float combinedArea = area(minimum(node.lower, leafLower), maximum(node.upper, leafUpper));
+		//a new parent for this node and the leaf
+		float cost = 2.f*combinedArea;
+		//everything below grows by the same amount
+		float inheritedCost = 2.f*(combinedArea - nodeArea);
+		float childCost[2];
+		int children[2] = { node.child1, node.child2 };
+		for(int k = 0; k < 2; k++) {
+			const Node& child = nodes[children[k]];
+			float merged = area(minimum(child.lower, leafLower), maximum(child.upper, leafUpper));
+			childCost[k] = (child.child1 < 0 ? merged : merged - area(child.lower, child.upper)) + inheritedCost;
+		}
+		if(cost < childCost[0] && cost < childCost[1])
+			break;
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+	Node& parent = nodes[newParent];
+	parent.parent = oldParent;
+	parent.lower = minimum(leafLower, nodes[sibling].lower);
+	parent.upper = maximum(leafUpper, nodes[sibling].upper);
+	parent.height = nodes[sibling].height + 1;
+	parent.child1 = sibling;
+	parent.child2 = leaf;
+	if(oldParent >= 0) {
+		if(nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+	}
+	else
+		root = newParent;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	//refit and rebalance the way up
+	for(index = nodes[leaf].parent; index >= 0; index = nodes[index].parent) {
+		index = balance(index);
+		refit(index);
+	}
+}
+
+void DynamicAABBTree::removeLeaf(int leaf)
+{
+	if(leaf == root) {
+		root = -1;
+		return;
+	}
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+	freeNode(parent);
+	if(grandParent < 0) {
+		root = sibling;
+		nodes[sibling].parent = -1;
+		return;
+	}
+	//the sibling takes the parent's place
+	if(nodes[grandParent].child1 == parent)
+		nodes[grandParent].child1 = sibling;
+	else
+		nodes[grandParent].child2 = sibling;
+	nodes[sibling].parent = grandParent;
+	for(int index = grandParent; index >= 0; index = nodes[index].parent) {
+		index = balance(index);
+		refit(index);
+	}
+}
+
+int DynamicAABBTree::balance(int iA)
+{
+	Node& a = nodes[iA];
+	if(a.child1 < 0 || a.height < 2)
+		return iA;
+	int iB = a.child1, iC = a.child2;
+	Node& b = nodes[iB];
+	Node& c = nodes[iC];
+	int difference = c.height - b.height;
+	if(difference > 1 || difference < -1) {
+		//rotate the taller child up, it takes A's place and A keeps the shorter grandchild
+		bool rightHeavy = difference > 1;
+		int iUp = rightHeavy ? iC : iB;
+		Node& up = nodes[iUp];
+		int iF = up.child1, iG = up.child2;
+		up.child1 = iA;
+		up.parent = a.parent;
+		a.parent = iUp;
+		if(up.parent >= 0) {
+			if(nodes[up.parent].child1 == iA)
+				nodes[up.parent].child1 = iUp;
+			else
+				nodes[up.parent].child2 = iUp;
+		}
+		else
+			root = iUp;
+		//the taller grandchild stays with the rotated node
+		int iKeep = nodes[iF].height > nodes[iG].height ? iF : iG;
+		int iMove = iKeep == iF ? iG : iF;
+		up.child2 = iKeep;
+		if(rightHeavy)
+			a.child2 = iMove;
+		else
+			a.child1 = iMove;
+		nodes[iMove].parent = iA;
+		refit(iA);
+		refit(iUp);
+		return iUp;
+	}
+	return iA;
+}
+
+void DynamicAABBTree::update(const std::vector<XMFLOAT3>& lower, const std::vector<XMFLOAT3>& upper, const std::vector<char>& isStatic)
+{
+	int count = (int)lower.size();
+	if(count != (int)leaves.size()) {
+		clear();
+		leaves.resize(count);
+		centres.resize(count);
+		for(int i = 0; i < count; i++) {
+			leaves[i] = allocateNode();
+			nodes[leaves[i]].object = i;
+			setFatBox(leaves[i], lower[i], upper[i], XMFLOAT3(0.f, 0.f, 0.f));
+			insertLeaf(leaves[i]);
+			centres[i] = XMFLOAT3(0.5f*(lower[i].x + upper[i].x), 0.5f*(lower[i].y + upper[i].y), 0.5f*(lower[i].z + upper[i].z));
+		}
+	}
+
+	//only objects that left their fat box go back into the tree
+	reinsertions = 0;
+	for(int i = 0; i < count; i++) {
+		XMFLOAT3 centre(0.5f*(lower[i].x + upper[i].x), 0.5f*(lower[i].y + upper[i].y), 0.5f*(lower[i].z + upper[i].z));
+		XMFLOAT3 displacement(centre.x - centres[i].x, centre.y - centres[i].y, centre.z - centres[i].z);
+		centres[i] = centre;
+		int leaf = leaves[i];
+		if(contains(nodes[leaf].lower, nodes[leaf].upper, lower[i], upper[i]))
+			continue;
+		removeLeaf(leaf);
+		setFatBox(leaf, lower[i], upper[i], displacement);
+		insertLeaf(leaf);
+		reinsertions++;
+	}
+	height = root >= 0 ? nodes[root].height : 0;
+
+	//every dynamic object looks for everything its fat box touches, dynamic pairs are kept from the lower index,
+	//the tight boxes decide
+	pairs.clear();
+	overlapTests = 0;
+	for(int i = 0; i < count; i++) {
+		if(isStatic[i])
+			continue;
+		const Node& self = nodes[leaves[i]];
+		stack.clear();
+		stack.push_back(root);
+		while(!stack.empty()) {
+			int index = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[index];
+			overlapTests++;
+			if(!overlaps(node.lower, node.upper, self.lower, self.upper))
+				continue;
+			if(node.child1 >= 0) {
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+				continue;
+			}
+			int other = node.object;
+			if(other == i || (!isStatic[other] && other < i))
+				continue;
+			if(overlaps(lower[i], upper[i], lower[other], upper[other]))
+				pairs.push_back(std::make_pair(std::min(i, other), std::max(i, other)));
+		}
+	}
+	std::sort(pairs.begin(), pairs.end());
+}
+
+void DynamicAABBTree::query(XMFLOAT3 lower, XMFLOAT3 upper, std::vector<int>& objects)
+{
+	objects.clear();
+	if(root < 0)
+		return;
+	stack.clear();
+	stack.push_back(root);
+	while(!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if(!overlaps(node.lower, node.upper, lower, upper))
+			continue;
+		if(node.child1 >= 0) {
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+		else
+			objects.push_back(node.object);
+	}
+}
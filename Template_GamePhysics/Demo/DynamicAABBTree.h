@@ -0,0 +1,74 @@
+#pragma once
+#ifndef DynamicAABBTree_HEADER
+#define DynamicAABBTree_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "BroadPhase.h"
+
+// Dynamic bounding volume hierarchy (as in Box2D's b2DynamicTree, in 3D).
+// Every object is a leaf holding a fat box: its tight box grown by margin and stretched along the
+// last displacement. As long as the tight box stays inside the fat one nothing happens, otherwise
+// the leaf is removed and inserted again, which refits the boxes of its ancestors on the way up.
+// Inserting descends by the surface area heuristic and every node on the way back up is
+// rebalanced with AVL style rotations, so the tree stays shallow when objects of very different
+// sizes (a 500 unit floor next to half unit boxes) come and go.
+// Only dynamic objects query the tree, so pairs of two static objects are never even tested.
+class DynamicAABBTree : public BroadPhase
+{
+public:
+	//added to every side of the tight box
+	float margin;
+	//the fat box also reaches this many last displacements ahead
+	float displacementFactor;
+
+	//statistics of the last update
+	int reinsertions;
+	int overlapTests;
+	int height;
+	int nodeCount;
+
+	DynamicAABBTree();
+
+	void clear();
+	void update(const std::vector<XMFLOAT3>& lower, const std::vector<XMFLOAT3>& upper, const std::vector<char>& isStatic);
+
+	//objects whose fat box overlaps the given box
+	void query(XMFLOAT3 lower, XMFLOAT3 upper, std::vector<int>& objects);
+
+private:
+	struct Node
+	{
+		XMFLOAT3 lower;
+		XMFLOAT3 upper;
+		//next free node while the node is unused
+		int parent;
+		//-1 for leaves
+		int child1;
+		int child2;
+		//0 for leaves, -1 for free nodes
+		int height;
+		int object;
+	};
+
+	std::vector<Node> nodes;
+	int root;
+	int freeList;
+	//leaf of every object and its tight centre at the last update
+	std::vector<int> leaves;
+	std::vector<XMFLOAT3> centres;
+	std::vector<int> stack;
+
+	int allocateNode();
+	void freeNode(int node);
+	void setFatBox(int leaf, const XMFLOAT3& lower, const XMFLOAT3& upper, const XMFLOAT3& displacement);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	//rotates the taller grandchild up if the children's heights differ by more than one, returns the new subtree root
+	int balance(int node);
+	void refit(int node);
+};
+
+#endif
@@ -16,15 +16,14 @@ std::vector<Particle>& Fluid::getParticles() {
 	return particles;
 }
 
-std::vector<Particle*> Fluid::getNeighbourParticles(Particle& particle) {
-	std::vector<Particle*> neigbours;
+void Fluid::getNeighbourParticles(Particle& particle, ScratchVector<Particle*>& neigbours) {
+	neigbours.reserve(neigbours.size() + particles.size());
 	for (auto particle = particles.begin(); particle != particles.end(); particle++) {
 		//std::cout << "particle: " << particle._Ptr << std::endl;
-		neigbours.push_back(particle._Ptr);
+		neigbours.push_back(&(*particle));
 		//std::cout << "neighbour: " << *(neigbours.end() - 1)._Ptr << std::endl;
 	}
 	//std::cout << "Fluid neighbours size: " << neigbours.size() << std::endl;
-	return neigbours;
 }
 
 Fluid::Fluid(XMFLOAT3 initialPostion, XMINT3 numParticles, int exp, float kernelSize, float positioningStep, float stiffness, float restDensity, float viscosity, bool random) : 
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include "Particle.h"
+#include "StepArena.h"
 #include <DirectXMath.h>
 
 using namespace DirectX;
@@ -27,7 +28,8 @@ public:
 	void setKernelSize(float newsize);
 	//get all particles
 	std::vector<Particle>& getParticles();
-	virtual std::vector<Particle*> getNeighbourParticles(Particle& particle);
+	//appends the neighbours of the particle, the list lives in the step arena
+	virtual void getNeighbourParticles(Particle& particle, ScratchVector<Particle*>& neighbours);
 	virtual void recomputeGrid();
 
 	Fluid(XMFLOAT3 initialPostion, XMINT3 numParticles, int exp, float kernelSize, float positioningStep, float stiffness, float restDensity, float viscosity, bool random);
@@ -1,5 +1,6 @@
 #include "FluidSimulation.h"
 #include "vectorOperations.h"
+#include "PointCollision.h"
 #include <iostream>
 
 float FluidSimulation::kernel(float& d, XMFLOAT3& x, XMFLOAT3& xi) {
@@ -33,7 +34,7 @@ XMFLOAT3 FluidSimulation::kernelGradient(float& d, XMFLOAT3& x, XMFLOAT3& xi) {
 	return multiplyVector(direction, kernel);
 }
 
-void FluidSimulation::integrateFluid(Fluid& fluid, float timeStep, float& gravity, XMVECTOR& lowerBoxBoundary, XMVECTOR& upperBoxBoundary, bool useGravity, bool useWalls, bool useDamping) {
+void FluidSimulation::integrateFluid(Fluid& fluid, float timeStep, float& gravity, XMVECTOR& lowerBoxBoundary, XMVECTOR& upperBoxBoundary, bool useGravity, bool useWalls, bool useDamping, StepArena& arena) {
 	//for each particle
 	//std::vector<Particle> particles = fluid.particles;
 
@@ -48,12 +49,14 @@ void FluidSimulation::integrateFluid(Fluid& fluid, float timeStep, float& gravit
 		std::cout << "acceleration: " << p1->gp_acceleration.x << "\t" << p1->gp_acceleration.y << "\t" << p1->gp_acceleration.z << "\t" <<  std::endl << std::endl;
 	}*/
 
-	std::vector<Particle*> neighbours;
+	//one list for all particles, clear() keeps its storage
+	ScratchVector<Particle*> neighbours(arena);
 	for (auto p1 = fluid.particles.begin(); p1 != fluid.particles.end(); p1++) {
 		//std::cout << "&p1: " << p1._Ptr << std::endl;
 		//1 find density
 		fluid.recomputeGrid();
-		neighbours = fluid.getNeighbourParticles(*p1);
+		neighbours.clear();
+		fluid.getNeighbourParticles(*p1, neighbours);
 		for (auto p2 = neighbours.begin(); p2 != neighbours.end(); p2++) {
 			//std::cout << "&p2: " << *p2._Ptr << std::endl;
 			//std::cout << "p2 position: " << (*p2._Ptr)->gp_position.x << " " << (*p2._Ptr)->gp_position.y << " " << (*p2._Ptr)->gp_position.z << std::endl;
@@ -68,7 +71,8 @@ void FluidSimulation::integrateFluid(Fluid& fluid, float timeStep, float& gravit
 	//see SPH fluids in Computer Graphics paper: equasion (6) and Algorithm 1
 	for (auto p1 = fluid.particles.begin(); p1 != fluid.particles.end(); p1++) {
 		//std::cout << "&p1: " << p1._Ptr << std::endl;
-		neighbours = fluid.getNeighbourParticles(*p1);
+		neighbours.clear();
+		fluid.getNeighbourParticles(*p1, neighbours);
 		for (auto p2 = neighbours.begin(); p2 != neighbours.end(); p2++) {
 			p1->gp_force = addVector(p1->gp_force, 
 				multiplyVector(kernelGradient(fluid.kernelSize, p1->gp_position, (*p2)->gp_position), 
@@ -87,15 +91,14 @@ void FluidSimulation::integrateFluid(Fluid& fluid, float timeStep, float& gravit
 		p1->gp_velocity = addVector(p1->gp_velocity, multiplyVector(p1->gp_acceleration, timeStep));
 		p1->gp_position = addVector(p1->gp_position, multiplyVector(p1->gp_velocity, timeStep));
 
-		//check the position & clamp to the box
 		if(useDamping)
 			p1->addDamping(timeStep);
-		if(useWalls)
-		{
-			p1->computeCollisionWithBox(timeStep,fluid.getKernelSize(),upperBoxBoundary, lowerBoxBoundary);
-		}
 	}
 
+	//check the positions & clamp to the box, all particles in one pass
+	if(useWalls)
+		PointCollision::resolve(fluid.particles, ContainmentBox::box(lowerBoxBoundary, upperBoxBoundary, fluid.getKernelSize()), timeStep);
+
 
 }
 
@@ -8,7 +8,8 @@ private:
 	inline float static kernel(float& d, XMFLOAT3& x, XMFLOAT3& xi);
 	inline XMFLOAT3 static kernelGradient(float& d, XMFLOAT3& x, XMFLOAT3& xi);
 public:
-	static void integrateFluid(Fluid& fluid, float timeStep, float& gravity, XMVECTOR& lowerBoxBoundary, XMVECTOR& upperBoxBoundary, bool useGravity, bool useWalls, bool useDamping);
+	//neighbour lists are taken from the arena, reset it after the step
+	static void integrateFluid(Fluid& fluid, float timeStep, float& gravity, XMVECTOR& lowerBoxBoundary, XMVECTOR& upperBoxBoundary, bool useGravity, bool useWalls, bool useDamping, StepArena& arena);
 	//FluidSimulation();
 	//~FluidSimulation(void);
 };
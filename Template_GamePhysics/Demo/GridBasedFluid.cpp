@@ -18,8 +18,7 @@ public:
 		grid->recompute(*this);
 	}
 
-	std::vector<Particle*> getNeighbourParticles(Particle& particle) { //TODO: Make this something useful
-		std::vector<Particle*> neigbours;
+	void getNeighbourParticles(Particle& particle, ScratchVector<Particle*>& neigbours) { //TODO: Make this something useful
 		XMVECTOR particleIndices = grid->getCellIndicesForParticle(particle);
 		int currCellIndex;
 		int iParticleIndex = XMVectorGetX(particleIndices);
@@ -52,7 +51,6 @@ public:
 		}
 		/*std::cout << "counter: " << counter << std::endl;
 		std::cout << "GridBasedFluid neighbours size: " << neigbours.size() << std::endl;*/
-		return neigbours;
 	}
 
 	~GridBasedFluid(void) {
@@ -0,0 +1,154 @@
+#pragma once
+#ifndef Matrix3_HEADER
+#define Matrix3_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <cmath>
+
+// Plain row major 3x3 matrix for per element math (deformation gradients, stresses, rotations),
+// where XMMATRIX would waste a row and a column and needs aligned storage.
+// Quaternions are XMFLOAT4 (x, y, z, w) like in DirectXMath.
+struct Matrix3
+{
+	float m[3][3];
+
+	static Matrix3 zero()
+	{
+		Matrix3 result;
+		for(int r = 0; r < 3; r++)
+			for(int c = 0; c < 3; c++)
+				result.m[r][c] = 0.f;
+		return result;
+	}
+
+	static Matrix3 identity()
+	{
+		Matrix3 result = zero();
+		result.m[0][0] = result.m[1][1] = result.m[2][2] = 1.f;
+		return result;
+	}
+
+	static Matrix3 fromColumns(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+	{
+		Matrix3 result;
+		result.m[0][0] = a.x; result.m[0][1] = b.x; result.m[0][2] = c.x;
+		result.m[1][0] = a.y; result.m[1][1] = b.y; result.m[1][2] = c.y;
+		result.m[2][0] = a.z; result.m[2][1] = b.z; result.m[2][2] = c.z;
+		return result;
+	}
+
+	//q has to be normalised
+	static Matrix3 fromQuaternion(const XMFLOAT4& q)
+	{
+		Matrix3 result;
+		float xx = q.x*q.x, yy = q.y*q.y, zz = q.z*q.z;
+		float xy = q.x*q.y, xz = q.x*q.z, yz = q.y*q.z;
+		float wx = q.w*q.x, wy = q.w*q.y, wz = q.w*q.z;
+		result.m[0][0] = 1 - 2*(yy + zz); result.m[0][1] = 2*(xy - wz);     result.m[0][2] = 2*(xz + wy);
+		result.m[1][0] = 2*(xy + wz);     result.m[1][1] = 1 - 2*(xx + zz); result.m[1][2] = 2*(yz - wx);
+		result.m[2][0] = 2*(xz - wy);     result.m[2][1] = 2*(yz + wx);     result.m[2][2] = 1 - 2*(xx + yy);
+		return result;
+	}
+
+	XMFLOAT3 column(int c) const
+	{
+		return XMFLOAT3(m[0][c], m[1][c], m[2][c]);
+	}
+
+	Matrix3 operator*(const Matrix3& other) const
+	{
+		Matrix3 result;
+		for(int r = 0; r < 3; r++)
+			for(int c = 0; c < 3; c++)
+				result.m[r][c] = m[r][0]*other.m[0][c] + m[r][1]*other.m[1][c] + m[r][2]*other.m[2][c];
+		return result;
+	}
+
+	XMFLOAT3 operator*(const XMFLOAT3& v) const
+	{
+		return XMFLOAT3(m[0][0]*v.x + m[0][1]*v.y + m[0][2]*v.z,
+			m[1][0]*v.x + m[1][1]*v.y + m[1][2]*v.z,
+			m[2][0]*v.x + m[2][1]*v.y + m[2][2]*v.z);
+	}
+
+	//transpose(this) * v without building the transpose
+	XMFLOAT3 transposeTimes(const XMFLOAT3& v) const
+	{
+		return XMFLOAT3(m[0][0]*v.x + m[1][0]*v.y + m[2][0]*v.z,
+			m[0][1]*v.x + m[1][1]*v.y + m[2][1]*v.z,
+			m[0][2]*v.x + m[1][2]*v.y + m[2][2]*v.z);
+	}
+
+	Matrix3 transposed() const
+	{
+		Matrix3 result;
+		for(int r = 0; r < 3; r++)
+			for(int c = 0; c < 3; c++)
+				result.m[r][c] = m[c][r];
+		return result;
+	}
+
+	float determinant() const
+	{
+		return m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1])
+			- m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0])
+			+ m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+	}
+
+	//returns false for (nearly) singular matrices and leaves result alone
+	bool inverse(Matrix3& result) const
+	{
+		float det = determinant();
+		if(std::abs(det) < 1e-20f)
+			return false;
+		float inv = 1.f/det;
+		result.m[0][0] = (m[1][1]*m[2][2] - m[1][2]*m[2][1])*inv;
+		result.m[0][1] = (m[0][2]*m[2][1] - m[0][1]*m[2][2])*inv;
+		result.m[0][2] = (m[0][1]*m[1][2] - m[0][2]*m[1][1])*inv;
+		result.m[1][0] = (m[1][2]*m[2][0] - m[1][0]*m[2][2])*inv;
+		result.m[1][1] = (m[0][0]*m[2][2] - m[0][2]*m[2][0])*inv;
+		result.m[1][2] = (m[0][2]*m[1][0] - m[0][0]*m[1][2])*inv;
+		result.m[2][0] = (m[1][0]*m[2][1] - m[1][1]*m[2][0])*inv;
+		result.m[2][1] = (m[0][1]*m[2][0] - m[0][0]*m[2][1])*inv;
+		result.m[2][2] = (m[0][0]*m[1][1] - m[0][1]*m[1][0])*inv;
+		return true;
+	}
+
+	// Rotational part of a (possibly inverted or degenerate) matrix, "A Robust Method to Extract the
+	// Rotational Part of Deformations" (Mueller et al. 2016). q is the initial guess (last frame's
+	// rotation) and receives the result, a warm started guess usually needs one or two iterations.
+	static void extractRotation(const Matrix3& a, XMFLOAT4& q, int maxIterations)
+	{
+		for(int iteration = 0; iteration < maxIterations; iteration++) {
+			Matrix3 r = fromQuaternion(q);
+			//omega = sum r_i x a_i / (|sum r_i . a_i| + eps), r_i and a_i the columns
+			float omega[3] = { 0.f, 0.f, 0.f }, denominator = 0.f;
+			for(int c = 0; c < 3; c++) {
+				float rx = r.m[0][c], ry = r.m[1][c], rz = r.m[2][c];
+				float ax = a.m[0][c], ay = a.m[1][c], az = a.m[2][c];
+				omega[0] += ry*az - rz*ay;
+				omega[1] += rz*ax - rx*az;
+				omega[2] += rx*ay - ry*ax;
+				denominator += rx*ax + ry*ay + rz*az;
+			}
+			float scale = 1.f / (std::abs(denominator) + 1e-9f);
+			float wx = omega[0]*scale, wy = omega[1]*scale, wz = omega[2]*scale;
+			float angle = std::sqrt(wx*wx + wy*wy + wz*wz);
+			if(angle < 1e-9f)
+				break;
+			//q = rotation(angle, omega/angle) * q
+			float s = std::sin(0.5f*angle)/angle, c = std::cos(0.5f*angle);
+			XMFLOAT4 d(wx*s, wy*s, wz*s, c);
+			XMFLOAT4 p(d.w*q.x + d.x*q.w + d.y*q.z - d.z*q.y,
+				d.w*q.y - d.x*q.z + d.y*q.w + d.z*q.x,
+				d.w*q.z + d.x*q.y - d.y*q.x + d.z*q.w,
+				d.w*q.w - d.x*q.x - d.y*q.y - d.z*q.z);
+			float length = std::sqrt(p.x*p.x + p.y*p.y + p.z*p.z + p.w*p.w);
+			q = XMFLOAT4(p.x/length, p.y/length, p.z/length, p.w/length);
+		}
+	}
+};
+
+#endif
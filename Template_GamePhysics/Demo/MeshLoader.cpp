@@ -0,0 +1,633 @@
+#include "MeshLoader.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+
+MeshSpringSettings::MeshSpringSettings()
+{
+	structuralStiffness = 40.f;
+	bendStiffness = 10.f;
+	volumeStiffness = 20.f;
+	damping = 0.1f;
+	totalMass = 1.f;
+	pointDamping = 1.f;
+}
+
+//-------------------------------------------------------------------------------------------------
+// file parsing
+
+static bool readFile(const std::string& path, std::string& contents)
+{
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if(!file) {
+		std::cout << "MeshLoader: can't open " << path << std::endl;
+		return false;
+	}
+	file.seekg(0, std::ios::end);
+	contents.resize((size_t)file.tellg());
+	file.seekg(0, std::ios::beg);
+	if(!contents.empty())
+		file.read(&contents[0], contents.size());
+	return true;
+}
+
+static const char* nextLine(const char* c, const char* end)
+{
+	while(c < end && *c != '\n')
+		c++;
+	return c < end ? c+1 : end;
+}
+
+static const char* skipBlanks(const char* c, const char* end)
+{
+	while(c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+		c++;
+	return c;
+}
+
+bool MeshLoader::loadObj(const std::string& path, std::vector<XMFLOAT3>& vertices, std::vector<int>& triangles)
+{
+	std::string contents;
+	if(!readFile(path, contents))
+		return false;
+	vertices.clear();
+	triangles.clear();
+
+	const char* c = contents.c_str();
+	const char* end = c + contents.size();
+	std::vector<int> polygon;
+	int line = 1;
+	for(; c < end; c = nextLine(c, end), line++) {
+		c = skipBlanks(c, end);
+		if(end - c < 2 || !(c[1] == ' ' || c[1] == '\t'))
+			continue;
+		if(c[0] == 'v') {
+			char* next;
+			XMFLOAT3 v;
+			v.x = (float)strtod(c+1, &next);
+			v.y = (float)strtod(next, &next);
+			v.z = (float)strtod(next, &next);
+			vertices.push_back(v);
+		}
+		else if(c[0] == 'f') {
+			//"f a b c ...", every corner may be a/t/n, a//n or a/t, negative indices count from the end
+			polygon.clear();
+			c = skipBlanks(c+1, end);
+			while(c < end && *c != '\n' && *c != '\r') {
+				char* next;
+				long index = strtol(c, &next, 10);
+				if(next == c) {
+					std::cout << "MeshLoader: bad face in " << path << " line " << line << std::endl;
+					return false;
+				}
+				int vertex = index < 0 ? (int)vertices.size() + (int)index : (int)index - 1;
+				if(vertex < 0 || vertex >= (int)vertices.size()) {
+					std::cout << "MeshLoader: face index out of range in " << path << " line " << line << std::endl;
+					return false;
+				}
+				polygon.push_back(vertex);
+				c = next;
+				while(c < end && !isspace((unsigned char)*c))
+					c++;
+				c = skipBlanks(c, end);
+			}
+			for(size_t i = 2; i < polygon.size(); i++) {
+				triangles.push_back(polygon[0]);
+				triangles.push_back(polygon[i-1]);
+				triangles.push_back(polygon[i]);
+			}
+			//the loop stopped on the line end already
+			c--;
+		}
+	}
+	if(triangles.empty()) {
+		std::cout << "MeshLoader: no faces in " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//whitespace separated numbers with # comments, as used by the TetGen formats
+class NumberReader
+{
+public:
+	NumberReader(const std::string& contents) : c(contents.c_str()), end(contents.c_str() + contents.size()) {}
+
+	bool next(double& value)
+	{
+		while(c < end) {
+			if(*c == '#')
+				c = nextLine(c, end);
+			else if(isspace((unsigned char)*c))
+				c++;
+			else
+				break;
+		}
+		if(c >= end)
+			return false;
+		char* after;
+		value = strtod(c, &after);
+		if(after == c)
+			return false;
+		c = after;
+		return true;
+	}
+	bool nextInt(int& value)
+	{
+		double d;
+		if(!next(d))
+			return false;
+		value = (int)d;
+		return true;
+	}
+
+private:
+	const char* c;
+	const char* end;
+};
+
+bool MeshLoader::loadTetGen(const std::string& basePath, std::vector<XMFLOAT3>& vertices, std::vector<int>& tets)
+{
+	std::string nodePath = basePath + ".node", elePath = basePath + ".ele";
+	std::string contents;
+	if(!readFile(nodePath, contents))
+		return false;
+	vertices.clear();
+	tets.clear();
+
+	//header: <#points> <dimension> <#attributes> <boundary markers>
+	NumberReader nodes(contents);
+	int pointCount, dimension, attributes, markers;
+	if(!nodes.nextInt(pointCount) || !nodes.nextInt(dimension) || !nodes.nextInt(attributes) || !nodes.nextInt(markers) || dimension != 3) {
+		std::cout << "MeshLoader: bad header in " << nodePath << std::endl;
+		return false;
+	}
+	//nodes are numbered from 0 or 1, the first one tells
+	int firstIndex = 0;
+	vertices.resize(pointCount);
+	for(int i = 0; i < pointCount; i++) {
+		int index;
+		double x, y, z, skip;
+		if(!nodes.nextInt(index) || !nodes.next(x) || !nodes.next(y) || !nodes.next(z)) {
+			std::cout << "MeshLoader: " << nodePath << " ends after " << i << " of " << pointCount << " points" << std::endl;
+			return false;
+		}
+		if(i == 0)
+			firstIndex = index;
+		vertices[i] = XMFLOAT3((float)x, (float)y, (float)z);
+		for(int a = 0; a < attributes + (markers ? 1 : 0); a++)
+			nodes.next(skip);
+	}
+
+	if(!readFile(elePath, contents))
+		return false;
+	//header: <#tets> <nodes per tet> <#attributes>, only the 4 corners of 10 node tets are used
+	NumberReader elements(contents);
+	int tetCount, nodesPerTet;
+	if(!elements.nextInt(tetCount) || !elements.nextInt(nodesPerTet) || !elements.nextInt(attributes) || nodesPerTet < 4) {
+		std::cout << "MeshLoader: bad header in " << elePath << std::endl;
+		return false;
+	}
+	tets.resize(4*tetCount);
+	for(int i = 0; i < tetCount; i++) {
+		int index, corner;
+		double skip;
+		if(!elements.nextInt(index)) {
+			std::cout << "MeshLoader: " << elePath << " ends after " << i << " of " << tetCount << " tets" << std::endl;
+			return false;
+		}
+		for(int n = 0; n < nodesPerTet; n++) {
+			if(!elements.nextInt(corner)) {
+				std::cout << "MeshLoader: " << elePath << " ends inside tet " << i << std::endl;
+				return false;
+			}
+			corner -= firstIndex;
+			if(n < 4) {
+				if(corner < 0 || corner >= pointCount) {
+					std::cout << "MeshLoader: node index out of range in tet " << i << " of " << elePath << std::endl;
+					return false;
+				}
+				tets[4*i+n] = corner;
+			}
+		}
+		for(int a = 0; a < attributes; a++)
+			elements.next(skip);
+	}
+	return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// partitioned hash tables for the edge and face deduplication
+
+static inline unsigned long long hashKey(unsigned long long key)
+{
+	//splitmix64 finaliser, the low bits pick the slot and the high bits the partition
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return key;
+}
+
+static inline int partitionOf(unsigned long long hash, int partitions)
+{
+	return (int)((hash >> 40) % (unsigned long long)partitions);
+}
+
+static inline unsigned long long edgeKey(int a, int b)
+{
+	if(a > b)
+		std::swap(a, b);
+	return ((unsigned long long)a << 32) | (unsigned int)b;
+}
+
+//three sorted 21 bit indices, the face table is only used for meshes below 2M points
+static const int faceIndexBits = 21;
+static inline unsigned long long faceKey(int a, int b, int c)
+{
+	if(a > b) std::swap(a, b);
+	if(b > c) std::swap(b, c);
+	if(a > b) std::swap(a, b);
+	return ((unsigned long long)a << 2*faceIndexBits) | ((unsigned long long)b << faceIndexBits) | (unsigned long long)c;
+}
+
+static const unsigned long long emptyKey = ~0ULL;
+
+//an edge with the corners opposite to it in the first two triangles that share it
+struct EdgeEntry
+{
+	unsigned long long key;
+	int count;
+	int opposite[2];
+};
+
+//a tet face, corners in the order of the first tet for the boundary triangles
+struct FaceEntry
+{
+	unsigned long long key;
+	int count;
+	int opposite[2];
+	int corner[3];
+};
+
+//open addressing table owned by one thread, linear probing
+template<class Entry>
+class PartitionTable
+{
+public:
+	std::vector<Entry> slots;
+	int used;
+
+	void init(int expected)
+	{
+		size_t size = 16;
+		while(size < 2*(size_t)expected)
+			size *= 2;
+		Entry empty;
+		empty.key = emptyKey;
+		slots.assign(size, empty);
+		used = 0;
+	}
+
+	Entry* insert(unsigned long long key, unsigned long long hash)
+	{
+		if(10*(used+1) > 7*(int)slots.size())
+			grow();
+		size_t mask = slots.size()-1;
+		for(size_t i = (size_t)hash & mask; ; i = (i+1) & mask) {
+			if(slots[i].key == key)
+				return &slots[i];
+			if(slots[i].key == emptyKey) {
+				slots[i].key = key;
+				slots[i].count = 0;
+				used++;
+				return &slots[i];
+			}
+		}
+	}
+
+	const Entry* find(unsigned long long key, unsigned long long hash) const
+	{
+		size_t mask = slots.size()-1;
+		for(size_t i = (size_t)hash & mask; ; i = (i+1) & mask) {
+			if(slots[i].key == key)
+				return &slots[i];
+			if(slots[i].key == emptyKey)
+				return nullptr;
+		}
+	}
+
+private:
+	void grow()
+	{
+		std::vector<Entry> old;
+		old.swap(slots);
+		init((int)old.size());
+		for(auto s = old.begin(); s != old.end(); s++)
+			if(s->key != emptyKey)
+				*insert(s->key, hashKey(s->key)) = *s;
+	}
+};
+
+typedef std::vector<PartitionTable<EdgeEntry>> EdgeTables;
+typedef std::vector<PartitionTable<FaceEntry>> FaceTables;
+
+static bool hasEdge(const EdgeTables& edges, int a, int b)
+{
+	unsigned long long key = edgeKey(a, b), hash = hashKey(key);
+	return edges[partitionOf(hash, (int)edges.size())].find(key, hash) != nullptr;
+}
+
+//a key met in an element, which says where in the element it came from (edge corners or skipped corner)
+struct ElementKey
+{
+	unsigned long long key;
+	unsigned long long hash;
+	int element;
+	int which;
+};
+
+//sorts the keys of all elements into one bucket per partition, so the tables can be filled without
+//every partition walking all elements. the elements are split into fixed chunks, each chunk counts
+//its keys per partition, a prefix sum over (partition, chunk) gives every chunk its write position
+//and a second pass scatters. keys stay in element order inside a bucket, like a serial walk.
+//emit(e, keys) writes keysPerElement keys and whiches, the hashes are filled in here
+template<class Emit>
+static void bucketKeys(int elementCount, int keysPerElement, int partitions, const Emit& emit, std::vector<ElementKey>& keys, std::vector<int>& start, ThreadPool& pool)
+{
+	int chunkSize = std::max(1, (elementCount + 4*partitions - 1) / (4*partitions));
+	int chunks = (elementCount + chunkSize - 1) / chunkSize;
+	std::vector<int> offset(chunks*partitions, 0);
+
+	pool.parallelFor(chunks, 1, [&](int begin, int end) {
+		ElementKey local[6];
+		for(int c = begin; c < end; c++) {
+			int* count = &offset[c*partitions];
+			for(int e = c*chunkSize; e < std::min(elementCount, (c+1)*chunkSize); e++) {
+				emit(e, local);
+				for(int k = 0; k < keysPerElement; k++)
+					count[partitionOf(hashKey(local[k].key), partitions)]++;
+			}
+		}
+	});
+
+	start.assign(partitions+1, 0);
+	int total = 0;
+	for(int p = 0; p < partitions; p++) {
+		start[p] = total;
+		for(int c = 0; c < chunks; c++) {
+			int count = offset[c*partitions+p];
+			offset[c*partitions+p] = total;
+			total += count;
+		}
+	}
+	start[partitions] = total;
+
+	keys.resize(total);
+	pool.parallelFor(chunks, 1, [&](int begin, int end) {
+		ElementKey local[6];
+		for(int c = begin; c < end; c++) {
+			int* write = &offset[c*partitions];
+			for(int e = c*chunkSize; e < std::min(elementCount, (c+1)*chunkSize); e++) {
+				emit(e, local);
+				for(int k = 0; k < keysPerElement; k++) {
+					local[k].hash = hashKey(local[k].key);
+					local[k].element = e;
+					keys[write[partitionOf(local[k].hash, partitions)]++] = local[k];
+				}
+			}
+		}
+	});
+}
+
+//the edge keys are bucketed by partition first, then every partition fills its own table from its
+//bucket, so the threads never share a table
+static void buildEdgeTables(const std::vector<int>& elements, int corners, EdgeTables& tables, ThreadPool& pool)
+{
+	int elementCount = (int)elements.size() / corners;
+	int partitions = (int)tables.size();
+	//edges are shared by about 2 triangles or 5 tets
+	int edgesPerElement = corners*(corners-1)/2;
+	int expected = elementCount*edgesPerElement / (corners == 3 ? 2 : 5) / partitions + 1;
+
+	std::vector<ElementKey> keys;
+	std::vector<int> start;
+	bucketKeys(elementCount, edgesPerElement, partitions, [&](int e, ElementKey* out) {
+		const int* element = &elements[corners*e];
+		for(int i = 0, n = 0; i < corners; i++) {
+			for(int j = i+1; j < corners; j++, n++) {
+				out[n].key = edgeKey(element[i], element[j]);
+				//triangles: the corner that isn't on the edge, tets don't need it
+				out[n].which = 3-i-j;
+			}
+		}
+	}, keys, start, pool);
+
+	pool.parallelFor(partitions, 1, [&](int begin, int end) {
+		for(int p = begin; p < end; p++) {
+			PartitionTable<EdgeEntry>& table = tables[p];
+			table.init(expected);
+			for(int k = start[p]; k < start[p+1]; k++) {
+				EdgeEntry* entry = table.insert(keys[k].key, keys[k].hash);
+				if(corners == 3 && entry->count < 2)
+					entry->opposite[entry->count] = elements[corners*keys[k].element + keys[k].which];
+				entry->count++;
+			}
+		}
+	});
+}
+
+//turns the table entries into spring endpoint arrays, emit writes up to two springs per entry.
+//partitions are appended in order so the result doesn't depend on the thread timing
+template<class Entry, class Emit>
+static void collectSprings(const std::vector<PartitionTable<Entry>>& tables, const Emit& emit, std::vector<int>& endpoints, std::vector<float>& stiffness, ThreadPool& pool)
+{
+	int partitions = (int)tables.size();
+	std::vector<std::vector<int>> partEndpoints(partitions);
+	std::vector<std::vector<float>> partStiffness(partitions);
+	pool.parallelFor(partitions, 1, [&](int begin, int end) {
+		int a[4];
+		float k[2];
+		for(int p = begin; p < end; p++) {
+			partEndpoints[p].reserve(2*tables[p].used);
+			partStiffness[p].reserve(tables[p].used);
+			for(auto s = tables[p].slots.begin(); s != tables[p].slots.end(); s++) {
+				if(s->key == emptyKey)
+					continue;
+				int n = emit(*s, a, k);
+				partEndpoints[p].insert(partEndpoints[p].end(), a, a + 2*n);
+				partStiffness[p].insert(partStiffness[p].end(), k, k + n);
+			}
+		}
+	});
+
+	std::vector<size_t> offset(partitions+1, stiffness.size());
+	for(int p = 0; p < partitions; p++)
+		offset[p+1] = offset[p] + partStiffness[p].size();
+	stiffness.resize(offset[partitions]);
+	endpoints.resize(2*offset[partitions]);
+	pool.parallelFor(partitions, 1, [&](int begin, int end) {
+		for(int p = begin; p < end; p++) {
+			std::copy(partStiffness[p].begin(), partStiffness[p].end(), stiffness.begin() + offset[p]);
+			std::copy(partEndpoints[p].begin(), partEndpoints[p].end(), endpoints.begin() + 2*offset[p]);
+		}
+	});
+}
+
+//the springs come out in hash order, a counting sort by their lower point index brings them back into
+//mesh order so the adjacency build and later the force loops walk memory mostly forward
+static void fillNetwork(const std::vector<XMFLOAT3>& vertices, const MeshSpringSettings& settings, const std::vector<int>& endpoints, const std::vector<float>& stiffness, SpringNetwork& network)
+{
+	int pointCount = (int)vertices.size();
+	int springCount = (int)stiffness.size();
+	std::vector<int> start(pointCount+1, 0);
+	for(int i = 0; i < springCount; i++)
+		start[std::min(endpoints[2*i], endpoints[2*i+1]) + 1]++;
+	for(int i = 0; i < pointCount; i++)
+		start[i+1] += start[i];
+	std::vector<int> sortedEndpoints(endpoints.size());
+	std::vector<float> sortedStiffness(springCount);
+	for(int i = 0; i < springCount; i++) {
+		int a = endpoints[2*i], b = endpoints[2*i+1];
+		if(a > b)
+			std::swap(a, b);
+		int write = start[a]++;
+		sortedEndpoints[2*write] = a;
+		sortedEndpoints[2*write+1] = b;
+		sortedStiffness[write] = stiffness[i];
+	}
+
+	network.clear();
+	network.reserve(pointCount, springCount);
+	float mass = settings.totalMass / std::max(1, pointCount);
+	for(auto v = vertices.begin(); v != vertices.end(); v++) {
+		SpringPoint point(*v);
+		point.setMass(mass);
+		point.setDamping(settings.pointDamping);
+		point.gp_bouncyness = 0.1f;
+		network.addPoint(point);
+	}
+	network.addSprings(sortedEndpoints, sortedStiffness, settings.damping);
+}
+
+static int partitionCount(ThreadPool& pool)
+{
+	//a few more partitions than threads to even out the work
+	return 2*pool.getThreadCount();
+}
+
+//-------------------------------------------------------------------------------------------------
+// network builders
+
+void MeshLoader::buildTriangleNetwork(const std::vector<XMFLOAT3>& vertices, const std::vector<int>& triangles, const MeshSpringSettings& settings, SpringNetwork& network, ThreadPool& pool)
+{
+	EdgeTables edges(partitionCount(pool));
+	buildEdgeTables(triangles, 3, edges, pool);
+
+	//structural spring per edge, bending spring between the two corners opposite a manifold edge
+	//unless they are already neighbours (closed meshes with very few triangles)
+	std::vector<int> endpoints;
+	std::vector<float> stiffness;
+	collectSprings(edges, [&](const EdgeEntry& edge, int* a, float* k) -> int {
+		a[0] = (int)(edge.key >> 32);
+		a[1] = (int)(edge.key & 0xffffffff);
+		k[0] = settings.structuralStiffness;
+		if(edge.count != 2 || settings.bendStiffness <= 0.f || edge.opposite[0] == edge.opposite[1] || hasEdge(edges, edge.opposite[0], edge.opposite[1]))
+			return 1;
+		a[2] = edge.opposite[0];
+		a[3] = edge.opposite[1];
+		k[1] = settings.bendStiffness;
+		return 2;
+	}, endpoints, stiffness, pool);
+
+	fillNetwork(vertices, settings, endpoints, stiffness, network);
+	network.triangles = triangles;
+}
+
+void MeshLoader::buildTetNetwork(const std::vector<XMFLOAT3>& vertices, const std::vector<int>& tets, const MeshSpringSettings& settings, SpringNetwork& network, ThreadPool& pool)
+{
+	int tetCount = (int)tets.size() / 4;
+	EdgeTables edges(partitionCount(pool));
+	buildEdgeTables(tets, 4, edges, pool);
+
+	std::vector<int> endpoints;
+	std::vector<float> stiffness;
+	collectSprings(edges, [&](const EdgeEntry& edge, int* a, float* k) -> int {
+		a[0] = (int)(edge.key >> 32);
+		a[1] = (int)(edge.key & 0xffffffff);
+		k[0] = settings.structuralStiffness;
+		return 1;
+	}, endpoints, stiffness, pool);
+
+	//faces: shared by two tets -> volume spring between the opposite corners, used once -> boundary triangle
+	std::vector<int> boundary;
+	if(vertices.size() >= (1u << faceIndexBits)) {
+		std::cout << "MeshLoader: more than " << (1 << faceIndexBits) << " points, no volume springs or boundary faces" << std::endl;
+	}
+	else {
+		FaceTables faces(edges.size());
+		int partitions = (int)faces.size();
+		std::vector<ElementKey> keys;
+		std::vector<int> start;
+		//one face per skipped corner
+		bucketKeys(tetCount, 4, partitions, [&](int t, ElementKey* out) {
+			const int* tet = &tets[4*t];
+			out[0].key = faceKey(tet[1], tet[2], tet[3]);
+			out[1].key = faceKey(tet[0], tet[2], tet[3]);
+			out[2].key = faceKey(tet[0], tet[1], tet[3]);
+			out[3].key = faceKey(tet[0], tet[1], tet[2]);
+			for(int skip = 0; skip < 4; skip++)
+				out[skip].which = skip;
+		}, keys, start, pool);
+
+		pool.parallelFor(partitions, 1, [&](int begin, int end) {
+			for(int p = begin; p < end; p++) {
+				PartitionTable<FaceEntry>& table = faces[p];
+				table.init(2*tetCount / partitions + 1);
+				for(int k = start[p]; k < start[p+1]; k++) {
+					const int* tet = &tets[4*keys[k].element];
+					int skip = keys[k].which;
+					FaceEntry* entry = table.insert(keys[k].key, keys[k].hash);
+					if(entry->count == 0) {
+						int c[3];
+						for(int i = 0, n = 0; i < 4; i++)
+							if(i != skip)
+								c[n++] = tet[i];
+						//wind the face so its normal points away from the opposite corner
+						XMVECTOR p0 = XMLoadFloat3(&vertices[c[0]]);
+						XMVECTOR n = XMVector3Cross(XMLoadFloat3(&vertices[c[1]]) - p0, XMLoadFloat3(&vertices[c[2]]) - p0);
+						if(XMVectorGetX(XMVector3Dot(n, XMLoadFloat3(&vertices[tet[skip]]) - p0)) > 0.f)
+							std::swap(c[1], c[2]);
+						entry->corner[0] = c[0];
+						entry->corner[1] = c[1];
+						entry->corner[2] = c[2];
+					}
+					if(entry->count < 2)
+						entry->opposite[entry->count] = tet[skip];
+					entry->count++;
+				}
+			}
+		});
+
+		collectSprings(faces, [&](const FaceEntry& face, int* a, float* k) -> int {
+			if(face.count != 2 || settings.volumeStiffness <= 0.f || hasEdge(edges, face.opposite[0], face.opposite[1]))
+				return 0;
+			a[0] = face.opposite[0];
+			a[1] = face.opposite[1];
+			k[0] = settings.volumeStiffness;
+			return 1;
+		}, endpoints, stiffness, pool);
+
+		for(int p = 0; p < partitions; p++)
+			for(auto s = faces[p].slots.begin(); s != faces[p].slots.end(); s++)
+				if(s->key != emptyKey && s->count == 1)
+					boundary.insert(boundary.end(), s->corner, s->corner+3);
+	}
+
+	fillNetwork(vertices, settings, endpoints, stiffness, network);
+	network.triangles.swap(boundary);
+}
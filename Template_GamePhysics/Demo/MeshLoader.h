@@ -0,0 +1,47 @@
+#pragma once
+#ifndef MeshLoader_HEADER
+#define MeshLoader_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include <string>
+#include "SpringNetwork.h"
+#include "ThreadPool.h"
+
+struct MeshSpringSettings
+{
+	//springs along the mesh edges
+	float structuralStiffness;
+	//triangle meshes: springs across every edge shared by two triangles, between the two opposite corners
+	float bendStiffness;
+	//tet meshes: springs across every face shared by two tets, between the two opposite corners
+	float volumeStiffness;
+	float damping;
+	//spread evenly over the points
+	float totalMass;
+	float pointDamping;
+
+	MeshSpringSettings();
+};
+
+// Loads triangle meshes (Wavefront OBJ) and tetrahedral meshes (TetGen .node/.ele) and turns them
+// into spring networks. Edges are deduplicated with a hash table that is split into partitions by
+// key hash, every partition is filled by its own thread so no locking is needed.
+// Loaders return false and print the reason when a file can't be read.
+class MeshLoader
+{
+public:
+	//polygons are triangulated as fans, only positions are read
+	static bool loadObj(const std::string& path, std::vector<XMFLOAT3>& vertices, std::vector<int>& triangles);
+	//reads basePath.node and basePath.ele, 4 indices per tet
+	static bool loadTetGen(const std::string& basePath, std::vector<XMFLOAT3>& vertices, std::vector<int>& tets);
+
+	//structural + bending springs, the triangles are kept for collisions
+	static void buildTriangleNetwork(const std::vector<XMFLOAT3>& vertices, const std::vector<int>& triangles, const MeshSpringSettings& settings, SpringNetwork& network, ThreadPool& pool);
+	//structural + volume springs, the boundary faces become the network's triangles
+	static void buildTetNetwork(const std::vector<XMFLOAT3>& vertices, const std::vector<int>& tets, const MeshSpringSettings& settings, SpringNetwork& network, ThreadPool& pool);
+};
+
+#endif
@@ -0,0 +1,930 @@
+#include "ModalSubspace.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+
+//-------------------------------------------------------------------------------------------------
+// linearised network
+
+struct LinearSpring
+{
+	int point1, point2;
+	double stiffness;
+	double length;
+	double direction[3];
+};
+
+// stiffness matrix with one 3x3 block per connected point pair, rows and columns of static points
+// are left out so every vector keeps zeros there
+struct StiffnessMatrix
+{
+	int pointCount;
+	std::vector<int> rowStart;
+	std::vector<int> columns;
+	std::vector<double> blocks;
+	//per degree of freedom, 0 for static points
+	std::vector<double> mass;
+	std::vector<char> isFixed;
+	//jacobi preconditioner of K + shift*M
+	std::vector<double> inverseDiagonal;
+	double shift;
+
+	int find(int row, int column) const
+	{
+		for(int e = rowStart[row]; e < rowStart[row+1]; e++)
+			if(columns[e] == column)
+				return e;
+		return -1;
+	}
+
+	//y = (K + diagonalShift*M) x for the rows [begin, end)
+	void multiply(const double* x, double* y, double diagonalShift, int begin, int end) const
+	{
+		for(int row = begin; row < end; row++) {
+			double* out = y + 3*row;
+			out[0] = out[1] = out[2] = 0;
+			if(isFixed[row])
+				continue;
+			for(int e = rowStart[row]; e < rowStart[row+1]; e++) {
+				const double* b = &blocks[9*e];
+				const double* in = x + 3*columns[e];
+				out[0] += b[0]*in[0] + b[1]*in[1] + b[2]*in[2];
+				out[1] += b[3]*in[0] + b[4]*in[1] + b[5]*in[2];
+				out[2] += b[6]*in[0] + b[7]*in[1] + b[8]*in[2];
+			}
+			double m = diagonalShift*mass[3*row];
+			out[0] += m*x[3*row];
+			out[1] += m*x[3*row+1];
+			out[2] += m*x[3*row+2];
+		}
+	}
+
+	void multiply(ThreadPool& pool, const double* x, double* y, double diagonalShift) const
+	{
+		pool.parallelFor(pointCount, 512, [&](int begin, int end) {
+			multiply(x, y, diagonalShift, begin, end);
+		});
+	}
+};
+
+//spring block k*((1-prestress)*d*d^T + prestress*I)
+static void springBlock(const LinearSpring& spring, double prestress, double* block)
+{
+	for(int r = 0; r < 3; r++)
+		for(int c = 0; c < 3; c++)
+			block[3*r+c] = spring.stiffness*((1-prestress)*spring.direction[r]*spring.direction[c] + (r == c ? prestress : 0));
+}
+
+static void assemble(const std::vector<LinearSpring>& springs, double prestress, StiffnessMatrix& matrix)
+{
+	int count = matrix.pointCount;
+	std::vector<std::vector<int>> neighbours(count);
+	for(auto spring = springs.begin(); spring != springs.end(); spring++) {
+		if(matrix.isFixed[spring->point1] || matrix.isFixed[spring->point2])
+			continue;
+		neighbours[spring->point1].push_back(spring->point2);
+		neighbours[spring->point2].push_back(spring->point1);
+	}
+	matrix.rowStart.assign(count+1, 0);
+	matrix.columns.clear();
+	for(int row = 0; row < count; row++) {
+		matrix.rowStart[row] = (int)matrix.columns.size();
+		if(matrix.isFixed[row])
+			continue;
+		std::vector<int>& list = neighbours[row];
+		list.push_back(row);
+		std::sort(list.begin(), list.end());
+		list.erase(std::unique(list.begin(), list.end()), list.end());
+		matrix.columns.insert(matrix.columns.end(), list.begin(), list.end());
+	}
+	matrix.rowStart[count] = (int)matrix.columns.size();
+	matrix.blocks.assign(9*matrix.columns.size(), 0.0);
+
+	double block[9];
+	for(auto spring = springs.begin(); spring != springs.end(); spring++) {
+		springBlock(*spring, prestress, block);
+		int p1 = spring->point1, p2 = spring->point2;
+		bool free1 = !matrix.isFixed[p1], free2 = !matrix.isFixed[p2];
+		//K_ii and K_jj get the block, K_ij and K_ji subtract it
+		int entries[4] = { free1 ? matrix.find(p1, p1) : -1, free2 ? matrix.find(p2, p2) : -1,
+			free1 && free2 ? matrix.find(p1, p2) : -1, free1 && free2 ? matrix.find(p2, p1) : -1 };
+		for(int i = 0; i < 4; i++) {
+			if(entries[i] < 0)
+				continue;
+			double sign = i < 2 ? 1.0 : -1.0;
+			for(int k = 0; k < 9; k++)
+				matrix.blocks[9*entries[i]+k] += sign*block[k];
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------------------
+// dense helpers, vectors have 3 entries per point
+
+static double dot(const double* a, const double* b, int n)
+{
+	double sum = 0;
+	for(int i = 0; i < n; i++)
+		sum += a[i]*b[i];
+	return sum;
+}
+
+static double massDot(const StiffnessMatrix& matrix, const double* a, const double* b)
+{
+	double sum = 0;
+	for(int i = 0; i < 3*matrix.pointCount; i++)
+		sum += matrix.mass[i]*a[i]*b[i];
+	return sum;
+}
+
+//removes the rigid body motion (mass orthonormal vectors in rigid) from v
+static void projectRigid(const StiffnessMatrix& matrix, const std::vector<std::vector<double>>& rigid, double* v)
+{
+	int n = 3*matrix.pointCount;
+	for(auto mode = rigid.begin(); mode != rigid.end(); mode++) {
+		double c = massDot(matrix, &(*mode)[0], v);
+		for(int i = 0; i < n; i++)
+			v[i] -= c*(*mode)[i];
+	}
+}
+
+//translations and linearised rotations about the centre of mass, mass orthonormalised
+static void buildRigidModes(const StiffnessMatrix& matrix, const std::vector<XMFLOAT3>& positions, std::vector<std::vector<double>>& rigid)
+{
+	int count = matrix.pointCount, n = 3*count;
+	double centre[3] = { 0, 0, 0 }, totalMass = 0;
+	for(int i = 0; i < count; i++) {
+		centre[0] += matrix.mass[3*i]*positions[i].x;
+		centre[1] += matrix.mass[3*i]*positions[i].y;
+		centre[2] += matrix.mass[3*i]*positions[i].z;
+		totalMass += matrix.mass[3*i];
+	}
+	for(int k = 0; k < 3; k++)
+		centre[k] /= totalMass;
+
+	rigid.clear();
+	for(int axis = 0; axis < 6; axis++) {
+		std::vector<double> mode(n, 0.0);
+		for(int i = 0; i < count; i++) {
+			if(axis < 3) {
+				mode[3*i+axis] = 1;
+				continue;
+			}
+			//e_axis x (x - centre)
+			double r[3] = { positions[i].x - centre[0], positions[i].y - centre[1], positions[i].z - centre[2] };
+			int a = axis-3, b = (a+1)%3, c = (a+2)%3;
+			mode[3*i+c] = r[b];
+			mode[3*i+b] = -r[c];
+		}
+		projectRigid(matrix, rigid, &mode[0]);
+		double norm = std::sqrt(massDot(matrix, &mode[0], &mode[0]));
+		//a straight line of points has only two rotations
+		if(norm < 1e-9*std::sqrt(totalMass))
+			continue;
+		for(int i = 0; i < n; i++)
+			mode[i] /= norm;
+		rigid.push_back(mode);
+	}
+}
+
+//jacobi preconditioned conjugate gradients for (K + shift*M) x = rhs, returns the iteration count
+static int solveShifted(const StiffnessMatrix& matrix, ThreadPool& pool, const double* rhs, double* x, std::vector<double>& work)
+{
+	const double tolerance = 1e-10;
+	const int maxIterations = 5000;
+	int n = 3*matrix.pointCount;
+	work.resize(4*n);
+	double* r = &work[0];
+	double* z = r + n;
+	double* p = z + n;
+	double* ap = p + n;
+	for(int i = 0; i < n; i++) {
+		x[i] = 0;
+		r[i] = rhs[i];
+		z[i] = p[i] = matrix.inverseDiagonal[i]*r[i];
+	}
+	double rz = dot(r, z, n), rhsNorm = dot(rhs, rhs, n);
+	if(rhsNorm == 0)
+		return 0;
+	for(int iteration = 0; iteration < maxIterations; iteration++) {
+		matrix.multiply(pool, p, ap, matrix.shift);
+		double alpha = rz / dot(p, ap, n);
+		for(int i = 0; i < n; i++) {
+			x[i] += alpha*p[i];
+			r[i] -= alpha*ap[i];
+		}
+		if(dot(r, r, n) < tolerance*rhsNorm)
+			return iteration+1;
+		for(int i = 0; i < n; i++)
+			z[i] = matrix.inverseDiagonal[i]*r[i];
+		double rzNew = dot(r, z, n);
+		double beta = rzNew / rz;
+		rz = rzNew;
+		for(int i = 0; i < n; i++)
+			p[i] = z[i] + beta*p[i];
+	}
+	return maxIterations;
+}
+
+//cyclic jacobi for a symmetric n x n matrix (row major), a ends up diagonal, vectors holds the eigenvectors as columns
+static void jacobiEigen(int n, std::vector<double>& a, std::vector<double>& vectors)
+{
+	vectors.assign(n*n, 0.0);
+	for(int i = 0; i < n; i++)
+		vectors[i*n+i] = 1;
+	for(int sweep = 0; sweep < 100; sweep++) {
+		double offDiagonal = 0, diagonal = 0;
+		for(int i = 0; i < n; i++) {
+			diagonal += a[i*n+i]*a[i*n+i];
+			for(int j = i+1; j < n; j++)
+				offDiagonal += a[i*n+j]*a[i*n+j];
+		}
+		if(offDiagonal <= 1e-24*diagonal)
+			break;
+		for(int p = 0; p < n; p++) {
+			for(int q = p+1; q < n; q++) {
+				double apq = a[p*n+q];
+				if(std::abs(apq) < 1e-300)
+					continue;
+				double theta = (a[q*n+q] - a[p*n+p]) / (2*apq);
+				double t = (theta >= 0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta*theta + 1));
+				double c = 1 / std::sqrt(t*t + 1), s = t*c;
+				for(int k = 0; k < n; k++) {
+					double akp = a[k*n+p], akq = a[k*n+q];
+					a[k*n+p] = c*akp - s*akq;
+					a[k*n+q] = s*akp + c*akq;
+				}
+				for(int k = 0; k < n; k++) {
+					double apk = a[p*n+k], aqk = a[q*n+k];
+					a[p*n+k] = c*apk - s*aqk;
+					a[q*n+k] = s*apk + c*aqk;
+				}
+				for(int k = 0; k < n; k++) {
+					double vkp = vectors[k*n+p], vkq = vectors[k*n+q];
+					vectors[k*n+p] = c*vkp - s*vkq;
+					vectors[k*n+q] = s*vkp + c*vkq;
+				}
+			}
+		}
+	}
+}
+
+//stiffness z = lambda mass z for small dense symmetric matrices, mass positive definite.
+//values ascending, vectors column i belongs to values[i] and is mass orthonormal
+static bool solveReducedEigenproblem(int n, const std::vector<double>& stiffness, const std::vector<double>& mass, std::vector<double>& values, std::vector<double>& vectors)
+{
+	//mass = L L^T
+	std::vector<double> l(n*n, 0.0);
+	for(int j = 0; j < n; j++) {
+		double s = mass[j*n+j];
+		for(int k = 0; k < j; k++)
+			s -= l[j*n+k]*l[j*n+k];
+		if(s <= 1e-12*std::abs(mass[j*n+j]) || s <= 0)
+			return false;
+		l[j*n+j] = std::sqrt(s);
+		for(int i = j+1; i < n; i++) {
+			double t = mass[i*n+j];
+			for(int k = 0; k < j; k++)
+				t -= l[i*n+k]*l[j*n+k];
+			l[i*n+j] = t / l[j*n+j];
+		}
+	}
+	//c = L^-1 stiffness L^-T, as stiffness is symmetric that's L^-1 (L^-1 stiffness)^T
+	std::vector<double> w(stiffness), c(n*n);
+	for(int col = 0; col < n; col++)
+		for(int i = 0; i < n; i++) {
+			double t = w[i*n+col];
+			for(int k = 0; k < i; k++)
+				t -= l[i*n+k]*w[k*n+col];
+			w[i*n+col] = t / l[i*n+i];
+		}
+	for(int col = 0; col < n; col++)
+		for(int i = 0; i < n; i++) {
+			double t = w[col*n+i];
+			for(int k = 0; k < i; k++)
+				t -= l[i*n+k]*c[k*n+col];
+			c[i*n+col] = t / l[i*n+i];
+		}
+	for(int i = 0; i < n; i++)
+		for(int j = i+1; j < n; j++)
+			c[i*n+j] = c[j*n+i] = 0.5*(c[i*n+j] + c[j*n+i]);
+
+	std::vector<double> v;
+	jacobiEigen(n, c, v);
+	std::vector<int> order(n);
+	for(int i = 0; i < n; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return c[a*n+a] < c[b*n+b]; });
+
+	//back to the original problem: z = L^-T v
+	values.resize(n);
+	vectors.assign(n*n, 0.0);
+	for(int col = 0; col < n; col++) {
+		int src = order[col];
+		values[col] = c[src*n+src];
+		for(int i = n-1; i >= 0; i--) {
+			double t = v[i*n+src];
+			for(int k = i+1; k < n; k++)
+				t -= l[k*n+i]*vectors[k*n+col];
+			vectors[i*n+col] = t / l[i*n+i];
+		}
+	}
+	return true;
+}
+
+//derivative of the spring stiffness in direction a applied to b, symmetrised in a and b.
+//with P = I - d*d^T: k/L*((1-prestress)*(Pa (d.b) + d (Pa.b)) + (d.a) Pb)
+static void stiffnessDerivative(const LinearSpring& spring, double prestress, const double* a, const double* b, double* result)
+{
+	const double* d = spring.direction;
+	double scale = spring.stiffness / spring.length;
+	double da = d[0]*a[0] + d[1]*a[1] + d[2]*a[2], db = d[0]*b[0] + d[1]*b[1] + d[2]*b[2];
+	double pa[3], pb[3];
+	for(int k = 0; k < 3; k++) {
+		pa[k] = a[k] - d[k]*da;
+		pb[k] = b[k] - d[k]*db;
+	}
+	double papb = pa[0]*pb[0] + pa[1]*pb[1] + pa[2]*pb[2];
+	for(int k = 0; k < 3; k++) {
+		double ab = (1-prestress)*(pa[k]*db + d[k]*papb) + da*pb[k];
+		double ba = (1-prestress)*(pb[k]*da + d[k]*papb) + db*pa[k];
+		result[k] = 0.5*scale*(ab + ba);
+	}
+}
+
+static unsigned long long hashBytes(unsigned long long hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for(size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+//-------------------------------------------------------------------------------------------------
+// ModalSubspace
+
+ModalSubspace::Progress::Progress()
+{
+	percent = 0;
+	cancel = false;
+}
+
+static void reportProgress(ModalSubspace::Progress* progress, int percent)
+{
+	if(progress)
+		progress->percent = percent;
+}
+
+static bool isCancelled(ModalSubspace::Progress* progress)
+{
+	return progress && progress->cancel;
+}
+
+ModalSubspace::ModalSubspace()
+{
+	modeCount = 16;
+	derivativeModes = 4;
+	prestress = 0.05f;
+	dampingRatio = 0.02f;
+	basisColumns = 0;
+	solverIterations = 0;
+	loadedFromCache = false;
+	buildSeconds = 0.f;
+	lowestFrequency = 0.f;
+	highestFrequency = 0.f;
+	pointCount = 0;
+	builtModes = 0;
+	builtDerivatives = 0;
+	transitionStep = 0.f;
+	transitionDamping = 0.f;
+	stepCount = 0;
+	reconstructedStep = -1;
+	reconstructedAlpha = 0.f;
+}
+
+bool ModalSubspace::isBuilt()
+{
+	return builtModes > 0;
+}
+
+void ModalSubspace::clear()
+{
+	pointCount = 0;
+	builtModes = 0;
+	builtDerivatives = 0;
+	basisColumns = 0;
+	restPositions.clear();
+	masses.clear();
+	basis.clear();
+	eigenvalues.clear();
+	modalGravity.clear();
+	q.clear();
+	qPrevious.clear();
+	qVelocity.clear();
+	modalForce.clear();
+	transition.clear();
+	transitionStep = 0.f;
+	reconstructedStep = -1;
+}
+
+void ModalSubspace::reset()
+{
+	q.assign(builtModes, 0.f);
+	qPrevious.assign(builtModes, 0.f);
+	qVelocity.assign(builtModes, 0.f);
+	modalForce.assign(builtModes, 0.f);
+	weights.assign(basisColumns, 0.f);
+	weightRates.assign(basisColumns, 0.f);
+	stepCount = 0;
+	reconstructedStep = -1;
+}
+
+bool ModalSubspace::build(const SpringNetwork& network, ThreadPool& pool, const std::string& cachePath, Progress* progress)
+{
+	auto buildBegin = std::chrono::high_resolution_clock::now();
+	clear();
+	reportProgress(progress, 0);
+	loadedFromCache = false;
+	solverIterations = 0;
+	int count = (int)network.points.size();
+	if(count == 0 || network.springs.empty() || modeCount < 1) {
+		std::cout << "ModalSubspace: nothing to build, the network is empty" << std::endl;
+		return false;
+	}
+
+	//linearise around the current state, it is taken as the rest state
+	const SpringPoint* first = &network.points[0];
+	StiffnessMatrix matrix;
+	matrix.pointCount = count;
+	matrix.mass.resize(3*count);
+	matrix.isFixed.resize(count);
+	restPositions.resize(count);
+	masses.resize(count);
+	bool anyFixed = false;
+	for(int i = 0; i < count; i++) {
+		const SpringPoint& point = network.points[i];
+		restPositions[i] = point.gp_position;
+		masses[i] = point.gp_mass;
+		matrix.isFixed[i] = point.gp_isStatic ? 1 : 0;
+		matrix.mass[3*i] = matrix.mass[3*i+1] = matrix.mass[3*i+2] = point.gp_isStatic ? 0.0 : point.gp_mass;
+		anyFixed = anyFixed || point.gp_isStatic;
+	}
+	std::vector<LinearSpring> springs;
+	springs.reserve(network.springs.size());
+	for(auto s = network.springs.begin(); s != network.springs.end(); s++) {
+		LinearSpring spring;
+		spring.point1 = (int)(s->gs_point1 - first);
+		spring.point2 = (int)(s->gs_point2 - first);
+		spring.stiffness = s->gs_stiffness;
+		XMFLOAT3 p1 = s->gs_point1->gp_position, p2 = s->gs_point2->gp_position;
+		double delta[3] = { p2.x - p1.x, p2.y - p1.y, p2.z - p1.z };
+		spring.length = std::sqrt(delta[0]*delta[0] + delta[1]*delta[1] + delta[2]*delta[2]);
+		if(spring.length < 1e-9 || spring.stiffness <= 0)
+			continue;
+		for(int k = 0; k < 3; k++)
+			spring.direction[k] = delta[k] / spring.length;
+		springs.push_back(spring);
+	}
+
+	unsigned long long key = 14695981039346656037ull;
+	int settings[3] = { 1, modeCount, derivativeModes };
+	key = hashBytes(key, settings, sizeof(settings));
+	key = hashBytes(key, &prestress, sizeof(prestress));
+	key = hashBytes(key, &count, sizeof(count));
+	key = hashBytes(key, &restPositions[0], count*sizeof(XMFLOAT3));
+	key = hashBytes(key, &masses[0], count*sizeof(float));
+	key = hashBytes(key, &matrix.isFixed[0], count);
+	for(auto spring = springs.begin(); spring != springs.end(); spring++) {
+		key = hashBytes(key, &spring->point1, 2*sizeof(int));
+		key = hashBytes(key, &spring->stiffness, 2*sizeof(double));
+	}
+
+	pointCount = count;
+	if(!cachePath.empty() && loadCache(cachePath, key)) {
+		loadedFromCache = true;
+	}
+	else {
+		assemble(springs, prestress, matrix);
+		int n = 3*count;
+		int freeDofs = 0;
+		double diagonalSum = 0, massSum = 0;
+		for(int i = 0; i < count; i++) {
+			if(matrix.isFixed[i])
+				continue;
+			freeDofs += 3;
+			const double* b = &matrix.blocks[9*matrix.find(i, i)];
+			diagonalSum += b[0] + b[4] + b[8];
+			massSum += 3*matrix.mass[3*i];
+		}
+		if(freeDofs == 0 || diagonalSum <= 0) {
+			std::cout << "ModalSubspace: the network has no free points or no stiffness" << std::endl;
+			clear();
+			return false;
+		}
+		//omega^2 of a single point against its springs, the scale everything is measured against
+		double typicalEigenvalue = diagonalSum / massSum;
+		matrix.shift = 1e-4*typicalEigenvalue;
+		matrix.inverseDiagonal.assign(n, 0.0);
+		for(int i = 0; i < count; i++) {
+			if(matrix.isFixed[i])
+				continue;
+			const double* b = &matrix.blocks[9*matrix.find(i, i)];
+			for(int k = 0; k < 3; k++)
+				matrix.inverseDiagonal[3*i+k] = 1.0 / (b[4*k] + matrix.shift*matrix.mass[3*i]);
+		}
+		std::vector<std::vector<double>> rigid;
+		if(!anyFixed)
+			buildRigidModes(matrix, restPositions, rigid);
+
+		//shift-invert lanczos: the krylov space of (K + shift*M)^-1 M is built one solve per vector,
+		//fully reorthogonalised in the mass inner product, and the modes are the rayleigh-ritz vectors
+		//of K in it. The lowest modes converge first, the space grows until their residuals are small
+		int available = freeDofs - (int)rigid.size();
+		int wanted = std::min(modeCount, available);
+		if(wanted < 1) {
+			std::cout << "ModalSubspace: the network has no deformation modes" << std::endl;
+			clear();
+			return false;
+		}
+		int limit = std::min(available, 3*wanted + 20);
+		int size = std::min(limit, 2*wanted + 8);
+		std::vector<double> krylov(n*limit), reducedStiffness(limit*limit), reducedMass(limit*limit);
+		std::vector<double> w(n), kw(n), work, values, vectors;
+		int built = 0;
+		bool exhausted = false;
+		std::vector<int> modes;
+		std::vector<double> x;
+		while(true) {
+			for(; built < size && !exhausted; built++) {
+				if(isCancelled(progress)) {
+					clear();
+					return false;
+				}
+				if(built == 0) {
+					unsigned int seed = 12345;
+					for(int i = 0; i < n; i++) {
+						seed = seed*1664525u + 1013904223u;
+						w[i] = matrix.isFixed[i/3] ? 0.0 : (double)(seed >> 8) / (1 << 24) - 0.5;
+					}
+				}
+				else {
+					const double* previous = &krylov[(built-1)*n];
+					for(int i = 0; i < n; i++)
+						kw[i] = matrix.mass[i]*previous[i];
+					solverIterations += solveShifted(matrix, pool, &kw[0], &w[0], work);
+				}
+				if(!rigid.empty())
+					projectRigid(matrix, rigid, &w[0]);
+				double before = std::sqrt(massDot(matrix, &w[0], &w[0]));
+				//classical gram-schmidt twice is enough to keep the basis orthogonal
+				for(int pass = 0; pass < 2; pass++)
+					for(int j = 0; j < built; j++) {
+						const double* q = &krylov[j*n];
+						double c = massDot(matrix, q, &w[0]);
+						for(int i = 0; i < n; i++)
+							w[i] -= c*q[i];
+					}
+				double norm = std::sqrt(massDot(matrix, &w[0], &w[0]));
+				if(norm <= 1e-10*before || norm == 0) {
+					//the space is invariant, all modes it can hold are exact
+					exhausted = true;
+					break;
+				}
+				double* q = &krylov[built*n];
+				for(int i = 0; i < n; i++)
+					q[i] = w[i] / norm;
+				matrix.multiply(pool, q, &kw[0], 0.0);
+				for(int j = 0; j <= built; j++) {
+					reducedStiffness[j*limit+built] = reducedStiffness[built*limit+j] = dot(&krylov[j*n], &kw[0], n);
+					reducedMass[j*limit+built] = reducedMass[built*limit+j] = massDot(matrix, &krylov[j*n], q);
+				}
+				//the space rarely grows to its limit, so this is a lower bound
+				reportProgress(progress, 80*(built+1)/limit);
+			}
+			size = built;
+			if(size == 0) {
+				std::cout << "ModalSubspace: the network has no deformation modes" << std::endl;
+				clear();
+				return false;
+			}
+			std::vector<double> stiffnessBlock(size*size), massBlock(size*size);
+			for(int a = 0; a < size; a++)
+				for(int b = 0; b < size; b++) {
+					stiffnessBlock[a*size+b] = reducedStiffness[a*limit+b];
+					massBlock[a*size+b] = reducedMass[a*limit+b];
+				}
+			if(!solveReducedEigenproblem(size, stiffnessBlock, massBlock, values, vectors)) {
+				std::cout << "ModalSubspace: the lanczos basis lost rank, try fewer modes" << std::endl;
+				clear();
+				return false;
+			}
+
+			//modes left at (numerically) zero stiffness can't be simulated as oscillators
+			modes.clear();
+			for(int i = 0; i < size && (int)modes.size() < wanted; i++)
+				if(values[i] > 1e-9*typicalEigenvalue)
+					modes.push_back(i);
+			x.assign(n*modes.size(), 0.0);
+			bool converged = true;
+			for(int m = 0; m < (int)modes.size(); m++) {
+				double* xm = &x[m*n];
+				for(int k = 0; k < size; k++) {
+					double c = vectors[k*size+modes[m]];
+					const double* q = &krylov[k*n];
+					for(int i = 0; i < n; i++)
+						xm[i] += c*q[i];
+				}
+				//|K x - lambda M x| relative to |lambda M x|
+				matrix.multiply(pool, xm, &kw[0], 0.0);
+				double residual = 0, reference = 0;
+				for(int i = 0; i < n; i++) {
+					double mx = values[modes[m]]*matrix.mass[i]*xm[i];
+					residual += (kw[i] - mx)*(kw[i] - mx);
+					reference += mx*mx;
+				}
+				converged = converged && residual <= 1e-8*reference;
+			}
+			if((converged && (int)modes.size() == wanted) || exhausted || size >= limit)
+				break;
+			size = std::min(limit, size + wanted + 8);
+		}
+
+		if(modes.empty()) {
+			std::cout << "ModalSubspace: no mode with stiffness found, flat networks need some prestress" << std::endl;
+			clear();
+			return false;
+		}
+		builtModes = (int)modes.size();
+		builtDerivatives = std::min(std::max(derivativeModes, 0), builtModes);
+		basisColumns = builtModes + builtDerivatives*(builtDerivatives+1)/2;
+		eigenvalues.resize(builtModes);
+		for(int i = 0; i < builtModes; i++)
+			eigenvalues[i] = (float)values[modes[i]];
+		std::vector<double>().swap(krylov);
+
+		//modal derivatives psi_ij = -(K + shift*M)^-1 (dK/du[phi_i] phi_j)
+		std::vector<int> pairFirst, pairSecond;
+		for(int i = 0; i < builtDerivatives; i++)
+			for(int j = i; j < builtDerivatives; j++) {
+				pairFirst.push_back(i);
+				pairSecond.push_back(j);
+			}
+		std::vector<double> derivatives(n*pairFirst.size());
+		std::vector<int> derivativeIterations(pairFirst.size(), 0);
+		std::atomic<int> pairsDone(0);
+		pool.parallelFor((int)pairFirst.size(), 1, [&](int begin, int end) {
+			std::vector<double> rhs(n), work;
+			for(int pair = begin; pair < end && !isCancelled(progress); pair++) {
+				const double* a = &x[pairFirst[pair]*n];
+				const double* b = &x[pairSecond[pair]*n];
+				std::fill(rhs.begin(), rhs.end(), 0.0);
+				for(auto spring = springs.begin(); spring != springs.end(); spring++) {
+					int p1 = spring->point1, p2 = spring->point2;
+					double aRel[3], bRel[3], g[3];
+					for(int k = 0; k < 3; k++) {
+						aRel[k] = a[3*p2+k] - a[3*p1+k];
+						bRel[k] = b[3*p2+k] - b[3*p1+k];
+					}
+					stiffnessDerivative(*spring, prestress, aRel, bRel, g);
+					//same sign pattern as K: -g on the first point, +g on the second, the rhs is negated
+					for(int k = 0; k < 3; k++) {
+						if(!matrix.isFixed[p1])
+							rhs[3*p1+k] += g[k];
+						if(!matrix.isFixed[p2])
+							rhs[3*p2+k] -= g[k];
+					}
+				}
+				if(!rigid.empty())
+					projectRigid(matrix, rigid, &rhs[0]);
+				derivativeIterations[pair] = solveShifted(matrix, pool, &rhs[0], &derivatives[pair*n], work);
+				if(!rigid.empty())
+					projectRigid(matrix, rigid, &derivatives[pair*n]);
+				reportProgress(progress, 80 + 20*(++pairsDone)/(int)pairFirst.size());
+			}
+		});
+		if(isCancelled(progress)) {
+			clear();
+			return false;
+		}
+		for(int pair = 0; pair < (int)pairFirst.size(); pair++)
+			solverIterations += derivativeIterations[pair];
+
+		basis.resize(n*basisColumns);
+		for(int i = 0; i < n; i++) {
+			float* row = &basis[i*basisColumns];
+			for(int m = 0; m < builtModes; m++)
+				row[m] = (float)x[m*n+i];
+			for(int pair = 0; pair < (int)pairFirst.size(); pair++)
+				row[builtModes+pair] = (float)derivatives[pair*n+i];
+		}
+		if(!cachePath.empty())
+			saveCache(cachePath, key);
+	}
+
+	computeModalGravity();
+	reset();
+	lowestFrequency = std::sqrt(eigenvalues.front()) / (2*XM_PI);
+	highestFrequency = std::sqrt(eigenvalues.back()) / (2*XM_PI);
+	auto buildEnd = std::chrono::high_resolution_clock::now();
+	buildSeconds = std::chrono::duration_cast<std::chrono::milliseconds>(buildEnd-buildBegin).count()/1000.0f;
+	reportProgress(progress, 100);
+	return true;
+}
+
+void ModalSubspace::project(const SpringNetwork& network)
+{
+	if(!isBuilt() || (int)network.points.size() != pointCount)
+		return;
+	reset();
+	//the modes are mass orthonormal, so q = phi^T M u. The derivative columns follow from q,
+	//whatever the linear modes can't hold is lost
+	for(int i = 0; i < pointCount; i++) {
+		const SpringPoint& point = network.points[i];
+		XMFLOAT3 rest = restPositions[i];
+		float offset[3] = { point.gp_position.x - rest.x, point.gp_position.y - rest.y, point.gp_position.z - rest.z };
+		float velocity[3] = { point.gp_velocity.x, point.gp_velocity.y, point.gp_velocity.z };
+		for(int k = 0; k < 3; k++) {
+			const float* row = &basis[(3*i+k)*basisColumns];
+			for(int m = 0; m < builtModes; m++) {
+				q[m] += masses[i]*row[m]*offset[k];
+				qVelocity[m] += masses[i]*row[m]*velocity[k];
+			}
+		}
+	}
+	qPrevious = q;
+}
+
+void ModalSubspace::computeModalGravity()
+{
+	//phi^T M (0,1,0), static points have no row in the basis anyway
+	modalGravity.assign(builtModes, 0.f);
+	for(int i = 0; i < pointCount; i++) {
+		const float* row = &basis[(3*i+1)*basisColumns];
+		for(int m = 0; m < builtModes; m++)
+			modalGravity[m] += masses[i]*row[m];
+	}
+}
+
+void ModalSubspace::computeTransition(float deltaTime)
+{
+	//exact solution of e'' + 2 zeta omega e' + omega^2 e = 0 over one step
+	double zeta = std::min(std::max((double)dampingRatio, 0.0), 0.999);
+	transition.resize(4*builtModes);
+	for(int m = 0; m < builtModes; m++) {
+		double omega = std::sqrt((double)eigenvalues[m]);
+		double omegaDamped = omega*std::sqrt(1 - zeta*zeta);
+		double decay = std::exp(-zeta*omega*deltaTime);
+		double c = std::cos(omegaDamped*deltaTime), s = std::sin(omegaDamped*deltaTime);
+		transition[4*m] = (float)(decay*(c + zeta*omega/omegaDamped*s));
+		transition[4*m+1] = (float)(decay*s/omegaDamped);
+		transition[4*m+2] = (float)(-decay*omega*omega/omegaDamped*s);
+		transition[4*m+3] = (float)(decay*(c - zeta*omega/omegaDamped*s));
+	}
+	transitionStep = deltaTime;
+	transitionDamping = dampingRatio;
+}
+
+void ModalSubspace::step(float deltaTime, float gravity)
+{
+	if(!isBuilt())
+		return;
+	if(deltaTime != transitionStep || dampingRatio != transitionDamping)
+		computeTransition(deltaTime);
+	for(int m = 0; m < builtModes; m++) {
+		//the force is constant over the step, oscillate around its static response
+		float rest = (modalGravity[m]*gravity + modalForce[m]) / eigenvalues[m];
+		float offset = q[m] - rest, velocity = qVelocity[m];
+		const float* t = &transition[4*m];
+		qPrevious[m] = q[m];
+		q[m] = rest + t[0]*offset + t[1]*velocity;
+		qVelocity[m] = t[2]*offset + t[3]*velocity;
+		modalForce[m] = 0.f;
+	}
+	stepCount++;
+}
+
+void ModalSubspace::addForce(int point, XMFLOAT3 force)
+{
+	if(!isBuilt() || point < 0 || point >= pointCount)
+		return;
+	const float* row = &basis[3*point*basisColumns];
+	for(int m = 0; m < builtModes; m++)
+		modalForce[m] += row[m]*force.x + row[basisColumns+m]*force.y + row[2*basisColumns+m]*force.z;
+}
+
+void ModalSubspace::computeWeights(float alpha)
+{
+	for(int m = 0; m < builtModes; m++) {
+		weights[m] = qPrevious[m] + alpha*(q[m] - qPrevious[m]);
+		weightRates[m] = qVelocity[m];
+	}
+	//1/2 sum_ij psi_ij q_i q_j with psi_ij = psi_ji, so the off diagonal pairs count once
+	int column = builtModes;
+	for(int i = 0; i < builtDerivatives; i++)
+		for(int j = i; j < builtDerivatives; j++, column++) {
+			float scale = i == j ? 0.5f : 1.f;
+			weights[column] = scale*weights[i]*weights[j];
+			weightRates[column] = scale*(weightRates[i]*weights[j] + weights[i]*weightRates[j]);
+		}
+}
+
+XMFLOAT3 ModalSubspace::getPosition(int point)
+{
+	if(!isBuilt() || point < 0 || point >= pointCount)
+		return XMFLOAT3(0,0,0);
+	computeWeights(1.f);
+	float offset[3];
+	for(int k = 0; k < 3; k++) {
+		const float* row = &basis[(3*point+k)*basisColumns];
+		float sum = 0.f;
+		for(int c = 0; c < basisColumns; c++)
+			sum += row[c]*weights[c];
+		offset[k] = sum;
+	}
+	XMFLOAT3 rest = restPositions[point];
+	return XMFLOAT3(rest.x + offset[0], rest.y + offset[1], rest.z + offset[2]);
+}
+
+void ModalSubspace::reconstruct(SpringNetwork& network, ThreadPool& pool, float alpha)
+{
+	if(!isBuilt() || (int)network.points.size() != pointCount)
+		return;
+	if(reconstructedStep == stepCount && reconstructedAlpha == alpha)
+		return;
+	computeWeights(alpha);
+	pool.parallelFor(pointCount, 256, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			float offset[3], velocity[3];
+			for(int k = 0; k < 3; k++) {
+				const float* row = &basis[(3*i+k)*basisColumns];
+				float sum = 0.f, rate = 0.f;
+				for(int c = 0; c < basisColumns; c++) {
+					sum += row[c]*weights[c];
+					rate += row[c]*weightRates[c];
+				}
+				offset[k] = sum;
+				velocity[k] = rate;
+			}
+			SpringPoint& point = network.points[i];
+			XMFLOAT3 rest = restPositions[i];
+			point.gp_position = XMFLOAT3(rest.x + offset[0], rest.y + offset[1], rest.z + offset[2]);
+			point.gp_prevPosition = point.gp_position;
+			point.gp_velocity = XMFLOAT3(velocity[0], velocity[1], velocity[2]);
+		}
+	});
+	reconstructedStep = stepCount;
+	reconstructedAlpha = alpha;
+}
+
+//-------------------------------------------------------------------------------------------------
+// basis cache
+
+static const char cacheMagic[4] = { 'M', 'O', 'D', '1' };
+
+bool ModalSubspace::loadCache(const std::string& path, unsigned long long key)
+{
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if(!file)
+		return false;
+	char magic[4];
+	unsigned long long fileKey;
+	int sizes[3];
+	file.read(magic, 4);
+	file.read((char*)&fileKey, sizeof(fileKey));
+	file.read((char*)sizes, sizeof(sizes));
+	if(!file || !std::equal(magic, magic+4, cacheMagic) || fileKey != key || sizes[0] != pointCount || sizes[1] < 1) {
+		std::cout << "ModalSubspace: " << path << " is for another network or settings, rebuilding" << std::endl;
+		return false;
+	}
+	builtModes = sizes[1];
+	builtDerivatives = sizes[2];
+	basisColumns = builtModes + builtDerivatives*(builtDerivatives+1)/2;
+	eigenvalues.resize(builtModes);
+	basis.resize(3*pointCount*basisColumns);
+	file.read((char*)&eigenvalues[0], eigenvalues.size()*sizeof(float));
+	file.read((char*)&basis[0], basis.size()*sizeof(float));
+	if(!file) {
+		std::cout << "ModalSubspace: " << path << " is truncated, rebuilding" << std::endl;
+		builtModes = builtDerivatives = basisColumns = 0;
+		eigenvalues.clear();
+		basis.clear();
+		return false;
+	}
+	return true;
+}
+
+void ModalSubspace::saveCache(const std::string& path, unsigned long long key)
+{
+	std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	int sizes[3] = { pointCount, builtModes, builtDerivatives };
+	file.write(cacheMagic, 4);
+	file.write((const char*)&key, sizeof(key));
+	file.write((const char*)sizes, sizeof(sizes));
+	file.write((const char*)&eigenvalues[0], eigenvalues.size()*sizeof(float));
+	file.write((const char*)&basis[0], basis.size()*sizeof(float));
+	if(!file)
+		std::cout << "ModalSubspace: can't write " << path << std::endl;
+}
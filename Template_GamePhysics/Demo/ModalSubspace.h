@@ -0,0 +1,114 @@
+#pragma once
+#ifndef ModalSubspace_HEADER
+#define ModalSubspace_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include "SpringNetwork.h"
+#include "ThreadPool.h"
+
+// Reduced order (modal) simulation of a spring network.
+// build() linearises the network around its current state, which is taken as the rest state, and
+// computes the lowest vibration modes with shift-invert Lanczos (sparse 3x3 block matrix, one CG
+// solve per Krylov vector). Modal derivatives of the first modes are added so that larger
+// deformations bend instead of stretching linearly: u = sum phi_i q_i + 1/2 sum psi_ij q_i q_j.
+// step() advances the decoupled modal oscillators exactly, so it costs O(modes) no matter how many
+// points the network has and is stable for any step size. Positions are only rebuilt by
+// reconstruct() (drawing) or getPosition() (single point queries).
+// Static points are kept in place. Networks without static points lose their rigid body modes,
+// the object deforms but stays where it is.
+// The basis is written to / read from cachePath, the file stores a hash of the network and the
+// settings so a stale cache is just rebuilt.
+// A big basis takes a while, build() can run on a worker thread with a Progress the caller polls
+// (and sets cancel in to give the build up). project() then starts the modes from wherever the
+// full network got to in the meantime.
+class ModalSubspace
+{
+public:
+	//settings, used by the next build()
+	int modeCount;
+	//modal derivatives are computed for the first derivativeModes modes, n(n+1)/2 extra columns
+	int derivativeModes;
+	//springs are linearised as if under a tension of prestress*stiffness, this gives flat networks
+	//(the cloth) stiffness across their plane, which a plain linearisation doesn't have
+	float prestress;
+	//per mode damping ratio, can be changed at any time
+	float dampingRatio;
+
+	//statistics of the last build
+	int basisColumns;
+	int solverIterations;
+	bool loadedFromCache;
+	float buildSeconds;
+	//lowest and highest mode frequency in Hz
+	float lowestFrequency;
+	float highestFrequency;
+
+	//shared with a build() running on another thread
+	struct Progress
+	{
+		//0 - 100
+		std::atomic<int> percent;
+		//the build returns false as soon as it sees this
+		std::atomic<bool> cancel;
+
+		Progress();
+	};
+
+	ModalSubspace();
+
+	//returns false and prints the reason if no basis could be computed (or returns false quietly when cancelled)
+	bool build(const SpringNetwork& network, ThreadPool& pool, const std::string& cachePath, Progress* progress = nullptr);
+	bool isBuilt();
+	void clear();
+	//back to the rest state
+	void reset();
+	//takes the modal state from the points (positions and velocities) of the network the basis was
+	//built for, projected onto the linear modes
+	void project(const SpringNetwork& network);
+
+	void step(float deltaTime, float gravity);
+	//added to the next step only
+	void addForce(int point, XMFLOAT3 force);
+
+	XMFLOAT3 getPosition(int point);
+	//writes the state interpolated between the last two steps into the points (position and
+	//previous position both, so getRenderPosition returns it for any alpha), skipped if nothing changed
+	void reconstruct(SpringNetwork& network, ThreadPool& pool, float alpha);
+
+private:
+	int pointCount;
+	int builtModes;
+	int builtDerivatives;
+	std::vector<XMFLOAT3> restPositions;
+	std::vector<float> masses;
+	//row major, basisColumns floats per degree of freedom: modes first, then psi_ij for i <= j
+	std::vector<float> basis;
+	std::vector<float> eigenvalues;
+	//mass weighted projection of a unit gravity
+	std::vector<float> modalGravity;
+
+	std::vector<float> q, qPrevious, qVelocity, modalForce;
+	//exact damped oscillator step per mode (4 coefficients), valid for transitionStep / transitionDamping
+	std::vector<float> transition;
+	float transitionStep;
+	float transitionDamping;
+
+	int stepCount;
+	int reconstructedStep;
+	float reconstructedAlpha;
+	std::vector<float> weights, weightRates;
+
+	void computeModalGravity();
+	void computeTransition(float deltaTime);
+	//weights of all basis columns (and their rates) for the state alpha of the way through the last step
+	void computeWeights(float alpha);
+	bool loadCache(const std::string& path, unsigned long long key);
+	void saveCache(const std::string& path, unsigned long long key);
+};
+
+#endif
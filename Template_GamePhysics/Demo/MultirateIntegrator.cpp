@@ -0,0 +1,132 @@
+#include "MultirateIntegrator.h"
+
+#include <algorithm>
+#include <cmath>
+
+MultirateIntegrator::MultirateIntegrator()
+{
+	stabilityLimit = 0.3f;
+	lastSubSteps = 0;
+	fastSpringCount = 0;
+	fastPointCount = 0;
+	partitionRevision = -1;
+	partitionStep = 0.f;
+	partitionLimit = 0.f;
+	subSteps = 1;
+}
+
+static float inverseMass(const SpringPoint& point)
+{
+	return point.gp_isStatic ? 0.f : 1.f/point.gp_mass;
+}
+
+void MultirateIntegrator::partition(SpringNetwork& network, float deltaTime)
+{
+	int pointCount = (int)network.points.size();
+	std::vector<char> isFast(pointCount, 0);
+	//summed fast stiffness per point, the sub-step has to be stable for the stiffest point, not the stiffest spring
+	std::vector<float> fastStiffness(pointCount, 0.f);
+	fastSprings.clear();
+	slowSprings.clear();
+	for(int i = 0; i < (int)network.springs.size(); i++) {
+		Spring& spring = network.springs[i];
+		float omega = std::sqrt(spring.gs_stiffness*(inverseMass(*spring.gs_point1) + inverseMass(*spring.gs_point2)));
+		if(omega*deltaTime <= stabilityLimit) {
+			slowSprings.push_back(i);
+			continue;
+		}
+		fastSprings.push_back(i);
+		int p1 = network.getPointIndex(spring.gs_point1), p2 = network.getPointIndex(spring.gs_point2);
+		isFast[p1] = isFast[p2] = 1;
+		fastStiffness[p1] += spring.gs_stiffness;
+		fastStiffness[p2] += spring.gs_stiffness;
+	}
+
+	fastPoints.clear();
+	slowPoints.clear();
+	float maxOmega = 0.f;
+	for(int i = 0; i < pointCount; i++) {
+		if(!isFast[i]) {
+			slowPoints.push_back(i);
+			continue;
+		}
+		fastPoints.push_back(i);
+		maxOmega = std::max(maxOmega, std::sqrt(fastStiffness[i]*inverseMass(network.points[i])));
+	}
+	//verlet is stable up to omega*h = 2, the point sum already covers the neighbouring springs
+	subSteps = std::max(1, (int)std::ceil(maxOmega*deltaTime / (2.f*stabilityLimit)));
+
+	fastSpringCount = (int)fastSprings.size();
+	fastPointCount = (int)fastPoints.size();
+	partitionRevision = network.topologyRevision;
+	partitionStep = deltaTime;
+	partitionLimit = stabilityLimit;
+}
+
+void MultirateIntegrator::slowKick(SpringNetwork& network, float halfStep, float gravity)
+{
+	for(auto point = network.points.begin(); point != network.points.end(); point++)
+		point->resetForces();
+	for(auto s = slowSprings.begin(); s != slowSprings.end(); s++) {
+		network.springs[*s].computeElasticForces();
+		network.springs[*s].computeDampingForces();
+	}
+	for(auto point = network.points.begin(); point != network.points.end(); point++) {
+		if(point->gp_isStatic)
+			continue;
+		point->addGravity(gravity);
+		point->computeAcceleration();
+		point->IntegrateVelocity(halfStep);
+	}
+}
+
+void MultirateIntegrator::computeFastForces(SpringNetwork& network)
+{
+	for(auto p = fastPoints.begin(); p != fastPoints.end(); p++)
+		network.points[*p].resetForces();
+	for(auto s = fastSprings.begin(); s != fastSprings.end(); s++) {
+		network.springs[*s].computeElasticForces();
+		network.springs[*s].computeDampingForces();
+	}
+}
+
+void MultirateIntegrator::fastKick(SpringNetwork& network, float halfStep)
+{
+	for(auto p = fastPoints.begin(); p != fastPoints.end(); p++) {
+		SpringPoint& point = network.points[*p];
+		point.computeAcceleration();
+		point.IntegrateVelocity(halfStep);
+	}
+}
+
+void MultirateIntegrator::step(SpringNetwork& network, float deltaTime, float gravity)
+{
+	if(network.points.empty() || deltaTime <= 0.f)
+		return;
+	if(partitionRevision != network.topologyRevision || partitionStep != deltaTime || partitionLimit != stabilityLimit)
+		partition(network, deltaTime);
+
+	slowKick(network, 0.5f*deltaTime, gravity);
+
+	//points without fast springs feel no force during the sub-cycles, one drift covers all of them
+	for(auto p = slowPoints.begin(); p != slowPoints.end(); p++)
+		network.points[*p].IntegratePosition(deltaTime);
+
+	//velocity verlet on the fast group, the force at the end of one sub-step starts the next
+	float h = deltaTime / subSteps;
+	if(!fastPoints.empty()) {
+		computeFastForces(network);
+		for(int sub = 0; sub < subSteps; sub++) {
+			fastKick(network, 0.5f*h);
+			for(auto p = fastPoints.begin(); p != fastPoints.end(); p++)
+				network.points[*p].IntegratePosition(h);
+			computeFastForces(network);
+			fastKick(network, 0.5f*h);
+		}
+	}
+	lastSubSteps = fastPoints.empty() ? 0 : subSteps;
+
+	slowKick(network, 0.5f*deltaTime, gravity);
+	for(auto point = network.points.begin(); point != network.points.end(); point++)
+		point->resetForces();
+}
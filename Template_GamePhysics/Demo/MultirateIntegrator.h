@@ -0,0 +1,51 @@
+#pragma once
+#ifndef MultirateIntegrator_HEADER
+#define MultirateIntegrator_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "SpringNetwork.h"
+
+// Multirate (r-RESPA style) integrator for spring networks.
+// Springs are split by their frequency sqrt(k*(1/m1+1/m2)): springs that would be unstable or
+// inaccurate at the frame step are "fast" and sub-cycled with velocity Verlet, everything else
+// (soft springs, gravity) is "slow" and applied as two half step velocity kicks around the
+// sub-cycles. Interface points feel the slow forces through the kicks and the fast ones in every
+// sub-step, so both groups see each other consistently. Points without fast springs just drift
+// over the whole step, so the sub-cycles only cost as much as the fast springs and their points.
+class MultirateIntegrator
+{
+public:
+	//largest omega*h a spring may see, springs above it at the frame step are sub-cycled
+	float stabilityLimit;
+
+	//statistics
+	int lastSubSteps;
+	int fastSpringCount;
+	int fastPointCount;
+
+	MultirateIntegrator();
+
+	//advances the network by deltaTime, forces are reset afterwards and every spring's current length is up to date
+	void step(SpringNetwork& network, float deltaTime, float gravity);
+
+private:
+	//partition, redone when the topology, the step or the limit change
+	int partitionRevision;
+	float partitionStep;
+	float partitionLimit;
+	std::vector<int> fastSprings;
+	std::vector<int> slowSprings;
+	std::vector<int> fastPoints;
+	std::vector<int> slowPoints;
+	int subSteps;
+
+	void partition(SpringNetwork& network, float deltaTime);
+	void slowKick(SpringNetwork& network, float halfStep, float gravity);
+	void computeFastForces(SpringNetwork& network);
+	void fastKick(SpringNetwork& network, float halfStep);
+};
+
+#endif
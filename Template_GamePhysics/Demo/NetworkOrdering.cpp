@@ -0,0 +1,190 @@
+#include "NetworkOrdering.h"
+
+#include <algorithm>
+
+NetworkOrdering::NetworkOrdering()
+{
+	bandwidthBefore = bandwidthAfter = 0;
+	cacheMissesBefore = cacheMissesAfter = 0;
+}
+
+void NetworkOrdering::reorder(SpringNetwork& network, Method method, std::vector<int>& newIndex)
+{
+	bandwidthBefore = computeBandwidth(network);
+	cacheMissesBefore = estimateCacheMisses(network);
+
+	std::vector<int> order;
+	if(method == HILBERT_CURVE)
+		computeHilbert(network, order);
+	else
+		computeReverseCuthillMcKee(network, order);
+	newIndex.resize(order.size());
+	for(int i = 0; i < (int)order.size(); i++)
+		newIndex[order[i]] = i;
+	network.permutePoints(newIndex);
+
+	bandwidthAfter = computeBandwidth(network);
+	cacheMissesAfter = estimateCacheMisses(network);
+}
+
+//breadth first levels from start, returns the last point reached (one of the farthest)
+static int breadthFirst(SpringNetwork& network, int start, std::vector<int>& level, std::vector<int>& queue)
+{
+	queue.clear();
+	queue.push_back(start);
+	level[start] = 0;
+	for(size_t head = 0; head < queue.size(); head++) {
+		int p = queue[head];
+		const std::vector<int>& n = network.adjacency[p];
+		for(auto neighbour = n.begin(); neighbour != n.end(); neighbour++) {
+			if(level[*neighbour] < 0) {
+				level[*neighbour] = level[p] + 1;
+				queue.push_back(*neighbour);
+			}
+		}
+	}
+	//reset what we touched, the caller reuses the array
+	for(auto p = queue.begin(); p != queue.end(); p++)
+		level[*p] = -1;
+	return queue.back();
+}
+
+void NetworkOrdering::computeReverseCuthillMcKee(SpringNetwork& network, std::vector<int>& order)
+{
+	int pointCount = (int)network.points.size();
+	order.clear();
+	order.reserve(pointCount);
+	std::vector<char> visited(pointCount, 0);
+	std::vector<int> level(pointCount, -1), scratch, neighbours;
+
+	//points by degree, every component starts from its lowest degree point
+	std::vector<int> byDegree(pointCount);
+	for(int i = 0; i < pointCount; i++)
+		byDegree[i] = i;
+	std::stable_sort(byDegree.begin(), byDegree.end(), [&](int a, int b) { return network.adjacency[a].size() < network.adjacency[b].size(); });
+
+	for(auto seed = byDegree.begin(); seed != byDegree.end(); seed++) {
+		if(visited[*seed])
+			continue;
+		//two sweeps to get close to a peripheral point, that gives the narrowest levels
+		int start = breadthFirst(network, *seed, level, scratch);
+		start = breadthFirst(network, start, level, scratch);
+
+		size_t head = order.size();
+		order.push_back(start);
+		visited[start] = 1;
+		for(; head < order.size(); head++) {
+			neighbours.clear();
+			const std::vector<int>& n = network.adjacency[order[head]];
+			for(auto neighbour = n.begin(); neighbour != n.end(); neighbour++)
+				if(!visited[*neighbour]) {
+					visited[*neighbour] = 1;
+					neighbours.push_back(*neighbour);
+				}
+			std::sort(neighbours.begin(), neighbours.end(), [&](int a, int b) { 
+				return network.adjacency[a].size() < network.adjacency[b].size() || (network.adjacency[a].size() == network.adjacency[b].size() && a < b);
+			});
+			order.insert(order.end(), neighbours.begin(), neighbours.end());
+		}
+	}
+	std::reverse(order.begin(), order.end());
+}
+
+//distance along a 3D Hilbert curve of a point on a 1024^3 grid (Skilling's transpose method)
+static unsigned long long hilbertIndex(unsigned int x, unsigned int y, unsigned int z)
+{
+	const int bits = 10;
+	unsigned int X[3] = { x, y, z };
+	//inverse undo of the excess work
+	for(unsigned int q = 1u << (bits-1); q > 1; q >>= 1) {
+		unsigned int p = q - 1;
+		for(int i = 0; i < 3; i++) {
+			if(X[i] & q)
+				X[0] ^= p;
+			else {
+				unsigned int t = (X[0] ^ X[i]) & p;
+				X[0] ^= t;
+				X[i] ^= t;
+			}
+		}
+	}
+	//gray encode
+	for(int i = 1; i < 3; i++)
+		X[i] ^= X[i-1];
+	unsigned int t = 0;
+	for(unsigned int q = 1u << (bits-1); q > 1; q >>= 1)
+		if(X[2] & q)
+			t ^= q - 1;
+	for(int i = 0; i < 3; i++)
+		X[i] ^= t;
+	//interleave the transposed bits, most significant first
+	unsigned long long index = 0;
+	for(int b = bits-1; b >= 0; b--)
+		for(int i = 0; i < 3; i++)
+			index = (index << 1) | ((X[i] >> b) & 1);
+	return index;
+}
+
+void NetworkOrdering::computeHilbert(SpringNetwork& network, std::vector<int>& order)
+{
+	int pointCount = (int)network.points.size();
+	order.resize(pointCount);
+	if(pointCount == 0)
+		return;
+	const std::vector<XMFLOAT3>& rest = network.restPositions;
+	XMVECTOR lower = XMLoadFloat3(&rest[0]), upper = lower;
+	for(auto position = rest.begin(); position != rest.end(); position++) {
+		lower = XMVectorMin(lower, XMLoadFloat3(&*position));
+		upper = XMVectorMax(upper, XMLoadFloat3(&*position));
+	}
+	//same scale on all axes so the curve isn't squashed on flat cloths
+	XMFLOAT3 extent;
+	XMStoreFloat3(&extent, upper - lower);
+	float scale = 1023.f / std::max(extent.x, std::max(extent.y, std::max(extent.z, 1e-6f)));
+
+	std::vector<unsigned long long> keys(pointCount);
+	for(int i = 0; i < pointCount; i++) {
+		XMFLOAT3 cell;
+		XMStoreFloat3(&cell, (XMLoadFloat3(&rest[i]) - lower) * scale);
+		keys[i] = hilbertIndex((unsigned int)cell.x, (unsigned int)cell.y, (unsigned int)cell.z);
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+}
+
+int NetworkOrdering::computeBandwidth(SpringNetwork& network)
+{
+	int bandwidth = 0;
+	for(auto spring = network.springs.begin(); spring != network.springs.end(); spring++)
+		bandwidth = std::max(bandwidth, abs(network.getPointIndex(spring->gs_point1) - network.getPointIndex(spring->gs_point2)));
+	return bandwidth;
+}
+
+int NetworkOrdering::estimateCacheMisses(SpringNetwork& network)
+{
+	const int lineSize = 64, ways = 8, sets = 32*1024 / (lineSize*ways);
+	//tags per set, most recently used first
+	std::vector<long long> cache(sets*ways, -1);
+	int misses = 0;
+	auto touch = [&](const void* address) {
+		long long line = (long long)((size_t)address / lineSize);
+		long long* set = &cache[(line % sets)*ways];
+		int hit = ways-1;
+		for(int w = 0; w < ways; w++)
+			if(set[w] == line) {
+				hit = w;
+				break;
+			}
+		if(set[hit] != line)
+			misses++;
+		//move to the front, dropping the least recently used way on a miss
+		for(int w = hit; w > 0; w--)
+			set[w] = set[w-1];
+		set[0] = line;
+	};
+	for(auto spring = network.springs.begin(); spring != network.springs.end(); spring++) {
+		touch(&spring->gs_point1->gp_position);
+		touch(&spring->gs_point2->gp_position);
+	}
+	return misses;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef NetworkOrdering_HEADER
+#define NetworkOrdering_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "SpringNetwork.h"
+
+// Bandwidth reducing point orders for spring networks.
+// Reverse Cuthill-McKee walks the spring graph breadth first so connected points get close indices,
+// the Hilbert order sorts the points along a space filling curve through their rest positions, so
+// reordering a deformed or torn cloth still follows the layout it was built with.
+// reorder() applies the order with SpringNetwork::permutePoints and returns the index map, anything
+// else holding point indices has to be remapped with it.
+class NetworkOrdering
+{
+public:
+	enum Method
+	{
+		REVERSE_CUTHILL_MCKEE,
+		HILBERT_CURVE
+	};
+
+	//statistics of the last reorder()
+	int bandwidthBefore;
+	int bandwidthAfter;
+	int cacheMissesBefore;
+	int cacheMissesAfter;
+
+	NetworkOrdering();
+
+	//newIndex[old point index] = new point index
+	void reorder(SpringNetwork& network, Method method, std::vector<int>& newIndex);
+
+	//order[new index] = old index
+	static void computeReverseCuthillMcKee(SpringNetwork& network, std::vector<int>& order);
+	static void computeHilbert(SpringNetwork& network, std::vector<int>& order);
+
+	//largest index distance between the two ends of a spring
+	static int computeBandwidth(SpringNetwork& network);
+	//cache misses of one pass over the springs reading both end points, simulated for a 32KB 8-way cache with 64 byte lines
+	static int estimateCacheMisses(SpringNetwork& network);
+};
+
+#endif
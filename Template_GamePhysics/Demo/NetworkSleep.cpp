@@ -0,0 +1,350 @@
+#include "NetworkSleep.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+NetworkSleep::NetworkSleep()
+{
+	sleepSpeed = 0.02f;
+	wakeSpeed = 0.1f;
+	wakeStrain = 0.01f;
+	sleepSteps = 30;
+	regionCount = 0;
+	sleepingRegions = 0;
+	sleepingPoints = 0;
+	sleepCount = 0;
+	wakeCount = 0;
+	listsValid = false;
+	listsRevision = -1;
+	springsRevision = -1;
+	boundsValid = false;
+	sleepGravity = 0.f;
+}
+
+bool NetworkSleep::isInitialized()
+{
+	return regionCount > 0;
+}
+
+void NetworkSleep::clear()
+{
+	regionCount = 0;
+	sleepingRegions = 0;
+	sleepingPoints = 0;
+	sleepCount = 0;
+	wakeCount = 0;
+	pointRegion.clear();
+	regionStart.clear();
+	regionPoints.clear();
+	neighbourStart.clear();
+	neighbours.clear();
+	springStart.clear();
+	regionSprings.clear();
+	springsRevision = -1;
+	asleep.clear();
+	awakeRegions.clear();
+	listed.clear();
+	restingSteps.clear();
+	speeds.clear();
+	lowerBounds.clear();
+	upperBounds.clear();
+	boundarySprings.clear();
+	boundaryLengths.clear();
+	boundaryPoints.clear();
+	activePoints.clear();
+	activeSprings.clear();
+	listsValid = false;
+	boundsValid = false;
+}
+
+bool NetworkSleep::isAsleep()
+{
+	return isInitialized() && sleepingRegions == regionCount;
+}
+
+void NetworkSleep::initialize(SpringNetwork& network, float regionSize)
+{
+	clear();
+	int pointCount = (int)network.points.size();
+	if(pointCount == 0 || regionSize <= 0.f)
+		return;
+
+	//one region per occupied cell, cell coordinates packed into 21 bits each
+	XMFLOAT3 lower = network.points[0].gp_position;
+	for(auto point = network.points.begin(); point != network.points.end(); point++) {
+		lower.x = std::min(lower.x, point->gp_position.x);
+		lower.y = std::min(lower.y, point->gp_position.y);
+		lower.z = std::min(lower.z, point->gp_position.z);
+	}
+	const long long cellMask = (1 << 21) - 1;
+	std::vector<std::pair<long long, int>> sorted(pointCount);
+	for(int i = 0; i < pointCount; i++) {
+		const XMFLOAT3& p = network.points[i].gp_position;
+		long long x = std::min((long long)((p.x - lower.x)/regionSize), cellMask);
+		long long y = std::min((long long)((p.y - lower.y)/regionSize), cellMask);
+		long long z = std::min((long long)((p.z - lower.z)/regionSize), cellMask);
+		sorted[i] = std::make_pair((x << 42) | (y << 21) | z, i);
+	}
+	std::sort(sorted.begin(), sorted.end());
+	pointRegion.resize(pointCount);
+	regionPoints.resize(pointCount);
+	for(int i = 0; i < pointCount; i++) {
+		if(i == 0 || sorted[i].first != sorted[i-1].first)
+			regionStart.push_back(i);
+		pointRegion[sorted[i].second] = (int)regionStart.size() - 1;
+		regionPoints[i] = sorted[i].second;
+	}
+	regionCount = (int)regionStart.size();
+	regionStart.push_back(pointCount);
+
+	//region graph from the springs
+	std::vector<std::pair<int, int>> links;
+	SpringPoint* first = &network.points[0];
+	for(auto spring = network.springs.begin(); spring != network.springs.end(); spring++) {
+		int a = pointRegion[spring->gs_point1 - first], b = pointRegion[spring->gs_point2 - first];
+		if(a != b) {
+			links.push_back(std::make_pair(a, b));
+			links.push_back(std::make_pair(b, a));
+		}
+	}
+	std::sort(links.begin(), links.end());
+	links.erase(std::unique(links.begin(), links.end()), links.end());
+	neighbourStart.assign(regionCount+1, 0);
+	neighbours.resize(links.size());
+	for(int i = 0; i < (int)links.size(); i++) {
+		neighbourStart[links[i].first+1]++;
+		neighbours[i] = links[i].second;
+	}
+	for(int r = 0; r < regionCount; r++)
+		neighbourStart[r+1] += neighbourStart[r];
+
+	asleep.assign(regionCount, 0);
+	listed.assign(regionCount, 0);
+	restingSteps.assign(regionCount, 0);
+	speeds.assign(regionCount, 0.f);
+	lowerBounds.resize(regionCount);
+	upperBounds.resize(regionCount);
+	listsValid = false;
+}
+
+void NetworkSleep::wakeRegion(int region)
+{
+	restingSteps[region] = 0;
+	if(!asleep[region])
+		return;
+	asleep[region] = 0;
+	sleepingRegions--;
+	sleepingPoints -= regionStart[region+1] - regionStart[region];
+	wakeCount++;
+	listsValid = false;
+}
+
+void NetworkSleep::sleepRegion(SpringNetwork& network, int region)
+{
+	asleep[region] = 1;
+	sleepingRegions++;
+	sleepingPoints += regionStart[region+1] - regionStart[region];
+	sleepCount++;
+	listsValid = false;
+	XMFLOAT3 lower = network.points[regionPoints[regionStart[region]]].gp_position, upper = lower;
+	for(int k = regionStart[region]; k < regionStart[region+1]; k++) {
+		SpringPoint& point = network.points[regionPoints[k]];
+		point.gp_velocity = point.gp_velTemp = XMFLOAT3(0.f, 0.f, 0.f);
+		point.gp_posTemp = point.gp_position;
+		lower = XMFLOAT3(std::min(lower.x, point.gp_position.x), std::min(lower.y, point.gp_position.y), std::min(lower.z, point.gp_position.z));
+		upper = XMFLOAT3(std::max(upper.x, point.gp_position.x), std::max(upper.y, point.gp_position.y), std::max(upper.z, point.gp_position.z));
+	}
+	lowerBounds[region] = lower;
+	upperBounds[region] = upper;
+}
+
+void NetworkSleep::wakeAll()
+{
+	for(int r = 0; r < regionCount; r++)
+		wakeRegion(r);
+}
+
+void NetworkSleep::wakePoint(int point)
+{
+	if(isInitialized())
+		wakeRegion(pointRegion[point]);
+}
+
+void NetworkSleep::wakeInside(XMFLOAT3 lower, XMFLOAT3 upper)
+{
+	if(sleepingRegions == 0)
+		return;
+	for(int r = 0; r < regionCount; r++)
+		if(asleep[r] && lowerBounds[r].x <= upper.x && upperBounds[r].x >= lower.x && lowerBounds[r].y <= upper.y && upperBounds[r].y >= lower.y
+			&& lowerBounds[r].z <= upper.z && upperBounds[r].z >= lower.z)
+			wakeRegion(r);
+}
+
+//a spring is listed in the region of each of its ends, once if both are in the same region
+void NetworkSleep::buildRegionSprings(SpringNetwork& network)
+{
+	springsRevision = network.topologyRevision;
+	springStart.assign(regionCount+1, 0);
+	SpringPoint* first = &network.points[0];
+	for(auto spring = network.springs.begin(); spring != network.springs.end(); spring++) {
+		int a = pointRegion[spring->gs_point1 - first], b = pointRegion[spring->gs_point2 - first];
+		springStart[a+1]++;
+		if(b != a)
+			springStart[b+1]++;
+	}
+	for(int r = 0; r < regionCount; r++)
+		springStart[r+1] += springStart[r];
+	regionSprings.resize(springStart[regionCount]);
+	std::vector<int> fill(springStart.begin(), springStart.end()-1);
+	for(int i = 0; i < (int)network.springs.size(); i++) {
+		int a = pointRegion[network.springs[i].gs_point1 - first], b = pointRegion[network.springs[i].gs_point2 - first];
+		regionSprings[fill[a]++] = i;
+		if(b != a)
+			regionSprings[fill[b]++] = i;
+	}
+}
+
+void NetworkSleep::prepare(SpringNetwork& network)
+{
+	if(!isInitialized() || (listsValid && listsRevision == network.topologyRevision))
+		return;
+	if(springsRevision != network.topologyRevision)
+		buildRegionSprings(network);
+	listsValid = true;
+	listsRevision = network.topologyRevision;
+	boundsValid = false;
+	activePoints.clear();
+	activeSprings.clear();
+	boundarySprings.clear();
+	boundaryLengths.clear();
+	boundaryPoints.clear();
+	awakeRegions.clear();
+	for(int r = 0; r < regionCount; r++) {
+		listed[r] = !asleep[r];
+		if(listed[r])
+			awakeRegions.push_back(r);
+	}
+
+	SpringPoint* first = &network.points[0];
+	for(auto r = awakeRegions.begin(); r != awakeRegions.end(); r++) {
+		activePoints.insert(activePoints.end(), regionPoints.begin() + regionStart[*r], regionPoints.begin() + regionStart[*r+1]);
+		for(int k = springStart[*r]; k < springStart[*r+1]; k++) {
+			int i = regionSprings[k];
+			const Spring& spring = network.springs[i];
+			int a = (int)(spring.gs_point1 - first), b = (int)(spring.gs_point2 - first);
+			bool sleepA = asleep[pointRegion[a]] != 0, sleepB = asleep[pointRegion[b]] != 0;
+			//a spring between two awake regions is taken by the region of its first end
+			if(pointRegion[a] != *r && !sleepA)
+				continue;
+			activeSprings.push_back(i);
+			if(sleepA || sleepB) {
+				boundarySprings.push_back(i);
+				boundaryLengths.push_back(vectorLength(subVector(spring.gs_point1->gp_position, spring.gs_point2->gp_position)));
+				boundaryPoints.push_back(sleepA ? a : b);
+			}
+		}
+	}
+	//back into memory order for the integrator loops
+	std::sort(activePoints.begin(), activePoints.end());
+	std::sort(activeSprings.begin(), activeSprings.end());
+}
+
+void NetworkSleep::update(SpringNetwork& network, float gravity)
+{
+	if(!isInitialized())
+		return;
+	if(sleepingRegions > 0 && gravity != sleepGravity)
+		wakeAll();
+	sleepGravity = gravity;
+
+	//the springs into sleeping regions were evaluated, their forces on the sleeping ends are dropped.
+	//a spring that was stretched or compressed since the lists were built means something pulls on the region
+	bool sameSprings = listsRevision == network.topologyRevision;
+	for(int k = 0; k < (int)boundarySprings.size(); k++) {
+		network.points[boundaryPoints[k]].resetForces();
+		if(!sameSprings)
+			continue;
+		const Spring& spring = network.springs[boundarySprings[k]];
+		float length = vectorLength(subVector(spring.gs_point1->gp_position, spring.gs_point2->gp_position));
+		if(std::abs(length - boundaryLengths[k]) > wakeStrain*spring.gs_initialLength)
+			wakeRegion(pointRegion[boundaryPoints[k]]);
+	}
+
+	//mean squared speed of the regions that were simulated. one woken during the step (by a contact)
+	//is looked at from the next step on, like a region woken here
+	for(auto region = awakeRegions.begin(); region != awakeRegions.end(); region++) {
+		int r = *region;
+		float sum = 0.f;
+		int count = 0;
+		for(int k = regionStart[r]; k < regionStart[r+1]; k++) {
+			const SpringPoint& point = network.points[regionPoints[k]];
+			if(point.gp_isStatic)
+				continue;
+			sum += point.gp_velocity.x*point.gp_velocity.x + point.gp_velocity.y*point.gp_velocity.y + point.gp_velocity.z*point.gp_velocity.z;
+			count++;
+		}
+		speeds[r] = count > 0 ? sum/count : 0.f;
+	}
+	float wake = wakeSpeed*wakeSpeed, rest = sleepSpeed*sleepSpeed;
+	for(auto region = awakeRegions.begin(); region != awakeRegions.end(); region++) {
+		int r = *region;
+		if(speeds[r] <= wake)
+			continue;
+		for(int k = neighbourStart[r]; k < neighbourStart[r+1]; k++)
+			wakeRegion(neighbours[k]);
+	}
+	for(auto region = awakeRegions.begin(); region != awakeRegions.end(); region++) {
+		int r = *region;
+		restingSteps[r] = speeds[r] < rest ? restingSteps[r] + 1 : 0;
+		if(restingSteps[r] >= sleepSteps)
+			sleepRegion(network, r);
+	}
+}
+
+void NetworkSleep::bounds(SpringNetwork& network, float radius, XMFLOAT3& lower, XMFLOAT3& upper)
+{
+	//nothing was integrated since the lists were built, a region woken since then hasn't moved yet
+	if(boundsValid) {
+		lower = cachedLower;
+		upper = cachedUpper;
+		return;
+	}
+	XMVECTOR low = XMVectorReplicate(FLT_MAX), high = XMVectorReplicate(-FLT_MAX);
+	for(int r = 0; r < regionCount; r++) {
+		if(listed[r])
+			continue;
+		low = XMVectorMin(low, XMLoadFloat3(&lowerBounds[r]));
+		high = XMVectorMax(high, XMLoadFloat3(&upperBounds[r]));
+	}
+	for(auto index = activePoints.begin(); index != activePoints.end(); index++) {
+		XMVECTOR position = XMLoadFloat3(&network.points[*index].gp_position);
+		low = XMVectorMin(low, position);
+		high = XMVectorMax(high, position);
+	}
+	XMStoreFloat3(&lower, low - XMVectorReplicate(radius));
+	XMStoreFloat3(&upper, high + XMVectorReplicate(radius));
+	if(listsValid && awakeRegions.empty()) {
+		cachedLower = lower;
+		cachedUpper = upper;
+		boundsValid = true;
+	}
+}
+
+void NetworkSleep::remapPoints(const std::vector<int>& newIndex)
+{
+	if(!isInitialized())
+		return;
+	std::vector<int> region(pointRegion.size());
+	for(int i = 0; i < (int)pointRegion.size(); i++)
+		region[newIndex[i]] = pointRegion[i];
+	pointRegion.swap(region);
+	for(auto point = regionPoints.begin(); point != regionPoints.end(); point++)
+		*point = newIndex[*point];
+	boundarySprings.clear();
+	boundaryLengths.clear();
+	boundaryPoints.clear();
+	springsRevision = -1;
+	listsValid = false;
+	boundsValid = false;
+}
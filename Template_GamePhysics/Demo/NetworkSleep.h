@@ -0,0 +1,106 @@
+#pragma once
+#ifndef NetworkSleep_HEADER
+#define NetworkSleep_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "SpringNetwork.h"
+
+// Sleeping for resting parts of a spring network.
+// The rest positions are split into cubic regions. A region whose points move slower than sleepSpeed
+// (root mean square) for sleepSteps steps in a row falls asleep: its velocities are zeroed and its
+// points and the springs between them drop out of activePoints/activeSprings, which is all the
+// integrator loops over. A sleeping region wakes up when
+//  - a neighbouring region moves faster than wakeSpeed,
+//  - a spring from an awake point into it changes length by more than wakeStrain (something pulls on it),
+//  - something touches it (wakePoint after a contact, wakeInside for a moving body's bounds),
+//  - the gravity changes.
+// Springs between an awake and a sleeping point are still evaluated, the sleeping end just doesn't move.
+// Every region knows the springs touching it, so rebuilding the lists and the per step bookkeeping
+// only walk the awake regions: a cloth that sleeps everywhere costs next to nothing.
+class NetworkSleep
+{
+public:
+	float sleepSpeed;
+	float wakeSpeed;
+	//relative to the spring's rest length
+	float wakeStrain;
+	int sleepSteps;
+
+	//statistics, sleeps and wakes are counted since initialize
+	int regionCount;
+	int sleepingRegions;
+	int sleepingPoints;
+	int sleepCount;
+	int wakeCount;
+
+	//what the integrator has to process, valid after prepare()
+	std::vector<int> activePoints;
+	std::vector<int> activeSprings;
+
+	NetworkSleep();
+
+	//regions are cubes with the given edge length around the current positions, everything starts awake
+	void initialize(SpringNetwork& network, float regionSize);
+	bool isInitialized();
+	void clear();
+	//true if there is nothing to simulate
+	bool isAsleep();
+
+	void wakeAll();
+	void wakePoint(int point);
+	void wakeInside(XMFLOAT3 lower, XMFLOAT3 upper);
+
+	//before the step, rebuilds the active lists after wakes, sleeps or tearing
+	void prepare(SpringNetwork& network);
+	//after the step (and its collisions), puts resting regions to sleep and wakes disturbed ones
+	void update(SpringNetwork& network, float gravity);
+	//bounds of all points grown by radius, from the stored bounds of the regions that weren't
+	//active in prepare() and the active points. kept as long as everything sleeps
+	void bounds(SpringNetwork& network, float radius, XMFLOAT3& lower, XMFLOAT3& upper);
+
+	//after the network's points were renumbered (SpringNetwork::permutePoints)
+	void remapPoints(const std::vector<int>& newIndex);
+
+private:
+	std::vector<int> pointRegion;
+	//points of region r are regionPoints[regionStart[r] .. regionStart[r+1])
+	std::vector<int> regionStart;
+	std::vector<int> regionPoints;
+	//regions connected by a spring, same layout
+	std::vector<int> neighbourStart;
+	std::vector<int> neighbours;
+	//springs with an end in the region, same layout, rebuilt when the network's topology changes
+	std::vector<int> springStart;
+	std::vector<int> regionSprings;
+	int springsRevision;
+	std::vector<char> asleep;
+	//the awake regions when the lists were built, update() only looks at these
+	std::vector<int> awakeRegions;
+	std::vector<char> listed;
+	std::vector<int> restingSteps;
+	std::vector<float> speeds;
+	//bounds of the sleeping regions, for wakeInside and bounds()
+	std::vector<XMFLOAT3> lowerBounds;
+	std::vector<XMFLOAT3> upperBounds;
+	XMFLOAT3 cachedLower;
+	XMFLOAT3 cachedUpper;
+	bool boundsValid;
+
+	//springs with exactly one sleeping end and their length when the lists were built
+	std::vector<int> boundarySprings;
+	std::vector<float> boundaryLengths;
+	std::vector<int> boundaryPoints;
+
+	bool listsValid;
+	int listsRevision;
+	float sleepGravity;
+
+	void wakeRegion(int region);
+	void sleepRegion(SpringNetwork& network, int region);
+	void buildRegionSprings(SpringNetwork& network);
+};
+
+#endif
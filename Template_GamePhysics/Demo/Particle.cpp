@@ -1,4 +1,5 @@
 #include "Particle.h"
+#include "PointCollision.h"
 
 Particle::Particle(void) 
 {
@@ -24,81 +25,5 @@ XMFLOAT3 Particle::getPosition()
 }
 void Particle::computeCollisionWithBox(float deltaTime, float sphereSize,XMVECTOR upper, XMVECTOR lower)
 {
-	if(!gp_isStatic)
-	{
-		//Ground at y=-1;
-		bool collided = true;
-		while(collided)
-		{
-			collided = false;
-
-			//test floor collision
-			if(gp_position.y<XMVectorGetY(lower)+sphereSize)
-			{
-				collided = true;
-				gp_position.y = (XMVectorGetY(lower)+sphereSize)-(gp_position.y-XMVectorGetY(lower)-sphereSize)*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.y = -gp_velocity.y*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.x -= gp_velocity.x*deltaTime*(gp_groundFriction);
-				gp_velocity.z -= gp_velocity.z*deltaTime*(gp_groundFriction);
-			}
-			//test negative x-wall collision
-			if(gp_position.x<XMVectorGetX(lower)+sphereSize)
-			{
-				collided = true;
-				gp_position.x = (XMVectorGetX(lower)+sphereSize)-(gp_position.x-XMVectorGetX(lower)-sphereSize)*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.x = -gp_velocity.x*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.y -= gp_velocity.y*deltaTime*(gp_groundFriction);
-				gp_velocity.z -= gp_velocity.z*deltaTime*(gp_groundFriction);
-			}
-			//test negative z-wall collision
-			if(gp_position.z<XMVectorGetZ(lower)+sphereSize)
-			{
-				collided = true;
-				gp_position.z = (XMVectorGetZ(lower)+sphereSize)-(gp_position.z-XMVectorGetZ(lower)-sphereSize)*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.z = -gp_velocity.z*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.y -= gp_velocity.y*deltaTime*(gp_groundFriction);
-				gp_velocity.x -= gp_velocity.x*deltaTime*(gp_groundFriction);
-			}
-
-			//test ceiling collision
-			if(gp_position.y>XMVectorGetY(upper)-sphereSize)
-			{
-				collided = true;
-				gp_position.y = (XMVectorGetY(upper)-sphereSize)-(gp_position.y-(XMVectorGetY(upper)-sphereSize))*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.y = -gp_velocity.y*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.x -= gp_velocity.x*deltaTime*(gp_groundFriction);
-				gp_velocity.z -= gp_velocity.z*deltaTime*(gp_groundFriction);
-			}
-			//test positive x-wall collision
-			if(gp_position.x>XMVectorGetX(upper)-sphereSize)
-			{
-				collided = true;
-				gp_position.x = (XMVectorGetX(upper)-sphereSize)-(gp_position.x-(XMVectorGetX(upper)-sphereSize))*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.x = -gp_velocity.x*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.y -= gp_velocity.y*deltaTime*(gp_groundFriction);
-				gp_velocity.z -= gp_velocity.z*deltaTime*(gp_groundFriction);
-			}
-			//test positive z-wall collision
-			if(gp_position.z>XMVectorGetZ(upper)-sphereSize)
-			{
-				collided = true;
-				gp_position.z = (XMVectorGetZ(upper)-sphereSize)-(gp_position.z-(XMVectorGetZ(upper)-sphereSize))*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.z = -gp_velocity.z*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.y -= gp_velocity.y*deltaTime*(gp_groundFriction);
-				gp_velocity.x -= gp_velocity.x*deltaTime*(gp_groundFriction);
-			}
-		}
-	}
+	PointCollision::resolve(this, 1, sizeof(Particle), ContainmentBox::box(lower, upper, sphereSize), deltaTime);
 }
@@ -0,0 +1,75 @@
+#include "PointBoxQuery.h"
+
+#include <cmath>
+
+PointBoxQuery::PointBoxQuery()
+{
+	testedPoints = 0;
+	culledPoints = 0;
+}
+
+void PointBoxQuery::clear()
+{
+	hitBox.clear();
+	hitNetwork.clear();
+	hitPoint.clear();
+	testedPoints = 0;
+	culledPoints = 0;
+}
+
+int PointBoxQuery::getHitCount()
+{
+	return (int)hitPoint.size();
+}
+
+void PointBoxQuery::query(const std::vector<XMFLOAT4X4>& boxes, const std::vector<SpringNetwork*>& networks)
+{
+	clear();
+	for(int b = 0; b < (int)boxes.size(); b++)
+		for(int n = 0; n < (int)networks.size(); n++)
+			queryBox(b, boxes[b], n, *networks[n]);
+}
+
+void PointBoxQuery::queryBox(int box, const XMFLOAT4X4& obj2World, int network, SpringNetwork& points)
+{
+	int pointCount = (int)points.points.size();
+	if(pointCount == 0)
+		return;
+	testedPoints += pointCount;
+
+	//rows 0-2 are the scaled box axes, row 3 the centre
+	const float (*m)[4] = obj2World.m;
+	float halfExtent[3];
+	for(int k = 0; k < 3; k++)
+		halfExtent[k] = 0.5f*(fabsf(m[0][k]) + fabsf(m[1][k]) + fabsf(m[2][k]));
+	float lo[3] = { m[3][0]-halfExtent[0], m[3][1]-halfExtent[1], m[3][2]-halfExtent[2] };
+	float hi[3] = { m[3][0]+halfExtent[0], m[3][1]+halfExtent[1], m[3][2]+halfExtent[2] };
+
+	//world AABB cull, gather the survivors so they can be transformed in one stream
+	candidates.clear();
+	gathered.clear();
+	for(int i = 0; i < pointCount; i++) {
+		const XMFLOAT3& p = points.points[i].gp_position;
+		if(p.x < lo[0] || p.x > hi[0] || p.y < lo[1] || p.y > hi[1] || p.z < lo[2] || p.z > hi[2])
+			continue;
+		candidates.push_back(i);
+		gathered.push_back(p);
+	}
+	int candidateCount = (int)candidates.size();
+	culledPoints += pointCount - candidateCount;
+	if(candidateCount == 0)
+		return;
+
+	XMMATRIX toBox = XMMatrixInverse(nullptr, XMLoadFloat4x4(&obj2World));
+	local.resize(candidateCount);
+	XMVector3TransformStream(&local[0], sizeof(XMFLOAT4), &gathered[0], sizeof(XMFLOAT3), candidateCount, toBox);
+
+	for(int c = 0; c < candidateCount; c++) {
+		const float* l = &local[c].x;
+		if(fabsf(l[0]) > 0.5f || fabsf(l[1]) > 0.5f || fabsf(l[2]) > 0.5f)
+			continue;
+		hitBox.push_back(box);
+		hitNetwork.push_back(network);
+		hitPoint.push_back(candidates[c]);
+	}
+}
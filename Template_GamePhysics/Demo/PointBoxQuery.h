@@ -0,0 +1,43 @@
+#pragma once
+#ifndef PointBoxQuery_HEADER
+#define PointBoxQuery_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "SpringNetwork.h"
+
+// Batched point versus oriented box query (the batched version of gayTest).
+// Boxes are unit cubes given by their object to world matrix, like getObj2WorldMat builds them.
+// Per box the matrix is inverted once, the points are culled against the box's world AABB,
+// the survivors are gathered and transformed into box space in one XMVector3TransformStream call.
+// Hits are returned in flat arrays, nothing is allocated once the buffers have grown.
+class PointBoxQuery
+{
+public:
+	//one entry per point inside a box
+	std::vector<int> hitBox;
+	std::vector<int> hitNetwork;
+	std::vector<int> hitPoint;
+
+	//statistics of the last query
+	int testedPoints;
+	int culledPoints;
+
+	PointBoxQuery();
+
+	void clear();
+	int getHitCount();
+	//tests every point of every network against every box
+	void query(const std::vector<XMFLOAT4X4>& boxes, const std::vector<SpringNetwork*>& networks);
+
+private:
+	std::vector<int> candidates;
+	std::vector<XMFLOAT3> gathered;
+	std::vector<XMFLOAT4> local;
+
+	void queryBox(int box, const XMFLOAT4X4& obj2World, int network, SpringNetwork& points);
+};
+
+#endif
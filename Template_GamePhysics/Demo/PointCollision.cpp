@@ -0,0 +1,148 @@
+#include "PointCollision.h"
+
+#include <cfloat>
+
+ContainmentBox ContainmentBox::ground(float sphereSize)
+{
+	ContainmentBox box;
+	box.lower = XMFLOAT3(-FLT_MAX, -1.f, -FLT_MAX);
+	box.upper = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	box.sphereSize = sphereSize;
+	box.invertFriction = true;
+	return box;
+}
+
+ContainmentBox ContainmentBox::walls(float sphereSize, float xWall, float zWall, float ceiling)
+{
+	ContainmentBox box;
+	box.lower = XMFLOAT3(-xWall, -1.f, -zWall);
+	box.upper = XMFLOAT3(xWall, ceiling, zWall);
+	box.sphereSize = sphereSize;
+	box.invertFriction = false;
+	return box;
+}
+
+ContainmentBox ContainmentBox::box(XMVECTOR lower, XMVECTOR upper, float sphereSize)
+{
+	ContainmentBox box;
+	XMStoreFloat3(&box.lower, lower);
+	XMStoreFloat3(&box.upper, upper);
+	box.sphereSize = sphereSize;
+	box.invertFriction = false;
+	return box;
+}
+
+//the wall planes moved inwards by the radius, one vector per axis so the lanes line up with the points
+struct BoxLanes
+{
+	XMVECTOR lower[3];
+	XMVECTOR upper[3];
+	float deltaTime;
+	bool invertFriction;
+};
+
+//four points at once, lanes of unused slots point at a static dummy
+static void resolveGroup(SpringPoint* const* p, const BoxLanes& box)
+{
+	XMMATRIX position(XMLoadFloat3(&p[0]->gp_position), XMLoadFloat3(&p[1]->gp_position), XMLoadFloat3(&p[2]->gp_position), XMLoadFloat3(&p[3]->gp_position));
+	position = XMMatrixTranspose(position);
+	XMVECTOR* x = position.r;
+
+	XMVECTOR movable = XMVectorEqualInt(XMVectorSetInt(p[0]->gp_isStatic, p[1]->gp_isStatic, p[2]->gp_isStatic, p[3]->gp_isStatic), XMVectorZero());
+	XMVECTOR hit[3], anyHit = XMVectorFalseInt();
+	for(int axis = 0; axis < 3; axis++) {
+		XMVECTOR below = XMVectorAndInt(XMVectorLess(x[axis], box.lower[axis]), movable);
+		XMVECTOR above = XMVectorAndInt(XMVectorGreater(x[axis], box.upper[axis]), movable);
+		hit[axis] = XMVectorOrInt(below, above);
+		anyHit = XMVectorOrInt(anyHit, hit[axis]);
+	}
+	//most groups are nowhere near a wall
+	if(XMVector4EqualInt(anyHit, XMVectorFalseInt()))
+		return;
+
+	XMMATRIX velocity(XMLoadFloat3(&p[0]->gp_velocity), XMLoadFloat3(&p[1]->gp_velocity), XMLoadFloat3(&p[2]->gp_velocity), XMLoadFloat3(&p[3]->gp_velocity));
+	velocity = XMMatrixTranspose(velocity);
+	XMVECTOR* v = velocity.r;
+	XMVECTOR bounce = XMVectorSet(p[0]->gp_bouncyness, p[1]->gp_bouncyness, p[2]->gp_bouncyness, p[3]->gp_bouncyness);
+	XMVECTOR friction = XMVectorSet(p[0]->gp_groundFriction, p[1]->gp_groundFriction, p[2]->gp_groundFriction, p[3]->gp_groundFriction);
+	if(box.invertFriction)
+		friction = XMVectorSubtract(XMVectorSplatOne(), friction);
+	//velocity factor for the two tangential axes of every wall that was hit
+	XMVECTOR slide = XMVectorNegativeMultiplySubtract(friction, XMVectorReplicate(box.deltaTime), XMVectorSplatOne());
+
+	for(int axis = 0; axis < 3; axis++) {
+		//mirror the penetration back inside, scaled by the bounciness, and stop at the opposite wall
+		XMVECTOR fromLower = XMVectorMultiplyAdd(XMVectorSubtract(box.lower[axis], x[axis]), bounce, box.lower[axis]);
+		XMVECTOR fromUpper = XMVectorNegativeMultiplySubtract(XMVectorSubtract(x[axis], box.upper[axis]), bounce, box.upper[axis]);
+		XMVECTOR reflected = XMVectorSelect(fromUpper, fromLower, XMVectorLess(x[axis], box.lower[axis]));
+		reflected = XMVectorClamp(reflected, box.lower[axis], box.upper[axis]);
+		x[axis] = XMVectorSelect(x[axis], reflected, hit[axis]);
+		v[axis] = XMVectorSelect(v[axis], XMVectorNegate(XMVectorMultiply(v[axis], bounce)), hit[axis]);
+	}
+	for(int axis = 0; axis < 3; axis++) {
+		int a1 = (axis+1) % 3, a2 = (axis+2) % 3;
+		v[a1] = XMVectorMultiply(v[a1], XMVectorSelect(XMVectorSplatOne(), slide, hit[axis]));
+		v[a2] = XMVectorMultiply(v[a2], XMVectorSelect(XMVectorSplatOne(), slide, hit[axis]));
+	}
+
+	position = XMMatrixTranspose(position);
+	velocity = XMMatrixTranspose(velocity);
+	for(int i = 0; i < 4; i++) {
+		XMStoreFloat3(&p[i]->gp_position, position.r[i]);
+		XMStoreFloat3(&p[i]->gp_velocity, velocity.r[i]);
+	}
+}
+
+static BoxLanes makeLanes(const ContainmentBox& box, float deltaTime)
+{
+	BoxLanes lanes;
+	const float* lower = &box.lower.x;
+	const float* upper = &box.upper.x;
+	for(int axis = 0; axis < 3; axis++) {
+		//the open sides of the ground box stay at +-FLT_MAX
+		lanes.lower[axis] = XMVectorReplicate(lower[axis] == -FLT_MAX ? -FLT_MAX : lower[axis] + box.sphereSize);
+		lanes.upper[axis] = XMVectorReplicate(upper[axis] == FLT_MAX ? FLT_MAX : upper[axis] - box.sphereSize);
+	}
+	lanes.deltaTime = deltaTime;
+	lanes.invertFriction = box.invertFriction;
+	return lanes;
+}
+
+template<class PointAt>
+static void resolvePoints(const PointAt& pointAt, int count, const ContainmentBox& box, float deltaTime)
+{
+	BoxLanes lanes = makeLanes(box, deltaTime);
+	SpringPoint* group[4];
+	int full = count & ~3;
+	for(int i = 0; i < full; i += 4) {
+		group[0] = pointAt(i);
+		group[1] = pointAt(i+1);
+		group[2] = pointAt(i+2);
+		group[3] = pointAt(i+3);
+		resolveGroup(group, lanes);
+	}
+	if(full < count) {
+		//static points are never touched, so the spare lanes can all share one
+		SpringPoint dummy;
+		dummy.setStatic(true);
+		for(int i = 0; i < 4; i++)
+			group[i] = full + i < count ? pointAt(full + i) : &dummy;
+		resolveGroup(group, lanes);
+	}
+}
+
+void PointCollision::resolve(SpringPoint* first, int count, size_t stride, const ContainmentBox& box, float deltaTime)
+{
+	char* base = (char*)first;
+	resolvePoints([=](int i) { return (SpringPoint*)(base + i*stride); }, count, box, deltaTime);
+}
+
+void PointCollision::resolve(SpringPoint* const* points, int count, const ContainmentBox& box, float deltaTime)
+{
+	resolvePoints([=](int i) { return points[i]; }, count, box, deltaTime);
+}
+
+void PointCollision::resolve(SpringPoint* first, const int* indices, int count, const ContainmentBox& box, float deltaTime)
+{
+	resolvePoints([=](int i) { return first + indices[i]; }, count, box, deltaTime);
+}
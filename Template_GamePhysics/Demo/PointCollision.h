@@ -0,0 +1,48 @@
+#pragma once
+#ifndef PointCollision_HEADER
+#define PointCollision_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "point.h"
+
+// Axis aligned box the points have to stay inside (inflated inwards by the point radius).
+struct ContainmentBox
+{
+	XMFLOAT3 lower;
+	XMFLOAT3 upper;
+	float sphereSize;
+	//the ground only collision slows sliding points by (1 - gp_groundFriction), the walls by gp_groundFriction
+	bool invertFriction;
+
+	//floor at y=-1, open everywhere else (SpringPoint::computeCollision)
+	static ContainmentBox ground(float sphereSize);
+	//floor at y=-1, walls at +-xWall, +-zWall and the ceiling (SpringPoint::computeCollisionWithWalls)
+	static ContainmentBox walls(float sphereSize, float xWall, float zWall, float ceiling);
+	//arbitrary box (Particle::computeCollisionWithBox)
+	static ContainmentBox box(XMVECTOR lower, XMVECTOR upper, float sphereSize);
+};
+
+// Point vs containment box for many points at once. Four points are transposed into x/y/z lanes and
+// every plane is handled with compares and selects, the only branch skips writing back groups that
+// didn't touch a wall. A point deeper than the box is wide ends up reflected once and clamped
+// instead of bouncing back and forth.
+class PointCollision
+{
+public:
+	//contiguous points, stride in bytes (sizeof(SpringPoint), sizeof(Particle), ...)
+	static void resolve(SpringPoint* first, int count, size_t stride, const ContainmentBox& box, float deltaTime);
+	static void resolve(SpringPoint* const* points, int count, const ContainmentBox& box, float deltaTime);
+	//the points first[indices[0..count)], e.g. the awake part of a sleeping cloth
+	static void resolve(SpringPoint* first, const int* indices, int count, const ContainmentBox& box, float deltaTime);
+
+	template<class T> static void resolve(std::vector<T>& points, const ContainmentBox& box, float deltaTime)
+	{
+		if(!points.empty())
+			resolve(&points[0], (int)points.size(), sizeof(T), box, deltaTime);
+	}
+};
+
+#endif
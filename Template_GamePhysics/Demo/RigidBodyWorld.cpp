@@ -0,0 +1,191 @@
+#include "RigidBodyWorld.h"
+
+int RigidBodyWorld::size()
+{
+	return (int)positions.size();
+}
+
+void RigidBodyWorld::clear()
+{
+	positions.clear();
+	orientations.clear();
+	velocities.clear();
+	angularMomenta.clear();
+	angularVelocities.clear();
+	scales.clear();
+	massInverses.clear();
+	inertiaInverses.clear();
+	worldInertiaInverses.clear();
+	isStatic.clear();
+	bodyShapes.clear();
+	shapes.clear();
+	forces.clear();
+	torques.clear();
+	prevPositions.clear();
+	prevOrientations.clear();
+	world.clear();
+	worldInverse.clear();
+	lower.clear();
+	upper.clear();
+}
+
+int RigidBodyWorld::addBox(XMFLOAT3 position, XMFLOAT3 rotation, XMFLOAT3 scale, float mass, XMFLOAT3 velocity)
+{
+	XMFLOAT4 orientation;
+	XMStoreFloat4(&orientation, XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z));
+	bool fixed = mass <= 0.f;
+	//solid box, I = m/12 (b^2 + c^2) about every axis
+	float x = scale.x*scale.x, y = scale.y*scale.y, z = scale.z*scale.z;
+	XMFLOAT3 inertiaInverse = fixed ? XMFLOAT3(0.f, 0.f, 0.f) : XMFLOAT3(12.f/(mass*(y + z)), 12.f/(mass*(x + z)), 12.f/(mass*(x + y)));
+	XMFLOAT3 zero(0.f, 0.f, 0.f);
+
+	positions.push_back(position);
+	orientations.push_back(orientation);
+	velocities.push_back(fixed ? zero : velocity);
+	angularMomenta.push_back(zero);
+	angularVelocities.push_back(zero);
+	scales.push_back(scale);
+	massInverses.push_back(fixed ? 0.f : 1.f/mass);
+	inertiaInverses.push_back(inertiaInverse);
+	worldInertiaInverses.push_back(XMFLOAT4X4());
+	isStatic.push_back(fixed);
+	forces.push_back(zero);
+	torques.push_back(zero);
+	prevPositions.push_back(position);
+	prevOrientations.push_back(orientation);
+	world.push_back(XMFLOAT4X4());
+	worldInverse.push_back(XMFLOAT4X4());
+	lower.push_back(position);
+	upper.push_back(position);
+	bodyShapes.push_back(-1);
+	int body = size() - 1;
+	updateInertia(body);
+	return body;
+}
+
+int RigidBodyWorld::addShapeType(const ConvexShape& shape)
+{
+	shapes.push_back(shape);
+	return (int)shapes.size() - 1;
+}
+
+int RigidBodyWorld::addShape(XMFLOAT3 position, XMFLOAT3 rotation, int shape, float mass, XMFLOAT3 velocity)
+{
+	int body = addBox(position, rotation, XMFLOAT3(1.f, 1.f, 1.f), mass, velocity);
+	bodyShapes[body] = shape;
+	XMFLOAT3 inertia = shapes[shape].unitInertia();
+	if(!isStatic[body])
+		inertiaInverses[body] = XMFLOAT3(1.f/(mass*inertia.x), 1.f/(mass*inertia.y), 1.f/(mass*inertia.z));
+	updateInertia(body);
+	return body;
+}
+
+const ConvexShape& RigidBodyWorld::shape(int body, ConvexShape& box)
+{
+	if(bodyShapes[body] >= 0)
+		return shapes[bodyShapes[body]];
+	const XMFLOAT3& s = scales[body];
+	box.type = ConvexShape::BOX;
+	box.halfExtents = XMFLOAT3(0.5f*s.x, 0.5f*s.y, 0.5f*s.z);
+	return box;
+}
+
+void RigidBodyWorld::applyForce(int body, XMFLOAT3 point, XMFLOAT3 force)
+{
+	if(isStatic[body])
+		return;
+	XMVECTOR f = XMLoadFloat3(&force);
+	XMVECTOR arm = XMLoadFloat3(&point) - XMLoadFloat3(&positions[body]);
+	XMStoreFloat3(&forces[body], XMLoadFloat3(&forces[body]) + f);
+	XMStoreFloat3(&torques[body], XMLoadFloat3(&torques[body]) + XMVector3Cross(arm, f));
+}
+
+void RigidBodyWorld::integrateVelocities(float timeStep, float gravity, float linearDamping, float angularDamping, ThreadPool& pool)
+{
+	XMVECTOR g = XMVectorSet(0.f, gravity, 0.f, 0.f);
+	pool.parallelFor(size(), 256, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			if(isStatic[i])
+				continue;
+			XMVECTOR v = XMLoadFloat3(&velocities[i]) + (XMLoadFloat3(&forces[i])*massInverses[i] + g)*timeStep;
+			XMVECTOR L = XMLoadFloat3(&angularMomenta[i]) + XMLoadFloat3(&torques[i])*timeStep;
+			//damping the momentum, the angular velocity follows from it
+			XMStoreFloat3(&velocities[i], v*(1.f - linearDamping*timeStep));
+			XMStoreFloat3(&angularMomenta[i], L*(1.f - angularDamping*timeStep));
+			XMStoreFloat3(&angularVelocities[i], XMVector3Transform(XMLoadFloat3(&angularMomenta[i]), XMLoadFloat4x4(&worldInertiaInverses[i])));
+			forces[i] = torques[i] = XMFLOAT3(0.f, 0.f, 0.f);
+		}
+	});
+}
+
+void RigidBodyWorld::integratePositions(float timeStep, ThreadPool& pool, const std::vector<char>* moved)
+{
+	pool.parallelFor(size(), 256, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			if(isStatic[i] || (moved && (*moved)[i]))
+				continue;
+			correctPosition(i, XMLoadFloat3(&velocities[i])*timeStep, XMLoadFloat3(&angularVelocities[i])*timeStep);
+		}
+	});
+}
+
+void RigidBodyWorld::correctPosition(int body, XMVECTOR translation, XMVECTOR rotation)
+{
+	if(isStatic[body])
+		return;
+	XMStoreFloat3(&positions[body], XMLoadFloat3(&positions[body]) + translation);
+	//first order quaternion update, XMQuaternionMultiply(a, b) is b*a and the rotation is in world space
+	XMVECTOR q = XMLoadFloat4(&orientations[body]);
+	XMVECTOR turn = XMQuaternionMultiply(q, XMVectorSetW(rotation, 0.f));
+	XMStoreFloat4(&orientations[body], XMQuaternionNormalize(q + turn*0.5f));
+	updateInertia(body);
+}
+
+void RigidBodyWorld::updateInertia(int body)
+{
+	//row vectors: into body space (transposed rotation), the body inverse inertia, back into world space
+	XMMATRIX rotation = XMMatrixRotationQuaternion(XMLoadFloat4(&orientations[body]));
+	const XMFLOAT3& d = inertiaInverses[body];
+	XMMATRIX inertia = XMMatrixMultiply(XMMatrixTranspose(rotation)*XMMatrixScaling(d.x, d.y, d.z), rotation);
+	XMStoreFloat4x4(&worldInertiaInverses[body], inertia);
+	XMStoreFloat3(&angularVelocities[body], XMVector3Transform(XMLoadFloat3(&angularMomenta[body]), inertia));
+}
+
+void RigidBodyWorld::updateTransforms(ThreadPool& pool)
+{
+	pool.parallelFor(size(), 256, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			const XMFLOAT3& s = scales[i];
+			const XMFLOAT3& p = positions[i];
+			XMMATRIX rotation = XMMatrixRotationQuaternion(XMLoadFloat4(&orientations[i]));
+			XMStoreFloat4x4(&world[i], XMMatrixScaling(s.x, s.y, s.z)*rotation*XMMatrixTranslation(p.x, p.y, p.z));
+			//the inverse of scale * rotation * translation, taken apart
+			XMStoreFloat4x4(&worldInverse[i], XMMatrixTranslation(-p.x, -p.y, -p.z)*XMMatrixTranspose(rotation)*XMMatrixScaling(1.f/s.x, 1.f/s.y, 1.f/s.z));
+			if(bodyShapes[i] >= 0) {
+				shapes[bodyShapes[i]].bounds(XMLoadFloat3(&p), XMLoadFloat4(&orientations[i]), lower[i], upper[i]);
+				continue;
+			}
+			//the half extents projected on the world axes, |R| * scale/2
+			XMVECTOR extent = XMVectorAbs(rotation.r[0])*(0.5f*s.x) + XMVectorAbs(rotation.r[1])*(0.5f*s.y) + XMVectorAbs(rotation.r[2])*(0.5f*s.z);
+			XMVECTOR centre = XMLoadFloat3(&p);
+			XMStoreFloat3(&lower[i], centre - extent);
+			XMStoreFloat3(&upper[i], centre + extent);
+		}
+	});
+}
+
+void RigidBodyWorld::storePreviousState()
+{
+	prevPositions = positions;
+	prevOrientations = orientations;
+}
+
+XMMATRIX RigidBodyWorld::renderTransform(int body, float alpha)
+{
+	if(alpha >= 1.f)
+		return XMLoadFloat4x4(&world[body]);
+	const XMFLOAT3& s = scales[body];
+	XMVECTOR position = XMVectorLerp(XMLoadFloat3(&prevPositions[body]), XMLoadFloat3(&positions[body]), alpha);
+	XMVECTOR orientation = XMQuaternionSlerp(XMLoadFloat4(&prevOrientations[body]), XMLoadFloat4(&orientations[body]), alpha);
+	return XMMatrixScaling(s.x, s.y, s.z)*XMMatrixRotationQuaternion(orientation)*XMMatrixTranslationFromVector(position);
+}
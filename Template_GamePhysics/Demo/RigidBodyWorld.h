@@ -0,0 +1,81 @@
+#pragma once
+#ifndef RigidBodyWorld_HEADER
+#define RigidBodyWorld_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "ThreadPool.h"
+#include "ConvexShape.h"
+
+// All boxes of demo 4 in structure of arrays form, body i is entry i of every array.
+// The bodies are scaled unit cubes, so a box needs no mass points: mass, diagonal body inertia and
+// scale are all there is to it. Static bodies (the floor) have no inverse mass or inertia and are
+// never moved.
+// A step is integrateVelocities (forces, gravity, damping), then the contact solver works on the
+// velocities, then integratePositions moves the bodies and updateTransforms writes the per step
+// cache: object to world matrix (scale, rotation, translation as in getObj2WorldMat), its inverse
+// (built directly, nothing inverted) and the world bounds. The cache then stays valid until the
+// next step and is what the broad phase, the narrow phase, mouse picking and drawing read, instead
+// of every one of them building the matrices from scale, quaternion and position again.
+// Bodies added with addShape are any ConvexShape (spheres, capsules, hulls) instead of a scaled
+// cube. They keep a scale of 1, so the cached matrix is their rotation and translation, and the
+// narrow phase takes them to GJK (see ConvexCollision). The shape types are shared between bodies.
+class RigidBodyWorld
+{
+public:
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT4> orientations;
+	std::vector<XMFLOAT3> velocities;
+	std::vector<XMFLOAT3> angularMomenta;
+	std::vector<XMFLOAT3> angularVelocities;
+	std::vector<XMFLOAT3> scales;
+	std::vector<float> massInverses;
+	//diagonal of the body space inverse inertia, and the world space one of the current orientation
+	std::vector<XMFLOAT3> inertiaInverses;
+	std::vector<XMFLOAT4X4> worldInertiaInverses;
+	std::vector<char> isStatic;
+	//index into shapes, -1 for the scaled unit cubes of addBox
+	std::vector<int> bodyShapes;
+	std::vector<ConvexShape> shapes;
+	//applied in the next integrateVelocities, then cleared
+	std::vector<XMFLOAT3> forces;
+	std::vector<XMFLOAT3> torques;
+	//state at the end of the previous fixed step, for render interpolation
+	std::vector<XMFLOAT3> prevPositions;
+	std::vector<XMFLOAT4> prevOrientations;
+
+	//per step cache, written by updateTransforms
+	std::vector<XMFLOAT4X4> world;
+	std::vector<XMFLOAT4X4> worldInverse;
+	std::vector<XMFLOAT3> lower;
+	std::vector<XMFLOAT3> upper;
+
+	int size();
+	void clear();
+	//a box of the given size, rotation as pitch, yaw, roll. a mass of 0 makes it static
+	int addBox(XMFLOAT3 position, XMFLOAT3 rotation, XMFLOAT3 scale, float mass, XMFLOAT3 velocity);
+	//a shape for addShape, returns its index
+	int addShapeType(const ConvexShape& shape);
+	int addShape(XMFLOAT3 position, XMFLOAT3 rotation, int shape, float mass, XMFLOAT3 velocity);
+	//the shape of a body, box is filled in for the unit cubes
+	const ConvexShape& shape(int body, ConvexShape& box);
+
+	//force at a world space point, also turns the body
+	void applyForce(int body, XMFLOAT3 point, XMFLOAT3 force);
+	void integrateVelocities(float timeStep, float gravity, float linearDamping, float angularDamping, ThreadPool& pool);
+	//bodies marked in moved (see ContinuousCollision) are left where they are
+	void integratePositions(float timeStep, ThreadPool& pool, const std::vector<char>* moved = nullptr);
+	//moves and turns (rotation vector, angle = length) a body without touching its velocity
+	void correctPosition(int body, XMVECTOR translation, XMVECTOR rotation);
+	//angular velocity and world inertia from the momentum and the current orientation
+	void updateInertia(int body);
+	void updateTransforms(ThreadPool& pool);
+
+	void storePreviousState();
+	//the cached matrix at alpha 1, otherwise built from the interpolated state
+	XMMATRIX renderTransform(int body, float alpha);
+};
+
+#endif
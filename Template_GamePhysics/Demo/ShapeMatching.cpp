@@ -0,0 +1,249 @@
+#include "ShapeMatching.h"
+
+#include <algorithm>
+#include <cmath>
+
+ShapeMatching::ShapeMatching()
+{
+	stiffness = 0.5f;
+	linearBlend = 0.f;
+	iterations = 2;
+	clusterCount = 0;
+	averageClusterSize = 0.f;
+	pointCount = 0;
+}
+
+bool ShapeMatching::isInitialized()
+{
+	return clusterCount > 0;
+}
+
+void ShapeMatching::clear()
+{
+	clusterCount = 0;
+	averageClusterSize = 0.f;
+	pointCount = 0;
+	clusterStart.clear();
+	members.clear();
+	restOffsets.clear();
+	restInverse.clear();
+	hasLinear.clear();
+	rotations.clear();
+	membershipStart.clear();
+	memberships.clear();
+}
+
+void ShapeMatching::initialize(const std::vector<SpringPoint>& points, const std::vector<XMFLOAT3>& restPositions, float cellSize)
+{
+	clear();
+	pointCount = (int)points.size();
+	if(pointCount == 0 || cellSize <= 0.f)
+		return;
+
+	//cell coordinates packed into 21 bits each
+	XMFLOAT3 lower = restPositions[0];
+	for(auto rest = restPositions.begin(); rest != restPositions.end(); rest++) {
+		lower.x = std::min(lower.x, rest->x);
+		lower.y = std::min(lower.y, rest->y);
+		lower.z = std::min(lower.z, rest->z);
+	}
+	const long long cellMask = (1 << 21) - 1;
+	std::vector<std::pair<long long, int>> sorted(pointCount);
+	for(int i = 0; i < pointCount; i++) {
+		const XMFLOAT3& p = restPositions[i];
+		long long x = std::min((long long)((p.x - lower.x)/cellSize), cellMask - 1);
+		long long y = std::min((long long)((p.y - lower.y)/cellSize), cellMask - 1);
+		long long z = std::min((long long)((p.z - lower.z)/cellSize), cellMask - 1);
+		sorted[i] = std::make_pair((x << 42) | (y << 21) | z, i);
+	}
+	std::sort(sorted.begin(), sorted.end());
+	std::vector<long long> cellKeys;
+	std::vector<int> cellStart;
+	for(int i = 0; i < pointCount; i++)
+		if(i == 0 || sorted[i].first != sorted[i-1].first) {
+			cellKeys.push_back(sorted[i].first);
+			cellStart.push_back(i);
+		}
+	cellStart.push_back(pointCount);
+
+	//one cluster per occupied cell covering it and its +x/+y/+z neighbours
+	clusterStart.push_back(0);
+	for(int c = 0; c < (int)cellKeys.size(); c++) {
+		int first = (int)members.size();
+		for(int d = 0; d < 8; d++) {
+			long long key = cellKeys[c] + ((long long)(d & 1) << 42) + ((long long)((d >> 1) & 1) << 21) + ((d >> 2) & 1);
+			auto cell = std::lower_bound(cellKeys.begin(), cellKeys.end(), key);
+			if(cell == cellKeys.end() || *cell != key)
+				continue;
+			int index = (int)(cell - cellKeys.begin());
+			for(int k = cellStart[index]; k < cellStart[index+1]; k++)
+				members.push_back(sorted[k].second);
+		}
+		//a single point has no shape to match
+		if((int)members.size() - first < 2) {
+			members.resize(first);
+			continue;
+		}
+		clusterStart.push_back((int)members.size());
+	}
+	clusterCount = (int)clusterStart.size() - 1;
+	averageClusterSize = clusterCount > 0 ? (float)members.size() / clusterCount : 0.f;
+
+	//rest shapes
+	restOffsets.resize(members.size());
+	restInverse.resize(clusterCount);
+	hasLinear.resize(clusterCount);
+	rotations.assign(clusterCount, XMFLOAT4(0.f, 0.f, 0.f, 1.f));
+	for(int c = 0; c < clusterCount; c++) {
+		XMFLOAT3 centre(0.f, 0.f, 0.f);
+		float mass = 0.f;
+		for(int k = clusterStart[c]; k < clusterStart[c+1]; k++) {
+			const XMFLOAT3& rest = restPositions[members[k]];
+			float m = points[members[k]].gp_mass;
+			centre.x += m*rest.x;
+			centre.y += m*rest.y;
+			centre.z += m*rest.z;
+			mass += m;
+		}
+		centre = XMFLOAT3(centre.x/mass, centre.y/mass, centre.z/mass);
+		Matrix3 aqq = Matrix3::zero();
+		for(int k = clusterStart[c]; k < clusterStart[c+1]; k++) {
+			const XMFLOAT3& rest = restPositions[members[k]];
+			float m = points[members[k]].gp_mass;
+			XMFLOAT3 q(rest.x - centre.x, rest.y - centre.y, rest.z - centre.z);
+			restOffsets[k] = q;
+			float v[3] = { q.x, q.y, q.z };
+			for(int r = 0; r < 3; r++)
+				for(int s = 0; s < 3; s++)
+					aqq.m[r][s] += m*v[r]*v[s];
+		}
+		//flat or straight clusters (cloth) can only be matched rigidly
+		float scale = aqq.m[0][0] + aqq.m[1][1] + aqq.m[2][2];
+		hasLinear[c] = std::abs(aqq.determinant()) > 1e-6f*scale*scale*scale && aqq.inverse(restInverse[c]);
+	}
+	buildMemberships();
+}
+
+void ShapeMatching::buildMemberships()
+{
+	membershipStart.assign(pointCount+1, 0);
+	for(auto member = members.begin(); member != members.end(); member++)
+		membershipStart[*member+1]++;
+	for(int i = 0; i < pointCount; i++)
+		membershipStart[i+1] += membershipStart[i];
+	memberships.resize(members.size());
+	std::vector<int> fill(membershipStart.begin(), membershipStart.end()-1);
+	for(int k = 0; k < (int)members.size(); k++)
+		memberships[fill[members[k]]++] = k;
+}
+
+void ShapeMatching::remapPoints(const std::vector<int>& newIndex)
+{
+	for(auto member = members.begin(); member != members.end(); member++)
+		*member = newIndex[*member];
+	buildMemberships();
+}
+
+void ShapeMatching::step(std::vector<SpringPoint>& points, float deltaTime, float gravity, ThreadPool& pool)
+{
+	if(!isInitialized() || (int)points.size() != pointCount)
+		return;
+	predicted.resize(pointCount);
+	goals.resize(members.size());
+
+	//free motion
+	pool.parallelFor(pointCount, 1024, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			SpringPoint& point = points[i];
+			if(!point.gp_isStatic)
+				point.gp_velocity.y += gravity*deltaTime;
+			predicted[i] = point.gp_isStatic ? point.gp_position : XMFLOAT3(point.gp_position.x + deltaTime*point.gp_velocity.x,
+				point.gp_position.y + deltaTime*point.gp_velocity.y, point.gp_position.z + deltaTime*point.gp_velocity.z);
+		}
+	});
+
+	//best transform per cluster: rotation of A_pq = sum m p q^T, optionally blended with A_pq A_qq^-1.
+	//every pass moves the predicted positions towards the averaged goals, more passes spread the shape
+	//through the overlapping clusters faster
+	float blend = std::min(std::max(linearBlend, 0.f), 1.f);
+	float alpha = std::min(std::max(stiffness, 0.f), 1.f);
+	for(int pass = 0; pass < std::max(iterations, 1); pass++) {
+		pool.parallelFor(clusterCount, 64, [&](int begin, int end) {
+			for(int c = begin; c < end; c++)
+				matchCluster(points, c, blend);
+		});
+		pool.parallelFor(pointCount, 1024, [&](int begin, int end) {
+			for(int i = begin; i < end; i++) {
+				int count = membershipStart[i+1] - membershipStart[i];
+				if(points[i].gp_isStatic || count == 0)
+					continue;
+				XMFLOAT3 sum(0.f, 0.f, 0.f);
+				for(int k = membershipStart[i]; k < membershipStart[i+1]; k++) {
+					const XMFLOAT3& goal = goals[memberships[k]];
+					sum.x += goal.x;
+					sum.y += goal.y;
+					sum.z += goal.z;
+				}
+				XMFLOAT3& x = predicted[i];
+				x = XMFLOAT3(x.x + alpha*(sum.x/count - x.x), x.y + alpha*(sum.y/count - x.y), x.z + alpha*(sum.z/count - x.z));
+			}
+		});
+	}
+
+	//velocities follow the position change
+	float inverseStep = 1.f/deltaTime;
+	pool.parallelFor(pointCount, 1024, [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			SpringPoint& point = points[i];
+			point.gp_posTemp = point.gp_position;
+			point.resetForces();
+			if(point.gp_isStatic)
+				continue;
+			const XMFLOAT3& target = predicted[i];
+			point.gp_velocity = XMFLOAT3((target.x - point.gp_position.x)*inverseStep, (target.y - point.gp_position.y)*inverseStep, (target.z - point.gp_position.z)*inverseStep);
+			point.gp_position = target;
+		}
+	});
+}
+
+void ShapeMatching::matchCluster(const std::vector<SpringPoint>& points, int c, float blend)
+{
+	XMFLOAT3 centre(0.f, 0.f, 0.f);
+	float mass = 0.f;
+	for(int k = clusterStart[c]; k < clusterStart[c+1]; k++) {
+		float m = points[members[k]].gp_mass;
+		const XMFLOAT3& x = predicted[members[k]];
+		centre.x += m*x.x;
+		centre.y += m*x.y;
+		centre.z += m*x.z;
+		mass += m;
+	}
+	centre = XMFLOAT3(centre.x/mass, centre.y/mass, centre.z/mass);
+	Matrix3 apq = Matrix3::zero();
+	for(int k = clusterStart[c]; k < clusterStart[c+1]; k++) {
+		float m = points[members[k]].gp_mass;
+		const XMFLOAT3& x = predicted[members[k]];
+		float p[3] = { m*(x.x - centre.x), m*(x.y - centre.y), m*(x.z - centre.z) };
+		float q[3] = { restOffsets[k].x, restOffsets[k].y, restOffsets[k].z };
+		for(int r = 0; r < 3; r++)
+			for(int s = 0; s < 3; s++)
+				apq.m[r][s] += p[r]*q[s];
+	}
+	Matrix3::extractRotation(apq, rotations[c], 5);
+	Matrix3 transform = Matrix3::fromQuaternion(rotations[c]);
+	if(blend > 0.f && hasLinear[c]) {
+		Matrix3 linear = apq*restInverse[c];
+		float det = linear.determinant();
+		if(det > 1e-6f) {
+			//volume preserving
+			float scale = 1.f/std::pow(det, 1.f/3.f);
+			for(int r = 0; r < 3; r++)
+				for(int s = 0; s < 3; s++)
+					transform.m[r][s] = blend*scale*linear.m[r][s] + (1-blend)*transform.m[r][s];
+		}
+	}
+	for(int k = clusterStart[c]; k < clusterStart[c+1]; k++) {
+		XMFLOAT3 goal = transform*restOffsets[k];
+		goals[k] = XMFLOAT3(goal.x + centre.x, goal.y + centre.y, goal.z + centre.z);
+	}
+}
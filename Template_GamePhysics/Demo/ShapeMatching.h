@@ -0,0 +1,72 @@
+#pragma once
+#ifndef ShapeMatching_HEADER
+#define ShapeMatching_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "Matrix3.h"
+#include "point.h"
+#include "ThreadPool.h"
+
+// Meshless shape matching ("Meshless Deformations Based on Shape Matching", Mueller et al. 2005)
+// on SpringPoints, as a cheap alternative to springs.
+// The rest positions are binned into cubic cells and every occupied cell starts a cluster of
+// 2x2x2 cells, so neighbouring clusters share points and the result is smooth. Each step the points
+// move freely under gravity, every cluster finds the best rigid (optionally blended with the best
+// linear) transform of its rest shape and each point is pulled towards the average of its goals.
+// The pull is a fraction of the distance, not a force, so there is no stiffness limit on the step.
+// Clusters are matched in parallel, goals are written per membership and gathered per point.
+class ShapeMatching
+{
+public:
+	//fraction of the way to the goal per step, 1 = rigid clusters
+	float stiffness;
+	//0 = rigid transforms only, up to 1 = volume preserving linear transforms
+	float linearBlend;
+	//matching passes per step
+	int iterations;
+
+	//statistics
+	int clusterCount;
+	float averageClusterSize;
+
+	ShapeMatching();
+
+	//restPositions (one per point) are the rest shape, the points only give the masses
+	void initialize(const std::vector<SpringPoint>& points, const std::vector<XMFLOAT3>& restPositions, float cellSize);
+	bool isInitialized();
+	void clear();
+
+	//moves the non static points, forces are left at zero
+	void step(std::vector<SpringPoint>& points, float deltaTime, float gravity, ThreadPool& pool);
+
+	//after the points were renumbered, newIndex[old index] = new index
+	void remapPoints(const std::vector<int>& newIndex);
+
+private:
+	int pointCount;
+	//members of cluster c are members[clusterStart[c] .. clusterStart[c+1])
+	std::vector<int> clusterStart;
+	std::vector<int> members;
+	//rest position relative to the cluster's rest centre of mass, per membership
+	std::vector<XMFLOAT3> restOffsets;
+	//inverse of sum m q q^T, only valid if hasLinear
+	std::vector<Matrix3> restInverse;
+	std::vector<char> hasLinear;
+	//warm start of the polar decomposition
+	std::vector<XMFLOAT4> rotations;
+	//memberships of every point, for gathering the goals
+	std::vector<int> membershipStart;
+	std::vector<int> memberships;
+
+	std::vector<XMFLOAT3> goals;
+	std::vector<XMFLOAT3> predicted;
+
+	void buildMemberships();
+	//writes the goals of cluster c from the predicted positions
+	void matchCluster(const std::vector<SpringPoint>& points, int c, float blend);
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "SimulationClock.h"
+
+SimulationClock::SimulationClock()
+{
+	fixedStep = 0.005f;
+	maxSubSteps = 8;
+	reset();
+}
+
+SimulationClock::SimulationClock(float fixedStep, int maxSubSteps) : fixedStep(fixedStep), maxSubSteps(maxSubSteps)
+{
+	reset();
+}
+
+void SimulationClock::reset()
+{
+	accumulator = 0.0f;
+	alpha = 1.0f;
+	lastSubSteps = 0;
+	droppedTime = 0.0f;
+}
+
+int SimulationClock::advance(float frameTime)
+{
+	if(fixedStep <= 0.0f)
+		fixedStep = 0.001f;
+	if(frameTime < 0.0f)
+		frameTime = 0.0f;
+
+	accumulator += frameTime;
+	int steps = (int)(accumulator / fixedStep);
+	droppedTime = 0.0f;
+	//spiral of death: if we can't keep up, drop the time instead of simulating even more next frame
+	if(steps > maxSubSteps) {
+		droppedTime = (steps - maxSubSteps) * fixedStep;
+		steps = maxSubSteps;
+	}
+	accumulator -= (steps * fixedStep) + droppedTime;
+	if(accumulator < 0.0f)
+		accumulator = 0.0f;
+	alpha = accumulator / fixedStep;
+	if(alpha > 1.0f)
+		alpha = 1.0f;
+	lastSubSteps = steps;
+	return steps;
+}
+
+int SimulationClock::singleStep()
+{
+	//the step ends exactly at the displayed state, nothing to interpolate
+	accumulator = 0.0f;
+	alpha = 1.0f;
+	droppedTime = 0.0f;
+	lastSubSteps = 1;
+	return 1;
+}
+
+float SimulationClock::getAlpha()
+{
+	return alpha;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef SimulationClock_HEADER
+#define SimulationClock_HEADER
+
+// Fixed step simulation clock.
+// Real frame time is accumulated and consumed in steps of fixedStep, so the simulation no longer depends on the frame rate.
+// At most maxSubSteps are taken per frame; time beyond that is dropped instead of producing ever longer frames.
+// The remainder of the accumulator gives the interpolation factor between the last two simulated states.
+class SimulationClock
+{
+public:
+	float fixedStep;
+	int maxSubSteps;
+
+	//statistics of the last frame
+	int lastSubSteps;
+	float droppedTime;
+
+	SimulationClock();
+	SimulationClock(float fixedStep, int maxSubSteps);
+
+	void reset();
+	//adds the frame time and returns how many fixed steps have to be simulated this frame
+	int advance(float frameTime);
+	//forces exactly one step (used when stepping manually or with a frame locked timestep)
+	int singleStep();
+	//0 = previous state, 1 = current state
+	float getAlpha();
+
+private:
+	float accumulator;
+	float alpha;
+};
+
+#endif
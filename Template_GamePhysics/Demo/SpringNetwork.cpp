@@ -0,0 +1,231 @@
+#include "SpringNetwork.h"
+
+#include <algorithm>
+
+SpringNetwork::SpringNetwork()
+{
+	clear();
+}
+
+void SpringNetwork::clear()
+{
+	points.clear();
+	restPositions.clear();
+	springs.clear();
+	adjacency.clear();
+	triangles.clear();
+	tearList.clear();
+	tornFlags.clear();
+	topologyRevision = 0;
+	lastTornSprings = 0;
+	totalTornSprings = 0;
+}
+
+void SpringNetwork::reserve(int pointCount, int springCount)
+{
+	//grow through addPoint's path so existing spring pointers are fixed up
+	if(pointCount > (int)points.capacity() && !points.empty()) {
+		std::vector<SpringPoint> grown;
+		grown.reserve(pointCount);
+		grown.assign(points.begin(), points.end());
+		for(auto spring = springs.begin(); spring != springs.end(); spring++) {
+			spring->gs_point1 = &grown[getPointIndex(spring->gs_point1)];
+			spring->gs_point2 = &grown[getPointIndex(spring->gs_point2)];
+		}
+		points.swap(grown);
+	}
+	else
+		points.reserve(pointCount);
+	restPositions.reserve(pointCount);
+	adjacency.reserve(pointCount);
+	springs.reserve(springCount);
+	tornFlags.reserve(springCount);
+}
+
+int SpringNetwork::addPoint(const SpringPoint& point)
+{
+	if(points.size() == points.capacity())
+		reserve(std::max<int>(16, 2*(int)points.size()), (int)springs.capacity());
+	points.push_back(point);
+	restPositions.push_back(point.gp_position);
+	adjacency.push_back(std::vector<int>());
+	return (int)points.size()-1;
+}
+
+int SpringNetwork::addSpring(int point1, int point2, float stiffness, float damping)
+{
+	Spring spring(&points[point1], &points[point2]);
+	spring.setDamping(damping);
+	spring.computeCurrentLength();
+	spring.setRestLength(spring.getCurrentLength());
+	spring.setStiffness(stiffness);
+	springs.push_back(spring);
+	tornFlags.push_back(0);
+	adjacency[point1].push_back(point2);
+	adjacency[point2].push_back(point1);
+	topologyRevision++;
+	return (int)springs.size()-1;
+}
+
+void SpringNetwork::addSprings(const std::vector<int>& endpoints, const std::vector<float>& stiffness, float damping)
+{
+	int count = (int)stiffness.size();
+	if(count == 0)
+		return;
+	springs.reserve(springs.size() + count);
+	tornFlags.resize(tornFlags.size() + count, 0);
+
+	std::vector<int> degree(points.size(), 0);
+	for(int i = 0; i < 2*count; i++)
+		degree[endpoints[i]]++;
+	for(size_t i = 0; i < points.size(); i++)
+		if(degree[i] > 0)
+			adjacency[i].reserve(adjacency[i].size() + degree[i]);
+
+	Spring spring;
+	spring.setDamping(damping);
+	for(int i = 0; i < count; i++) {
+		int point1 = endpoints[2*i], point2 = endpoints[2*i+1];
+		spring.gs_point1 = &points[point1];
+		spring.gs_point2 = &points[point2];
+		spring.computeCurrentLength();
+		spring.setRestLength(spring.getCurrentLength());
+		spring.setStiffness(stiffness[i]);
+		springs.push_back(spring);
+		adjacency[point1].push_back(point2);
+		adjacency[point2].push_back(point1);
+	}
+	topologyRevision++;
+}
+
+void SpringNetwork::addTriangle(int point1, int point2, int point3)
+{
+	triangles.push_back(point1);
+	triangles.push_back(point2);
+	triangles.push_back(point3);
+}
+
+int SpringNetwork::getTriangleCount()
+{
+	return (int)triangles.size()/3;
+}
+
+void SpringNetwork::permutePoints(const std::vector<int>& newIndex)
+{
+	if(hasPendingTears())
+		applyTears();
+	int pointCount = (int)points.size();
+
+	std::vector<SpringPoint> newPoints(pointCount);
+	std::vector<XMFLOAT3> newRestPositions(pointCount);
+	std::vector<std::vector<int>> newAdjacency(pointCount);
+	for(int i = 0; i < pointCount; i++) {
+		newPoints[newIndex[i]] = points[i];
+		newRestPositions[newIndex[i]] = restPositions[i];
+		std::vector<int>& n = newAdjacency[newIndex[i]];
+		n.swap(adjacency[i]);
+		for(auto neighbour = n.begin(); neighbour != n.end(); neighbour++)
+			*neighbour = newIndex[*neighbour];
+	}
+
+	//springs by (lower, upper) end point, so a pass over the springs walks the points forward
+	int springCount = (int)springs.size();
+	std::vector<long long> keys(springCount);
+	for(int i = 0; i < springCount; i++) {
+		long long a = newIndex[getPointIndex(springs[i].gs_point1)], b = newIndex[getPointIndex(springs[i].gs_point2)];
+		if(a > b)
+			std::swap(a, b);
+		keys[i] = (a << 32) | b;
+	}
+	std::vector<int> springOrder(springCount);
+	for(int i = 0; i < springCount; i++)
+		springOrder[i] = i;
+	std::stable_sort(springOrder.begin(), springOrder.end(), [&](int x, int y) { return keys[x] < keys[y]; });
+	std::vector<Spring> newSprings(springCount);
+	for(int i = 0; i < springCount; i++) {
+		newSprings[i] = springs[springOrder[i]];
+		long long key = keys[springOrder[i]];
+		newSprings[i].gs_point1 = &newPoints[(int)(key >> 32)];
+		newSprings[i].gs_point2 = &newPoints[(int)(key & 0xffffffff)];
+	}
+
+	for(auto t = triangles.begin(); t != triangles.end(); t++)
+		*t = newIndex[*t];
+
+	points.swap(newPoints);
+	restPositions.swap(newRestPositions);
+	adjacency.swap(newAdjacency);
+	springs.swap(newSprings);
+	topologyRevision++;
+}
+
+int SpringNetwork::getPointIndex(const SpringPoint* point)
+{
+	return (int)(point - &points[0]);
+}
+
+bool SpringNetwork::areConnected(int point1, int point2)
+{
+	const std::vector<int>& n = adjacency[point1];
+	return std::find(n.begin(), n.end(), point2) != n.end();
+}
+
+void SpringNetwork::markTorn(int spring)
+{
+	if(tornFlags[spring])
+		return;
+	tornFlags[spring] = 1;
+	tearList.push_back(spring);
+}
+
+bool SpringNetwork::hasPendingTears()
+{
+	return !tearList.empty();
+}
+
+bool SpringNetwork::isMarkedTorn(int spring)
+{
+	return tornFlags[spring] != 0;
+}
+
+void SpringNetwork::removeNeighbour(int point, int neighbour)
+{
+	//swap and pop, the order of the neighbours doesn't matter
+	std::vector<int>& n = adjacency[point];
+	for(size_t i = 0; i < n.size(); i++) {
+		if(n[i] == neighbour) {
+			n[i] = n.back();
+			n.pop_back();
+			return;
+		}
+	}
+}
+
+void SpringNetwork::applyTears()
+{
+	lastTornSprings = (int)tearList.size();
+	if(tearList.empty())
+		return;
+
+	//adjacency only has to be touched around the torn springs
+	std::sort(tearList.begin(), tearList.end());
+	for(auto t = tearList.begin(); t != tearList.end(); t++) {
+		int i1 = getPointIndex(springs[*t].gs_point1);
+		int i2 = getPointIndex(springs[*t].gs_point2);
+		removeNeighbour(i1, i2);
+		removeNeighbour(i2, i1);
+	}
+
+	//swap and pop from the highest index down, so the last spring moved into a torn slot is never torn itself.
+	//O(torn springs), the springs after a torn one keep their place apart from the one moved in
+	for(auto t = tearList.rbegin(); t != tearList.rend(); t++) {
+		springs[*t] = springs.back();
+		springs.pop_back();
+		tornFlags[*t] = 0;
+		tornFlags.pop_back();
+	}
+
+	totalTornSprings += lastTornSprings;
+	tearList.clear();
+	topologyRevision++;
+}
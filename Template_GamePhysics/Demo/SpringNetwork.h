@@ -0,0 +1,70 @@
+#pragma once
+#ifndef SpringNetwork_HEADER
+#define SpringNetwork_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "point.h"
+#include "spring.h"
+
+// Mass spring network with contiguous point and spring storage (used by the cloth).
+// Springs point into the points vector, so the points must not be reallocated behind their back:
+// addPoint takes care of that while building, afterwards the point array stays fixed.
+// Removing springs (tearing) is deferred: springs are marked during the force pass and
+// removed together by applyTears() once the step is done, so nobody erases while iterating.
+class SpringNetwork
+{
+public:
+	std::vector<SpringPoint> points;
+	//where each point was when it was added, permuted along with the points
+	std::vector<XMFLOAT3> restPositions;
+	std::vector<Spring> springs;
+	//indices of the points connected to each point, kept in sync when springs tear
+	std::vector<std::vector<int>> adjacency;
+	//surface triangles, three point indices each (only used for collisions, tearing leaves them alone)
+	std::vector<int> triangles;
+
+	//incremented on every topology change, anything cached per spring (colourings, factorisations) compares against it
+	int topologyRevision;
+	int lastTornSprings;
+	int totalTornSprings;
+
+	SpringNetwork();
+
+	void clear();
+	void reserve(int pointCount, int springCount);
+	//returns the index of the new point
+	int addPoint(const SpringPoint& point);
+	//rest length is the current distance of the two points, returns the index of the new spring
+	int addSpring(int point1, int point2, float stiffness, float damping);
+	//bulk version for generated meshes: endpoints holds two point indices per spring,
+	//adjacency is grown once per point instead of once per spring
+	void addSprings(const std::vector<int>& endpoints, const std::vector<float>& stiffness, float damping);
+	void addTriangle(int point1, int point2, int point3);
+	int getTriangleCount();
+
+	//renumbers the points, newIndex[old index] = new index. springs are re-pointed, ordered by their lower
+	//end point (which becomes gs_point1) and adjacency and triangles are remapped. Pending tears are applied first
+	void permutePoints(const std::vector<int>& newIndex);
+
+	int getPointIndex(const SpringPoint* point);
+	bool areConnected(int point1, int point2);
+
+	//marks a spring for removal, cheap enough to call from the force loop
+	void markTorn(int spring);
+	bool hasPendingTears();
+	bool isMarkedTorn(int spring);
+	//removes all marked springs in O(torn springs), the last springs are moved into the freed slots so the
+	//order changes. spring indices are only valid within one topologyRevision anyway
+	void applyTears();
+
+private:
+	std::vector<int> tearList;
+	std::vector<char> tornFlags;
+
+	void removeNeighbour(int point, int neighbour);
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "StepArena.h"
+
+#include <cstdlib>
+#include <algorithm>
+#ifdef COUNT_HEAP_ALLOCATIONS
+#include <new>
+#include <atomic>
+#endif
+
+StepArena::StepArena(size_t initialSize)
+{
+	blockAllocations = 0;
+	highWater = 0;
+	blockSize = std::max<size_t>(initialSize, 4096);
+	block = (char*)malloc(blockSize);
+	blockAllocations++;
+	offset = 0;
+	overflowUsed = 0;
+}
+
+StepArena::~StepArena()
+{
+	for(auto b = overflowBlocks.begin(); b != overflowBlocks.end(); b++)
+		free(*b);
+	free(block);
+}
+
+void* StepArena::allocate(size_t bytes, size_t alignment)
+{
+	size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+	if(aligned + bytes > blockSize) {
+		grow(bytes + alignment);
+		aligned = (offset + alignment - 1) & ~(alignment - 1);
+	}
+	offset = aligned + bytes;
+	highWater = std::max(highWater, overflowUsed + offset);
+	return block + aligned;
+}
+
+void StepArena::grow(size_t bytes)
+{
+	//keep the full block alive until the reset, everything handed out from it is still in use
+	overflowBlocks.push_back(block);
+	overflowUsed += offset;
+	blockSize = std::max(2*blockSize, bytes);
+	block = (char*)malloc(blockSize);
+	blockAllocations++;
+	offset = 0;
+}
+
+void StepArena::reset()
+{
+	offset = 0;
+	if(overflowBlocks.empty())
+		return;
+	//the last step didn't fit, replace everything by one block big enough for it
+	size_t needed = highWater;
+	for(auto b = overflowBlocks.begin(); b != overflowBlocks.end(); b++)
+		free(*b);
+	overflowBlocks.clear();
+	overflowUsed = 0;
+	if(needed > blockSize) {
+		free(block);
+		blockSize = needed + needed/4;
+		block = (char*)malloc(blockSize);
+		blockAllocations++;
+	}
+}
+
+size_t StepArena::getUsed()
+{
+	return overflowUsed + offset;
+}
+
+size_t StepArena::getCapacity()
+{
+	//retired blocks only count with the part that was used, they are freed at the next reset
+	return blockSize + overflowUsed;
+}
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+//counting replacements of the global allocation functions
+static std::atomic<long long> heapAllocationCount(0);
+
+long long getHeapAllocationCount()
+{
+	return heapAllocationCount;
+}
+
+void* operator new(size_t size)
+{
+	heapAllocationCount++;
+	void* p = malloc(size ? size : 1);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p)
+{
+	free(p);
+}
+
+void operator delete[](void* p)
+{
+	free(p);
+}
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+#ifndef StepArena_HEADER
+#define StepArena_HEADER
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Monotonic arena for data that only lives during one simulation step (neighbour lists, contact
+// buffers, per-point corrections). allocate() just bumps an offset, reset() at the end of the
+// step releases everything at once. If a step needs more than the block holds, extra blocks are
+// taken from the heap and merged into one bigger block at the next reset, so after a few steps
+// the arena stops touching the heap.
+// Nothing allocated from the arena is destructed, only use it for plain data.
+class StepArena
+{
+public:
+	//statistics
+	int blockAllocations;
+	size_t highWater;
+
+	StepArena(size_t initialSize = 1 << 20);
+	~StepArena();
+
+	void* allocate(size_t bytes, size_t alignment = 16);
+	template<class T> T* allocateArray(size_t count)
+	{
+		return (T*)allocate(count*sizeof(T), __alignof(T) > 16 ? __alignof(T) : 16);
+	}
+	//releases everything allocated since the last reset
+	void reset();
+
+	size_t getUsed();
+	size_t getCapacity();
+
+private:
+	char* block;
+	size_t blockSize;
+	size_t offset;
+	//blocks added during this step, merged at the next reset
+	std::vector<char*> overflowBlocks;
+	size_t overflowUsed;
+
+	void grow(size_t bytes);
+
+	//not copyable
+	StepArena(const StepArena&);
+	StepArena& operator=(const StepArena&);
+};
+
+// Growable array whose storage lives in a StepArena. Only for plain types (pointers, indices, XMFLOAT3),
+// elements are copied with memcpy and never destructed. Growing leaves the old storage in the arena
+// until the next reset, clear() keeps the capacity, so one vector reused through a step stays cheap.
+template<class T>
+class ScratchVector
+{
+public:
+	ScratchVector(StepArena& arena) : arena(&arena), data(nullptr), count(0), capacity(0) {}
+
+	void push_back(const T& value)
+	{
+		if(count == capacity)
+			reserve(capacity < 16 ? 16 : 2*capacity);
+		data[count++] = value;
+	}
+	void reserve(size_t newCapacity)
+	{
+		if(newCapacity <= capacity)
+			return;
+		T* newData = arena->allocateArray<T>(newCapacity);
+		if(count > 0)
+			memcpy(newData, data, count*sizeof(T));
+		data = newData;
+		capacity = newCapacity;
+	}
+	void resize(size_t newCount)
+	{
+		reserve(newCount);
+		count = newCount;
+	}
+	void clear() { count = 0; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T& operator[](size_t i) { return data[i]; }
+	const T& operator[](size_t i) const { return data[i]; }
+	T* begin() { return data; }
+	T* end() { return data + count; }
+
+private:
+	StepArena* arena;
+	T* data;
+	size_t count;
+	size_t capacity;
+};
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+// number of heap allocations (operator new) made by the whole program so far, take the difference
+// around a step to check that the steady state doesn't allocate. Replacing the global operator
+// new/delete affects everything linked in, so it is only done in builds that define
+// COUNT_HEAP_ALLOCATIONS (in the project settings, e.g. for benchmarking); otherwise blockAllocations
+// still says whether the arena itself had to go to the heap
+long long getHeapAllocationCount();
+#endif
+
+#endif
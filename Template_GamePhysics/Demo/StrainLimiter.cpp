@@ -0,0 +1,126 @@
+#include "StrainLimiter.h"
+
+#include <algorithm>
+#include <atomic>
+
+//colours are tracked as bits of a 64 bit mask per point, springs that don't fit go into colour 64
+//which is processed serially (doesn't happen for cloth, the point degree is far below that)
+static const int serialColour = 64;
+
+StrainLimiter::StrainLimiter()
+{
+	maxStretch = 0.1f;
+	maxCompression = 0.1f;
+	iterations = 8;
+	colourCount = 0;
+	lastLimitedSprings = 0;
+	colouredRevision = -1;
+}
+
+void StrainLimiter::buildColouring(SpringNetwork& network)
+{
+	int springCount = (int)network.springs.size();
+	//colours already taken at every point
+	std::vector<unsigned long long> used(network.points.size(), 0);
+	std::vector<int> colour(springCount);
+	colourCount = 0;
+	for(int i = 0; i < springCount; i++) {
+		int p1 = network.getPointIndex(network.springs[i].gs_point1);
+		int p2 = network.getPointIndex(network.springs[i].gs_point2);
+		unsigned long long taken = used[p1] | used[p2];
+		int c = 0;
+		while(c < serialColour && (taken >> c) & 1)
+			c++;
+		if(c < serialColour) {
+			used[p1] |= 1ULL << c;
+			used[p2] |= 1ULL << c;
+		}
+		colour[i] = c;
+		colourCount = std::max(colourCount, c+1);
+	}
+
+	//counting sort by colour, springs keep their order inside a colour
+	colourStart.assign(colourCount+1, 0);
+	for(int i = 0; i < springCount; i++)
+		colourStart[colour[i]+1]++;
+	for(int c = 0; c < colourCount; c++)
+		colourStart[c+1] += colourStart[c];
+	colourOrder.resize(springCount);
+	std::vector<int> fill(colourStart.begin(), colourStart.end()-1);
+	for(int i = 0; i < springCount; i++)
+		colourOrder[fill[colour[i]]++] = i;
+
+	colouredRevision = network.topologyRevision;
+}
+
+void StrainLimiter::apply(SpringNetwork& network, ThreadPool& pool)
+{
+	lastLimitedSprings = 0;
+	if(network.springs.empty())
+		return;
+	if(colouredRevision != network.topologyRevision)
+		buildColouring(network);
+
+	Spring* springs = &network.springs[0];
+	float lower = std::max(0.f, 1.f - maxCompression), upper = 1.f + maxStretch;
+	std::atomic<int> limited(0);
+	for(int iteration = 0; iteration < iterations; iteration++) {
+		for(int c = 0; c < colourCount; c++) {
+			const int* order = &colourOrder[colourStart[c]];
+			int count = colourStart[c+1] - colourStart[c];
+			auto limit = [&](int begin, int end) {
+				int outside = 0;
+				for(int i = begin; i < end; i++) {
+					int s = order[i];
+					//springs that tear this step are left alone, they are removed after the step
+					if(network.isMarkedTorn(s))
+						continue;
+					Spring& spring = springs[s];
+					SpringPoint* p1 = spring.gs_point1;
+					SpringPoint* p2 = spring.gs_point2;
+					float w1 = p1->gp_isStatic ? 0.f : 1.f/p1->gp_mass;
+					float w2 = p2->gp_isStatic ? 0.f : 1.f/p2->gp_mass;
+					if(w1 + w2 == 0.f)
+						continue;
+					XMVECTOR x1 = XMLoadFloat3(&p1->gp_position), x2 = XMLoadFloat3(&p2->gp_position);
+					XMVECTOR delta = x2 - x1;
+					float length = XMVectorGetX(XMVector3Length(delta));
+					float target = std::min(std::max(length, lower*spring.gs_initialLength), upper*spring.gs_initialLength);
+					if(target == length || length < 1e-12f)
+						continue;
+					outside++;
+
+					//move both ends along the spring, the lighter one further
+					XMVECTOR direction = delta / length;
+					XMVECTOR correction = direction * ((length - target) / (w1 + w2));
+					XMStoreFloat3(&p1->gp_position, x1 + correction*w1);
+					XMStoreFloat3(&p2->gp_position, x2 - correction*w2);
+
+					//and remove the velocity that keeps pushing past the limit, this is what keeps larger steps stable
+					XMVECTOR v1 = XMLoadFloat3(&p1->gp_velocity), v2 = XMLoadFloat3(&p2->gp_velocity);
+					float separating = XMVectorGetX(XMVector3Dot(v2 - v1, direction));
+					if((length > target && separating > 0.f) || (length < target && separating < 0.f)) {
+						XMVECTOR impulse = direction * (separating / (w1 + w2));
+						XMStoreFloat3(&p1->gp_velocity, v1 + impulse*w1);
+						XMStoreFloat3(&p2->gp_velocity, v2 - impulse*w2);
+					}
+				}
+				return outside;
+			};
+			if(c == serialColour) {
+				//points may be shared in this one
+				int outside = limit(0, count);
+				if(iteration == 0)
+					limited += outside;
+			}
+			else {
+				pool.parallelFor(count, 256, [&](int begin, int end) {
+					int outside = limit(begin, end);
+					if(iteration == 0)
+						limited += outside;
+				});
+			}
+		}
+	}
+	lastLimitedSprings = limited;
+}
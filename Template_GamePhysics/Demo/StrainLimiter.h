@@ -0,0 +1,45 @@
+#pragma once
+#ifndef StrainLimiter_HEADER
+#define StrainLimiter_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include "SpringNetwork.h"
+#include "ThreadPool.h"
+
+// Strain limiting post pass for spring networks.
+// After the integration every spring longer than (1+maxStretch) or shorter than (1-maxCompression)
+// times its rest length is moved back into that range, the correction is split by inverse mass.
+// The relative velocity that drives the spring further out of the range is removed as well,
+// which damps the stiff modes that make the explicit integrators blow up at larger steps.
+// Springs are greedily coloured so that no two springs of one colour share a point, every colour
+// is processed in parallel without locks (Gauss-Seidel between colours, Jacobi within one).
+class StrainLimiter
+{
+public:
+	//allowed relative stretch and compression, 0.1 = 10%
+	float maxStretch;
+	float maxCompression;
+	int iterations;
+
+	//statistics
+	int colourCount;
+	//springs outside the range in the first iteration of the last apply()
+	int lastLimitedSprings;
+
+	StrainLimiter();
+
+	void apply(SpringNetwork& network, ThreadPool& pool);
+
+private:
+	//springs sorted by colour, colour c is colourOrder[colourStart[c] .. colourStart[c+1])
+	std::vector<int> colourOrder;
+	std::vector<int> colourStart;
+	int colouredRevision;
+
+	void buildColouring(SpringNetwork& network);
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+
+static float component(const XMFLOAT3& v, int axis)
+{
+	return (&v.x)[axis];
+}
+
+SweepAndPrune::SweepAndPrune()
+{
+	sweepAxis = 0;
+	swaps = 0;
+	overlapTests = 0;
+	boxCount = 0;
+}
+
+void SweepAndPrune::clear()
+{
+	pairs.clear();
+	endpoints.clear();
+	values.clear();
+	open.clear();
+	openSlot.clear();
+	boxCount = 0;
+	swaps = 0;
+	overlapTests = 0;
+}
+
+void SweepAndPrune::chooseAxis(const std::vector<XMFLOAT3>& lower, const std::vector<XMFLOAT3>& upper)
+{
+	//variance of the box centres per axis
+	float sum[3] = { 0.f, 0.f, 0.f }, squares[3] = { 0.f, 0.f, 0.f };
+	for(int i = 0; i < (int)lower.size(); i++)
+		for(int axis = 0; axis < 3; axis++) {
+			float centre = 0.5f*(component(lower[i], axis) + component(upper[i], axis));
+			sum[axis] += centre;
+			squares[axis] += centre*centre;
+		}
+	float variance[3];
+	int best = 0;
+	for(int axis = 0; axis < 3; axis++) {
+		variance[axis] = squares[axis] - sum[axis]*sum[axis]/lower.size();
+		if(variance[axis] > variance[best])
+			best = axis;
+	}
+	bool restart = boxCount != (int)lower.size();
+	if(!restart && variance[best] <= 1.5f*variance[sweepAxis])
+		return;
+	sweepAxis = best;
+	boxCount = (int)lower.size();
+	endpoints.resize(2*boxCount);
+	values.resize(2*boxCount);
+	for(int i = 0; i < 2*boxCount; i++)
+		endpoints[i] = i;
+	std::sort(endpoints.begin(), endpoints.end(), [&](int a, int b) -> bool {
+		float va = component((a & 1) ? upper[a >> 1] : lower[a >> 1], best);
+		float vb = component((b & 1) ? upper[b >> 1] : lower[b >> 1], best);
+		//begin before end on ties, touching boxes overlap
+		return va < vb || (va == vb && (a & 1) < (b & 1));
+	});
+}
+
+void SweepAndPrune::update(const std::vector<XMFLOAT3>& lower, const std::vector<XMFLOAT3>& upper, const std::vector<char>& isStatic)
+{
+	pairs.clear();
+	swaps = 0;
+	overlapTests = 0;
+	if(lower.empty()) {
+		clear();
+		return;
+	}
+	chooseAxis(lower, upper);
+
+	//refresh the values and restore the order, nearly sorted if the boxes moved coherently
+	for(int k = 0; k < 2*boxCount; k++) {
+		int e = endpoints[k];
+		values[k] = component((e & 1) ? upper[e >> 1] : lower[e >> 1], sweepAxis);
+	}
+	for(int k = 1; k < 2*boxCount; k++) {
+		int e = endpoints[k];
+		float v = values[k];
+		int j = k;
+		while(j > 0 && (values[j-1] > v || (values[j-1] == v && (endpoints[j-1] & 1) > (e & 1)))) {
+			endpoints[j] = endpoints[j-1];
+			values[j] = values[j-1];
+			j--;
+		}
+		endpoints[j] = e;
+		values[j] = v;
+		swaps += k - j;
+	}
+
+	//sweep, the other two axes are only compared for boxes open at the same time
+	int axisA = (sweepAxis + 1) % 3, axisB = (sweepAxis + 2) % 3;
+	open.clear();
+	openSlot.resize(boxCount);
+	for(int k = 0; k < 2*boxCount; k++) {
+		int e = endpoints[k], box = e >> 1;
+		if(e & 1) {
+			//swap remove
+			int slot = openSlot[box];
+			open[slot] = open.back();
+			openSlot[open[slot]] = slot;
+			open.pop_back();
+			continue;
+		}
+		const XMFLOAT3& lo = lower[box];
+		const XMFLOAT3& hi = upper[box];
+		for(auto other = open.begin(); other != open.end(); other++) {
+			if(isStatic[box] && isStatic[*other])
+				continue;
+			overlapTests++;
+			if(component(lo, axisA) <= component(upper[*other], axisA) && component(lower[*other], axisA) <= component(hi, axisA)
+				&& component(lo, axisB) <= component(upper[*other], axisB) && component(lower[*other], axisB) <= component(hi, axisB))
+				pairs.push_back(std::make_pair(std::min(box, *other), std::max(box, *other)));
+		}
+		openSlot[box] = (int)open.size();
+		open.push_back(box);
+	}
+	//the sweep order changes with the motion, the pair order should not
+	std::sort(pairs.begin(), pairs.end());
+}
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef SweepAndPrune_HEADER
+#define SweepAndPrune_HEADER
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <vector>
+#include <utility>
+#include "BroadPhase.h"
+
+// Incremental sweep and prune over axis aligned boxes.
+// The begin and end points of all boxes are kept sorted along one axis across calls, so after
+// the bodies moved a little the insertion sort only swaps a few neighbours instead of sorting
+// from scratch. The sweep keeps the boxes whose interval is open and tests the other two axes
+// for those only. The axis is the one the box centres are spread out most along, it only
+// changes when another axis becomes clearly better (that one update sorts from scratch).
+// Pairs of two static boxes are never reported.
+class SweepAndPrune : public BroadPhase
+{
+public:
+	//statistics of the last update
+	int sweepAxis;
+	int swaps;
+	int overlapTests;
+
+	SweepAndPrune();
+
+	void clear();
+
+	void update(const std::vector<XMFLOAT3>& lower, const std::vector<XMFLOAT3>& upper, const std::vector<char>& isStatic);
+
+private:
+	//box index * 2, +1 for the end point
+	std::vector<int> endpoints;
+	std::vector<float> values;
+	//open boxes during the sweep and where they are in that list
+	std::vector<int> open;
+	std::vector<int> openSlot;
+	int boxCount;
+
+	void chooseAxis(const std::vector<XMFLOAT3>& lower, const std::vector<XMFLOAT3>& upper);
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount)
+{
+	stopping = false;
+	generation = 0;
+	activeWorkers = 0;
+	busy = false;
+	job = nullptr;
+	jobBody = nullptr;
+	jobCount = 0;
+	jobChunk = 1;
+	nextIndex = 0;
+
+	if(threadCount <= 0)
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency()) - 1;
+	for(int i = 0; i < threadCount; i++)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(auto worker = workers.begin(); worker != workers.end(); worker++)
+		worker->join();
+}
+
+int ThreadPool::getThreadCount()
+{
+	return (int)workers.size() + 1;
+}
+
+void ThreadPool::runChunks()
+{
+	while(true) {
+		int begin = nextIndex.fetch_add(jobChunk);
+		if(begin >= jobCount)
+			break;
+		job(jobBody, begin, std::min(begin + jobChunk, jobCount));
+	}
+}
+
+void ThreadPool::workerLoop()
+{
+	int seen = 0;
+	while(true) {
+		std::unique_lock<std::mutex> lock(mutex);
+		while(!stopping && generation == seen)
+			wake.wait(lock);
+		if(stopping)
+			return;
+		seen = generation;
+		lock.unlock();
+
+		runChunks();
+
+		lock.lock();
+		if(--activeWorkers == 0)
+			done.notify_one();
+	}
+}
+
+void ThreadPool::run(int count, int minChunk, void (*function)(void*, int, int), void* body)
+{
+	if(count <= 0)
+		return;
+	minChunk = std::max(1, minChunk);
+	bool expected = false;
+	if(workers.empty() || count <= minChunk || !busy.compare_exchange_strong(expected, true)) {
+		function(body, 0, count);
+		return;
+	}
+
+	//a few chunks per thread so uneven chunks balance out
+	int chunk = std::max(minChunk, count / (4*getThreadCount()));
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		job = function;
+		jobBody = body;
+		jobCount = count;
+		jobChunk = chunk;
+		nextIndex = 0;
+		activeWorkers = (int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	runChunks();
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while(activeWorkers > 0)
+			done.wait(lock);
+		job = nullptr;
+		jobBody = nullptr;
+	}
+	busy = false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef ThreadPool_HEADER
+#define ThreadPool_HEADER
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Small persistent worker pool for the simulation loops.
+// parallelFor splits [0,count) into chunks of at least minChunk elements which are grabbed by the
+// workers and the calling thread. The body must only write data owned by its own range.
+// Calls made while a parallelFor is already running (nested or from a worker) run serially.
+class ThreadPool
+{
+public:
+	//0 threads = one worker per hardware thread besides the caller
+	ThreadPool(int threadCount = 0);
+	~ThreadPool();
+
+	//number of threads working on a parallelFor, including the caller
+	int getThreadCount();
+	//body is called as body(begin, end), it is passed through a plain function pointer so nothing is allocated
+	template<class Body> void parallelFor(int count, int minChunk, const Body& body)
+	{
+		run(count, minChunk, &invokeBody<Body>, (void*)&body);
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool stopping;
+	int generation;
+	int activeWorkers;
+	std::atomic<bool> busy;
+
+	//current job
+	void (*job)(void* body, int begin, int end);
+	void* jobBody;
+	int jobCount;
+	int jobChunk;
+	std::atomic<int> nextIndex;
+
+	template<class Body> static void invokeBody(void* body, int begin, int end)
+	{
+		(*(const Body*)body)(begin, end);
+	}
+	void run(int count, int minChunk, void (*function)(void*, int, int), void* body);
+	void workerLoop();
+	void runChunks();
+
+	//not copyable
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
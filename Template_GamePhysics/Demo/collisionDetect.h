@@ -14,11 +14,10 @@ struct CollisionInfo{
 /* params:
 obj2World_A, the transfer matrix from object space of A to the world space
 obj2World_B, the transfer matrix from object space of B to the world space
+world2Obj_A, the inverse of obj2World_A, when it is known already (RigidBodyWorld caches it)
 */
-inline CollisionInfo checkCollision(const XMMATRIX &obj2World_A, const XMMATRIX &obj2World_B) {
+inline CollisionInfo checkCollision(const XMMATRIX &obj2World_A, const XMMATRIX &world2Obj_A, const XMMATRIX &obj2World_B) {
 
-	// the transfer matrix from the world space to object space of A:
-	const XMMATRIX world2Obj_A = XMMatrixInverse(nullptr, obj2World_A);	
 	// the transfer matrix from the object space of B to the object space of A:
 	const XMMATRIX objB2objA = obj2World_B * world2Obj_A;
 	
@@ -79,6 +78,11 @@ inline CollisionInfo checkCollision(const XMMATRIX &obj2World_A, const XMMATRIX
 	return info; 
 }
 
+inline CollisionInfo checkCollision(const XMMATRIX &obj2World_A, const XMMATRIX &obj2World_B) {
+	// the transfer matrix from the world space to object space of A:
+	return checkCollision(obj2World_A, XMMatrixInverse(nullptr, obj2World_A), obj2World_B);
+}
+
 /*
 // simple examples, suppose that boxes A and B are at the original point and have no rotation
 // case 1, collide at a corner of Box B:
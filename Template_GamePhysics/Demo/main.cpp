@@ -7,9 +7,13 @@
 #include <sstream>
 #include <iomanip>
 #include <random>
+#include <algorithm>
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <cfloat>
 #include <iostream>
+#include <thread>
+#include <atomic>
 
 //DirectX includes
 #include <DirectXMath.h>
@@ -48,6 +52,32 @@ using std::cout;
 // Mass Spring includes
 #include "spring.h"
 #include "point.h"
+#include "AdaptiveIntegrator.h"
+#include "SimulationClock.h"
+#include "SpringNetwork.h"
+#include "ThreadPool.h"
+#include "ClothSelfCollision.h"
+#include "PointBoxQuery.h"
+#include "StepArena.h"
+#include "MeshLoader.h"
+#include "PointCollision.h"
+#include "StrainLimiter.h"
+#include "MultirateIntegrator.h"
+#include "NetworkOrdering.h"
+#include "ModalSubspace.h"
+#include "CorotationalFEM.h"
+#include "ShapeMatching.h"
+#include "NetworkSleep.h"
+#include "SweepAndPrune.h"
+#include "DynamicAABBTree.h"
+#include "BoxCollision.h"
+#include "BoxCollisionBatch.h"
+#include "ContactCache.h"
+#include "ContactSolver.h"
+#include "RigidBodyWorld.h"
+#include "ContinuousCollision.h"
+#include "ConvexShape.h"
+#include "ConvexCollision.h"
 #include <vector>
 #include <list>
 #include <Windows.h>
@@ -131,6 +161,7 @@ bool g_usingWalls = false;
 float g_explosionForce =1;
 
 bool g_firstStep = true;
+AdaptiveIntegrator g_adaptiveIntegrator;
 #endif
 
 //general variables for both simulations
@@ -138,6 +169,44 @@ DWORD previousTime, currentTime;
 float deltaTime = 0;
 bool g_fixedTimestep = false;
 float g_manualTimestep = 0.005;
+//transient per step data of the solvers, reset after every step
+StepArena g_stepArena;
+int g_stepHeapAllocations = 0;
+int g_stepArenaBlocks = 0;
+float g_stepArenaKB = 0;
+long long g_heapAllocationsBefore = 0;
+int g_arenaBlocksBefore = 0;
+
+//heap use around the steps of a frame: the blocks the arena had to take always, every operator new
+//of the program only in builds with COUNT_HEAP_ALLOCATIONS (see StepArena.h)
+void BeginHeapCount()
+{
+	g_arenaBlocksBefore = g_stepArena.blockAllocations;
+#ifdef COUNT_HEAP_ALLOCATIONS
+	g_heapAllocationsBefore = getHeapAllocationCount();
+#endif
+}
+
+void EndHeapCount()
+{
+	g_stepArenaBlocks = g_stepArena.blockAllocations - g_arenaBlocksBefore;
+#ifdef COUNT_HEAP_ALLOCATIONS
+	g_stepHeapAllocations = (int)(getHeapAllocationCount() - g_heapAllocationsBefore);
+#endif
+}
+
+void AddHeapCountVars()
+{
+#ifdef COUNT_HEAP_ALLOCATIONS
+	TwAddVarRO(g_pTweakBar, "Heap allocs (step)", TW_TYPE_INT32, &g_stepHeapAllocations, "");
+#endif
+	TwAddVarRO(g_pTweakBar, "Arena heap blocks (step)", TW_TYPE_INT32, &g_stepArenaBlocks, "");
+	TwAddVarRO(g_pTweakBar, "Step arena (KB)", TW_TYPE_FLOAT, &g_stepArenaKB, "");
+}
+//the real time demos (3, 7 and 10) simulate in fixed steps and interpolate the rendered state
+SimulationClock g_simulationClock;
+float g_renderAlpha = 1.0f;
+float g_clothTimestep = 0.005f;
 float g_gravity = -9.81;
 bool g_useGravity = true;
 bool g_useDamping = true;
@@ -161,8 +230,37 @@ float g_damping_angular = 0.3f;
 bool g_bDrawRigidBodyCollision = true;
 std::vector<MassPoint>* pointList1, * pointList2;
 rigidBody* rb1, * rb2;
-std::vector<rigidBody>* rigidBodies; // for rb demo 4
-rigidBody* floorRB;
+//demo 4, the floor is the static box after the last body. world matrices and bounds are cached once per step
+RigidBodyWorld rigidBodyWorld;
+int g_rigidBodyCount = 10, g_preRigidBodyCount = 10;
+//sweep and prune or the dynamic tree (better with the huge floor next to small boxes)
+bool g_rigidBodyTree = false;
+SweepAndPrune rigidBodySweep;
+DynamicAABBTree rigidBodyTree;
+int g_broadPhasePairs = 0;
+//time of impact sub-steps for the boxes that would pass through others in one step
+bool g_rigidBodyCCD = true;
+ContinuousCollision rigidBodyCCD;
+//separating axis narrow phase (else the corner test of checkCollision). the cache keeps the axis and
+//the contacts of every pair with their impulses for the next step
+bool g_rigidBodySAT = true;
+ContactCache rigidBodyContactCache;
+ContactManifold rigidBodyManifold;
+//all pairs through the four lane test at once, else one collide per pair starting with its cached axis
+bool g_rigidBodyBatch = true;
+BoxCollisionBatch rigidBodyBatch;
+//contacts of the step and the cached point each one reports its impulses back to (none for the corner test)
+std::vector<SolverContact> rigidBodyContactList;
+std::vector<CachedContact*> rigidBodyContactSource;
+ContactSolver rigidBodySolver;
+int g_rigidBodyContacts = 0;
+float g_rigidBodyFriction = 0.5f;
+//spheres, capsules and hulls between the boxes. pairs with one of them go to GJK (EPA if they overlap),
+//started from the simplex the contact cache kept for the pair
+bool g_rigidBodyShapes = false, g_preRigidBodyShapes = false;
+int g_rigidBodyShapeTypes[4];
+ConvexCollision rigidBodyConvex;
+ConvexResult rigidBodyConvexResult;
 
 XMMATRIX mat1, mat2;
 CollisionInfo simpletest;
@@ -171,13 +269,58 @@ Contact contact;
 #ifdef EX4_MS_CLOTH_AND_RB
 int collWithRB = 0;
 bool ex4_fixed = true;
-struct CollPoint {
-	SpringPoint* point;
-	CollisionInfo* info;
-};
 float ripeforce = 4;
-
-std::vector<CollPoint>* collPoints;
+//cloth resolution (points per side) and self collision
+int g_clothResolution = 16, g_preClothResolution = 16;
+bool g_clothSelfCollision = true;
+ClothSelfCollision clothSelfCollision;
+//clamps the spring stretch after every step, allows 2-4x larger cloth timesteps
+bool g_clothStrainLimit = false;
+StrainLimiter clothStrainLimiter;
+//sub-cycles only the stiff springs instead of running the whole cloth at the stiffest rate
+bool g_clothMultirate = false;
+MultirateIntegrator clothMultirate;
+//point renumbering for cache locality, on demand or after every topology change
+NetworkOrdering clothOrdering;
+bool g_clothHilbertOrder = false, g_clothAutoReorder = false;
+int clothOrderedRevision = -1;
+//reduced order cloth, steps a few vibration modes instead of the points, no tearing or collisions in that mode
+bool g_clothReduced = false, g_preClothReduced = false;
+ModalSubspace clothModes;
+//the basis is built on a worker thread from a copy of the rest state, the full cloth is simulated until it is done
+ModalSubspace clothModesPending;
+SpringNetwork clothModesRest;
+std::string clothModesCachePath;
+ModalSubspace::Progress clothModesProgress;
+std::thread clothModesThread;
+std::atomic<bool> clothModesFinished(false);
+bool clothModesSucceeded = false;
+int g_clothModesProgress = 0;
+//tet meshes as co-rotational FEM bodies instead of spring lattices, the springs are only drawn
+bool g_clothFEM = false, g_preClothFEM = false;
+CorotationalFEM clothFEM;
+std::vector<int> clothTets;
+//meshless shape matching instead of the springs, clusters are cells of this many average spring lengths
+bool g_clothShapeMatching = false, g_preClothShapeMatching = false;
+ShapeMatching clothShapeMatching;
+float g_clothClusterScale = 2.f, g_preClothClusterScale = 2.f;
+//resting regions of the cloth (cubes of this many average spring lengths) are frozen and skipped by the midpoint integrator
+bool g_clothSleep = false;
+NetworkSleep clothSleep;
+float g_clothSleepRegionScale = 4.f;
+ThreadPool g_threadPool;
+//load the cloth from a mesh instead of the grid, .obj files or TetGen .node/.ele pairs (path without extension)
+bool g_clothFromMesh = false, g_preClothFromMesh = false;
+std::string g_clothMeshPath = "cloth.obj";
+
+//cloth vs rigid body query, kept around so its buffers are reused every step
+PointBoxQuery clothBoxQuery;
+//bodies and whole cloths as boxes, the point query only runs if some body touches some cloth
+DynamicAABBTree clothBroadPhase;
+std::vector<XMFLOAT3> clothGroupLower, clothGroupUpper;
+std::vector<char> clothGroupStatic;
+std::vector<XMFLOAT4X4> clothBoxes;
+std::vector<SpringNetwork*> clothNetworks;
 //COPIED FROM MASS SPRING SYSTEM IFDEF.. slightly changed though
 //g_bDrawMassSpringSystem = true;
 //int g_integrationMethod = 0, g_preIntegrationMethod = 0;
@@ -224,6 +367,8 @@ Grid* grid;
 float kernelsize = 0.03f;
 float frametimeNative = 0;
 float frametimeGrid= 0;
+float frametimeCloth = 0;
+float frametimeSelfCollision = 0;
 
 bool cloth_horizontal = false; 
 
@@ -243,10 +388,38 @@ void InitRigidBox(std::vector<MassPoint>* listOfPoints, float width, float heigh
 	listOfPoints->push_back(MassPoint(XMFLOAT3(width,-height,depth), mass ));
 }
 
+//demo 4 with mixed shapes: a box, a sphere, a capsule and a pebble shaped hull in turn
+void AddRigidBodyShapes()
+{
+	for(int k = 0; k < 4; k++)
+		g_rigidBodyShapeTypes[k] = -1;
+	if(!g_rigidBodyShapes)
+		return;
+	//a flattened icosahedron, the corners are (0, +-1, +-phi) and its cyclic permutations
+	std::vector<XMFLOAT3> pebble;
+	float phi = 1.618034f;
+	for(int k = 0; k < 12; k++) {
+		float a = k&1 ? -1.f : 1.f, b = k&2 ? -phi : phi;
+		XMFLOAT3 corner = k < 4 ? XMFLOAT3(0.f, a, b) : k < 8 ? XMFLOAT3(a, b, 0.f) : XMFLOAT3(b, 0.f, a);
+		pebble.push_back(XMFLOAT3(0.15f*corner.x, 0.1f*corner.y, 0.15f*corner.z));
+	}
+	g_rigidBodyShapeTypes[1] = rigidBodyWorld.addShapeType(ConvexShape::sphere(0.25f));
+	g_rigidBodyShapeTypes[2] = rigidBodyWorld.addShapeType(ConvexShape::capsule(0.15f, 0.2f));
+	g_rigidBodyShapeTypes[3] = rigidBodyWorld.addShapeType(ConvexShape::hull(pebble));
+}
+
+//body i of demo 4, a box of the given size or the shape whose turn it is
+void AddRigidBody(int i, XMFLOAT3 position, XMFLOAT3 rotation, XMFLOAT3 scale, XMFLOAT3 velocity)
+{
+	int shape = g_rigidBodyShapeTypes[i%4];
+	if(shape < 0)
+		rigidBodyWorld.addBox(position, rotation, scale, 2.f, velocity);
+	else
+		rigidBodyWorld.addShape(position, rotation, shape, 2.f, velocity);
+}
+
 void InitRigidBodies()
 {
-	rigidBody* rbTemp;
-	std::vector<MassPoint> * pointListTemp;
 	float w = 0.0f, h = 0.0f, d = 0.0f;
 	switch(g_iTestCase) {
 	case 4:
@@ -285,30 +458,21 @@ void InitRigidBodies()
 	case 7:
 		w = 1.0f, h = 0.6f, d = 0.5f;
 		w /= 2, h /= 2, d /= 2;
-		rigidBodies = new std::vector<rigidBody>;
+		rigidBodyWorld.clear();
+		AddRigidBodyShapes();
 		for(int i = 0; i<5; i++) //init 5 rigidbodies
-		{
-			pointListTemp = new std::vector<MassPoint>;
-			InitRigidBox(pointListTemp, w,h,d,2.f);
-			rbTemp = new rigidBody(pointListTemp, XMFLOAT3(i*0.5f , -1.f, 0.5 - i*0.2), XMFLOAT3(0.4f*i , 0.1*i, 0.785398f), XMFLOAT3(d/2, h, d));
-
-			rbTemp->setPosition(XMFLOAT3(-2+i*0.5f,1.0f+0.5*i,.0f));
-			rigidBodies->push_back(*rbTemp);
-		}
+			AddRigidBody(i, XMFLOAT3(-2+i*0.5f,1.0f+0.5*i,.0f), XMFLOAT3(0.4f*i , 0.1*i, 0.785398f), XMFLOAT3(d/2, h, d), XMFLOAT3(i*0.5f , -1.f, 0.5 - i*0.2));
 		for(int i = 0; i<5; i++) //init 5 rigidbodies
-		{
-			pointListTemp = new std::vector<MassPoint>;
-			InitRigidBox(pointListTemp, w,h,d,2.f);
-			rbTemp = new rigidBody(pointListTemp, XMFLOAT3(.0f , 2*i, .0f), XMFLOAT3(.01f*i , .0f, .0f), XMFLOAT3(d, w, h));
-			rbTemp->setPosition(XMFLOAT3(-2+0.75f*i,.0f,.0f));
-			rigidBodies->push_back(*rbTemp);
-		}
-		//rb2->setPosition(XMFLOAT3(.0f,1.0f,.0f));
-		pointListTemp = new std::vector<MassPoint>;
-		InitRigidBox(pointListTemp, 1,1,1,9999999.9f);
-		floorRB = rbTemp = new rigidBody(pointListTemp, XMFLOAT3(.0f , .0f, .0f), XMFLOAT3(.0f , .0f, .0f), XMFLOAT3(500, 10, 500));
-		floorRB-> setPosition(XMFLOAT3(.0f,-6,0));
-		floorRB->setStatic(true);
+			rigidBodyWorld.addBox(XMFLOAT3(-2+0.75f*i,.0f,.0f), XMFLOAT3(.01f*i , .0f, .0f), XMFLOAT3(d, w, h), 2.f, XMFLOAT3(.0f , 2*i, .0f));
+		//more boxes (or shapes) in 16x16 layers behind the first ten
+		for(int i = 0; i < g_rigidBodyCount-10; i++)
+			AddRigidBody(i, XMFLOAT3(-6+0.8f*(i%16), 0.8f*(i/256), 1+0.8f*(i/16%16)), XMFLOAT3(0.1f*(i%7) , 0.2f*(i%5), .0f), XMFLOAT3(d, w, h), XMFLOAT3(.0f , .0f, .0f));
+		//the floor doesn't move, no mass
+		rigidBodyWorld.addBox(XMFLOAT3(.0f,-6,0), XMFLOAT3(.0f , .0f, .0f), XMFLOAT3(500, 10, 500), 0.f, XMFLOAT3(.0f , .0f, .0f));
+		rigidBodyWorld.updateTransforms(g_threadPool);
+		rigidBodySweep.clear();
+		rigidBodyTree.clear();
+		rigidBodyContactCache.clear();
 		mat1 = mat2 = XMMATRIX(.0f,.0f,.0f,.0f,.0f,.0f,.0f,.0f,.0f,.0f,.0f,.0f,.0f,.0f,.0f,.0f);
 		break;
 	case 10:	
@@ -356,7 +520,7 @@ void DestroyRigidBodies()
 	//	delete(pointList1);
 	//	delete(rb1);
 		cout<<"for ";
-		delete(rigidBodies);
+		rigidBodyWorld.clear();
 		break;
 	case 10:
 		delete(pointList);
@@ -376,6 +540,8 @@ void ResetRigidBodies()
 // Mass Spring variable
 std::list<Spring> springs;
 std::list<SpringPoint*> points;
+//cloth of the ex4 demo
+SpringNetwork cloth;
 
 //EX4
 
@@ -383,101 +549,49 @@ float springDamping, springStiffness = 2.f;
 void InitEx4MSAndRB(int cloth_width, int cloth_height, XMFLOAT3 startPos, XMFLOAT3 offset ){
 	//Create all points and springs in the grid, 
 	float weight = 1.f / (cloth_height*cloth_width);
-	std::vector<SpringPoint*> springPointVec;
 	springDamping = 0.1f;
 	float twoOrtho = 0.5, oneDiag = 0.709, twoDiag = 0.35;
+	cloth.clear();
+	//at most 8 springs per point, reserving keeps the spring pointers valid while building
+	cloth.reserve(cloth_width*cloth_height, 8*cloth_width*cloth_height);
 	for(int row = 0, i = 0; row < cloth_height ; row++) {
 		for(int column = 0 ; column < cloth_width ; column++, i++) {
-			SpringPoint* s_point;
-			s_point = new SpringPoint(XMFLOAT3(startPos.x+offset.x*column, startPos.y+offset.y*row, startPos.z+offset.z*row));
-			s_point->setMass(weight);
-			s_point->setDamping(1.f);
-			s_point->gp_bouncyness = 0.1f;
-			points.push_back(s_point);
-			springPointVec.push_back(s_point);
+			SpringPoint s_point(XMFLOAT3(startPos.x+offset.x*column, startPos.y+offset.y*row, startPos.z+offset.z*row));
+			s_point.setMass(weight);
+			s_point.setDamping(1.f);
+			s_point.gp_bouncyness = 0.1f;
+			cloth.addPoint(s_point);
 
 			//1 step horizontal springs. Sets spring from previous point to current
 			if(column > 0) {
-				Spring spring;
-				spring.setPoint(1,springPointVec[i-1]);
-				spring.setPoint(2,s_point);	
-				spring.setDamping(springDamping);
-				spring.computeCurrentLength();
-				spring.setRestLength(spring.getCurrentLength());
-				spring.setStiffness(springStiffness);
-				springs.push_back(spring);
+				cloth.addSpring(i-1, i, springStiffness, springDamping);
 				//2 step horizontal springs
-				if(column > 1) {
-					spring.setPoint(1,springPointVec[i-2]);
-					spring.setPoint(2,s_point);	
-					spring.setDamping(springDamping);
-					spring.computeCurrentLength();
-					spring.setRestLength(spring.getCurrentLength());
-					spring.setStiffness(springStiffness*twoOrtho);
-					springs.push_back(spring);
-				}
+				if(column > 1)
+					cloth.addSpring(i-2, i, springStiffness*twoOrtho, springDamping);
+			}
+			//two triangles per grid cell, for the self collision
+			if(row > 0 && column > 0) {
+				cloth.addTriangle(i-cloth_width-1, i-cloth_width, i);
+				cloth.addTriangle(i-cloth_width-1, i, i-1);
 			}
 			//1 step vertical springs
 			if(row > 0) {
-				Spring spring;
-				spring.setPoint(1,springPointVec[i-cloth_width]);
-				spring.setPoint(2,s_point);		
-				spring.setDamping(springDamping);
-				spring.computeCurrentLength();
-				spring.setRestLength(spring.getCurrentLength());
-				spring.setStiffness(springStiffness);
-				springs.push_back(spring);
+				cloth.addSpring(i-cloth_width, i, springStiffness, springDamping);
 				//1 step diagonal springs (/)
-				if(column != cloth_width-1) {
-					//Spring spring1;
-					spring.setPoint(1,springPointVec[i-cloth_width+1]);
-					spring.setPoint(2,s_point);		
-					spring.setDamping(springDamping);
-					spring.computeCurrentLength();
-					spring.setRestLength(spring.getCurrentLength());
-					spring.setStiffness(springStiffness*oneDiag);
-					springs.push_back(spring);
-				}
+				if(column != cloth_width-1)
+					cloth.addSpring(i-cloth_width+1, i, springStiffness*oneDiag, springDamping);
 				//1 step diagonal springs (\)
-				if(column != 0) {
-					//Spring spring1;
-					spring.setPoint(1,springPointVec[i-cloth_width-1]);
-					spring.setPoint(2,s_point);		
-					spring.setDamping(springDamping);
-					spring.computeCurrentLength();
-					spring.setRestLength(spring.getCurrentLength());
-					spring.setStiffness(springStiffness*oneDiag);
-					springs.push_back(spring);
-				}
+				if(column != 0)
+					cloth.addSpring(i-cloth_width-1, i, springStiffness*oneDiag, springDamping);
 				//two steps vertical springs
 				if(row > 1) {
-					spring.setPoint(1,springPointVec[i-2*cloth_width]);
-					spring.setPoint(2,s_point);		
-					spring.setDamping(springDamping);
-					spring.computeCurrentLength();					
-					spring.setRestLength(spring.getCurrentLength());
-					spring.setStiffness(springStiffness*twoOrtho);
-					springs.push_back(spring);
+					cloth.addSpring(i-2*cloth_width, i, springStiffness*twoOrtho, springDamping);
 					//two step diagonal (\)
-					if(column > 1) {
-						spring.setPoint(1,springPointVec[i-2*cloth_width-2]);
-						spring.setPoint(2,s_point);		
-						spring.setDamping(springDamping);
-						spring.computeCurrentLength();
-						spring.setRestLength(spring.getCurrentLength());
-						spring.setStiffness(springStiffness*twoDiag);
-						springs.push_back(spring);
-					}
+					if(column > 1)
+						cloth.addSpring(i-2*cloth_width-2, i, springStiffness*twoDiag, springDamping);
 					//Two step diagonal (/)
-					if(column < cloth_width - 2) {
-						spring.setPoint(1,springPointVec[i-2*cloth_width+2]);
-						spring.setPoint(2,s_point);		
-						spring.setDamping(springDamping);
-						spring.computeCurrentLength();
-						spring.setRestLength(spring.getCurrentLength());
-						spring.setStiffness(springStiffness*twoOrtho);
-						springs.push_back(spring);
-					}
+					if(column < cloth_width - 2)
+						cloth.addSpring(i-2*cloth_width+2, i, springStiffness*twoOrtho, springDamping);
 				}
 			}			
 		}
@@ -485,25 +599,350 @@ void InitEx4MSAndRB(int cloth_width, int cloth_height, XMFLOAT3 startPos, XMFLOA
 	if(cloth_horizontal) {
 		for(int i = 0 ; i < cloth_height*cloth_width ; i++) 
 			if(i < cloth_width || i > (cloth_height-1)*(cloth_width)-1 || i%cloth_width == 0 || (i-cloth_width+1) % cloth_width == 0)
-				springPointVec[i]->setStatic(true);
+				cloth.points[i].setStatic(true);
 	}
 	else {
 		for(int i = 0; i < cloth_width; i++) {
-			springPointVec[i]->setStatic(true);
+			cloth.points[i].setStatic(true);
 		}
-		//springPointVec[0]->setStatic(true);
-		//springPointVec[cloth_width-1]->setStatic(true);
+		//cloth.points[0].setStatic(true);
+		//cloth.points[cloth_width-1].setStatic(true);
 		
-		//springPointVec[cloth_width*cloth_height-1]->setStatic(true);
-		//springPointVec[cloth_width*(cloth_height-1)]->setStatic(true);
+		//cloth.points[cloth_width*cloth_height-1].setStatic(true);
+		//cloth.points[cloth_width*(cloth_height-1)].setStatic(true);
 	}
 }
 
+//builds the cloth from g_clothMeshPath, scaled into the same 2x2 area the grid cloth uses
+bool InitEx4MeshCloth()
+{
+	std::vector<XMFLOAT3> vertices;
+	std::vector<int> elements;
+	bool isObj = g_clothMeshPath.size() > 4 && g_clothMeshPath.compare(g_clothMeshPath.size()-4, 4, ".obj") == 0;
+	if(isObj ? !MeshLoader::loadObj(g_clothMeshPath, vertices, elements) : !MeshLoader::loadTetGen(g_clothMeshPath, vertices, elements))
+		return false;
+
+	XMVECTOR lower = XMLoadFloat3(&vertices[0]), upper = lower;
+	for(auto v = vertices.begin(); v != vertices.end(); v++) {
+		lower = XMVectorMin(lower, XMLoadFloat3(&*v));
+		upper = XMVectorMax(upper, XMLoadFloat3(&*v));
+	}
+	XMFLOAT3 extent;
+	XMStoreFloat3(&extent, upper - lower);
+	float scale = 2.f / std::max(extent.x, std::max(extent.y, std::max(extent.z, 1e-6f)));
+	XMVECTOR center = 0.5f*(lower + upper), target = XMVectorSet(0.f, 1.f, 0.f, 0.f);
+	for(auto v = vertices.begin(); v != vertices.end(); v++)
+		XMStoreFloat3(&*v, (XMLoadFloat3(&*v) - center)*scale + target);
+
+	springDamping = 0.1f;
+	MeshSpringSettings settings;
+	settings.structuralStiffness = springStiffness;
+	settings.bendStiffness = springStiffness*0.5f;
+	settings.volumeStiffness = springStiffness*0.5f;
+	settings.damping = springDamping;
+	auto begin = std::chrono::high_resolution_clock::now();
+	if(isObj)
+		MeshLoader::buildTriangleNetwork(vertices, elements, settings, cloth, g_threadPool);
+	else
+		MeshLoader::buildTetNetwork(vertices, elements, settings, cloth, g_threadPool);
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "Mesh cloth: " << cloth.points.size() << " points, " << cloth.springs.size() << " springs, built in "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(end-begin).count()/1000.0f << "ms" << std::endl;
+	if(!isObj)
+		clothTets.swap(elements);
+	if(g_clothFEM) {
+		if(isObj)
+			std::cout << "FEM needs a TetGen mesh, simulating the springs" << std::endl;
+		else if(clothFEM.initialize(cloth, clothTets, settings.totalMass))
+			std::cout << "FEM body: " << clothFEM.getElementCount() << " tets" << std::endl;
+	}
+	return true;
+}
+
+void ReorderCloth()
+{
+	if(g_clothReduced) {
+		std::cout << "the modal basis is stored per point, switch off the reduced mode before reordering" << std::endl;
+		return;
+	}
+	std::vector<int> newIndex;
+	clothOrdering.reorder(cloth, g_clothHilbertOrder ? NetworkOrdering::HILBERT_CURVE : NetworkOrdering::REVERSE_CUTHILL_MCKEE, newIndex);
+	clothOrderedRevision = cloth.topologyRevision;
+	//the tets are the only other thing holding point indices (the rigid body query is redone every step)
+	for(auto index = clothTets.begin(); index != clothTets.end(); index++)
+		*index = newIndex[*index];
+	if(clothFEM.isInitialized())
+		clothFEM.remapPoints(newIndex);
+	if(clothShapeMatching.isInitialized())
+		clothShapeMatching.remapPoints(newIndex);
+	clothSleep.remapPoints(newIndex);
+	std::cout << "Cloth reordered (" << (g_clothHilbertOrder ? "Hilbert" : "RCM") << "): bandwidth " << clothOrdering.bandwidthBefore << " -> " << clothOrdering.bandwidthAfter
+		<< ", simulated cache misses per spring pass " << clothOrdering.cacheMissesBefore << " -> " << clothOrdering.cacheMissesAfter << std::endl;
+}
+
+//the clusters are taken from the rest positions, so they can be rebuilt at any time. the torn springs don't matter to them
+void InitClothShapeMatching()
+{
+	float restLength = 0.f;
+	for(auto spring = cloth.springs.begin(); spring != cloth.springs.end(); spring++)
+		restLength += spring->gs_initialLength;
+	if(!cloth.springs.empty())
+		restLength /= cloth.springs.size();
+	clothShapeMatching.initialize(cloth.points, cloth.restPositions, g_clothClusterScale*restLength);
+	std::cout << "Shape matching: " << clothShapeMatching.clusterCount << " clusters, " << clothShapeMatching.averageClusterSize << " points per cluster" << std::endl;
+}
+
+void InitClothSleep()
+{
+	float restLength = 0.f;
+	for(auto spring = cloth.springs.begin(); spring != cloth.springs.end(); spring++)
+		restLength += spring->gs_initialLength;
+	if(!cloth.springs.empty())
+		restLength /= cloth.springs.size();
+	clothSleep.initialize(cloth, g_clothSleepRegionScale*restLength);
+	std::cout << "Cloth sleeping: " << clothSleep.regionCount << " regions" << std::endl;
+}
+
+//sleeping only skips work in the midpoint integrator, FEM, shape matching and multirate keep everything awake
+bool ClothSleepApplies()
+{
+	bool isFEM = g_clothFEM && clothFEM.isInitialized();
+	bool isShapeMatching = !isFEM && g_clothShapeMatching && clothShapeMatching.isInitialized();
+	return g_clothSleep && clothSleep.isInitialized() && !isFEM && !isShapeMatching && !g_clothMultirate;
+}
+
+//explicit midpoint for the whole network, every spring at the same rate
+void IntegrateClothMidpoint(SpringNetwork& network, NetworkSleep* sleep, float deltaTime)
+{
+	SpringPoint* a;
+	Spring* b;
+	//with sleeping only the awake points and the springs touching them, otherwise everything
+	bool sleeping = sleep != nullptr;
+	if(sleeping)
+		sleep->prepare(network);
+	int springCount = sleeping ? (int)sleep->activeSprings.size() : (int)network.springs.size();
+	int pointCount = sleeping ? (int)sleep->activePoints.size() : (int)network.points.size();
+	for(int k = 0; k < springCount; k++)
+	{
+		b = &network.springs[sleeping ? sleep->activeSprings[k] : k];
+		b->computeElasticForces();
+		b->computeDampingForces();
+	}
+	for(int k = 0; k < pointCount; k++)
+	{	
+		a = &network.points[sleeping ? sleep->activePoints[k] : k];
+		a->addGravity(g_gravity);
+		a->gp_posTemp = a->IntegratePositionTmp(deltaTime/2.0f);
+		a->computeAcceleration();
+		a->gp_velTemp = a->IntegrateVelocityTmp(deltaTime/2.0f);
+		//a->addDamping(deltaTime);
+		a->gp_posTemp = a->gp_posTemp; //store the previous pos
+		a->IntegratePosition(deltaTime, a->gp_velTemp);
+		
+		a->resetForces();
+	}
+	//springs stretched too far are only marked here, they are removed after the step
+	for(int k = 0; k < springCount; k++)
+	{
+		int i = sleeping ? sleep->activeSprings[k] : k;
+		b = &network.springs[i];
+		b->computeElasticForcesTmp();
+		b->computeDampingForcesTmp();
+		if(b->checkRipe(ripeforce))
+			network.markTorn(i);
+	}
+	for(int k = 0; k < pointCount; k++)
+	{
+		a = &network.points[sleeping ? sleep->activePoints[k] : k];
+		a->IntegrateVelocity(deltaTime);
+		a->resetForces();	
+	}
+}
+
+#ifdef MEASURE_CLOTH_SLEEPING
+//what a resting cloth costs per step with and without sleeping. a 64x64 grid is dropped a little onto
+//the ground with the current stiffness and time step, left to settle, then the same steps are timed
+//awake and, once every region sleeps, asleep. runs on its own network, the demo cloth is left alone.
+//only in builds that define MEASURE_CLOTH_SLEEPING (project settings), it adds a button to the tweak bar
+void MeasureClothSleeping()
+{
+	const int n = 64, timedSteps = 200;
+	SpringNetwork network;
+	network.reserve(n*n, 4*n*n);
+	for(int row = 0, i = 0; row < n; row++) {
+		for(int column = 0; column < n; column++, i++) {
+			SpringPoint point(XMFLOAT3(2.f*column/n - 1.f, -0.9f + 0.1f*column/n, 2.f*row/n - 1.f));
+			//heavier than the demo grid's points, so the default stiffness stays stable at this resolution
+			point.setMass(1.f/256);
+			point.setDamping(1.f);
+			point.gp_bouncyness = 0.1f;
+			network.addPoint(point);
+			if(column > 0)
+				network.addSpring(i-1, i, springStiffness, 0.1f);
+			if(row > 0)
+				network.addSpring(i-n, i, springStiffness, 0.1f);
+			if(row > 0 && column > 0) {
+				network.addSpring(i-n-1, i, springStiffness, 0.1f);
+				network.addSpring(i-n, i-1, springStiffness, 0.1f);
+			}
+		}
+	}
+	float deltaTime = g_clothTimestep, restLength = 2.f/n;
+	ContainmentBox ground = ContainmentBox::ground(g_fSphereSize);
+	//the sleeping part of StepClothAndRigidBody without the body
+	auto step = [&](NetworkSleep* sleep) {
+		IntegrateClothMidpoint(network, sleep, deltaTime);
+		if(sleep) {
+			for(auto index = sleep->activePoints.begin(); index != sleep->activePoints.end(); index++)
+				network.points[*index].addDamping(deltaTime);
+			if(!sleep->activePoints.empty())
+				PointCollision::resolve(&network.points[0], &sleep->activePoints[0], (int)sleep->activePoints.size(), ground, deltaTime);
+		}
+		else {
+			for(auto point = network.points.begin(); point != network.points.end(); point++)
+				point->addDamping(deltaTime);
+			PointCollision::resolve(network.points, ground, deltaTime);
+		}
+		if(network.hasPendingTears())
+			network.applyTears();
+		if(sleep)
+			sleep->update(network, g_gravity);
+	};
+	auto timeSteps = [&](NetworkSleep* sleep) -> float {
+		auto begin = std::chrono::high_resolution_clock::now();
+		for(int s = 0; s < timedSteps; s++)
+			step(sleep);
+		auto end = std::chrono::high_resolution_clock::now();
+		//an asleep step is well below a microsecond
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(end-begin).count()/1000000.0f/timedSteps;
+	};
+
+	for(int s = 0; s < 1000; s++)
+		step(nullptr);
+	float awake = timeSteps(nullptr);
+	NetworkSleep sleep;
+	sleep.sleepSpeed = clothSleep.sleepSpeed;
+	sleep.wakeSpeed = clothSleep.wakeSpeed;
+	sleep.sleepSteps = clothSleep.sleepSteps;
+	sleep.initialize(network, g_clothSleepRegionScale*restLength);
+	for(int s = 0; s < 4000 && !sleep.isAsleep(); s++)
+		step(&sleep);
+	if(!sleep.isAsleep()) {
+		std::cout << "Sleeping cost: the test cloth didn't fall asleep (" << sleep.sleepingRegions << " of " << sleep.regionCount << " regions), " << awake << "ms per step awake" << std::endl;
+		return;
+	}
+	float asleep = timeSteps(&sleep);
+	XMFLOAT3 lower, upper;
+	auto boundsBegin = std::chrono::high_resolution_clock::now();
+	for(int s = 0; s < timedSteps; s++)
+		sleep.bounds(network, g_fSphereSize, lower, upper);
+	auto boundsEnd = std::chrono::high_resolution_clock::now();
+	std::cout << "Sleeping cost, " << n << "x" << n << " cloth at rest: " << awake << "ms per step awake, " << asleep << "ms asleep ("
+		<< awake/std::max(asleep, 1e-9f) << "x), bounds " << std::chrono::duration_cast<std::chrono::nanoseconds>(boundsEnd-boundsBegin).count()/timedSteps << "ns, "
+		<< sleep.regionCount << " regions" << std::endl;
+}
+#endif
+
+//the reduced cloth only steps once its basis is there, until then the full cloth runs
+bool ClothReducedRuns()
+{
+	return g_clothReduced && clothModes.isBuilt();
+}
+
+bool ClothModesBuilding()
+{
+	return clothModesThread.joinable();
+}
+
+//linearises the freshly initialised cloth on a worker thread, the basis is cached next to the mesh (or in cloth.modes for the grid).
+//springs point into their own network, so the worker gets a rebuilt copy of the cloth and not the cloth itself
+void StartClothModes()
+{
+	clothModesRest.clear();
+	clothModesRest.reserve((int)cloth.points.size(), (int)cloth.springs.size());
+	for(auto point = cloth.points.begin(); point != cloth.points.end(); point++)
+		clothModesRest.addPoint(*point);
+	std::vector<int> endpoints;
+	std::vector<float> stiffness;
+	for(auto spring = cloth.springs.begin(); spring != cloth.springs.end(); spring++) {
+		endpoints.push_back(cloth.getPointIndex(spring->gs_point1));
+		endpoints.push_back(cloth.getPointIndex(spring->gs_point2));
+		stiffness.push_back(spring->gs_stiffness);
+	}
+	clothModesRest.addSprings(endpoints, stiffness, 0.f);
+
+	clothModesPending.clear();
+	clothModesPending.modeCount = clothModes.modeCount;
+	clothModesPending.derivativeModes = clothModes.derivativeModes;
+	clothModesPending.prestress = clothModes.prestress;
+	clothModesCachePath = g_clothFromMesh ? g_clothMeshPath + ".modes" : "cloth.modes";
+	clothModesProgress.percent = 0;
+	clothModesProgress.cancel = false;
+	clothModesFinished = false;
+	g_clothModesProgress = 0;
+	clothModesThread = std::thread([]() {
+		clothModesSucceeded = clothModesPending.build(clothModesRest, g_threadPool, clothModesCachePath, &clothModesProgress);
+		clothModesFinished = true;
+	});
+}
+
+//gives up a running build, its cloth is about to be replaced
+void CancelClothModes()
+{
+	if(!ClothModesBuilding())
+		return;
+	clothModesProgress.cancel = true;
+	clothModesThread.join();
+	clothModesPending.clear();
+	clothModesRest.clear();
+	g_clothModesProgress = 0;
+}
+
+//once per frame, switches to the finished basis starting from where the full cloth got to
+void PollClothModes()
+{
+	if(!ClothModesBuilding())
+		return;
+	g_clothModesProgress = clothModesProgress.percent;
+	if(!clothModesFinished)
+		return;
+	clothModesThread.join();
+	clothModesRest.clear();
+	if(!clothModesSucceeded) {
+		g_clothReduced = g_preClothReduced = false;
+		return;
+	}
+	//the settings may have been changed during the build, they are for the next one
+	int modeCount = clothModes.modeCount, derivativeModes = clothModes.derivativeModes;
+	float prestress = clothModes.prestress, dampingRatio = clothModes.dampingRatio;
+	clothModes = clothModesPending;
+	clothModesPending.clear();
+	clothModes.modeCount = modeCount;
+	clothModes.derivativeModes = derivativeModes;
+	clothModes.prestress = prestress;
+	clothModes.dampingRatio = dampingRatio;
+	clothModes.project(cloth);
+	std::cout << "Cloth modes: " << clothModes.basisColumns << " basis columns, " << clothModes.lowestFrequency << " - " << clothModes.highestFrequency << " Hz, "
+		<< (clothModes.loadedFromCache ? "loaded from " + clothModesCachePath : "computed") << " in " << clothModes.buildSeconds << "s" << std::endl;
+}
+
 void InitMassSprings()
 {
 	if (g_iTestCase ==10) {
 		std::cout << "Ex4 Mass Spring setup" << std::endl;
-		float x = 16, y = 16;
+		//the basis belongs to the old points, rebuilt on the next frame if needed
+		CancelClothModes();
+		clothModes.clear();
+		clothFEM.clear();
+		clothShapeMatching.clear();
+		clothSleep.clear();
+		clothTets.clear();
+		if(g_clothFromMesh) {
+			if(InitEx4MeshCloth())
+				return;
+			std::cout << "falling back to the grid cloth" << std::endl;
+		}
+		float x = g_clothResolution, y = g_clothResolution;
 		if(!cloth_horizontal)
 			InitEx4MSAndRB(x,y,XMFLOAT3(-1.f,2.f,0),XMFLOAT3(2.0f/x,0.001,-2.0f/y));
 		else
@@ -639,11 +1078,13 @@ void DestroyMassSprings()
 		spring++;
 		springs.erase(it);
 	}
+	cloth.clear();
 }
 
 void ResetMassSprings(float deltaTime) {
 	DestroyMassSprings();
 	InitMassSprings();
+	g_adaptiveIntegrator.reset();
 	if(g_integrationMethod == 2) {
 		SpringPoint* a;
 		Spring* b;
@@ -693,12 +1134,14 @@ void explode()
 	}
 		if(g_iTestCase == 7)
 		{
-			rigidBody* b;
-			for(auto rb = rigidBodies->begin(); rb != rigidBodies->end();rb++)
+			for(int i = 0; i < rigidBodyWorld.size(); i++)
 			{
-				b = &*rb;
+				if(rigidBodyWorld.isStatic[i])
+					continue;
+				XMFLOAT3& v = rigidBodyWorld.velocities[i];
+				XMFLOAT3& x = rigidBodyWorld.positions[i];
 				//a->setVelocity(addVector(a->gp_velocity,invertVector(addVector(a->gp_position,XMFLOAT3(0,3,0)),g_explosionForce)));
-				b->setLinearVelocity(addVector(b->getVelocity(),multiplyVector(normalizeVector(addVector(b->getPosition(),XMFLOAT3(0,2,0))),g_explosionForce/vectorLength(b->getPosition()))));
+				v = addVector(v,multiplyVector(normalizeVector(addVector(x,XMFLOAT3(0,2,0))),g_explosionForce/vectorLength(x)));
 			}
 		}
 
@@ -715,8 +1158,9 @@ void InitTweakBar(ID3D11Device* pd3dDevice)
     g_pTweakBar = TwNewBar("TweakBar");
 	TwDefine(" TweakBar color='0 128 128' alpha=128 ");
 
-	TwType TW_TYPE_INTEGRATOR = TwDefineEnumFromString("Integration Method", "Euler,Midpoint,LeapFrog");
+	TwType TW_TYPE_INTEGRATOR = TwDefineEnumFromString("Integration Method", "Euler,Midpoint,LeapFrog,Adaptive RK45");
 	TwType TW_TYPE_DEMOCASE = TwDefineEnumFromString("Demo Setup", "Demo 1/2/3,Demo 4");
+	TwType TW_TYPE_CORRECTION = TwDefineEnumFromString("Position Correction", "None,Baumgarte,Split impulse");
 	TwType TW_TYPE_TESTCASE = TwDefineEnumFromString("Test Scene", "MSS Demo 1,MSS Demo 2,MSS Demo 3,MSS Demo 4, RB Demo 1, RB Demo 2, RB Demo 3, RB Demo 4, FlSim Demo, FlSim Grid Demo,Ex4 SpringDamper+RigidBodies");
 	TwAddVarRW(g_pTweakBar, "Test Scene", TW_TYPE_TESTCASE, &g_iTestCase, "");
 	// HINT: For buttons you can directly pass the callback function as a lambda expression.
@@ -738,10 +1182,22 @@ void InitTweakBar(ID3D11Device* pd3dDevice)
 	case 3:
 		TwAddVarRW(g_pTweakBar, "Demo Setup", TW_TYPE_DEMOCASE, &g_demoCase, "");
 		TwAddVarRW(g_pTweakBar, "-> Integration Method", TW_TYPE_INTEGRATOR, &g_integrationMethod, "");
+		TwAddVarRW(g_pTweakBar, "-> RK45 tolerance", TW_TYPE_FLOAT, &g_adaptiveIntegrator.tolerance, "min=0.0000001 max=0.1 step=0.00001");
+		TwAddVarRW(g_pTweakBar, "-> RK45 max step", TW_TYPE_FLOAT, &g_adaptiveIntegrator.maxStep, "min=0.0001 max=0.5 step=0.001");
+		TwAddVarRW(g_pTweakBar, "-> RK45 max growth", TW_TYPE_FLOAT, &g_adaptiveIntegrator.maxGrowth, "min=1 max=10 step=0.1");
+		TwAddVarRO(g_pTweakBar, "RK45 steps (frame)", TW_TYPE_INT32, &g_adaptiveIntegrator.frameAcceptedSteps, "");
+		TwAddVarRO(g_pTweakBar, "RK45 rejected (frame)", TW_TYPE_INT32, &g_adaptiveIntegrator.frameRejectedSteps, "");
+		TwAddVarRO(g_pTweakBar, "RK45 steps (total)", TW_TYPE_INT32, &g_adaptiveIntegrator.acceptedSteps, "");
+		TwAddVarRO(g_pTweakBar, "RK45 rejected (total)", TW_TYPE_INT32, &g_adaptiveIntegrator.rejectedSteps, "");
+		TwAddVarRO(g_pTweakBar, "RK45 last step", TW_TYPE_FLOAT, &g_adaptiveIntegrator.lastStep, "");
+		TwAddVarRO(g_pTweakBar, "RK45 last error", TW_TYPE_FLOAT, &g_adaptiveIntegrator.lastError, "");
 		TwAddVarRW(g_pTweakBar, "Use damping", TW_TYPE_BOOLCPP, &g_useDamping, "");
 		TwAddVarRW(g_pTweakBar, "Point Size", TW_TYPE_FLOAT, &g_fSphereSize, "min=0.01 step=0.01");
 		TwAddVarRW(g_pTweakBar, "Use fixed timestep", TW_TYPE_BOOLCPP, &g_fixedTimestep, "");
 		TwAddVarRW(g_pTweakBar, "-> timestep (ms)", TW_TYPE_FLOAT, &g_manualTimestep, "min=0.001 step=0.001");
+		TwAddVarRW(g_pTweakBar, "-> max sub-steps", TW_TYPE_INT32, &g_simulationClock.maxSubSteps, "min=1 max=64");
+		TwAddVarRO(g_pTweakBar, "Sub-steps (frame)", TW_TYPE_INT32, &g_simulationClock.lastSubSteps, "");
+		TwAddVarRO(g_pTweakBar, "Dropped time", TW_TYPE_FLOAT, &g_simulationClock.droppedTime, "");
 		TwAddVarRW(g_pTweakBar, "Use gravity", TW_TYPE_BOOLCPP, &g_useGravity, "");
 		TwAddVarRW(g_pTweakBar, "-> gravity constant", TW_TYPE_FLOAT, &g_gravity, "min=-20 ma=20 step=0.1");
 		TwAddVarRW(g_pTweakBar, "Collide with walls:", TW_TYPE_BOOLCPP, &g_usingWalls, "");
@@ -799,6 +1255,9 @@ void InitTweakBar(ID3D11Device* pd3dDevice)
 		//RB Demo 4
 		TwAddVarRW(g_pTweakBar, "Use fixed timestep", TW_TYPE_BOOLCPP, &g_fixedTimestep, "");
 		TwAddVarRW(g_pTweakBar, "-> timestep (ms)", TW_TYPE_FLOAT, &g_manualTimestep, "min=0.001 step=0.001");
+		TwAddVarRW(g_pTweakBar, "-> max sub-steps", TW_TYPE_INT32, &g_simulationClock.maxSubSteps, "min=1 max=64");
+		TwAddVarRO(g_pTweakBar, "Sub-steps (frame)", TW_TYPE_INT32, &g_simulationClock.lastSubSteps, "");
+		TwAddVarRO(g_pTweakBar, "Dropped time", TW_TYPE_FLOAT, &g_simulationClock.droppedTime, "");
 		TwAddVarRW(g_pTweakBar, "Use gravity", TW_TYPE_BOOLCPP, &g_useGravity, "");
 		TwAddVarRW(g_pTweakBar, "-> gravity constant", TW_TYPE_FLOAT, &g_gravity, "min=-20 max=20 step=0.1");
 		TwAddButton(g_pTweakBar, "Explode!!", [](void *){explode(); }, nullptr, "");	
@@ -806,6 +1265,36 @@ void InitTweakBar(ID3D11Device* pd3dDevice)
 		TwAddVarRW(g_pTweakBar, "Use damping", TW_TYPE_BOOLCPP, &g_useDamping, "");
 		TwAddVarRW(g_pTweakBar, "-> Linear Damping", TW_TYPE_FLOAT, &g_damping_linear, "min=0 ma=10 step=0.1");
 		TwAddVarRW(g_pTweakBar, "-> Angular Damping", TW_TYPE_FLOAT, &g_damping_angular, "min=0 max=10 step=0.1");
+		TwAddVarRW(g_pTweakBar, "Boxes", TW_TYPE_INT32, &g_rigidBodyCount, "min=10 max=5000 step=10");
+		TwAddVarRO(g_pTweakBar, "Broad phase pairs", TW_TYPE_INT32, &g_broadPhasePairs, "");
+		TwAddVarRW(g_pTweakBar, "AABB tree (else SAP)", TW_TYPE_BOOLCPP, &g_rigidBodyTree, "");
+		TwAddVarRO(g_pTweakBar, "Sweep axis", TW_TYPE_INT32, &rigidBodySweep.sweepAxis, "");
+		TwAddVarRO(g_pTweakBar, "Endpoint swaps", TW_TYPE_INT32, &rigidBodySweep.swaps, "");
+		TwAddVarRW(g_pTweakBar, "-> fat margin", TW_TYPE_FLOAT, &rigidBodyTree.margin, "min=0 step=0.01");
+		TwAddVarRO(g_pTweakBar, "Tree height", TW_TYPE_INT32, &rigidBodyTree.height, "");
+		TwAddVarRO(g_pTweakBar, "Tree reinsertions", TW_TYPE_INT32, &rigidBodyTree.reinsertions, "");
+		TwAddVarRW(g_pTweakBar, "Continuous collision", TW_TYPE_BOOLCPP, &g_rigidBodyCCD, "");
+		TwAddVarRO(g_pTweakBar, "-> fast bodies", TW_TYPE_INT32, &rigidBodyCCD.fastBodies, "");
+		TwAddVarRO(g_pTweakBar, "-> impacts", TW_TYPE_INT32, &rigidBodyCCD.impacts, "");
+		TwAddVarRW(g_pTweakBar, "SAT manifolds", TW_TYPE_BOOLCPP, &g_rigidBodySAT, "");
+		TwAddVarRW(g_pTweakBar, "-> batched (4 pairs)", TW_TYPE_BOOLCPP, &g_rigidBodyBatch, "");
+		TwAddVarRW(g_pTweakBar, "Mixed shapes", TW_TYPE_BOOLCPP, &g_rigidBodyShapes, "");
+		TwAddVarRO(g_pTweakBar, "-> GJK queries", TW_TYPE_INT32, &rigidBodyConvex.queries, "");
+		TwAddVarRO(g_pTweakBar, "-> support calls", TW_TYPE_INT32, &rigidBodyConvex.iterations, "");
+		TwAddVarRO(g_pTweakBar, "-> EPA", TW_TYPE_INT32, &rigidBodyConvex.penetrations, "");
+		TwAddVarRO(g_pTweakBar, "Contact points", TW_TYPE_INT32, &g_rigidBodyContacts, "");
+		TwAddVarRW(g_pTweakBar, "-> friction", TW_TYPE_FLOAT, &g_rigidBodyFriction, "min=0 max=2 step=0.05");
+		TwAddVarRO(g_pTweakBar, "-> warm started", TW_TYPE_INT32, &rigidBodyContactCache.matchedPoints, "");
+		TwAddVarRO(g_pTweakBar, "-> new", TW_TYPE_INT32, &rigidBodyContactCache.newPoints, "");
+		TwAddVarRW(g_pTweakBar, "Solver iterations", TW_TYPE_INT32, &rigidBodySolver.iterations, "min=1 max=100");
+		TwAddVarRW(g_pTweakBar, "-> position correction", TW_TYPE_CORRECTION, &rigidBodySolver.positionCorrection, "");
+		TwAddVarRW(g_pTweakBar, "-> correction factor", TW_TYPE_FLOAT, &rigidBodySolver.correctionFactor, "min=0 max=1 step=0.05");
+		TwAddVarRW(g_pTweakBar, "-> restitution", TW_TYPE_FLOAT, &rigidBodySolver.restitution, "min=0 max=1 step=0.05");
+		TwAddVarRO(g_pTweakBar, "Islands", TW_TYPE_INT32, &rigidBodySolver.islandCount, "");
+		TwAddVarRO(g_pTweakBar, "-> largest (contacts)", TW_TYPE_INT32, &rigidBodySolver.largestIsland, "");
+		TwAddVarRW(g_pTweakBar, "-> colour from", TW_TYPE_INT32, &rigidBodySolver.colouringThreshold, "min=16 step=16");
+		TwAddVarRO(g_pTweakBar, "-> colours", TW_TYPE_INT32, &rigidBodySolver.colourCount, "");
+		AddHeapCountVars();
 		break;
 	case 8: //normal fluid
 		TwAddButton(g_pTweakBar, "Number of Particles", NULL, NULL, "");
@@ -815,6 +1304,7 @@ void InitTweakBar(ID3D11Device* pd3dDevice)
 		TwAddVarRW(g_pTweakBar, "Frametime Benchmark only", TW_TYPE_BOOLCPP, &g_Benchmark, "");
 		TwAddVarRO(g_pTweakBar, "Last Frametime (Native):", TW_TYPE_FLOAT, &frametimeNative, "");
 		TwAddVarRO(g_pTweakBar, "Last Frametime (Grid):", TW_TYPE_FLOAT, &frametimeGrid, "");
+		AddHeapCountVars();
 		break;
 	case 9: //grid fluid
 		TwAddVarRW(g_pTweakBar, "Particle size", TW_TYPE_FLOAT, &kernelsize, "min=0.001 step=0.001");
@@ -839,14 +1329,79 @@ void InitTweakBar(ID3D11Device* pd3dDevice)
 		TwAddVarRW(g_pTweakBar, "Frametime Benchmark only", TW_TYPE_BOOLCPP, &g_Benchmark, "");		
 		TwAddVarRO(g_pTweakBar, "Last Frametime (Native):", TW_TYPE_FLOAT, &frametimeNative, "");
 		TwAddVarRO(g_pTweakBar, "Last Frametime (Grid):", TW_TYPE_FLOAT, &frametimeGrid, "");
+		AddHeapCountVars();
 		break;
 	case 10:
 		//std::cout << "EX4 MASS SPRING CLOTH AND RIGID BODY" << std::endl;
 		TwAddVarRW(g_pTweakBar, "Use fixed timestep", TW_TYPE_BOOLCPP, &ex4_fixed, "");
+		TwAddVarRW(g_pTweakBar, "-> timestep (ms)", TW_TYPE_FLOAT, &g_clothTimestep, "min=0.001 step=0.001");
+		TwAddVarRW(g_pTweakBar, "-> max sub-steps", TW_TYPE_INT32, &g_simulationClock.maxSubSteps, "min=1 max=64");
+		TwAddVarRO(g_pTweakBar, "Sub-steps (frame)", TW_TYPE_INT32, &g_simulationClock.lastSubSteps, "");
 		TwAddVarRW(g_pTweakBar, "Spring Stiffness Coeff.:", TW_TYPE_FLOAT, &springStiffness,"");
 		TwAddVarRW(g_pTweakBar, "Spring Damping Coeff.:", TW_TYPE_FLOAT, &springDamping,"");
 		TwAddVarRW(g_pTweakBar, "Horizontal Cloth", TW_TYPE_BOOLCPP, &cloth_horizontal,"");
 		TwAddVarRW(g_pTweakBar, "Ripe:", TW_TYPE_FLOAT, &ripeforce,"min=0.5 max=10 step=0.1");
+		TwAddVarRO(g_pTweakBar, "Torn springs", TW_TYPE_INT32, &cloth.totalTornSprings, "");
+		TwAddVarRW(g_pTweakBar, "Cloth resolution", TW_TYPE_INT32, &g_clothResolution, "min=2 max=512");
+		TwAddVarRW(g_pTweakBar, "Cloth from mesh file", TW_TYPE_BOOLCPP, &g_clothFromMesh, "");
+		TwAddVarRW(g_pTweakBar, "Self collision", TW_TYPE_BOOLCPP, &g_clothSelfCollision, "");
+		TwAddVarRW(g_pTweakBar, "-> thickness (edge length)", TW_TYPE_FLOAT, &clothSelfCollision.thicknessScale, "min=0.05 max=1 step=0.05");
+		TwAddVarRO(g_pTweakBar, "Self contacts", TW_TYPE_INT32, &clothSelfCollision.lastContacts, "");
+		TwAddVarRO(g_pTweakBar, "-> truncated triangles", TW_TYPE_INT32, &clothSelfCollision.lastTruncatedTriangles, "");
+		TwAddVarRW(g_pTweakBar, "Strain limiting", TW_TYPE_BOOLCPP, &g_clothStrainLimit, "");
+		TwAddVarRW(g_pTweakBar, "-> max stretch", TW_TYPE_FLOAT, &clothStrainLimiter.maxStretch, "min=0 max=2 step=0.01");
+		TwAddVarRW(g_pTweakBar, "-> max compression", TW_TYPE_FLOAT, &clothStrainLimiter.maxCompression, "min=0 max=1 step=0.01");
+		TwAddVarRW(g_pTweakBar, "-> iterations", TW_TYPE_INT32, &clothStrainLimiter.iterations, "min=1 max=64");
+		TwAddVarRO(g_pTweakBar, "Limited springs", TW_TYPE_INT32, &clothStrainLimiter.lastLimitedSprings, "");
+		TwAddVarRO(g_pTweakBar, "Spring colours", TW_TYPE_INT32, &clothStrainLimiter.colourCount, "");
+		TwAddVarRW(g_pTweakBar, "Multirate integration", TW_TYPE_BOOLCPP, &g_clothMultirate, "");
+		TwAddVarRW(g_pTweakBar, "-> stability limit", TW_TYPE_FLOAT, &clothMultirate.stabilityLimit, "min=0.05 max=1 step=0.05");
+		TwAddVarRO(g_pTweakBar, "Fast springs", TW_TYPE_INT32, &clothMultirate.fastSpringCount, "");
+		TwAddVarRO(g_pTweakBar, "Fast sub-steps", TW_TYPE_INT32, &clothMultirate.lastSubSteps, "");
+		TwAddButton(g_pTweakBar, "Reorder cloth points", [](void *){ ReorderCloth(); }, nullptr, "");
+		TwAddVarRW(g_pTweakBar, "-> Hilbert order (else RCM)", TW_TYPE_BOOLCPP, &g_clothHilbertOrder, "");
+		TwAddVarRW(g_pTweakBar, "-> after topology changes", TW_TYPE_BOOLCPP, &g_clothAutoReorder, "");
+		TwAddVarRO(g_pTweakBar, "Cache misses before", TW_TYPE_INT32, &clothOrdering.cacheMissesBefore, "");
+		TwAddVarRO(g_pTweakBar, "Cache misses after", TW_TYPE_INT32, &clothOrdering.cacheMissesAfter, "");
+		TwAddVarRW(g_pTweakBar, "FEM body (tet meshes)", TW_TYPE_BOOLCPP, &g_clothFEM, "");
+		TwAddVarRW(g_pTweakBar, "-> Young's modulus", TW_TYPE_FLOAT, &clothFEM.youngsModulus, "min=1 step=10");
+		TwAddVarRW(g_pTweakBar, "-> Poisson ratio", TW_TYPE_FLOAT, &clothFEM.poissonRatio, "min=0 max=0.49 step=0.01");
+		TwAddVarRW(g_pTweakBar, "-> mass damping", TW_TYPE_FLOAT, &clothFEM.massDamping, "min=0 step=0.01");
+		TwAddVarRW(g_pTweakBar, "-> stiffness damping", TW_TYPE_FLOAT, &clothFEM.stiffnessDamping, "min=0 step=0.001");
+		TwAddVarRO(g_pTweakBar, "FEM CG iterations", TW_TYPE_INT32, &clothFEM.lastIterations, "");
+		TwAddVarRO(g_pTweakBar, "Inverted tets", TW_TYPE_INT32, &clothFEM.invertedElements, "");
+		TwAddVarRW(g_pTweakBar, "Sleeping regions", TW_TYPE_BOOLCPP, &g_clothSleep, "");
+		TwAddVarRW(g_pTweakBar, "-> region size (spring lengths)", TW_TYPE_FLOAT, &g_clothSleepRegionScale, "min=1 max=32 step=1");
+		TwAddVarRW(g_pTweakBar, "-> sleep speed", TW_TYPE_FLOAT, &clothSleep.sleepSpeed, "min=0 step=0.005");
+		TwAddVarRW(g_pTweakBar, "-> wake speed", TW_TYPE_FLOAT, &clothSleep.wakeSpeed, "min=0 step=0.01");
+		TwAddVarRW(g_pTweakBar, "-> steps before sleeping", TW_TYPE_INT32, &clothSleep.sleepSteps, "min=1 max=600");
+		TwAddVarRO(g_pTweakBar, "Asleep regions", TW_TYPE_INT32, &clothSleep.sleepingRegions, "");
+		TwAddVarRO(g_pTweakBar, "Regions", TW_TYPE_INT32, &clothSleep.regionCount, "");
+		TwAddVarRO(g_pTweakBar, "Sleeping points", TW_TYPE_INT32, &clothSleep.sleepingPoints, "");
+		TwAddVarRO(g_pTweakBar, "Sleeps", TW_TYPE_INT32, &clothSleep.sleepCount, "");
+		TwAddVarRO(g_pTweakBar, "Wakes", TW_TYPE_INT32, &clothSleep.wakeCount, "");
+#ifdef MEASURE_CLOTH_SLEEPING
+		TwAddButton(g_pTweakBar, "Measure sleeping cost", [](void *){ MeasureClothSleeping(); }, nullptr, "");
+#endif
+		TwAddVarRW(g_pTweakBar, "Shape matching", TW_TYPE_BOOLCPP, &g_clothShapeMatching, "");
+		TwAddVarRW(g_pTweakBar, "-> cluster cells (spring lengths)", TW_TYPE_FLOAT, &g_clothClusterScale, "min=1 max=8 step=0.5");
+		TwAddVarRW(g_pTweakBar, "-> stiffness", TW_TYPE_FLOAT, &clothShapeMatching.stiffness, "min=0 max=1 step=0.05");
+		TwAddVarRW(g_pTweakBar, "-> linear blend", TW_TYPE_FLOAT, &clothShapeMatching.linearBlend, "min=0 max=1 step=0.05");
+		TwAddVarRW(g_pTweakBar, "-> passes", TW_TYPE_INT32, &clothShapeMatching.iterations, "min=1 max=10");
+		TwAddVarRO(g_pTweakBar, "Clusters", TW_TYPE_INT32, &clothShapeMatching.clusterCount, "");
+		TwAddVarRW(g_pTweakBar, "Reduced (modal) cloth", TW_TYPE_BOOLCPP, &g_clothReduced, "");
+		TwAddVarRW(g_pTweakBar, "-> modes", TW_TYPE_INT32, &clothModes.modeCount, "min=1 max=64");
+		TwAddVarRW(g_pTweakBar, "-> modal derivatives", TW_TYPE_INT32, &clothModes.derivativeModes, "min=0 max=8");
+		TwAddVarRW(g_pTweakBar, "-> prestress", TW_TYPE_FLOAT, &clothModes.prestress, "min=0 max=1 step=0.01");
+		TwAddVarRW(g_pTweakBar, "-> modal damping", TW_TYPE_FLOAT, &clothModes.dampingRatio, "min=0 max=0.99 step=0.01");
+		TwAddVarRO(g_pTweakBar, "Basis columns", TW_TYPE_INT32, &clothModes.basisColumns, "");
+		TwAddVarRO(g_pTweakBar, "Basis build (s)", TW_TYPE_FLOAT, &clothModes.buildSeconds, "");
+		TwAddVarRO(g_pTweakBar, "Basis build (%)", TW_TYPE_INT32, &g_clothModesProgress, "");
+		TwAddVarRO(g_pTweakBar, "Lowest mode (Hz)", TW_TYPE_FLOAT, &clothModes.lowestFrequency, "");
+		TwAddVarRW(g_pTweakBar, "Frametime Benchmark only", TW_TYPE_BOOLCPP, &g_Benchmark, "");
+		TwAddVarRO(g_pTweakBar, "Last Frametime (Cloth):", TW_TYPE_FLOAT, &frametimeCloth, "");
+		TwAddVarRO(g_pTweakBar, "Last Frametime (Self coll.):", TW_TYPE_FLOAT, &frametimeSelfCollision, "");
+		AddHeapCountVars();
 		TwAddVarRW(g_pTweakBar, "-> gravity constant", TW_TYPE_FLOAT, &g_gravity, "min=-20 max=20 step=0.1");
 		break;
 	default:
@@ -1033,8 +1588,9 @@ void DrawPoint(ID3D11DeviceContext* pd3dImmediateContext, SpringPoint* point)
 	//g_pEffectPositionNormal->SetSpecularColor(0.5f * Colors::White);
     //g_pEffectPositionNormal->SetSpecularPower(50);
 
-	//set position
-	XMMATRIX trans    = XMMatrixTranslation(point->gp_position.x,point->gp_position.y,point->gp_position.z);
+	//set position (interpolated between the last two simulation steps)
+	XMFLOAT3 position = point->getRenderPosition(g_renderAlpha);
+	XMMATRIX trans    = XMMatrixTranslation(position.x,position.y,position.z);
     g_pEffectPositionNormal->SetWorld(scale * trans * g_camera.GetWorldMatrix());
 
 	//draw everything
@@ -1073,20 +1629,23 @@ void DrawSpring(ID3D11DeviceContext* pd3dImmediateContext, Spring* spring)
     g_pEffectPositionColor->Apply(pd3dImmediateContext);
     pd3dImmediateContext->IASetInputLayout(g_pInputLayoutPositionColor);
 
+	XMFLOAT3 p1 = spring->gs_point1->getRenderPosition(g_renderAlpha);
+	XMFLOAT3 p2 = spring->gs_point2->getRenderPosition(g_renderAlpha);
+
     // Draw
     g_pPrimitiveBatchPositionColor->Begin();
 	if(g_iTestCase != 10)
 	{
 		g_pPrimitiveBatchPositionColor->DrawLine(
-			VertexPositionColor(XMVectorSet(spring->gs_point1->gp_position.x,spring->gs_point1->gp_position.y,spring->gs_point1->gp_position.z, 1),TUM_BLUE),
-			VertexPositionColor(XMVectorSet(spring->gs_point2->gp_position.x,spring->gs_point2->gp_position.y,spring->gs_point2->gp_position.z, 1), Colors::White)
+			VertexPositionColor(XMVectorSet(p1.x,p1.y,p1.z, 1),TUM_BLUE),
+			VertexPositionColor(XMVectorSet(p2.x,p2.y,p2.z, 1), Colors::White)
 		);
 	}
 	else
 	{
 			g_pPrimitiveBatchPositionColor->DrawLine(
-				VertexPositionColor(XMVectorSet(spring->gs_point1->gp_position.x,spring->gs_point1->gp_position.y,spring->gs_point1->gp_position.z, 1),Colors::OrangeRed),
-				VertexPositionColor(XMVectorSet(spring->gs_point2->gp_position.x,spring->gs_point2->gp_position.y,spring->gs_point2->gp_position.z, 1), Colors::Orange)
+				VertexPositionColor(XMVectorSet(p1.x,p1.y,p1.z, 1),Colors::OrangeRed),
+				VertexPositionColor(XMVectorSet(p2.x,p2.y,p2.z, 1), Colors::Orange)
 		);
 	}
     
@@ -1109,6 +1668,14 @@ void DrawMassSpringSystem(ID3D11DeviceContext* pd3dImmediateContext)
 	
 }
 
+void DrawSpringNetwork(ID3D11DeviceContext* pd3dImmediateContext, SpringNetwork& network)
+{
+	for(auto point = network.points.begin(); point != network.points.end();point++)
+		DrawPoint(pd3dImmediateContext, &(*point));
+	for(auto spring = network.springs.begin(); spring != network.springs.end();spring++)
+		DrawSpring(pd3dImmediateContext, &(*spring));
+}
+
 
 #endif
 
@@ -1135,9 +1702,10 @@ void DrawCube(rigidBody* rb) {
 	//set position
 	//cout << "scale x,y,z: " << rb->scale.x << ", " << rb->scale.y << ", " << rb->scale.z << std::endl;
 	//cout << "pos x,y,z: " << rb->r_position.x << ", " << rb->r_position.y << ", " << rb->r_position.z << std::endl;
+	XMFLOAT3 position = rb->getRenderPosition(g_renderAlpha);
 	XMMATRIX scale    = XMMatrixScaling(rb->getScale().x, rb->getScale().y, rb->getScale().z);
-	XMMATRIX trans    = XMMatrixTranslation(rb->getPosition().x,rb->getPosition().y,rb->getPosition().z);
-	XMMATRIX rotation = XMMatrixRotationQuaternion(XMLoadFloat4(&rb->getRotationQuaternion()));
+	XMMATRIX trans    = XMMatrixTranslation(position.x,position.y,position.z);
+	XMMATRIX rotation = XMMatrixRotationQuaternion(XMLoadFloat4(&rb->getRenderRotation(g_renderAlpha)));
     g_pEffectPositionNormal->SetWorld( scale * rotation * trans/* g_camera.GetWorldMatrix()*/); //scale * trans * rotation * g_camera.GetWorldMatrix());
 
 	//draw everything
@@ -1152,6 +1720,34 @@ XMMATRIX getObj2WorldMat(rigidBody* rb1){
 		XMMATRIX rotation1 = XMMatrixRotationQuaternion(XMLoadFloat4(&rb1->getRotationQuaternion()));
 		return scale1 * rotation1 * trans1;
 }
+//a scaled unit cube, bodyToWorld as getObj2WorldMat builds it
+void DrawCollisionCube(const XMMATRIX& bodyToWorld) {
+	g_pEffectPositionNormal->SetDiffuseColor(TUM_BLUE_LIGHT);
+	g_pEffectPositionNormal->SetEmissiveColor(Colors::Black);
+	g_pEffectPositionNormal->SetSpecularColor(0.5f * Colors::White);
+	g_pEffectPositionNormal->SetSpecularPower(50);
+	g_pEffectPositionNormal->SetWorld(bodyToWorld);
+	g_pCube->Draw(g_pEffectPositionNormal, g_pInputLayoutPositionNormal);
+}
+
+//a convex shape of demo 4 from its mesh, bodyToWorld is its rotation and translation
+void DrawConvexShape(ID3D11DeviceContext* pd3dImmediateContext, const ConvexShape& shape, const XMMATRIX& bodyToWorld) {
+	static std::vector<VertexPositionNormal> vertices;
+	vertices.clear();
+	for(size_t i = 0; i < shape.meshPositions.size(); i++)
+		vertices.push_back(VertexPositionNormal(shape.meshPositions[i], shape.meshNormals[i]));
+	g_pEffectPositionNormal->SetDiffuseColor(TUM_BLUE);
+	g_pEffectPositionNormal->SetEmissiveColor(Colors::Black);
+	g_pEffectPositionNormal->SetSpecularColor(0.5f * Colors::White);
+	g_pEffectPositionNormal->SetSpecularPower(50);
+	g_pEffectPositionNormal->SetWorld(bodyToWorld);
+	g_pEffectPositionNormal->Apply(pd3dImmediateContext);
+	pd3dImmediateContext->IASetInputLayout(g_pInputLayoutPositionNormal);
+	g_pPrimitiveBatchPositionNormal->Begin();
+	g_pPrimitiveBatchPositionNormal->DrawIndexed(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST, &shape.meshIndices[0], shape.meshIndices.size(), &vertices[0], vertices.size());
+	g_pPrimitiveBatchPositionNormal->End();
+}
+
 void DrawCollisionCubes(rigidBody* rb1) {
 	//TODO FIX ALL CODE IN THIS TO SUIT COLLISIONS
 	//set color
@@ -1170,9 +1766,10 @@ void DrawCollisionCubes(rigidBody* rb1) {
 	//set position
 	//cout << "scale x,y,z: " << rb->scale.x << ", " << rb->scale.y << ", " << rb->scale.z << std::endl;
 	//cout << "pos x,y,z: " << rb->r_position.x << ", " << rb->r_position.y << ", " << rb->r_position.z << std::endl;
+	XMFLOAT3 position1 = rb1->getRenderPosition(g_renderAlpha);
 	XMMATRIX scale1    = XMMatrixScaling(rb1->getScale().x, rb1->getScale().y, rb1->getScale().z);
-	XMMATRIX trans1    = XMMatrixTranslation(rb1->getPosition().x,rb1->getPosition().y,rb1->getPosition().z);
-	XMMATRIX rotation1 = XMMatrixRotationQuaternion(XMLoadFloat4(&rb1->getRotationQuaternion()));
+	XMMATRIX trans1    = XMMatrixTranslation(position1.x,position1.y,position1.z);
+	XMMATRIX rotation1 = XMMatrixRotationQuaternion(XMLoadFloat4(&rb1->getRenderRotation(g_renderAlpha)));
 	XMFLOAT4X4 debug; 
 	XMStoreFloat4x4(&debug, rotation1);
     g_pEffectPositionNormal->SetWorld( scale1 * rotation1 * trans1/* g_camera.GetWorldMatrix()*/); //scale * trans * rotation * g_camera.GetWorldMatrix());
@@ -1357,6 +1954,7 @@ void CALLBACK OnD3D11DestroyDevice( void* pUserContext )
 	//Destroy Rigid Body Simulation
 	DestroyRigidBodies();
 
+	CancelClothModes();
 	DestroyMassSprings();
 }
 
@@ -1504,6 +2102,48 @@ void applyForceByMouseDrag(int& xPos, int& yPos, int& xPosSave, int& yPosSave, r
 			cout << std:: endl << "Mouse [-1; 1]: " << "\t" << ((static_cast<float>(xPos)/g_windowWidth) * 2.f - 1.f) << "\t" << (((static_cast<double>(yPos)/g_windowHeight) * 2.f - 1.f) * -1.f) << std::endl;*/
 }
 
+//demo 4: the force goes to the box corner closest to the mouse on screen, the corners come from the cached world matrices
+void applyForceByMouseDrag(int& xPos, int& yPos, int& xPosSave, int& yPosSave, RigidBodyWorld& world, float forceScale) {
+	g_viMouseDelta.x += xPos - xPosSave;
+	g_viMouseDelta.y += yPos - yPosSave;
+	xPosSave = xPos;
+	yPosSave = yPos;
+
+	XMMATRIX viewInv = XMMatrixInverse(nullptr, g_camera.GetViewMatrix());
+	XMVECTOR force = forceScale * (float)g_viMouseDelta.x * XMVector3TransformNormal(g_XMIdentityR0, viewInv)
+		- forceScale * (float)g_viMouseDelta.y * XMVector3TransformNormal(g_XMIdentityR1, viewInv);
+	g_viMouseDelta = XMINT2(0, 0);
+
+	XMMATRIX viewProjection = g_camera.GetViewMatrix() * g_camera.GetProjMatrix();
+	XMVECTOR mouse = XMVectorSet((static_cast<float>(xPos)/g_windowWidth) * 2.f - 1.f, ((static_cast<float>(yPos)/g_windowHeight) * 2.f - 1.f) * -1.f, 0.f, 0.f);
+	float distanceMousePoint = FLT_MAX;
+	int closestBody = -1;
+	XMVECTOR closest = XMVectorZero();
+	for(int i = 0; i < world.size(); i++) {
+		if(world.isStatic[i])
+			continue;
+		XMMATRIX bodyToWorld = XMLoadFloat4x4(&world.world[i]);
+		//boxes by their closest corner, convex shapes by the centre
+		int corners = world.bodyShapes[i] < 0 ? 8 : 1;
+		for(int corner = 0; corner < corners; corner++) {
+			XMVECTOR point = corners == 1 ? XMLoadFloat3(&world.positions[i]) : XMVector3Transform(XMVectorSet(corner&1 ? 0.5f : -0.5f, corner&2 ? 0.5f : -0.5f, corner&4 ? 0.5f : -0.5f, 0.f), bodyToWorld);
+			XMVECTOR screen = XMVector3TransformCoord(point, viewProjection);
+			float distance = XMVectorGetX(XMVector2LengthSq(screen - mouse));
+			if(distance < distanceMousePoint) {
+				distanceMousePoint = distance;
+				closestBody = i;
+				closest = point;
+			}
+		}
+	}
+	if(closestBody < 0)
+		return;
+	XMFLOAT3 point, vfForce;
+	XMStoreFloat3(&point, closest);
+	XMStoreFloat3(&vfForce, force);
+	world.applyForce(closestBody, point, vfForce);
+}
+
 //--------------------------------------------------------------------------------------
 // Handle mouse button presses
 //--------------------------------------------------------------------------------------
@@ -1596,7 +2236,7 @@ void CALLBACK OnMouse( bool bLeftButtonDown, bool bRightButtonDown, bool bMiddle
 		if (bLeftButtonDown) {
 			//cout << std::endl << "case 6" << std::endl;
 			//cout << std::endl << sizeof(rbs) / sizeof(*rbs) << std::endl;
-			applyForceByMouseDrag(xPos, yPos, xPosSave, yPosSave, rigidBodies->data(), rigidBodies->size(), 0.5f);
+			applyForceByMouseDrag(xPos, yPos, xPosSave, yPosSave, rigidBodyWorld, 0.5f);
 		}
 		break;
 	}
@@ -1657,6 +2297,437 @@ void static colideWithBOundaryCube(float* vecs[2][3], float boundaryCubeHalfSide
 	}
 }
 
+//--------------------------------------------------------------------------------------
+// Fixed step updates, called by OnFrameMove once per simulation step
+//--------------------------------------------------------------------------------------
+//ground or wall collision for all mass spring points in one batch, the pointer array keeps its storage between steps
+std::vector<SpringPoint*> g_collisionPoints;
+void CollideMassSpringPoints(float deltaTime)
+{
+	g_collisionPoints.assign(points.begin(), points.end());
+	if(g_collisionPoints.empty())
+		return;
+	ContainmentBox box = g_usingWalls ? ContainmentBox::walls(g_fSphereSize,g_xWall,g_zWall,g_ceiling) : ContainmentBox::ground(g_fSphereSize);
+	PointCollision::resolve(&g_collisionPoints[0], (int)g_collisionPoints.size(), box, deltaTime);
+}
+
+void StepMassSpringSystem(float deltaTime)
+{
+	SpringPoint* a;
+	Spring* b;
+	switch (g_integrationMethod)
+	{
+	case 0: //EULER
+		for(auto spring = springs.begin(); spring != springs.end(); spring++)
+		{
+			b= &((Spring)*spring);
+			b->computeElasticForces();
+		}
+		for(auto point = points.begin(); point != points.end();point++)
+		{
+
+			a =  ((SpringPoint*)*point);
+			if(g_useGravity) { a->addGravity(g_gravity); }
+			if(g_useDamping) {a->addDamping(deltaTime); }
+			a->IntegratePosition(deltaTime);
+			a->computeAcceleration();
+			a->IntegrateVelocity(deltaTime);
+			a->resetForces();
+		}	
+		CollideMassSpringPoints(deltaTime);
+		
+		if(g_firstStep == true && g_demoCase == 0)
+		{
+			for(auto spring = springs.begin(); spring != springs.end(); spring++)
+			{
+				b= &((Spring)*spring);
+				std::cout << "\nEuler demo1 after one time step:\n";
+				b->printSpring();
+			}
+			g_firstStep = false;
+		}
+		break;
+	case 1: //MIDPOINT
+		for(auto spring = springs.begin(); spring != springs.end();spring++)
+		{
+			b= &(((Spring)*spring));
+			b->computeElasticForces();
+		}
+		for(auto point = points.begin(); point != points.end();point++)
+		{	
+			a =  (((SpringPoint*)*point));
+			if(g_useGravity) { a->addGravity(g_gravity); }
+			a->gp_posTemp = a->IntegratePositionTmp(deltaTime/2.0f);
+			a->computeAcceleration();
+			a->gp_velTemp = a->IntegrateVelocityTmp(deltaTime/2.0f);
+			if(g_useDamping) {a->addDamping(deltaTime); }
+			a->IntegratePosition(deltaTime, a->gp_velTemp);
+			a->resetForces();
+		}
+		for(auto spring = springs.begin(); spring != springs.end();spring++)
+		{
+			b= &(((Spring)*spring));
+			b->computeElasticForcesTmp();
+		}
+		for(auto point = points.begin(); point != points.end();point++)
+		{
+			a =  (((SpringPoint*)*point));
+			a->IntegrateVelocity(deltaTime);
+			a->resetForces();				
+		}
+		CollideMassSpringPoints(deltaTime);
+
+		if(g_firstStep == true && g_demoCase == 0)
+		{
+			for(auto spring = springs.begin(); spring != springs.end(); spring++)
+			{
+				b= &((Spring)*spring);
+				std::cout << "\nMidpoint demo1 after one time step:\n";
+				b->printSpring();
+			}
+			g_firstStep = false;
+		}
+		break;
+	case 2: //LEAP FROG
+		for(auto spring = springs.begin(); spring != springs.end();spring++)
+		{
+			b= &(((Spring)*spring));
+			b->computeElasticForces();
+		}
+		for(auto point = points.begin(); point != points.end();point++)
+		{
+			a =  (((SpringPoint*)*point));
+			if(g_useGravity) { a->addGravity(g_gravity); }
+			a->computeAcceleration();
+			a->IntegrateVelocity(deltaTime);
+			if(g_useDamping) {a->addDamping(deltaTime); }
+			a->IntegratePosition(deltaTime);
+			a->resetForces();
+		}	
+		CollideMassSpringPoints(deltaTime);
+		break;
+	case 3: //DORMAND-PRINCE
+		//the integrator picks its own step sizes inside the frame interval, collisions are applied after every accepted step
+		g_adaptiveIntegrator.advance(points, springs, deltaTime, g_gravity, g_useGravity, g_useDamping,
+			[](SpringPoint* p, float h) {
+				if(g_usingWalls)
+					p->computeCollisionWithWalls(h,g_fSphereSize,g_xWall,g_zWall,g_ceiling);
+				else
+					p->computeCollision(h, g_fSphereSize);
+			});
+		break;
+	default:
+		break;
+	}
+}
+
+void StepRigidBodies(float deltaTime)
+{
+	RigidBodyWorld& world = rigidBodyWorld;
+	//forces first, then contacts on the new velocities, then the bodies move.
+	//the matrices and bounds cached at the end of the last step are where the bodies are now
+	world.integrateVelocities(deltaTime, g_useGravity ? g_gravity : 0.f, g_useDamping ? g_damping_linear : 0.f, g_useDamping ? g_damping_angular : 0.f, g_threadPool);
+	//fast bodies enter the broad phase with their whole motion
+	if(g_rigidBodyCCD)
+		rigidBodyCCD.sweepBounds(world, deltaTime);
+	BroadPhase* broadPhase = g_rigidBodyTree ? (BroadPhase*)&rigidBodyTree : (BroadPhase*)&rigidBodySweep;
+	broadPhase->update(world.lower, world.upper, world.isStatic);
+	g_broadPhasePairs = (int)broadPhase->pairs.size();
+
+	//only the overlapping pairs reach the narrow phase, the floor is always the second body
+	SolverContact solverContact;
+	solverContact.friction = g_rigidBodyFriction;
+	rigidBodyContactList.clear();
+	rigidBodyContactSource.clear();
+	bool batched = g_rigidBodySAT && g_rigidBodyBatch;
+	if(batched)
+		rigidBodyBatch.run(world.world, broadPhase->pairs, g_threadPool, &world.bodyShapes);
+	rigidBodyConvex.resetStatistics();
+	for(size_t p = 0; p < broadPhase->pairs.size(); p++)
+	{
+		const std::pair<int, int>* pair = &broadPhase->pairs[p];
+		solverContact.bodyA = pair->first;
+		solverContact.bodyB = pair->second;
+		bool convex = world.bodyShapes[pair->first] >= 0 || world.bodyShapes[pair->second] >= 0;
+		if(g_rigidBodySAT || convex)
+		{
+			//pairs that left the broad phase are forgotten at the end of the step
+			CachedManifold& cached = rigidBodyContactCache.find(pair->first, pair->second);
+			int axis = cached.axis;
+			const ContactManifold* manifold = &rigidBodyManifold;
+			bool touching;
+			if(convex)
+			{
+				//one point per step, the cache builds the manifold up from them
+				ConvexShape boxA, boxB;
+				ConvexBody a, b;
+				a.shape = &world.shape(pair->first, boxA);
+				a.position = world.positions[pair->first];
+				a.orientation = world.orientations[pair->first];
+				b.shape = &world.shape(pair->second, boxB);
+				b.position = world.positions[pair->second];
+				b.orientation = world.orientations[pair->second];
+				rigidBodyConvex.query(a, b, cached.simplex, rigidBodyConvexResult);
+				touching = rigidBodyConvexResult.distance <= 0.f;
+			}
+			else if(batched)
+			{
+				int index = rigidBodyBatch.manifoldIndex[p];
+				axis = rigidBodyBatch.axes[p];
+				if(index >= 0)
+					manifold = &rigidBodyBatch.manifolds[index];
+				touching = index >= 0 && manifold->pointCount > 0;
+			}
+			else
+				touching = BoxCollision::collide(world.world[pair->first], world.world[pair->second], rigidBodyManifold, axis);
+			if(!touching)
+			{
+				cached.axis = axis;
+				cached.pointCount = 0;
+				continue;
+			}
+			if(convex)
+				rigidBodyContactCache.accumulate(cached, rigidBodyConvexResult, world.world[pair->first], world.worldInverse[pair->first], world.world[pair->second], world.worldInverse[pair->second]);
+			else
+				rigidBodyContactCache.refresh(cached, *manifold);
+			solverContact.normal = cached.normal;
+			for(int k = 0; k < cached.pointCount; k++)
+			{
+				solverContact.position = cached.points[k].position;
+				solverContact.depth = cached.points[k].depth;
+				solverContact.normalImpulse = cached.points[k].normalImpulse;
+				solverContact.frictionImpulse = cached.points[k].frictionImpulse;
+				rigidBodyContactList.push_back(solverContact);
+				rigidBodyContactSource.push_back(&cached.points[k]);
+			}
+			continue;
+		}
+		mat1 = XMLoadFloat4x4(&world.world[pair->first]);
+		mat2 = XMLoadFloat4x4(&world.world[pair->second]);
+		simpletest = checkCollision(mat1, XMLoadFloat4x4(&world.worldInverse[pair->first]), mat2);
+		if (!simpletest.isValid){ // Check if a corner of mat1 is in mat2
+			simpletest = checkCollision(mat2, XMLoadFloat4x4(&world.worldInverse[pair->second]), mat1);
+			simpletest.normalWorld = -simpletest.normalWorld;// we compute the impulse to A
+		}
+		if (simpletest.isValid)
+		{
+			XMStoreFloat3(&solverContact.position, simpletest.collisionPointWorld);
+			XMStoreFloat3(&solverContact.normal, simpletest.normalWorld);
+			solverContact.depth = 0.f;
+			solverContact.normalImpulse = 0.f;
+			solverContact.frictionImpulse = XMFLOAT3(0.f, 0.f, 0.f);
+			rigidBodyContactList.push_back(solverContact);
+			rigidBodyContactSource.push_back(nullptr);
+		}
+	}
+
+	//all contacts of the step together, warm started with last step's impulses, which are kept for the next one
+	rigidBodySolver.solve(rigidBodyContactList, world, deltaTime, g_threadPool, g_stepArena);
+	if(g_rigidBodyCCD)
+		rigidBodyCCD.integratePositions(world, broadPhase->pairs, deltaTime, g_threadPool);
+	else
+		world.integratePositions(deltaTime, g_threadPool);
+	world.updateTransforms(g_threadPool);
+	for(size_t k = 0; k < rigidBodyContactList.size(); k++)
+	{
+		//the corner test has nothing cached
+		if(!rigidBodyContactSource[k])
+			continue;
+		rigidBodyContactSource[k]->normalImpulse = rigidBodyContactList[k].normalImpulse;
+		rigidBodyContactSource[k]->frictionImpulse = rigidBodyContactList[k].frictionImpulse;
+	}
+	g_rigidBodyContacts = (int)rigidBodyContactList.size();
+	rigidBodyContactCache.endStep();
+}
+
+void StepClothAndRigidBody(float deltaTime)
+{
+	collWithRB = 0;
+
+	if(ClothReducedRuns()) {
+		//only the modal coordinates move, the points are rebuilt for drawing
+		clothModes.step(deltaTime, g_gravity);
+		rb->integrateValues(deltaTime);
+		if(cloth_horizontal)
+			rb->addGravity(deltaTime, g_gravity);
+		return;
+	}
+	bool isFEM = g_clothFEM && clothFEM.isInitialized();
+	bool isShapeMatching = !isFEM && g_clothShapeMatching && clothShapeMatching.isInitialized();
+	if(isFEM)
+		clothFEM.step(cloth, deltaTime, g_gravity, g_threadPool);
+	else if(isShapeMatching)
+		clothShapeMatching.step(cloth.points, deltaTime, g_gravity, g_threadPool);
+	else if(g_clothMultirate) {
+		clothMultirate.step(cloth, deltaTime, g_gravity);
+		//the integrator leaves the end of step lengths in the springs
+		for(int i = 0; i < (int)cloth.springs.size(); i++)
+			if(cloth.springs[i].gs_currentLength >= ripeforce*cloth.springs[i].gs_initialLength)
+				cloth.markTorn(i);
+	}
+	else
+		IntegrateClothMidpoint(cloth, ClothSleepApplies() ? &clothSleep : nullptr, deltaTime);
+	//only the midpoint integrator skips sleeping regions, the others keep everything awake
+	bool isSleeping = ClothSleepApplies();
+	if(!isSleeping && clothSleep.isInitialized())
+		clothSleep.wakeAll();
+	//the FEM body has its own (rayleigh) damping, shape matching damps through the stiffness
+	if(isSleeping)
+		for(auto index = clothSleep.activePoints.begin(); index != clothSleep.activePoints.end(); index++)
+			cloth.points[*index].addDamping(deltaTime);
+	else if(!isFEM && !isShapeMatching)
+		for(auto point = cloth.points.begin(); point != cloth.points.end();point++)
+			point->addDamping(deltaTime);
+	//a cloth that is asleep everywhere can't stretch or intersect itself any further
+	bool isResting = isSleeping && clothSleep.isAsleep();
+	if(g_clothStrainLimit && !isResting)
+		clothStrainLimiter.apply(cloth, g_threadPool);
+	//damping and the ground response both just scale the velocity, so colliding after the loop gives the same result.
+	//sleeping points rest where their last collision put them
+	if(isSleeping) {
+		if(!clothSleep.activePoints.empty())
+			PointCollision::resolve(&cloth.points[0], &clothSleep.activePoints[0], (int)clothSleep.activePoints.size(), ContainmentBox::ground(g_fSphereSize), deltaTime);
+	}
+	else
+		PointCollision::resolve(cloth.points, ContainmentBox::ground(g_fSphereSize), deltaTime);
+	if(g_clothSelfCollision && !isResting) {
+		auto selfBegin = std::chrono::high_resolution_clock::now();
+		clothSelfCollision.resolve(cloth, g_threadPool, g_stepArena);
+		auto selfEnd = std::chrono::high_resolution_clock::now();
+		frametimeSelfCollision = std::chrono::duration_cast<std::chrono::microseconds>(selfEnd-selfBegin).count()/1000.0f;
+	}
+	//integrate rb
+	rb->integrateValues(deltaTime);
+	if(cloth_horizontal)
+		rb->addGravity(deltaTime, g_gravity);
+	//rb->addDamping(deltaTime, g_damping_linear, g_damping_angular);
+	//a moving body wakes the sleeping regions around it, also when it moves away from the cloth
+	if(isSleeping && !rb->isStatic && vectorLength(rb->getVelocity()) + vectorLength(rb->getAngularVelocity()) > clothSleep.wakeSpeed) {
+		XMMATRIX bodyToWorld = getObj2WorldMat(rb);
+		XMVECTOR lower = XMVectorReplicate(FLT_MAX), upper = XMVectorReplicate(-FLT_MAX);
+		for(int corner = 0; corner < 8; corner++) {
+			XMVECTOR p = XMVector3Transform(XMVectorSet(corner & 1 ? 0.5f : -0.5f, corner & 2 ? 0.5f : -0.5f, corner & 4 ? 0.5f : -0.5f, 1.f), bodyToWorld);
+			lower = XMVectorMin(lower, p);
+			upper = XMVectorMax(upper, p);
+		}
+		XMVECTOR margin = XMVectorReplicate(g_fSphereSize + vectorLength(rb->getVelocity())*deltaTime);
+		XMFLOAT3 lowerBound, upperBound;
+		XMStoreFloat3(&lowerBound, lower - margin);
+		XMStoreFloat3(&upperBound, upper + margin);
+		clothSleep.wakeInside(lowerBound, upperBound);
+	}
+
+	//all bodies against all cloths in one batched query, the body transform is inverted once per step
+	rigidBody* clothBodies[] = { rb };
+	int bodyCount = sizeof(clothBodies)/sizeof(clothBodies[0]);
+	clothNetworks.assign(1, &cloth);
+	clothBoxes.resize(bodyCount);
+	for(int i = 0; i < bodyCount; i++)
+		XMStoreFloat4x4(&clothBoxes[i], getObj2WorldMat(clothBodies[i]));
+	int groupCount = bodyCount + (int)clothNetworks.size();
+	clothGroupLower.resize(groupCount);
+	clothGroupUpper.resize(groupCount);
+	clothGroupStatic.assign(groupCount, 0);
+	for(int i = 0; i < bodyCount; i++)
+		clothBodies[i]->getWorldBounds(clothGroupLower[i], clothGroupUpper[i]);
+	//the sleeping cloth keeps its bounds, only the awake points are looked at
+	for(int i = 0; i < (int)clothNetworks.size(); i++)
+		if(isSleeping && clothNetworks[i] == &cloth)
+			clothSleep.bounds(cloth, g_fSphereSize, clothGroupLower[bodyCount+i], clothGroupUpper[bodyCount+i]);
+		else
+			BroadPhase::pointBounds(clothNetworks[i]->points, g_fSphereSize, clothGroupLower[bodyCount+i], clothGroupUpper[bodyCount+i]);
+	clothBroadPhase.update(clothGroupLower, clothGroupUpper, clothGroupStatic);
+	//pairs are sorted and bodies come first, so a body-cloth pair has its body as first
+	bool bodyTouchesCloth = false;
+	for(auto pair = clothBroadPhase.pairs.begin(); pair != clothBroadPhase.pairs.end(); pair++)
+		bodyTouchesCloth |= pair->first < bodyCount && pair->second >= bodyCount;
+	if(bodyTouchesCloth)
+		clothBoxQuery.query(clothBoxes, clothNetworks);
+	else
+		clothBoxQuery.clear();
+	collWithRB = clothBoxQuery.getHitCount();
+
+	//for each collision point apply an impulse between the point and the rigid body
+	for(int hit = 0; hit < clothBoxQuery.getHitCount(); hit++) {
+		rigidBody* rb = clothBodies[clothBoxQuery.hitBox[hit]];
+		SpringPoint* point = &clothNetworks[clothBoxQuery.hitNetwork[hit]]->points[clothBoxQuery.hitPoint[hit]];
+		if(isSleeping)
+			clothSleep.wakePoint(clothBoxQuery.hitPoint[hit]);
+		XMFLOAT3 zeroVec = XMFLOAT3(0,0,0);
+		float v_relative_dot;
+
+		XMFLOAT3 cross;
+		XMFLOAT3 collisionPoint = point->gp_position;
+		XMStoreFloat3(&cross, XMVector3Cross(XMLoadFloat3(&rb->getAngularVelocity()), XMLoadFloat3(&subVector(collisionPoint,rb->getPosition()))));
+		XMFLOAT3 v1 = addVector(rb->getVelocity(), cross);
+		XMFLOAT3 v2 = point->getVelocity();
+		//v_relative_dot;
+		v1 = subVector(v1,v2);
+		XMVECTOR normalWorld = XMVector3Normalize(XMLoadFloat3( &subVector( point->gp_position,point->gp_posTemp)));
+		XMStoreFloat(&v_relative_dot, XMVector3Dot(normalWorld,XMLoadFloat3(&v1)));
+
+		if(v_relative_dot > 0 ) { //separating
+		
+		}
+		else if ( v_relative_dot < 0) { //colliding
+			//std::cout << "Colliding" << std::endl;
+			//calculateImpulse();
+			float c = 0.5f; //this should determine if the body is elastic or plastic.. for now i'll leave it as plastic!
+
+			float ma = rb->getMassInverse(), mb = 1/point->gp_mass;
+
+			float numerator = -(1+c)*v_relative_dot;
+
+			XMVECTOR tempVec_a, tempVec_b, center_1, center_2;
+			center_1 = XMLoadFloat3(&(subVector(collisionPoint,rb->getPosition())));
+			center_2 = XMLoadFloat3(&(subVector(collisionPoint,point->gp_position)));
+			tempVec_a = XMVector3Transform(XMVector3Cross(XMVector3Cross(center_1,normalWorld),center_1),rb->getInertiaTensorInverse());
+			tempVec_b = XMVector3Transform(XMVector3Cross(XMVector3Cross(center_2,normalWorld),center_2),rb->getInertiaTensorInverse());
+			tempVec_a = XMVector3Dot(tempVec_a+tempVec_b,normalWorld);
+
+			float temp;
+			XMStoreFloat(&temp, tempVec_a);
+			float denominator = ma + mb + temp;
+
+			float impulse = numerator / denominator;
+
+			XMFLOAT3 newVelocity_1, newVelocity_2, newAngMom_1, newAngMom_2,tempf3;
+			normalWorld *= impulse; //scale the normal with the impulse
+
+			XMStoreFloat3(&tempf3, normalWorld*ma);
+			newVelocity_1 = addVector(rb->getAngularVelocity(),tempf3);
+
+			XMStoreFloat3(&tempf3, normalWorld*mb);
+			newVelocity_2 = subVector(zeroVec,tempf3);
+
+			XMStoreFloat3(&tempf3, XMVector3Cross(center_1,normalWorld));
+			newAngMom_1 = addVector(rb->getAngularMomentum(),tempf3);
+
+			XMStoreFloat3(&tempf3, XMVector3Cross(center_2,normalWorld));
+			newAngMom_2 = subVector(zeroVec,tempf3);
+
+			if(!rb->isStatic)
+			{
+				rb->setLinearVelocity(newVelocity_1);
+				rb->setAngularMomentum(newAngMom_1);
+			}
+			if(!point->gp_isStatic)
+			{
+				point->setVelocity(newVelocity_2);
+				//body2->setAngularMomentum(newAngMom_2);
+			}
+		}
+		else { //sliding
+			//std::cout << "vadym ist dick" << std::endl;
+		}
+	}
+
+	//remove the springs torn during this step in one go
+	cloth.applyTears();
+	if(isSleeping)
+		clothSleep.update(cloth, g_gravity);
+}
+
 //--------------------------------------------------------------------------------------
 // Handle updates to the scene
 //--------------------------------------------------------------------------------------
@@ -1684,6 +2755,8 @@ void CALLBACK OnFrameMove(double dTime, float fElapsedTime, void* pUserContext)
 		TwDeleteBar(g_pTweakBar);
 		g_pTweakBar = nullptr;
 		InitTweakBar(g_pPd3Device);
+		g_simulationClock.reset();
+		currentTime = timeGetTime();
 		switch (g_iTestCase)
 		{
 		case 0:
@@ -1899,7 +2972,10 @@ void CALLBACK OnFrameMove(double dTime, float fElapsedTime, void* pUserContext)
 	// update current setup for each frame
 	SpringPoint* a;
 	Spring* b;
-	XMMATRIX g2a;
+	float frameTime;
+	int numSteps;
+	//only the fixed step demos interpolate, everything else shows the current state
+	g_renderAlpha = 1.0f;
 	switch (g_iTestCase)
 	{// handling different cases
 	case 0:
@@ -1951,119 +3027,35 @@ void CALLBACK OnFrameMove(double dTime, float fElapsedTime, void* pUserContext)
 	case 3:
 		previousTime = currentTime;
 		currentTime = timeGetTime();
-		deltaTime = (currentTime-previousTime)/1000.0f;
-		if(g_fixedTimestep) {
-			deltaTime = g_manualTimestep;
-		}
+		frameTime = (currentTime-previousTime)/1000.0f;
+		g_simulationClock.fixedStep = g_manualTimestep;
+		//with a frame locked timestep every frame simulates exactly one step, like before
+		numSteps = (g_fixedTimestep || g_bSimulateByStep) ? g_simulationClock.singleStep() : g_simulationClock.advance(frameTime);
+		deltaTime = g_simulationClock.fixedStep;
 
 		if(g_preIntegrationMethod != g_integrationMethod || g_preDemoCase != g_demoCase) {
 			ResetMassSprings(deltaTime);
 			g_preIntegrationMethod = g_integrationMethod;
 			g_preDemoCase = g_demoCase;
 		}
-		switch (g_integrationMethod)
-		{
-		case 0: //EULER
-			for(auto spring = springs.begin(); spring != springs.end(); spring++)
-			{
-				b= &((Spring)*spring);
-				b->computeElasticForces();
-			}
-			for(auto point = points.begin(); point != points.end();point++)
-			{
-
-				a =  ((SpringPoint*)*point);
-				if(g_useGravity) { a->addGravity(g_gravity); }
-				if(g_useDamping) {a->addDamping(deltaTime); }
-				a->IntegratePosition(deltaTime);
-				a->computeAcceleration();
-				a->IntegrateVelocity(deltaTime);
-				a->resetForces();
-				if(g_usingWalls)
-					a->computeCollisionWithWalls(deltaTime,g_fSphereSize,g_xWall,g_zWall,g_ceiling);
-				else
-					a->computeCollision(deltaTime, g_fSphereSize);
-			}	
-			
-			if(g_firstStep == true && g_demoCase == 0)
-			{
-				for(auto spring = springs.begin(); spring != springs.end(); spring++)
-				{
-					b= &((Spring)*spring);
-					std::cout << "\nEuler demo1 after one time step:\n";
-					b->printSpring();
-				}
-				g_firstStep = false;
-			}
-			break;
-		case 1: //MIDPOINT
-			for(auto spring = springs.begin(); spring != springs.end();spring++)
-			{
-				b= &(((Spring)*spring));
-				b->computeElasticForces();
-			}
-			for(auto point = points.begin(); point != points.end();point++)
-			{	
-				a =  (((SpringPoint*)*point));
-				if(g_useGravity) { a->addGravity(g_gravity); }
-				a->gp_posTemp = a->IntegratePositionTmp(deltaTime/2.0f);
-				a->computeAcceleration();
-				a->gp_velTemp = a->IntegrateVelocityTmp(deltaTime/2.0f);
-				if(g_useDamping) {a->addDamping(deltaTime); }
-				a->IntegratePosition(deltaTime, a->gp_velTemp);
-				a->resetForces();
-			}
-			for(auto spring = springs.begin(); spring != springs.end();spring++)
-			{
-				b= &(((Spring)*spring));
-				b->computeElasticForcesTmp();
-			}
-			for(auto point = points.begin(); point != points.end();point++)
-			{
-				a =  (((SpringPoint*)*point));
-				a->IntegrateVelocity(deltaTime);
-				a->resetForces();				
-				if(g_usingWalls)
-					a->computeCollisionWithWalls(deltaTime,g_fSphereSize,g_xWall,g_zWall,g_ceiling);
-				else
-					a->computeCollision(deltaTime, g_fSphereSize);
-			}
-
-			if(g_firstStep == true && g_demoCase == 0)
-			{
-				for(auto spring = springs.begin(); spring != springs.end(); spring++)
-				{
-					b= &((Spring)*spring);
-					std::cout << "\nMidpoint demo1 after one time step:\n";
-					b->printSpring();
-				}
-				g_firstStep = false;
+		if(g_integrationMethod == 3) {
+			//the adaptive integrator picks its own steps, only the last fixed step is split off for the interpolation
+			if(numSteps > 1)
+				StepMassSpringSystem((numSteps-1)*deltaTime);
+			if(numSteps > 0) {
+				for(auto point = points.begin(); point != points.end();point++)
+					(*point)->storePreviousPosition();
+				StepMassSpringSystem(deltaTime);
 			}
-			break;
-		case 2: //LEAP FROG
-			for(auto spring = springs.begin(); spring != springs.end();spring++)
-			{
-				b= &(((Spring)*spring));
-				b->computeElasticForces();
+		}
+		else {
+			for(int step = 0; step < numSteps; step++) {
+				for(auto point = points.begin(); point != points.end();point++)
+					(*point)->storePreviousPosition();
+				StepMassSpringSystem(deltaTime);
 			}
-			for(auto point = points.begin(); point != points.end();point++)
-			{
-				a =  (((SpringPoint*)*point));
-				if(g_useGravity) { a->addGravity(g_gravity); }
-				a->computeAcceleration();
-				a->IntegrateVelocity(deltaTime);
-				if(g_useDamping) {a->addDamping(deltaTime); }
-				a->IntegratePosition(deltaTime);
-				a->resetForces();
-				if(g_usingWalls)
-					a->computeCollisionWithWalls(deltaTime,g_fSphereSize,g_xWall,g_zWall,g_ceiling);
-				else
-					a->computeCollision(deltaTime, g_fSphereSize);
-			}	
-			break;
-		default:
-			break;
 		}
+		g_renderAlpha = g_simulationClock.getAlpha();
 
 		// REALLY SIMPLE COLLISION DETECTION WITH GROUND PLANE
 		/*
@@ -2134,79 +3126,36 @@ void CALLBACK OnFrameMove(double dTime, float fElapsedTime, void* pUserContext)
 	case 7:
 		previousTime = currentTime;
 		currentTime = timeGetTime();
-		deltaTime = (currentTime-previousTime)/1000.0f;
-		if(g_fixedTimestep) {
-			deltaTime = g_manualTimestep;
+		frameTime = (currentTime-previousTime)/1000.0f;
+		//a different box count or shape mix sets the scene up again
+		if(g_rigidBodyCount != g_preRigidBodyCount || g_rigidBodyShapes != g_preRigidBodyShapes) {
+			g_preRigidBodyCount = g_rigidBodyCount;
+			g_preRigidBodyShapes = g_rigidBodyShapes;
+			g_iPreTestCase = -1;
+			break;
 		}
-		for(auto rb = rigidBodies->begin(); rb != rigidBodies->end();rb++)
-		{
-			rb->integrateValues(deltaTime);
-			if(g_useGravity)
-				rb->addGravity(deltaTime, g_gravity);
-			if(g_useDamping)
-				rb->addDamping(deltaTime, g_damping_linear, g_damping_angular);
-		}
-		rigidBody* first;
-		rigidBody* second;
-		for(auto one = rigidBodies->begin(); one != rigidBodies->end();one++)
-		{
-			first = &(*one);
-			for(auto two = one+1; two != rigidBodies->end();two++)
-			{
-				second = &(*two);
-
-					mat1 = getObj2WorldMat(first);
-					mat2 = getObj2WorldMat(second);
-					simpletest = checkCollision(mat1, mat2);
-					if (!simpletest.isValid){ // Check if a corner of mat1 is in mat2
-						simpletest = checkCollision(mat2, mat1);
-						simpletest.normalWorld = -simpletest.normalWorld;// we compute the impulse to A
-					}
-					if (!simpletest.isValid)
-					{
-					}
-					else{
-						XMFLOAT3 collisionPoint;// ,collisionNormal;
-						XMStoreFloat3(&collisionPoint,simpletest.collisionPointWorld); 
-						contact = Contact(collisionPoint,simpletest.normalWorld, first, second);
-						contact.calcRelativeVelocity();
-			
-					}
-
-			}
-		}
-		//collision with floor
-		second = floorRB;
-		for(auto one = rigidBodies->begin(); one != rigidBodies->end();one++)
-		{				
-			first = &*one;
-			mat1 = getObj2WorldMat(first);
-			mat2 = getObj2WorldMat(second);
-			simpletest = checkCollision(mat1, mat2);
-			if (!simpletest.isValid){ // Check if a corner of mat1 is in mat2
-				simpletest = checkCollision(mat2, mat1);
-				simpletest.normalWorld = -simpletest.normalWorld;// we compute the impulse to A
-			}
-			if (!simpletest.isValid)
-			{			
-				//std::printf("No Collision\n");
-			}
-			else
-			{
-				XMFLOAT3 collisionPoint;// ,collisionNormal;
-				XMStoreFloat3(&collisionPoint,simpletest.collisionPointWorld); 
-				//XMStoreFloat3(&collisionNormal,simpletest.normalWorld); 
-				contact = Contact(collisionPoint,/*collisionNormal*/simpletest.normalWorld, first, second);
-				contact.calcRelativeVelocity();
-			}
+		g_simulationClock.fixedStep = g_manualTimestep;
+		numSteps = (g_fixedTimestep || g_bSimulateByStep) ? g_simulationClock.singleStep() : g_simulationClock.advance(frameTime);
+		BeginHeapCount();
+		for(int step = 0; step < numSteps; step++) {
+			rigidBodyWorld.storePreviousState();
+			StepRigidBodies(g_simulationClock.fixedStep);
+			g_stepArenaKB = g_stepArena.getUsed()/1024.0f;
+			g_stepArena.reset();
 		}
+		EndHeapCount();
+		g_renderAlpha = g_simulationClock.getAlpha();
 		break;
 	case 8:
 		if(g_Benchmark) {
 			//previousTime = timeGetTime();
 			bench_begin = std::chrono::high_resolution_clock::now();
 		}
-		FluidSimulation::integrateFluid(*fluid, .001f, g_gravity, lowerBoxBoundary, upperBoxBoundary, true, true, false);
+		BeginHeapCount();
+		FluidSimulation::integrateFluid(*fluid, .001f, g_gravity, lowerBoxBoundary, upperBoxBoundary, true, true, false, g_stepArena);
+		g_stepArenaKB = g_stepArena.getUsed()/1024.0f;
+		g_stepArena.reset();
+		EndHeapCount();
 		if(g_Benchmark) {
 			//print [current time - saved time]
 			//save new current time
@@ -2223,7 +3172,11 @@ void CALLBACK OnFrameMove(double dTime, float fElapsedTime, void* pUserContext)
 			//previousTime = timeGetTime();
 			bench_begin = std::chrono::high_resolution_clock::now();
 		}
-		FluidSimulation::integrateFluid(*gridBasedFluid, .001f, g_gravity, lowerBoxBoundary, upperBoxBoundary, g_useGravity, g_usingWalls, g_useDamping);
+		BeginHeapCount();
+		FluidSimulation::integrateFluid(*gridBasedFluid, .001f, g_gravity, lowerBoxBoundary, upperBoxBoundary, g_useGravity, g_usingWalls, g_useDamping, g_stepArena);
+		g_stepArenaKB = g_stepArena.getUsed()/1024.0f;
+		g_stepArena.reset();
+		EndHeapCount();
 		if(g_Benchmark) {
 			//print [current time - saved time]
 			//save new current time
@@ -2240,164 +3193,69 @@ void CALLBACK OnFrameMove(double dTime, float fElapsedTime, void* pUserContext)
 		
 		previousTime = currentTime;
 		currentTime = timeGetTime();
-		deltaTime = (currentTime-previousTime)/1000.0f;
-		if(ex4_fixed)
-			deltaTime = 0.005;
-
-		collWithRB = 0;
-
-		for(auto spring = springs.begin(); spring != springs.end();spring++)
-		{
-			b= &(((Spring)*spring));
-			b->computeElasticForces();
-			b->computeDampingForces();
+		frameTime = (currentTime-previousTime)/1000.0f;
+		if(!g_clothReduced && g_preClothReduced) {
+			//leaving the reduced mode continues from the current shape
+			CancelClothModes();
+			clothModes.reconstruct(cloth, g_threadPool, 1.f);
+			clothModes.clear();
+			g_preClothReduced = false;
 		}
-		for(auto point = points.begin(); point != points.end();point++)
-		{	
-			a =  (((SpringPoint*)*point));
-			a->addGravity(g_gravity);
-			a->gp_posTemp = a->IntegratePositionTmp(deltaTime/2.0f);
-			a->computeAcceleration();
-			a->gp_velTemp = a->IntegrateVelocityTmp(deltaTime/2.0f);
-			//a->addDamping(deltaTime);
-			a->gp_posTemp = a->gp_posTemp; //store the previous pos
-			a->IntegratePosition(deltaTime, a->gp_velTemp);
-			
-			a->resetForces();
+		if(g_clothResolution != g_preClothResolution || g_clothFromMesh != g_preClothFromMesh || g_clothReduced != g_preClothReduced || g_clothFEM != g_preClothFEM || g_clothShapeMatching != g_preClothShapeMatching) {
+			g_preClothResolution = g_clothResolution;
+			g_preClothFromMesh = g_clothFromMesh;
+			g_preClothFEM = g_clothFEM;
+			g_preClothShapeMatching = g_clothShapeMatching;
+			//the modes are taken around the rest state, so entering the reduced mode starts over
+			g_preClothReduced = g_clothReduced;
+			ResetMassSprings(deltaTime);
+			g_simulationClock.reset();
 		}
-		for(auto spring = springs.begin(); spring != springs.end();)
-		{
-			b= &(((Spring)*spring));
-			b->computeElasticForcesTmp();
-			b->computeDampingForcesTmp();
-
-			auto it = spring;
-			spring++;
-			if(spring->checkRipe(ripeforce))
-			{
-				springs.erase(it);
-			}
+		if(g_clothReduced && !clothModes.isBuilt() && !ClothModesBuilding())
+			StartClothModes();
+		PollClothModes();
+		//a different cluster size only needs new clusters, the cloth keeps going
+		if(g_clothClusterScale != g_preClothClusterScale) {
+			g_preClothClusterScale = g_clothClusterScale;
+			if(clothShapeMatching.isInitialized())
+				InitClothShapeMatching();
 		}
-		for(auto point = points.begin(); point != points.end();point++)
-		{
-			a =  (((SpringPoint*)*point));
-			a->IntegrateVelocity(deltaTime);
-			a->resetForces();	
-			/*			
-			if(g_usingWalls)
-				a->computeCollisionWithWalls(deltaTime,g_fSphereSize,g_xWall,g_zWall,g_ceiling);
-			else*/
-				a->computeCollision(deltaTime, g_fSphereSize);
-				a->addDamping(deltaTime);
-				
-		}
-		//integrate rb
-		rb->integrateValues(deltaTime);
-		if(cloth_horizontal)
-			rb->addGravity(deltaTime, g_gravity);
-		//rb->addDamping(deltaTime, g_damping_linear, g_damping_angular);
-
-		g2a = getObj2WorldMat(rb);
-		collPoints = new std::vector<CollPoint>();
-		for(auto point = points.begin(); point != points.end();point++)
-		{
-			simpletest = gayTest(g2a,(*point));
-			if (simpletest.isValid) {
-					XMFLOAT3 collisionPoint;// ,collisionNormal;
-					XMStoreFloat3(&collisionPoint,simpletest.collisionPointWorld);
-					//cout<<"collega";
-					/**
-					contact = Contact(collisionPoint,simpletest.normalWorld, first, second);
-					contact.calcRelativeVelocity();
-			        **/
-
-					//this should technically give us a list of (point, collisionInfo) and the total count of collisions with the rigid body.
-					//technically we could expand this so #collisions for each face is tracked, but for now, this has to do.
-					CollPoint* cp = new CollPoint();
-					cp->point = *point;
-					cp->info = &simpletest;
-					collPoints->push_back(*cp);
-					collWithRB++;
+		if(g_clothShapeMatching && !clothShapeMatching.isInitialized())
+			InitClothShapeMatching();
+		//sleeping can be switched on at any time, the regions are taken around the current positions
+		if(!g_clothSleep && clothSleep.isInitialized())
+			clothSleep.clear();
+		if(g_clothSleep && !clothSleep.isInitialized())
+			InitClothSleep();
+		g_simulationClock.fixedStep = g_clothTimestep;
+		numSteps = (ex4_fixed || g_bSimulateByStep || g_Benchmark) ? g_simulationClock.singleStep() : g_simulationClock.advance(frameTime);
+		if(g_Benchmark)
+			bench_begin = std::chrono::high_resolution_clock::now();
+		BeginHeapCount();
+		for(int step = 0; step < numSteps; step++) {
+			//sleeping points don't move, their previous position already is their position
+			if(!ClothReducedRuns() && ClothSleepApplies()) {
+				clothSleep.prepare(cloth);
+				for(auto index = clothSleep.activePoints.begin(); index != clothSleep.activePoints.end(); index++)
+					cloth.points[*index].storePreviousPosition();
 			}
+			else if(!ClothReducedRuns())
+				for(auto point = cloth.points.begin(); point != cloth.points.end();point++)
+					point->storePreviousPosition();
+			rb->storePreviousState();
+			StepClothAndRigidBody(g_simulationClock.fixedStep);
+			g_stepArenaKB = g_stepArena.getUsed()/1024.0f;
+			g_stepArena.reset();
 		}
-
-		//here we should iterate over the collPoints list and for each collision point, 
-		//	apply the rigidbody's impulse * 1/collWithRB to the point, 
-		//	as well as apply the point's impulse to the RB. (what is the impulse for each though? relative velocity mirrored at the normal and damped by some retention value?)
-		//TODO
-		
-	//	std::cout << collPoints->size() << std::endl;
-		for(auto cp = collPoints->begin(); cp != collPoints->end(); cp++) {
-			XMFLOAT3 zeroVec = XMFLOAT3(0,0,0);
-			float v_relative_dot;
-
-			XMFLOAT3 cross;
-			XMFLOAT3 collisionPoint;
-			XMStoreFloat3(&collisionPoint,cp->info->collisionPointWorld);
-			XMStoreFloat3(&cross, XMVector3Cross(XMLoadFloat3(&rb->getAngularVelocity()), XMLoadFloat3(&subVector(collisionPoint,rb->getPosition()))));
-			XMFLOAT3 v1 = addVector(rb->getVelocity(), cross);
-			XMFLOAT3 v2 = cp->point->getVelocity();
-			//v_relative_dot;
-			v1 = subVector(v1,v2);
-			cp->info->normalWorld = XMVector3Normalize(XMLoadFloat3( &subVector( cp->point->gp_position,cp->point->gp_posTemp)));
-			XMStoreFloat(&v_relative_dot, XMVector3Dot(cp->info->normalWorld,XMLoadFloat3(&v1)));
-
-			if(v_relative_dot > 0 ) { //separating
-			
-			}
-			else if ( v_relative_dot < 0) { //colliding
-				//std::cout << "Colliding" << std::endl;
-				//calculateImpulse();
-				float c = 0.5f; //this should determine if the body is elastic or plastic.. for now i'll leave it as plastic!
-
-				float ma = rb->getMassInverse(), mb = 1/cp->point->gp_mass;
-
-				float numerator = -(1+c)*v_relative_dot;
-
-				XMVECTOR tempVec_a, tempVec_b, center_1, center_2;
-				center_1 = XMLoadFloat3(&(subVector(collisionPoint,rb->getPosition())));
-				center_2 = XMLoadFloat3(&(subVector(collisionPoint,cp->point->gp_position)));
-				tempVec_a = XMVector3Transform(XMVector3Cross(XMVector3Cross(center_1,cp->info->normalWorld),center_1),rb->getInertiaTensorInverse());
-				tempVec_b = XMVector3Transform(XMVector3Cross(XMVector3Cross(center_2,cp->info->normalWorld),center_2),rb->getInertiaTensorInverse());
-				tempVec_a = XMVector3Dot(tempVec_a+tempVec_b,cp->info->normalWorld);
-
-				float temp;
-				XMStoreFloat(&temp, tempVec_a);
-				float denominator = ma + mb + temp;
-
-				float impulse = numerator / denominator;
-
-				XMFLOAT3 newVelocity_1, newVelocity_2, newAngMom_1, newAngMom_2,tempf3;
-				cp->info->normalWorld *= impulse; //scale the normal with the impulse
-	
-				XMStoreFloat3(&tempf3, cp->info->normalWorld*ma);
-				newVelocity_1 = addVector(rb->getAngularVelocity(),tempf3);
-
-				XMStoreFloat3(&tempf3, cp->info->normalWorld*mb);
-				newVelocity_2 = subVector(zeroVec,tempf3);
-
-				XMStoreFloat3(&tempf3, XMVector3Cross(center_1,cp->info->normalWorld));
-				newAngMom_1 = addVector(rb->getAngularMomentum(),tempf3);
-
-				XMStoreFloat3(&tempf3, XMVector3Cross(center_2,cp->info->normalWorld));
-				newAngMom_2 = subVector(zeroVec,tempf3);
-
-				if(!rb->isStatic)
-				{
-					rb->setLinearVelocity(newVelocity_1);
-					rb->setAngularMomentum(newAngMom_1);
-				}
-				if(!cp->point->gp_isStatic)
-				{
-					cp->point->setVelocity(newVelocity_2);
-					//body2->setAngularMomentum(newAngMom_2);
-				}
-			}
-			else { //sliding
-				//std::cout << "vadym ist dick" << std::endl;
-			}
+		EndHeapCount();
+		if(g_Benchmark) {
+			bench_end = std::chrono::high_resolution_clock::now();
+			frametimeCloth = std::chrono::duration_cast<std::chrono::microseconds>(bench_end-bench_begin).count()/1000.0f;
 		}
-
+		//outside the timed part, tearing or loading a mesh bumps the revision
+		if(g_clothAutoReorder && !g_clothReduced && cloth.topologyRevision != clothOrderedRevision)
+			ReorderCloth();
+		g_renderAlpha = g_simulationClock.getAlpha();
 		break;	
 	default: 
 		break;
@@ -2475,11 +3333,12 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 		break;
 #endif
 	case 7:
-		for(auto rb = rigidBodies->begin(); rb != rigidBodies->end();rb++)
-		{
-			DrawCollisionCubes(&((rigidBody)*rb));
-		}
-	//	DrawCube(floorRB);
+		//the floor is the last body, it isn't drawn
+		for(int i = 0; i < rigidBodyWorld.size() - 1; i++)
+			if(rigidBodyWorld.bodyShapes[i] < 0)
+				DrawCollisionCube(rigidBodyWorld.renderTransform(i, g_renderAlpha));
+			else
+				DrawConvexShape(pd3dImmediateContext, rigidBodyWorld.shapes[rigidBodyWorld.bodyShapes[i]], rigidBodyWorld.renderTransform(i, g_renderAlpha));
 		break;
 	case 8:
 		{
@@ -2504,7 +3363,11 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 	// EX 4 - COMBINED
 	case 10:
 		//std::cout << "Ex4 comobmomomombo " << std::endl;
-		if (g_bDrawMassSpringSystem) DrawMassSpringSystem(pd3dImmediateContext);
+		if (g_bDrawMassSpringSystem && !g_Benchmark) {
+			if(ClothReducedRuns())
+				clothModes.reconstruct(cloth, g_threadPool, g_renderAlpha);
+			DrawSpringNetwork(pd3dImmediateContext, cloth);
+		}
 		DrawCube(rb);
 		break;
 	default:
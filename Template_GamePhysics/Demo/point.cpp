@@ -2,6 +2,7 @@
 using namespace DirectX;
 #include "vectorOperations.h"
 #include "point.h"
+#include "PointCollision.h"
 
 #define g -9.81f
 
@@ -23,7 +24,7 @@ SpringPoint::SpringPoint()
 SpringPoint::SpringPoint(XMFLOAT3 position)
 {
 	initialize();
-	gp_position = position;
+	gp_position = gp_prevPosition = position;
 
 
 }
@@ -31,6 +32,7 @@ SpringPoint::SpringPoint(XMFLOAT3 position)
 void SpringPoint::initialize()
 {
 	gp_position =	XMFLOAT3(0,0,0);
+	gp_prevPosition = XMFLOAT3(0,0,0);
 	gp_velocity =	XMFLOAT3(0,0,0);
 	gp_force	=	XMFLOAT3(0,0,0);
 	gp_acceleration =	XMFLOAT3(0,0,0);
@@ -108,104 +110,29 @@ void SpringPoint::resetForces()
 {
 	gp_force = XMFLOAT3(0,0,0);
 }
+//single point versions, batches should call PointCollision::resolve directly
 void SpringPoint::computeCollision(float deltaTime, float sphereSize)
 {
 	//Ground at y=-1;
-	if(!gp_isStatic)
-	{
-		if(gp_position.y<-1+sphereSize)
-		{
-			gp_position.y = (-1+sphereSize)-(gp_position.y+1-sphereSize)*gp_bouncyness; //simulates a dampend bounce with constant velocity
-			gp_velocity.y = -gp_velocity.y*gp_bouncyness;
-
-			//apply friction, scaled on the frametime
-			gp_velocity.x -= gp_velocity.x*deltaTime*(1-gp_groundFriction);
-			gp_velocity.z -= gp_velocity.z*deltaTime*(1-gp_groundFriction);
-		}
-	}
+	SpringPoint* self = this;
+	PointCollision::resolve(&self, 1, ContainmentBox::ground(sphereSize), deltaTime);
 }
 void SpringPoint::computeCollisionWithWalls(float deltaTime, float sphereSize, float xWall, float zWall, float ceiling)
 {
-	if(!gp_isStatic)
-	{
-		//Ground at y=-1;
-		bool collided = true;
-		while(collided)
-		{
-			collided = false;
-
-			//test floor collision
-			if(gp_position.y<-1+sphereSize)
-			{
-				collided = true;
-				gp_position.y = (-1+sphereSize)-(gp_position.y+1-sphereSize)*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.y = -gp_velocity.y*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.x -= gp_velocity.x*deltaTime*(gp_groundFriction);
-				gp_velocity.z -= gp_velocity.z*deltaTime*(gp_groundFriction);
-			}
-			//test negative x-wall collision
-			if(gp_position.x<-xWall+sphereSize)
-			{
-				collided = true;
-				gp_position.x = (-xWall+sphereSize)-(gp_position.x+xWall-sphereSize)*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.x = -gp_velocity.x*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.y -= gp_velocity.y*deltaTime*(gp_groundFriction);
-				gp_velocity.z -= gp_velocity.z*deltaTime*(gp_groundFriction);
-			}
-			//test negative z-wall collision
-			if(gp_position.z<-zWall+sphereSize)
-			{
-				collided = true;
-				gp_position.z = (-zWall+sphereSize)-(gp_position.z+zWall-sphereSize)*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.z = -gp_velocity.z*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.y -= gp_velocity.y*deltaTime*(gp_groundFriction);
-				gp_velocity.x -= gp_velocity.x*deltaTime*(gp_groundFriction);
-			}
-
-			//test ceiling collision
-			if(gp_position.y>ceiling-sphereSize)
-			{
-				collided = true;
-				gp_position.y = (ceiling-sphereSize)-(gp_position.y-(ceiling-sphereSize))*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.y = -gp_velocity.y*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.x -= gp_velocity.x*deltaTime*(gp_groundFriction);
-				gp_velocity.z -= gp_velocity.z*deltaTime*(gp_groundFriction);
-			}
-			//test positive x-wall collision
-			if(gp_position.x>xWall-sphereSize)
-			{
-				collided = true;
-				gp_position.x = (xWall-sphereSize)-(gp_position.x-(xWall-sphereSize))*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.x = -gp_velocity.x*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.y -= gp_velocity.y*deltaTime*(gp_groundFriction);
-				gp_velocity.z -= gp_velocity.z*deltaTime*(gp_groundFriction);
-			}
-			//test positive z-wall collision
-			if(gp_position.z>zWall-sphereSize)
-			{
-				collided = true;
-				gp_position.z = (zWall-sphereSize)-(gp_position.z-(zWall-sphereSize))*gp_bouncyness; //simulates a dampend bounce with constant velocity
-				gp_velocity.z = -gp_velocity.z*gp_bouncyness;
-
-				//apply friction, scaled on the frametime
-				gp_velocity.y -= gp_velocity.y*deltaTime*(gp_groundFriction);
-				gp_velocity.x -= gp_velocity.x*deltaTime*(gp_groundFriction);
-			}
-		}
-	}
+	SpringPoint* self = this;
+	PointCollision::resolve(&self, 1, ContainmentBox::walls(sphereSize, xWall, zWall, ceiling), deltaTime);
 }
 
 XMFLOAT3 SpringPoint::getVelocity()
 {
 	return gp_velocity;
-};
\ No newline at end of file
+};
+void SpringPoint::storePreviousPosition()
+{
+	gp_prevPosition = gp_position;
+}
+XMFLOAT3 SpringPoint::getRenderPosition(float alpha)
+{
+	//lerp between the last two simulated states
+	return addVector(gp_prevPosition, multiplyVector(subVector(gp_position, gp_prevPosition), alpha));
+}
\ No newline at end of file
@@ -12,6 +12,8 @@ class SpringPoint
 {
 public:
 	XMFLOAT3 gp_position;
+	//position at the end of the previous fixed step, for render interpolation
+	XMFLOAT3 gp_prevPosition;
 	XMFLOAT3 gp_posTemp;
 	XMFLOAT3 gp_velocity;
 	XMFLOAT3 gp_velTemp;
@@ -38,6 +40,8 @@ public:
 	void addGravity(float gravity);
 	void addDamping(float deltaTime);
 	XMFLOAT3 getVelocity();
+	void storePreviousPosition();
+	XMFLOAT3 getRenderPosition(float alpha);
 
 	void SpringPoint::IntegrateVelocity(float deltaTime);
 	XMFLOAT3 SpringPoint::IntegrateVelocityTmp(float deltaTime);
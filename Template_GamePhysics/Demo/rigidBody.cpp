@@ -14,7 +14,6 @@ using namespace DirectX;
 //XMFLOAT3 r_position;
 //XMFLOAT3 r_velocity;
 //XMMATRIX inertiaTensorInverse;
-XMMATRIX currentInertiaInverse;
 //XMFLOAT4 orientation;
 //XMFLOAT3 angularVelocity;
 //XMFLOAT3 angularMomentum;
@@ -42,7 +41,7 @@ void rigidBody::preCompute()
 
 	//inertiaTensorInverse = XMMATRIX(0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0);
 	XMMATRIX I =  DirectX::XMMatrixInverse(nullptr,XMMATRIX(m*(y+z),0,0,0,0,m*(x+z),0,0,0,0,m*(x+y),0,0,0,0,1));
-	inertiaTensorInverse = currentInertiaInverse = I;
+	inertiaTensorInverse = worldInertiaInverse = I;
 	for(auto mp = points->begin(); mp != points->end(); mp++) {
 		//position to model view
 		mp->position = subVector(mp->position, r_position);
@@ -62,12 +61,10 @@ void rigidBody::computeInverInertTensAndAngVel()
 	//
 	//inverse inertia tensor
 	XMMATRIX rotationMatrix = XMMatrixRotationQuaternion(XMLoadFloat4(&rotationQuaternion));
-	//TODO: fix this more neatly.. There was a problem with inertiaTensor beeing private, so i just made a temp copy for now
-	//currentInertiaInverse = XMMatrixMultiply(XMMatrixMultiply(rotationMatrix, inertiaTensorInverse), XMMatrixTranspose(rotationMatrix));
-	XMMATRIX temp = inertiaTensorInverse;
-	currentInertiaInverse = XMMatrixMultiply(rotationMatrix*temp,XMMatrixTranspose(rotationMatrix));
+	//row vectors: into body space (transposed rotation), the body inverse inertia, back into world space
+	worldInertiaInverse = XMMatrixMultiply(XMMatrixTranspose(rotationMatrix)*inertiaTensorInverse, rotationMatrix);
 	//angular velocity
-	XMStoreFloat3(&angularVelocity, XMVector3Transform(XMLoadFloat3(&angularMomentum), currentInertiaInverse));
+	XMStoreFloat3(&angularVelocity, XMVector3Transform(XMLoadFloat3(&angularMomentum), worldInertiaInverse));
 	//angularVelocity = normalizeVector(angularVelocity);
 }
 
@@ -100,10 +97,10 @@ void rigidBody::integrateValues(float timeStep) {
 			XMVectorAdd(
 					// (0,w)r * h/2
 					XMVectorScale(
-						// (0,w)r
+						// (0,w)r, XMQuaternionMultiply(a, b) is b*a and w is in world space, so the rotation goes first
 						XMQuaternionMultiply(
-							XMLoadFloat4(&XMFLOAT4(angularVelocity.x, angularVelocity.y, angularVelocity.z, .0f)), 
-							XMLoadFloat4(&rotationQuaternion))
+							XMLoadFloat4(&rotationQuaternion),
+							XMLoadFloat4(&XMFLOAT4(angularVelocity.x, angularVelocity.y, angularVelocity.z, .0f)))
 						, timeStep / 2), 
 					// + original rotation
 					XMLoadFloat4(&rotationQuaternion))
@@ -140,6 +137,8 @@ void rigidBody::addDamping(float timeStep, float linear, float angular)
 void rigidBody::setPosition(XMFLOAT3 newPos) {
 	XMFLOAT3 centerOffset = subVector(newPos,r_position);
 	r_position = addVector(r_position,centerOffset);
+	//teleport, don't interpolate from the old position
+	prevPosition = r_position;
 	for(auto mp = points->begin(); mp != points->end(); mp++) {
 		mp->worldPosition = addVector(centerOffset,mp->worldPosition);
 	}
@@ -151,11 +150,75 @@ void rigidBody::setStatic(bool val)
 	isStatic = val;
 }
 
+void rigidBody::getWorldBounds(XMFLOAT3& lower, XMFLOAT3& upper)
+{
+	//the half extents projected on the world axes, |R| * scale/2
+	XMMATRIX rotation = XMMatrixRotationQuaternion(XMLoadFloat4(&rotationQuaternion));
+	XMVECTOR extent = XMVectorAbs(rotation.r[0])*(0.5f*scale.x) + XMVectorAbs(rotation.r[1])*(0.5f*scale.y) + XMVectorAbs(rotation.r[2])*(0.5f*scale.z);
+	XMVECTOR centre = XMLoadFloat3(&r_position);
+	XMStoreFloat3(&lower, centre - extent);
+	XMStoreFloat3(&upper, centre + extent);
+}
+
+XMMATRIX rigidBody::getWorldInertiaInverse()
+{
+	return worldInertiaInverse;
+}
+
+XMFLOAT3 rigidBody::getPointVelocity(XMFLOAT3 point)
+{
+	XMFLOAT3 cross;
+	XMStoreFloat3(&cross, XMVector3Cross(XMLoadFloat3(&angularVelocity), XMLoadFloat3(&subVector(point, r_position))));
+	return addVector(r_velocity, cross);
+}
+
+void rigidBody::applyImpulse(XMFLOAT3 point, XMFLOAT3 impulse)
+{
+	if(isStatic)
+		return;
+	r_velocity = addVector(r_velocity, multiplyVector(impulse, massInverse));
+	XMFLOAT3 torque;
+	XMStoreFloat3(&torque, XMVector3Cross(XMLoadFloat3(&subVector(point, r_position)), XMLoadFloat3(&impulse)));
+	angularMomentum = addVector(angularMomentum, torque);
+	XMStoreFloat3(&angularVelocity, XMVector3Transform(XMLoadFloat3(&angularMomentum), worldInertiaInverse));
+}
+
+void rigidBody::correctPosition(XMFLOAT3 translation, XMFLOAT3 rotation)
+{
+	if(isStatic)
+		return;
+	r_position = addVector(r_position, translation);
+	//same first order quaternion update as integrateValues
+	XMVECTOR q = XMLoadFloat4(&rotationQuaternion);
+	XMVECTOR turn = XMQuaternionMultiply(q, XMVectorSet(rotation.x, rotation.y, rotation.z, 0.f));
+	XMStoreFloat4(&rotationQuaternion, XMQuaternionNormalize(q + turn*0.5f));
+	computeInverInertTensAndAngVel();
+}
+
+void rigidBody::storePreviousState()
+{
+	prevPosition = r_position;
+	prevRotation = rotationQuaternion;
+}
+
+XMFLOAT3 rigidBody::getRenderPosition(float alpha)
+{
+	return addVector(prevPosition, multiplyVector(subVector(r_position, prevPosition), alpha));
+}
+
+XMFLOAT4 rigidBody::getRenderRotation(float alpha)
+{
+	XMFLOAT4 rot;
+	XMStoreFloat4(&rot, XMQuaternionSlerp(XMLoadFloat4(&prevRotation), XMLoadFloat4(&rotationQuaternion), alpha));
+	return rot;
+}
+
 void rigidBody::setLinearVelocity(XMFLOAT3 lV) {
 	r_velocity = lV;
 }
 void rigidBody::setAngularMomentum(XMFLOAT3 aM) {
 	angularMomentum = aM;
+	XMStoreFloat3(&angularVelocity, XMVector3Transform(XMLoadFloat3(&angularMomentum), worldInertiaInverse));
 }
 
 XMFLOAT3 rigidBody::getScale() {
@@ -205,6 +268,7 @@ rigidBody::rigidBody(std::vector<MassPoint>* pointList, XMFLOAT3 vel, XMFLOAT3 r
 	XMStoreFloat4(&rotationQuaternion,XMQuaternionRotationRollPitchYaw(rotation.x,rotation.y, rotation.z));
 	preCompute();
 	computeInverInertTensAndAngVel();
+	storePreviousState();
 }
 
 rigidBody::~rigidBody(void)
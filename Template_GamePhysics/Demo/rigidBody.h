@@ -16,6 +16,8 @@ private:
 	XMFLOAT3 r_position;
 	XMFLOAT3 r_velocity;
 	XMMATRIX inertiaTensorInverse;
+	//inertiaTensorInverse rotated into world space, kept up to date with the rotation
+	XMMATRIX worldInertiaInverse;
 	XMFLOAT4 orientation;
 	XMFLOAT3 angularVelocity;
 	XMFLOAT3 angularMomentum;
@@ -28,6 +30,10 @@ private:
 
 	XMMATRIX transform;
 
+	//state at the end of the previous fixed step, for render interpolation
+	XMFLOAT3 prevPosition;
+	XMFLOAT4 prevRotation;
+
 	std::vector<MassPoint>* points;
 public:
 	bool isStatic;
@@ -51,6 +57,19 @@ public:
 	void setLinearVelocity(XMFLOAT3 lV);
 	void setAngularMomentum(XMFLOAT3 aM);
 	void setStatic(bool val);
+	//world space bounds of the scaled unit cube
+	void getWorldBounds(XMFLOAT3& lower, XMFLOAT3& upper);
+	XMMATRIX getWorldInertiaInverse();
+	//velocity of the body at a world space point
+	XMFLOAT3 getPointVelocity(XMFLOAT3 point);
+	//changes the linear and angular velocity right away, static bodies ignore it
+	void applyImpulse(XMFLOAT3 point, XMFLOAT3 impulse);
+	//moves and turns (rotation vector, angle = length) the body without touching its velocity
+	void correctPosition(XMFLOAT3 translation, XMFLOAT3 rotation);
+
+	void storePreviousState();
+	XMFLOAT3 getRenderPosition(float alpha);
+	XMFLOAT4 getRenderRotation(float alpha);
 
 	rigidBody(void);
 	rigidBody(std::vector<MassPoint>* points, XMFLOAT3 vel, XMFLOAT3 rotation, XMFLOAT3 scale);
@@ -11,7 +11,6 @@ SpringPoint* gs_point2;
 float gs_stiffness = 40.0f;
 float gs_initialLength = 1.0f;
 float gs_currentLength = 1.0f;
-float gs_currentLengthTmp = 1.0f;
 float damping = 0.5f;
 
 Spring::Spring()
@@ -31,6 +30,7 @@ void Spring::initialize()
 	gs_point1 = nullptr;
 	gs_point2 = nullptr;
 	gs_currentLength=1;
+	gs_currentLengthTmp=1;
 	gs_initialLength = 1;
 	gs_stiffness = 40;
 };
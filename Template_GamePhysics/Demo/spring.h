@@ -15,6 +15,7 @@ public:
 	float gs_stiffness;
 	float gs_initialLength;
 	float gs_currentLength;
+	float gs_currentLengthTmp;
 	SpringPoint* gs_point1;
 	SpringPoint* gs_point2;
 